@@ -0,0 +1,69 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <invrequest.h>
+#include <primitives/txid.h>
+#include <random.h>
+
+#include <cassert>
+#include <chrono>
+#include <vector>
+
+static constexpr NodeId NUM_PEERS = 64;
+static constexpr size_t NUM_TXIDS = 2000;
+static constexpr size_t ANNOUNCERS_PER_TXID = 8;
+
+static constexpr std::chrono::microseconds REQUEST_DELAY{2'000'000};
+static constexpr std::chrono::microseconds REQUEST_EXPIRY{60'000'000};
+
+/**
+ * A burst of announcements from many peers, every transaction being requested
+ * from one of its announcers until the requests time out, then the peers
+ * disconnect.
+ */
+static void InvRequestTrackerBurst(benchmark::Bench &bench) {
+    FastRandomContext rng(true);
+    std::vector<TxId> txids;
+    for (size_t i = 0; i < NUM_TXIDS; ++i) {
+        txids.push_back(TxId(rng.rand256()));
+    }
+
+    bench.batch(NUM_TXIDS * ANNOUNCERS_PER_TXID)
+        .unit("announcement")
+        .run([&] {
+            InvRequestTracker<TxId> tracker(true);
+            std::chrono::microseconds now{1'000'000};
+            for (size_t i = 0; i < txids.size(); ++i) {
+                for (size_t j = 0; j < ANNOUNCERS_PER_TXID; ++j) {
+                    const NodeId peer = (i + j * 7) % NUM_PEERS;
+                    tracker.ReceivedInv(peer, txids[i], peer % 4 == 0,
+                                        now + REQUEST_DELAY);
+                }
+                now += std::chrono::microseconds{10};
+            }
+
+            // Request everything once the delay elapsed
+            now += REQUEST_DELAY;
+            std::vector<std::pair<NodeId, TxId>> expired;
+            for (NodeId peer = 0; peer < NUM_PEERS; ++peer) {
+                for (const TxId &txid :
+                     tracker.GetRequestable(peer, now, &expired)) {
+                    tracker.RequestedData(peer, txid, now + REQUEST_EXPIRY);
+                }
+            }
+
+            // All the requests expire at once
+            now += REQUEST_EXPIRY;
+            tracker.GetRequestable(0, now, &expired);
+            assert(expired.size() == NUM_TXIDS);
+
+            for (NodeId peer = 0; peer < NUM_PEERS; ++peer) {
+                tracker.DisconnectedPeer(peer);
+            }
+            assert(tracker.Size() == 0);
+        });
+}
+
+BENCHMARK(InvRequestTrackerBurst);
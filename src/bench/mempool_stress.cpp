@@ -3,10 +3,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <bench/bench.h>
+#include <core_memusage.h>
 #include <kernel/mempool_entry.h>
 #include <policy/policy.h>
 #include <random.h>
 #include <test/util/setup_common.h>
+#include <tinyformat.h>
 #include <txmempool.h>
 #include <validation.h>
 
@@ -106,6 +108,65 @@ static void ComplexMemPool(benchmark::Bench &bench) {
     });
 }
 
+static void MempoolRemoveForBlock(benchmark::Bench &bench) {
+    FastRandomContext det_rand{true};
+    int childTxs = 800;
+    if (bench.complexityN() > 1) {
+        childTxs = static_cast<int>(bench.complexityN());
+    }
+    std::vector<CTransactionRef> ordered_coins =
+        CreateOrderedCoins(det_rand, childTxs, /* min_ancestors */ 1);
+    // The first half of the transactions is mined, the others stay in the
+    // mempool with some of their parents gone.
+    const std::vector<CTransactionRef> block_txs(
+        ordered_coins.begin(),
+        ordered_coins.begin() + ordered_coins.size() / 2);
+    const auto testing_setup =
+        MakeNoLogFileContext<const TestingSetup>(CBaseChainParams::MAIN);
+    CTxMemPool &pool = *testing_setup.get()->m_node.mempool;
+    LOCK2(cs_main, pool.cs);
+    bench.run([&]() NO_THREAD_SAFETY_ANALYSIS {
+        for (auto &tx : ordered_coins) {
+            AddTx(tx, pool);
+        }
+        pool.removeForBlock(block_txs);
+        pool.clear();
+    });
+}
+
+static void MempoolMemoryUsage(benchmark::Bench &bench) {
+    FastRandomContext det_rand{true};
+    std::vector<CTransactionRef> ordered_coins =
+        CreateOrderedCoins(det_rand, 800, /* min_ancestors */ 1);
+    const auto testing_setup =
+        MakeNoLogFileContext<const TestingSetup>(CBaseChainParams::MAIN);
+    CTxMemPool &pool = *testing_setup.get()->m_node.mempool;
+    LOCK2(cs_main, pool.cs);
+
+    // Report the memory used per entry on top of the transaction itself, which
+    // is mostly the entry and its links to the parents and children.
+    size_t tx_usage{0};
+    for (auto &tx : ordered_coins) {
+        AddTx(tx, pool);
+        tx_usage += RecursiveDynamicUsage(tx);
+    }
+    if (bench.output() != nullptr) {
+        *bench.output() << strprintf(
+            "MempoolMemoryUsage: %u entries, %u bytes per entry, %u bytes of "
+            "overhead per entry\n",
+            pool.size(), pool.DynamicMemoryUsage() / pool.size(),
+            (pool.DynamicMemoryUsage() - tx_usage) / pool.size());
+    }
+    pool.clear();
+
+    bench.run([&]() NO_THREAD_SAFETY_ANALYSIS {
+        for (auto &tx : ordered_coins) {
+            AddTx(tx, pool);
+        }
+        pool.clear();
+    });
+}
+
 static void MempoolCheck(benchmark::Bench &bench) {
     FastRandomContext det_rand{true};
     auto testing_setup = MakeNoLogFileContext<TestChain100Setup>(
@@ -124,4 +185,6 @@ static void MempoolCheck(benchmark::Bench &bench) {
 }
 
 BENCHMARK(ComplexMemPool);
+BENCHMARK(MempoolRemoveForBlock);
+BENCHMARK(MempoolMemoryUsage);
 BENCHMARK(MempoolCheck);
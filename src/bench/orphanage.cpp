@@ -0,0 +1,104 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <net_processing.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <txorphanage.h>
+
+#include <cassert>
+#include <set>
+#include <vector>
+
+static constexpr size_t NUM_PEERS = 64;
+static constexpr size_t NUM_PARENTS = 100;
+static constexpr size_t CHILDREN_PER_PARENT = 50;
+
+/**
+ * Create NUM_PARENTS transactions with CHILDREN_PER_PARENT outputs, each
+ * spent by a child. The parents are not added to the orphanage, only the
+ * children are.
+ */
+static void MakeOrphanFlood(FastRandomContext &rng,
+                            std::vector<CTransactionRef> &parents,
+                            std::vector<CTransactionRef> &children) {
+    for (size_t i = 0; i < NUM_PARENTS; ++i) {
+        CMutableTransaction parent;
+        parent.vin.resize(1);
+        parent.vin[0].prevout = COutPoint(TxId(rng.rand256()), 0);
+        parent.vout.resize(CHILDREN_PER_PARENT);
+        for (CTxOut &out : parent.vout) {
+            out.nValue = 1 * COIN;
+            out.scriptPubKey = CScript() << OP_TRUE;
+        }
+        const CTransactionRef parent_ref = MakeTransactionRef(parent);
+        parents.push_back(parent_ref);
+
+        for (uint32_t n = 0; n < CHILDREN_PER_PARENT; ++n) {
+            CMutableTransaction child;
+            child.vin.resize(1);
+            child.vin[0].prevout = COutPoint(parent_ref->GetId(), n);
+            child.vout.resize(1);
+            child.vout[0].nValue = 1 * COIN;
+            child.vout[0].scriptPubKey = CScript() << OP_TRUE;
+            children.push_back(MakeTransactionRef(child));
+        }
+    }
+}
+
+/**
+ * Many peers flooding orphans well above -maxorphantx: every insertion
+ * triggers an eviction.
+ */
+static void OrphanageFlood(benchmark::Bench &bench) {
+    FastRandomContext rng(true);
+    std::vector<CTransactionRef> parents;
+    std::vector<CTransactionRef> children;
+    MakeOrphanFlood(rng, parents, children);
+
+    bench.batch(children.size()).unit("orphan").run([&] {
+        TxOrphanage orphanage;
+        for (size_t i = 0; i < children.size(); ++i) {
+            orphanage.AddTx(children[i], i % NUM_PEERS);
+            orphanage.LimitOrphans(
+                DEFAULT_MAX_ORPHAN_TRANSACTIONS,
+                GetMaxPeerOrphans(DEFAULT_MAX_ORPHAN_TRANSACTIONS),
+                GetMaxPeerOrphanBytes(DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+        }
+    });
+}
+
+/**
+ * Resolution of orphans once their parent arrives, then removal of the
+ * orphans when the block including them is connected.
+ */
+static void OrphanageResolve(benchmark::Bench &bench) {
+    FastRandomContext rng(true);
+    std::vector<CTransactionRef> parents;
+    std::vector<CTransactionRef> children;
+    MakeOrphanFlood(rng, parents, children);
+
+    CBlock block;
+    block.vtx = children;
+
+    bench.batch(children.size()).unit("orphan").run([&] {
+        TxOrphanage orphanage;
+        for (size_t i = 0; i < children.size(); ++i) {
+            orphanage.AddTx(children[i], i % NUM_PEERS);
+        }
+
+        std::set<TxId> work_set;
+        for (const CTransactionRef &parent : parents) {
+            orphanage.AddChildrenToWorkSet(*parent, work_set);
+        }
+        assert(work_set.size() == children.size());
+
+        orphanage.EraseForBlock(block);
+        assert(orphanage.Size() == 0);
+    });
+}
+
+BENCHMARK(OrphanageFlood);
+BENCHMARK(OrphanageResolve);
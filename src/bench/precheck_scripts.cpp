@@ -0,0 +1,117 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <consensus/amount.h>
+#include <key.h>
+#include <primitives/transaction.h>
+#include <script/interpreter.h>
+#include <script/script.h>
+#include <script/sighashtype.h>
+#include <validation.h>
+
+#include <test/util/setup_common.h>
+
+#include <cassert>
+#include <vector>
+
+/// Number of transactions received from the peers in a round of the message
+/// handler.
+static constexpr size_t BATCH_SIZE{100};
+
+static void SignInput(CMutableTransaction &tx, const CKey &key,
+                      const CScript &script_pub_key, const Amount amount) {
+    std::vector<uint8_t> sig;
+    const uint256 hash =
+        SignatureHash(script_pub_key, CTransaction(tx), 0,
+                      SigHashType().withForkId(), amount);
+    const bool signed_ok{key.SignECDSA(hash, sig)};
+    assert(signed_ok);
+    sig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+    tx.vin[0].scriptSig = CScript() << sig;
+}
+
+/**
+ * Create batches of transactions spending the outputs of a transaction in the
+ * mempool. Every batch has its own signatures, so that each iteration verifies
+ * scripts that are in neither the signature cache nor the script cache.
+ */
+static std::vector<std::vector<CTransactionRef>>
+CreateBatches(TestChain100Setup &setup, size_t num_batches) {
+    const CScript coinbase_script =
+        CScript() << ToByteVector(setup.coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    // The coinbase key is the same for all the benchmarks, a new key keeps
+    // their signatures apart.
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript script_pub_key =
+        CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+    const CTransactionRef &coinbase = setup.m_coinbase_txns[0];
+    const size_t num_outputs{num_batches * BATCH_SIZE};
+    const Amount output_value{(coinbase->vout[0].nValue - COIN) /
+                              int64_t(num_outputs)};
+
+    CMutableTransaction fanout;
+    fanout.vin.emplace_back(COutPoint(coinbase->GetId(), 0));
+    fanout.vout.assign(num_outputs, CTxOut(output_value, script_pub_key));
+    SignInput(fanout, setup.coinbaseKey, coinbase_script,
+              coinbase->vout[0].nValue);
+    const CTransactionRef fanout_ref = MakeTransactionRef(fanout);
+    {
+        LOCK(cs_main);
+        const MempoolAcceptResult result =
+            setup.m_node.chainman->ProcessTransaction(fanout_ref);
+        assert(result.m_result_type == MempoolAcceptResult::ResultType::VALID);
+    }
+
+    std::vector<std::vector<CTransactionRef>> batches(num_batches);
+    for (size_t i = 0; i < num_outputs; ++i) {
+        CMutableTransaction spend;
+        spend.vin.emplace_back(COutPoint(fanout_ref->GetId(), i));
+        spend.vout.emplace_back(output_value - 1000 * SATOSHI, script_pub_key);
+        SignInput(spend, key, script_pub_key, output_value);
+        batches[i / BATCH_SIZE].push_back(MakeTransactionRef(spend));
+    }
+    return batches;
+}
+
+/**
+ * Verify the scripts of the transactions received in a round of the message
+ * handler, either one transaction at a time or all at once.
+ */
+static void PreCheckScripts(benchmark::Bench &bench, bool batched) {
+    const auto testing_setup = MakeNoLogFileContext<TestChain100Setup>();
+    ChainstateManager &chainman = *testing_setup->m_node.chainman;
+
+    // The scripts of a batch are only verified once
+    bench.epochs(5).epochIterations(1);
+    const std::vector<std::vector<CTransactionRef>> batches = CreateBatches(
+        *testing_setup, bench.epochs() * bench.epochIterations() + 1);
+
+    auto it = batches.begin();
+    bench.unit("tx").batch(BATCH_SIZE).run([&] {
+        assert(it != batches.end());
+        const std::vector<CTransactionRef> &txs = *it++;
+        size_t num_verified{0};
+        if (batched) {
+            num_verified = chainman.PreCheckTransactionScripts(txs);
+        } else {
+            for (const CTransactionRef &tx : txs) {
+                num_verified += chainman.PreCheckTransactionScripts({tx});
+            }
+        }
+        assert(num_verified == txs.size());
+    });
+}
+
+static void PreCheckScriptsOneByOne(benchmark::Bench &bench) {
+    PreCheckScripts(bench, /*batched=*/false);
+}
+
+static void PreCheckScriptsBatched(benchmark::Bench &bench) {
+    PreCheckScripts(bench, /*batched=*/true);
+}
+
+BENCHMARK(PreCheckScriptsOneByOne);
+BENCHMARK(PreCheckScriptsBatched);
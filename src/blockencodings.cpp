@@ -97,14 +97,19 @@ ReadStatus PartiallyDownloadedBlock::InitData(
     }
 
     {
+        // The short ids are keyed by the block header and a nonce chosen by
+        // the sender, so they cannot be indexed ahead of time. Hash the cached
+        // transaction hashes from the contiguous txns_randomized vector, and
+        // only dereference the mempool entries that match.
         LOCK(pool->cs);
-        auto it = pool->mapTx.begin();
-        while (it != pool->mapTx.end()) {
-            uint64_t shortid = cmpctblock.GetShortID((*it)->GetTx().GetHash());
+        for (const auto &[txhash, it] : pool->txns_randomized) {
+            uint64_t shortid = cmpctblock.GetShortID(txhash);
+            if (!shortidProcessor->hasShortId(shortid)) {
+                continue;
+            }
 
             mempool_count +=
                 shortidProcessor->matchKnownItem(shortid, (*it)->GetSharedTx());
-            it++;
 
             if (mempool_count == shortidProcessor->getShortIdCount()) {
                 break;
@@ -10,6 +10,7 @@
 #include <util/threadnames.h>
 
 #include <algorithm>
+#include <string>
 #include <vector>
 
 template <typename T> class CCheckQueueControl;
@@ -58,6 +59,9 @@ private:
     //! The maximum number of elements to be processed in one batch
     const unsigned int nBatchSize;
 
+    //! Prefix of the worker threads names
+    const std::string m_thread_name;
+
     std::vector<std::thread> m_worker_threads;
     bool m_request_stop GUARDED_BY(m_mutex){false};
 
@@ -140,8 +144,9 @@ public:
     Mutex m_control_mutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn)
-        : nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn,
+                         const std::string &thread_name = "scriptch")
+        : nBatchSize(nBatchSizeIn), m_thread_name(thread_name) {}
 
     //! Create a pool of new worker threads.
     void StartWorkerThreads(const int threads_num)
@@ -155,7 +160,7 @@ public:
         assert(m_worker_threads.empty());
         for (int n = 0; n < threads_num; ++n) {
             m_worker_threads.emplace_back([this, n]() {
-                util::ThreadRename(strprintf("scriptch.%i", n));
+                util::ThreadRename(strprintf("%s.%i", m_thread_name, n));
                 Loop(false /* worker thread */);
             });
         }
@@ -10,6 +10,13 @@
 
 #include <stdexcept>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 FlatFileSeq::FlatFileSeq(fs::path dir, const char *prefix, size_t chunk_size)
     : m_dir(std::move(dir)), m_prefix(prefix), m_chunk_size(chunk_size) {
     if (chunk_size == 0) {
@@ -48,6 +55,14 @@ FILE *FlatFileSeq::Open(const FlatFilePos &pos, bool read_only) {
     return file;
 }
 
+std::unique_ptr<const MappedFlatFile>
+FlatFileSeq::Map(const FlatFilePos &pos) const {
+    if (pos.IsNull()) {
+        return nullptr;
+    }
+    return MappedFlatFile::Map(FileName(pos));
+}
+
 size_t FlatFileSeq::Allocate(const FlatFilePos &pos, size_t add_size,
                              bool &out_of_space) {
     out_of_space = false;
@@ -95,3 +110,37 @@ bool FlatFileSeq::Flush(const FlatFilePos &pos, bool finalize) {
     fclose(file);
     return true;
 }
+
+MappedFlatFile::~MappedFlatFile() {
+#ifndef WIN32
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+}
+
+std::unique_ptr<const MappedFlatFile>
+MappedFlatFile::Map(const fs::path &path) {
+#ifdef WIN32
+    return nullptr;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        LogPrintf("Unable to open file %s\n", fs::PathToString(path));
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    const size_t size = st.st_size;
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    if (addr == MAP_FAILED) {
+        LogPrintf("Unable to map file %s\n", fs::PathToString(path));
+        return nullptr;
+    }
+    return std::unique_ptr<const MappedFlatFile>(
+        new MappedFlatFile(static_cast<const uint8_t *>(addr), size));
+#endif
+}
@@ -8,7 +8,10 @@
 
 #include <fs.h>
 #include <serialize.h>
+#include <span.h>
 
+#include <cstdint>
+#include <memory>
 #include <string>
 
 struct FlatFilePos {
@@ -42,6 +45,35 @@ struct FlatFilePos {
     std::string ToString() const;
 };
 
+/**
+ * A read-only memory mapping of a whole flat file. The mapping stays valid for
+ * the lifetime of the object, even if the file is unlinked in the meantime.
+ */
+class MappedFlatFile {
+private:
+    const uint8_t *m_data;
+    const size_t m_size;
+
+    MappedFlatFile(const uint8_t *data, size_t size)
+        : m_data(data), m_size(size) {}
+
+public:
+    ~MappedFlatFile();
+
+    MappedFlatFile(const MappedFlatFile &) = delete;
+    MappedFlatFile &operator=(const MappedFlatFile &) = delete;
+
+    /**
+     * Map the file at the given path. Returns nullptr if the file cannot be
+     * mapped (missing or empty file, or platform without mmap support).
+     */
+    static std::unique_ptr<const MappedFlatFile> Map(const fs::path &path);
+
+    /** The mapped bytes, from the start of the file. */
+    Span<const uint8_t> GetSpan() const { return {m_data, m_size}; }
+    size_t size() const { return m_size; }
+};
+
 /**
  * FlatFileSeq represents a sequence of numbered files storing raw data. This
  * class facilitates access to and efficient management of these files.
@@ -69,6 +101,9 @@ public:
     /** Open a handle to the file at the given position. */
     FILE *Open(const FlatFilePos &pos, bool read_only = false);
 
+    /** Map the whole file containing the given position read-only. */
+    std::unique_ptr<const MappedFlatFile> Map(const FlatFilePos &pos) const;
+
     /**
      * Allocate additional space in a file after the given starting position.
      * The amount allocated will be the minimum multiple of the sequence chunk
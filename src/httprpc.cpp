@@ -16,6 +16,7 @@
 #include <boost/algorithm/string.hpp> // boost::trim
 
 #include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <functional>
 #include <iterator>
@@ -23,6 +24,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char *WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
@@ -285,19 +287,105 @@ static bool checkCORS(HTTPRequest *req) {
     return false;
 }
 
-bool HTTPRPCRequestProcessor::ProcessHTTPRequest(HTTPRequest *req) {
-    // First, check and/or set CORS headers
-    if (checkCORS(req)) {
+/**
+ * Execute a single request, letting large results be streamed as a chunked
+ * reply. Returns true if the reply was sent, otherwise it is left in strReply.
+ */
+static bool ExecuteStreamed(Config &config, RPCServer &rpcServer,
+                            HTTPRequest *req, JSONRPCRequest &jreq,
+                            size_t request_size, std::string &strReply) {
+    bool started{false};
+    UniValueWriter writer{[req, &started](const std::string &chunk) {
+        if (!started) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartReply(HTTP_OK);
+            started = true;
+        }
+        req->WriteReplyChunk(chunk);
+    }};
+    writer.beginObject();
+    writer.key("result");
+    jreq.resultWriter = &writer;
+    try {
+        UniValue result = rpcServer.ExecuteCommand(config, jreq);
+        jreq.resultWriter = nullptr;
+        if (writer.expectingValue()) {
+            writer.value(result);
+        }
+    } catch (...) {
+        jreq.resultWriter = nullptr;
+        if (!started) {
+            throw;
+        }
+        // Part of the result was already sent, so the reply can only be cut
+        // short and the client will fail to parse it.
+        LogPrintf("%s: failed to stream the result of %s\n", __func__,
+                  jreq.strMethod);
+        RecordRPCBytes(jreq.strMethod, request_size, writer.bytesFlushed());
+        req->EndReply();
         return true;
     }
+    writer.key("error");
+    writer.value(NullUniValue);
+    writer.key("id");
+    writer.value(jreq.id);
+    writer.endObject();
+    if (!started) {
+        // Small replies are sent at once
+        strReply = writer.release() + "\n";
+        RecordRPCBytes(jreq.strMethod, request_size, strReply.size());
+        return false;
+    }
+    writer.flush();
+    RecordRPCBytes(jreq.strMethod, request_size, writer.bytesFlushed() + 1);
+    req->WriteReplyChunk("\n");
+    req->EndReply();
+    return true;
+}
 
-    // JSONRPC handles only POST
-    if (req->GetRequestMethod() != HTTPRequest::POST) {
-        req->WriteReply(HTTP_BAD_METHOD,
-                        "JSONRPC server handles only POST requests");
+/** Whether the client asks for the binary encoding of the result */
+static bool AcceptsBinary(HTTPRequest *req) {
+    const std::pair<bool, std::string> accept = req->GetHeader("accept");
+    return accept.first &&
+           accept.second.find("application/octet-stream") != std::string::npos;
+}
+
+/**
+ * Execute a single request, replying with the binary encoding of the result
+ * if the call has one. Returns true if the reply was sent, otherwise the JSON
+ * reply is left in strReply.
+ */
+static bool ExecuteBinary(Config &config, RPCServer &rpcServer,
+                          HTTPRequest *req, JSONRPCRequest &jreq,
+                          size_t request_size, std::string &strReply) {
+    std::vector<uint8_t> data;
+    jreq.resultBinary = &data;
+    UniValue result;
+    try {
+        result = rpcServer.ExecuteCommand(config, jreq);
+    } catch (...) {
+        jreq.resultBinary = nullptr;
+        throw;
+    }
+    jreq.resultBinary = nullptr;
+
+    if (data.empty()) {
+        // The call has no binary encoding
+        strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+        RecordRPCBytes(jreq.strMethod, request_size, strReply.size());
         return false;
     }
-    // Check authorization
+    RecordRPCBytes(jreq.strMethod, request_size, data.size());
+    req->WriteHeader("Content-Type", "application/octet-stream");
+    req->WriteReply(HTTP_OK, std::string(data.begin(), data.end()));
+    return true;
+}
+
+/**
+ * Check the credentials of a request and reply with an error if they are
+ * missing or wrong.
+ */
+static bool CheckAuthorization(HTTPRequest *req, std::string &authUser) {
     std::pair<bool, std::string> authHeader = req->GetHeader("authorization");
     if (!authHeader.first) {
         req->WriteHeader("WWW-Authenticate", WWW_AUTH_HEADER_DATA);
@@ -305,12 +393,9 @@ bool HTTPRPCRequestProcessor::ProcessHTTPRequest(HTTPRequest *req) {
         return false;
     }
 
-    JSONRPCRequest jreq;
-    jreq.context = context;
-    jreq.peerAddr = req->GetPeer().ToString();
-    if (!RPCAuthorized(authHeader.second, jreq.authUser)) {
+    if (!RPCAuthorized(authHeader.second, authUser)) {
         LogPrintf("ThreadRPCServer incorrect password attempt from %s\n",
-                  jreq.peerAddr);
+                  req->GetPeer().ToString());
 
         /**
          * Deter brute-forcing.
@@ -324,11 +409,33 @@ bool HTTPRPCRequestProcessor::ProcessHTTPRequest(HTTPRequest *req) {
         req->WriteReply(HTTP_UNAUTHORIZED);
         return false;
     }
+    return true;
+}
+
+bool HTTPRPCRequestProcessor::ProcessHTTPRequest(HTTPRequest *req) {
+    // First, check and/or set CORS headers
+    if (checkCORS(req)) {
+        return true;
+    }
+
+    // JSONRPC handles only POST
+    if (req->GetRequestMethod() != HTTPRequest::POST) {
+        req->WriteReply(HTTP_BAD_METHOD,
+                        "JSONRPC server handles only POST requests");
+        return false;
+    }
+    JSONRPCRequest jreq;
+    jreq.context = context;
+    jreq.peerAddr = req->GetPeer().ToString();
+    if (!CheckAuthorization(req, jreq.authUser)) {
+        return false;
+    }
 
     try {
         // Parse request
+        const std::string body{req->ReadBody()};
         UniValue valRequest;
-        if (!valRequest.read(req->ReadBody())) {
+        if (!valRequest.read(body)) {
             throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
         }
 
@@ -353,10 +460,15 @@ bool HTTPRPCRequestProcessor::ProcessHTTPRequest(HTTPRequest *req) {
                 req->WriteReply(HTTP_FORBIDDEN);
                 return false;
             }
-            UniValue result = rpcServer.ExecuteCommand(config, jreq);
-
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            if (AcceptsBinary(req)) {
+                if (ExecuteBinary(config, rpcServer, req, jreq, body.size(),
+                                  strReply)) {
+                    return true;
+                }
+            } else if (ExecuteStreamed(config, rpcServer, req, jreq,
+                                       body.size(), strReply)) {
+                return true;
+            }
 
             // array of requests
         } else if (valRequest.isArray()) {
@@ -382,7 +494,7 @@ bool HTTPRPCRequestProcessor::ProcessHTTPRequest(HTTPRequest *req) {
                 }
             }
             strReply = JSONRPCExecBatch(config, rpcServer, jreq,
-                                        valRequest.get_array());
+                                        valRequest.get_array(), body.size());
         } else {
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
         }
@@ -446,6 +558,92 @@ static bool InitRPCAuthentication() {
     return true;
 }
 
+static std::string MetricSeconds(std::chrono::nanoseconds duration) {
+    return strprintf("%.6f", duration.count() / 1e9);
+}
+
+/**
+ * Serve the getrpcstats counters in the Prometheus text exposition format, to
+ * the users allowed to call getrpcstats.
+ */
+static bool HTTPReq_Metrics(HTTPRequest *req) {
+    if (req->GetRequestMethod() != HTTPRequest::GET) {
+        req->WriteReply(HTTP_BAD_METHOD,
+                        "The metrics are only served to GET requests");
+        return false;
+    }
+    std::string authUser;
+    if (!CheckAuthorization(req, authUser)) {
+        return false;
+    }
+    auto whitelist = g_rpc_whitelist.find(authUser);
+    if (whitelist == g_rpc_whitelist.end() ? g_rpc_whitelist_default
+                                           : !whitelist->second.count(
+                                                 "getrpcstats")) {
+        LogPrintf("RPC User %s not allowed to read the metrics\n", authUser);
+        req->WriteReply(HTTP_FORBIDDEN);
+        return false;
+    }
+
+    const std::map<std::string, RPCMethodStats> method_stats{
+        GetRPCMethodStats()};
+    std::string out;
+    auto counter = [&](const std::string &name, const std::string &help,
+                       auto value) {
+        out += strprintf("# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+        for (const auto &[method, stats] : method_stats) {
+            out += strprintf("%s{method=\"%s\"} %s\n", name, method,
+                             value(stats));
+        }
+    };
+    counter("bitcoin_rpc_calls_total", "Number of calls to the method",
+            [](const RPCMethodStats &stats) { return ToString(stats.calls); });
+    counter("bitcoin_rpc_errors_total", "Number of calls that failed",
+            [](const RPCMethodStats &stats) { return ToString(stats.errors); });
+    counter("bitcoin_rpc_request_bytes_total", "Total size of the requests",
+            [](const RPCMethodStats &stats) {
+                return ToString(stats.bytes_in);
+            });
+    counter("bitcoin_rpc_reply_bytes_total", "Total size of the replies",
+            [](const RPCMethodStats &stats) {
+                return ToString(stats.bytes_out);
+            });
+    counter("bitcoin_rpc_cs_main_wait_seconds_total",
+            "Time spent waiting for the chain state lock",
+            [](const RPCMethodStats &stats) {
+                return MetricSeconds(stats.cs_main_wait);
+            });
+    counter("bitcoin_rpc_mempool_wait_seconds_total",
+            "Time spent waiting for the mempool lock",
+            [](const RPCMethodStats &stats) {
+                return MetricSeconds(stats.mempool_wait);
+            });
+
+    const std::string latency{"bitcoin_rpc_duration_seconds"};
+    out += strprintf("# HELP %s Execution time of the calls\n"
+                     "# TYPE %s histogram\n",
+                     latency, latency);
+    for (const auto &[method, stats] : method_stats) {
+        uint64_t calls{0};
+        for (size_t i = 0; i < RPC_LATENCY_BUCKETS.size(); i++) {
+            calls += stats.latency[i];
+            out += strprintf("%s_bucket{method=\"%s\",le=\"%g\"} %d\n",
+                             latency, method, RPC_LATENCY_BUCKETS[i] / 1e6,
+                             calls);
+        }
+        out += strprintf("%s_bucket{method=\"%s\",le=\"+Inf\"} %d\n", latency,
+                         method, stats.calls);
+        out += strprintf("%s_sum{method=\"%s\"} %s\n", latency, method,
+                         MetricSeconds(stats.time));
+        out += strprintf("%s_count{method=\"%s\"} %d\n", latency, method,
+                         stats.calls);
+    }
+
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, out);
+    return true;
+}
+
 bool StartHTTPRPC(HTTPRPCRequestProcessor &httpRPCRequestProcessor) {
     LogPrint(BCLog::RPC, "Starting HTTP RPC server\n");
     if (!InitRPCAuthentication()) {
@@ -460,6 +658,17 @@ bool StartHTTPRPC(HTTPRPCRequestProcessor &httpRPCRequestProcessor) {
     if (g_wallet_init_interface.HasWalletSupport()) {
         RegisterHTTPHandler("/wallet/", false, rpcFunction);
     }
+    SetHTTPAuthenticator([](const HTTPRequest &req, std::string &user) {
+        const auto [has_auth, auth] = req.GetHeader("authorization");
+        return has_auth && RPCAuthorized(auth, user);
+    });
+    if (gArgs.GetBoolArg("-rpcmetrics", DEFAULT_HTTP_METRICS)) {
+        RegisterHTTPHandler("/metrics", true,
+                            [](Config &, HTTPRequest *req,
+                               const std::string &) {
+                                return HTTPReq_Metrics(req);
+                            });
+    }
     struct event_base *eventBase = EventBase();
     assert(eventBase);
     httpRPCTimerInterface = std::make_unique<HTTPRPCTimerInterface>(eventBase);
@@ -477,6 +686,8 @@ void StopHTTPRPC() {
     if (g_wallet_init_interface.HasWalletSupport()) {
         UnregisterHTTPHandler("/wallet/", false);
     }
+    UnregisterHTTPHandler("/metrics", true);
+    SetHTTPAuthenticator(nullptr);
     if (httpRPCTimerInterface) {
         RPCUnsetTimerInterface(httpRPCTimerInterface.get());
         httpRPCTimerInterface.reset();
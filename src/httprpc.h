@@ -10,6 +10,9 @@
 
 #include <any>
 
+/** Default for -rpcmetrics, serving the RPC metrics on /metrics */
+static const bool DEFAULT_HTTP_METRICS = false;
+
 class Config;
 
 class HTTPRPCRequestProcessor {
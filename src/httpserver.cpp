@@ -30,11 +30,14 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <deque>
+#include <map>
 #include <memory>
+#include <set>
 
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
@@ -45,6 +48,12 @@ static const size_t MAX_HEADERS_SIZE = 8192;
  */
 static const size_t MIN_SUPPORTED_BODY_SIZE = 0x02000000;
 
+/**
+ * Bytes of a chunked reply allowed to wait for being written to the client
+ * before the next chunk is produced
+ */
+static const size_t HTTP_CHUNKED_REPLY_WATERMARK = 1 << 20;
+
 /** HTTP request work item */
 class HTTPWorkItem final : public HTTPClosure {
 public:
@@ -63,17 +72,90 @@ private:
 };
 
 /**
- * Simple work queue for distributing work over multiple threads.
- * Work items are simply callable objects.
+ * Work queue for distributing work over multiple threads, fairly between the
+ * clients. Priority items are run first. The other items are queued per
+ * client and the clients are served in turn, so that a client sending many
+ * slow requests does not delay the others. When the queue is full, a new item
+ * takes the place of the newest item of the client with the most queued
+ * items, if that client holds more than its fair share of the queue and the
+ * new item is not from it.
  */
 template <typename WorkItem> class WorkQueue {
 private:
+    struct Queued {
+        std::unique_ptr<WorkItem> item;
+        std::chrono::steady_clock::time_point time;
+    };
+
     /** Mutex protects entire object */
     Mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
-    bool running;
+    std::deque<Queued> priorityQueue GUARDED_BY(cs);
+    std::map<std::string, std::deque<Queued>> clientQueues GUARDED_BY(cs);
+    /** Clients with queued items, in the order they are served */
+    std::deque<std::string> clientTurns GUARDED_BY(cs);
+    size_t depth GUARDED_BY(cs){0};
+    bool running GUARDED_BY(cs);
     size_t maxDepth;
+    HTTPWorkQueueStats stats GUARDED_BY(cs);
+
+    Queued Pop() EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        Queued queued;
+        if (!priorityQueue.empty()) {
+            queued = std::move(priorityQueue.front());
+            priorityQueue.pop_front();
+        } else {
+            const std::string client = std::move(clientTurns.front());
+            clientTurns.pop_front();
+            auto it = clientQueues.find(client);
+            queued = std::move(it->second.front());
+            it->second.pop_front();
+            if (it->second.empty()) {
+                clientQueues.erase(it);
+            } else {
+                clientTurns.push_back(client);
+            }
+        }
+        depth--;
+        return queued;
+    }
+
+    /**
+     * Drop the newest item of the client with the most queued items, if it
+     * holds more than its share of the queue between the clients, counting
+     * the client of the new item.
+     */
+    std::unique_ptr<WorkItem> Evict(const std::string &client, bool priority)
+        EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        auto largest = clientQueues.end();
+        for (auto it = clientQueues.begin(); it != clientQueues.end(); ++it) {
+            if (largest == clientQueues.end() ||
+                it->second.size() > largest->second.size()) {
+                largest = it;
+            }
+        }
+        if (largest == clientQueues.end() ||
+            (!priority && largest->first == client)) {
+            return nullptr;
+        }
+        const size_t clients{clientQueues.size() +
+                             (priority || clientQueues.count(client) ? 0 : 1)};
+        const size_t fair_share{(maxDepth - priorityQueue.size()) / clients};
+        if (largest->second.size() <= fair_share) {
+            return nullptr;
+        }
+        std::unique_ptr<WorkItem> evicted =
+            std::move(largest->second.back().item);
+        largest->second.pop_back();
+        if (largest->second.empty()) {
+            clientTurns.erase(std::find(clientTurns.begin(), clientTurns.end(),
+                                        largest->first));
+            clientQueues.erase(largest);
+        }
+        depth--;
+        stats.evicted++;
+        return evicted;
+    }
 
 public:
     explicit WorkQueue(size_t _maxDepth) : running(true), maxDepth(_maxDepth) {}
@@ -82,13 +164,34 @@ public:
      */
     ~WorkQueue() {}
 
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem *item) EXCLUSIVE_LOCKS_REQUIRED(!cs) {
+    /**
+     * Enqueue a work item from the given client. Returns false if the queue
+     * is full, otherwise the queue took ownership of the item and evicted
+     * holds the item it replaced, if any.
+     */
+    bool Enqueue(const std::string &client, bool priority,
+                 std::unique_ptr<WorkItem> &item,
+                 std::unique_ptr<WorkItem> &evicted)
+        EXCLUSIVE_LOCKS_REQUIRED(!cs) {
         LOCK(cs);
-        if (queue.size() >= maxDepth) {
-            return false;
+        if (depth >= maxDepth) {
+            evicted = Evict(client, priority);
+            if (!evicted) {
+                stats.rejected++;
+                return false;
+            }
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        Queued queued{std::move(item), std::chrono::steady_clock::now()};
+        if (priority) {
+            priorityQueue.push_back(std::move(queued));
+        } else {
+            auto &queue = clientQueues[client];
+            if (queue.empty()) {
+                clientTurns.push_back(client);
+            }
+            queue.push_back(std::move(queued));
+        }
+        depth++;
         cond.notify_one();
         return true;
     }
@@ -96,19 +199,24 @@ public:
     /** Thread function */
     void Run() EXCLUSIVE_LOCKS_REQUIRED(!cs) {
         while (true) {
-            std::unique_ptr<WorkItem> i;
+            Queued queued;
             {
                 WAIT_LOCK(cs, lock);
-                while (running && queue.empty()) {
+                while (running && depth == 0) {
                     cond.wait(lock);
                 }
                 if (!running) {
                     break;
                 }
-                i = std::move(queue.front());
-                queue.pop_front();
+                queued = Pop();
+                const auto wait{std::chrono::duration_cast<
+                    std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - queued.time)};
+                stats.served++;
+                stats.total_wait += wait;
+                stats.max_wait = std::max(stats.max_wait, wait);
             }
-            (*i)();
+            (*queued.item)();
         }
     }
 
@@ -118,6 +226,15 @@ public:
         running = false;
         cond.notify_all();
     }
+
+    HTTPWorkQueueStats GetStats() EXCLUSIVE_LOCKS_REQUIRED(!cs) {
+        LOCK(cs);
+        HTTPWorkQueueStats ret{stats};
+        ret.depth = depth;
+        ret.priority_depth = priorityQueue.size();
+        ret.clients = clientQueues.size();
+        return ret;
+    }
 };
 
 struct HTTPPathHandler {
@@ -138,12 +255,32 @@ static struct evhttp *eventHTTP = nullptr;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
-static WorkQueue<HTTPClosure> *workQueue = nullptr;
+static WorkQueue<HTTPWorkItem> *workQueue = nullptr;
+//! RPC methods whose requests are run before the others
+static std::set<std::string> g_priority_methods;
+//! Credentials check of the requests before they are queued
+static HTTPAuthenticator g_authenticator;
 //! Handlers for (sub)paths
 static std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
 static std::vector<evhttp_bound_socket *> boundSockets;
 
+/**
+ * Additional event loops (see -rpceventthreads). They accept connections on
+ * duplicates of the bound listening sockets and feed the same work queue.
+ */
+struct HTTPEventLoop {
+    struct event_base *base;
+    struct evhttp *http;
+    std::vector<evhttp_bound_socket *> sockets;
+    std::thread thread;
+};
+static std::vector<HTTPEventLoop> g_extra_event_loops;
+//! Number of requests received by each event loop, the main one first
+static std::vector<std::atomic<uint64_t>> g_event_loop_requests;
+//! Index of the event loop run by the current thread
+static thread_local size_t g_event_loop_index{0};
+
 /** Check if a network address is allowed to access the HTTP server */
 static bool ClientAllowed(const CNetAddr &netaddr) {
     if (!netaddr.IsValid()) {
@@ -210,6 +347,52 @@ std::string RequestMethodString(HTTPRequest::RequestMethod m) {
     }
 }
 
+/**
+ * The client a request is queued for: its RPC user if it sent valid
+ * credentials, otherwise its network address.
+ */
+static std::string RequestClient(const HTTPRequest &req, bool &authenticated) {
+    std::string user;
+    authenticated = g_authenticator && g_authenticator(req, user);
+    if (authenticated) {
+        return "user:" + user;
+    }
+    return req.GetPeer().ToStringIP();
+}
+
+/**
+ * Whether a request calls one of the priority RPC methods. Only the start of
+ * the body is looked at, for the "method" of a single JSON-RPC request.
+ */
+static bool IsPriorityRequest(evhttp_request *req) {
+    if (g_priority_methods.empty() ||
+        evhttp_request_get_command(req) != EVHTTP_REQ_POST) {
+        return false;
+    }
+    struct evbuffer *buf = evhttp_request_get_input_buffer(req);
+    const size_t len{std::min<size_t>(evbuffer_get_length(buf), 256)};
+    const uint8_t *data{evbuffer_pullup(buf, len)};
+    if (!data) {
+        return false;
+    }
+    const std::string body(reinterpret_cast<const char *>(data), len);
+    const size_t key{body.find("\"method\"")};
+    if (body.empty() || body.front() != '{' || key == std::string::npos) {
+        return false;
+    }
+    const size_t colon{body.find_first_not_of(" \t\r\n", key + 8)};
+    if (colon == std::string::npos || body[colon] != ':') {
+        return false;
+    }
+    const size_t start{body.find_first_not_of(" \t\r\n", colon + 1)};
+    if (start == std::string::npos || body[start] != '"') {
+        return false;
+    }
+    const size_t end{body.find('"', start + 1)};
+    return end != std::string::npos &&
+           g_priority_methods.count(body.substr(start + 1, end - start - 1));
+}
+
 /** HTTP request callback */
 static void http_request_cb(struct evhttp_request *req, void *arg) {
     Config &config = *reinterpret_cast<Config *>(arg);
@@ -226,6 +409,7 @@ static void http_request_cb(struct evhttp_request *req, void *arg) {
         }
     }
     auto hreq = std::make_unique<HTTPRequest>(req);
+    ++g_event_loop_requests[g_event_loop_index];
 
     // Early address-based allow check
     if (!ClientAllowed(hreq->GetPeer())) {
@@ -271,12 +455,24 @@ static void http_request_cb(struct evhttp_request *req, void *arg) {
 
     // Dispatch to worker thread.
     if (i != iend) {
+        // Only the requests with valid credentials can skip the queue
+        bool authenticated{false};
+        const std::string client{RequestClient(*hreq, authenticated)};
+        const bool priority{authenticated && IsPriorityRequest(req)};
         std::unique_ptr<HTTPWorkItem> item(
             new HTTPWorkItem(config, std::move(hreq), path, i->handler));
+        std::unique_ptr<HTTPWorkItem> evicted;
         assert(workQueue);
-        if (workQueue->Enqueue(item.get())) {
+        if (workQueue->Enqueue(client, priority, item, evicted)) {
             /* if true, queue took ownership */
-            item.release();
+            if (evicted) {
+                LogPrint(BCLog::HTTP,
+                         "Dropped a queued request from %s to make room for "
+                         "a request from %s\n",
+                         evicted->req->GetPeer().ToString(), client);
+                evicted->req->WriteReply(HTTP_SERVICE_UNAVAILABLE,
+                                         "Work queue depth exceeded");
+            }
         } else {
             LogPrintf("WARNING: request rejected because http work queue depth "
                       "exceeded, it can be increased with the -rpcworkqueue= "
@@ -360,7 +556,7 @@ static bool HTTPBindAddresses(struct evhttp *http) {
 }
 
 /** Simple wrapper to set thread name and run work queue */
-static void HTTPWorkQueueRun(WorkQueue<HTTPClosure> *queue, int worker_num) {
+static void HTTPWorkQueueRun(WorkQueue<HTTPWorkItem> *queue, int worker_num) {
     util::ThreadRename(strprintf("httpworker.%i", worker_num));
     queue->Run();
 }
@@ -379,6 +575,71 @@ static void libevent_log_cb(int severity, const char *msg) {
     }
 }
 
+/** Set up an evhttp object to handle the requests */
+static void ConfigureHTTP(struct evhttp *http, Config &config) {
+    evhttp_set_timeout(http, gArgs.GetIntArg("-rpcservertimeout",
+                                             DEFAULT_HTTP_SERVER_TIMEOUT));
+    evhttp_set_max_headers_size(http, MAX_HEADERS_SIZE);
+    evhttp_set_max_body_size(http, MIN_SUPPORTED_BODY_SIZE +
+                                       2 * config.GetMaxBlockSize());
+    evhttp_set_gencb(http, http_request_cb, &config);
+
+    // Only POST and OPTIONS are supported, but we return HTTP 405 for the
+    // others
+    evhttp_set_allowed_methods(
+        http, EVHTTP_REQ_GET | EVHTTP_REQ_POST | EVHTTP_REQ_HEAD |
+                  EVHTTP_REQ_PUT | EVHTTP_REQ_DELETE | EVHTTP_REQ_OPTIONS);
+}
+
+/**
+ * Create the additional event loops. Each of them listens on duplicates of
+ * the bound sockets, so that the kernel hands every new connection to one of
+ * the loops waiting on the sockets.
+ */
+static bool InitExtraEventLoops(Config &config) {
+    const int64_t num_loops{std::max<int64_t>(
+        gArgs.GetIntArg("-rpceventthreads", DEFAULT_HTTP_EVENT_THREADS), 1)};
+#ifdef WIN32
+    if (num_loops > 1) {
+        LogPrintf("HTTP: -rpceventthreads is not supported on Windows, using "
+                  "a single event thread\n");
+    }
+    return true;
+#else
+    for (int64_t i = 1; i < num_loops; i++) {
+        raii_event_base base_ctr = obtain_event_base();
+        raii_evhttp http_ctr = obtain_evhttp(base_ctr.get());
+        if (!http_ctr) {
+            LogPrintf("couldn't create evhttp. Exiting.\n");
+            return false;
+        }
+        ConfigureHTTP(http_ctr.get(), config);
+
+        std::vector<evhttp_bound_socket *> sockets;
+        for (evhttp_bound_socket *socket : boundSockets) {
+            const int fd{dup(evhttp_bound_socket_get_fd(socket))};
+            evhttp_bound_socket *handle{
+                fd < 0 ? nullptr
+                       : evhttp_accept_socket_with_handle(http_ctr.get(), fd)};
+            if (!handle) {
+                LogPrintf("HTTP: couldn't share the listening socket with "
+                          "event loop %d\n",
+                          i);
+                if (fd >= 0) {
+                    close(fd);
+                }
+                continue;
+            }
+            sockets.push_back(handle);
+        }
+
+        g_extra_event_loops.push_back(
+            {base_ctr.release(), http_ctr.release(), std::move(sockets), {}});
+    }
+    return true;
+#endif
+}
+
 bool InitHTTPServer(Config &config) {
     if (!InitHTTPAllowList()) {
         return false;
@@ -409,31 +670,33 @@ bool InitHTTPServer(Config &config) {
         LogPrintf("couldn't create evhttp. Exiting.\n");
         return false;
     }
-
-    evhttp_set_timeout(http, gArgs.GetIntArg("-rpcservertimeout",
-                                             DEFAULT_HTTP_SERVER_TIMEOUT));
-    evhttp_set_max_headers_size(http, MAX_HEADERS_SIZE);
-    evhttp_set_max_body_size(http, MIN_SUPPORTED_BODY_SIZE +
-                                       2 * config.GetMaxBlockSize());
-    evhttp_set_gencb(http, http_request_cb, &config);
-
-    // Only POST and OPTIONS are supported, but we return HTTP 405 for the
-    // others
-    evhttp_set_allowed_methods(
-        http, EVHTTP_REQ_GET | EVHTTP_REQ_POST | EVHTTP_REQ_HEAD |
-                  EVHTTP_REQ_PUT | EVHTTP_REQ_DELETE | EVHTTP_REQ_OPTIONS);
+    ConfigureHTTP(http, config);
 
     if (!HTTPBindAddresses(http)) {
         LogPrintf("Unable to bind any endpoint for RPC server\n");
         return false;
     }
 
+    if (!InitExtraEventLoops(config)) {
+        return false;
+    }
+
     LogPrint(BCLog::HTTP, "Initialized HTTP server\n");
     int workQueueDepth = std::max(
         (long)gArgs.GetIntArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
     LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    workQueue = new WorkQueue<HTTPWorkItem>(workQueueDepth);
+    g_priority_methods.clear();
+    for (const std::string &method :
+         gArgs.IsArgSet("-rpcprioritymethod")
+             ? gArgs.GetArgs("-rpcprioritymethod")
+             : std::vector<std::string>{DEFAULT_HTTP_PRIORITY_METHODS.begin(),
+                                        DEFAULT_HTTP_PRIORITY_METHODS.end()}) {
+        g_priority_methods.insert(method);
+    }
+    g_event_loop_requests =
+        std::vector<std::atomic<uint64_t>>(g_extra_event_loops.size() + 1);
     // transfer ownership to eventBase/HTTP via .release()
     eventBase = base_ctr.release();
     eventHTTP = http_ctr.release();
@@ -463,18 +726,41 @@ void StartHTTPServer() {
         (long)gArgs.GetIntArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
     LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
     g_thread_http = std::thread(ThreadHTTP, eventBase);
+    for (size_t i = 0; i < g_extra_event_loops.size(); i++) {
+        HTTPEventLoop &loop = g_extra_event_loops[i];
+        loop.thread = std::thread([base = loop.base, i] {
+            util::ThreadRename(strprintf("http.%d", i + 1));
+            g_event_loop_index = i + 1;
+            event_base_dispatch(base);
+        });
+    }
+    if (!g_extra_event_loops.empty()) {
+        LogPrintf("HTTP: started %d event threads\n",
+                  g_extra_event_loops.size() + 1);
+    }
 
     for (int i = 0; i < rpcThreads; i++) {
         g_thread_http_workers.emplace_back(HTTPWorkQueueRun, workQueue, i);
     }
 }
 
+HTTPWorkQueueStats GetHTTPWorkQueueStats() {
+    return workQueue ? workQueue->GetStats() : HTTPWorkQueueStats{};
+}
+
+std::vector<uint64_t> GetHTTPEventLoopRequests() {
+    return {g_event_loop_requests.begin(), g_event_loop_requests.end()};
+}
+
 void InterruptHTTPServer() {
     LogPrint(BCLog::HTTP, "Interrupting HTTP server\n");
     if (eventHTTP) {
         // Reject requests on current connections
         evhttp_set_gencb(eventHTTP, http_reject_request_cb, nullptr);
     }
+    for (HTTPEventLoop &loop : g_extra_event_loops) {
+        evhttp_set_gencb(loop.http, http_reject_request_cb, nullptr);
+    }
     if (workQueue) {
         workQueue->Interrupt();
     }
@@ -497,6 +783,20 @@ void StopHTTPServer() {
         evhttp_del_accept_socket(eventHTTP, socket);
     }
     boundSockets.clear();
+    for (HTTPEventLoop &loop : g_extra_event_loops) {
+        for (evhttp_bound_socket *socket : loop.sockets) {
+            evhttp_del_accept_socket(loop.http, socket);
+        }
+        loop.sockets.clear();
+    }
+    for (HTTPEventLoop &loop : g_extra_event_loops) {
+        if (loop.thread.joinable()) {
+            loop.thread.join();
+        }
+        evhttp_free(loop.http);
+        event_base_free(loop.base);
+    }
+    g_extra_event_loops.clear();
     if (eventBase) {
         LogPrint(BCLog::HTTP, "Waiting for HTTP event thread to exit\n");
         if (g_thread_http.joinable()) {
@@ -546,9 +846,17 @@ void HTTPEvent::trigger(struct timeval *tv) {
     }
 }
 HTTPRequest::HTTPRequest(struct evhttp_request *_req, bool _replySent)
-    : req(_req), replySent(_replySent) {}
+    : req(_req), replySent(_replySent) {
+    // Replies are sent from the event loop of the request's connection
+    evhttp_connection *conn = evhttp_request_get_connection(req);
+    base = conn ? evhttp_connection_get_base(conn) : eventBase;
+}
 HTTPRequest::~HTTPRequest() {
-    if (!replySent) {
+    if (replyStarted && !replySent) {
+        // A chunked reply can only be cut short at this point
+        LogPrintf("%s: Unfinished reply\n", __func__);
+        EndReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL_SERVER_ERROR, "Unhandled request");
@@ -599,6 +907,23 @@ void HTTPRequest::WriteHeader(const std::string &hdr,
     evhttp_add_header(headers, hdr.c_str(), value.c_str());
 }
 
+/**
+ * Re-enable reading from the socket once a reply was sent. This is the second
+ * part of the libevent workaround in http_request_cb.
+ */
+static void ReenableReading(evhttp_request *req) {
+    if (event_get_version_number() >= 0x02010600 &&
+        event_get_version_number() < 0x02020001) {
+        evhttp_connection *conn = evhttp_request_get_connection(req);
+        if (conn) {
+            bufferevent *bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
 /**
  * Closure sent to main thread to request a reply to be sent to a HTTP request.
  * Replies must be sent in the main loop in the main http thread, this cannot be
@@ -614,20 +939,109 @@ void HTTPRequest::WriteReply(int nStatus, const std::string &strReply) {
     assert(evb);
     evbuffer_add(evb, strReply.data(), strReply.size());
     auto req_copy = req;
-    HTTPEvent *ev = new HTTPEvent(eventBase, true, [req_copy, nStatus] {
+    HTTPEvent *ev = new HTTPEvent(base, true, [req_copy, nStatus] {
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
-        // Re-enable reading from the socket. This is the second part of the
-        // libevent workaround above.
-        if (event_get_version_number() >= 0x02010600 &&
-            event_get_version_number() < 0x02020001) {
-            evhttp_connection *conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent *bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
+        ReenableReading(req_copy);
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    // transferred back to main thread.
+    req = nullptr;
+}
+
+/** Flow control of a chunked reply */
+struct HTTPRequest::ChunkedReply {
+    Mutex mutex;
+    std::condition_variable cond;
+    //! Bytes given to WriteReplyChunk and not yet written to the socket
+    size_t pending GUARDED_BY(mutex){0};
+    //! Bytes handed to libevent since its output buffer was last drained
+    size_t handed GUARDED_BY(mutex){0};
+    //! Whether the connection is gone or stopped draining
+    bool closed GUARDED_BY(mutex){false};
+    //! How long the output may not drain before the connection is given up
+    const std::chrono::seconds timeout{gArgs.GetIntArg(
+        "-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT)};
+};
+
+void HTTPRequest::StartReply(int nStatus) {
+    assert(!replySent && !replyStarted && req);
+    if (ShutdownRequested()) {
+        WriteHeader("Connection", "close");
+    }
+    // The chunks are sent from the main http thread, in order, as the events
+    // triggered immediately run in the order they were triggered.
+    auto req_copy = req;
+    HTTPEvent *ev = new HTTPEvent(base, true, [req_copy, nStatus] {
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+    });
+    ev->trigger(nullptr);
+    chunkedReply = std::make_shared<ChunkedReply>();
+    replyStarted = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string &chunk) {
+    assert(replyStarted && !replySent && req);
+    if (chunk.empty()) {
+        // An empty chunk would mark the end of the reply
+        return;
+    }
+    {
+        // Wait for the client to catch up. If the output doesn't drain within
+        // the server timeout, libevent dropped the connection.
+        WAIT_LOCK(chunkedReply->mutex, lock);
+        while (!chunkedReply->closed &&
+               chunkedReply->pending >= HTTP_CHUNKED_REPLY_WATERMARK) {
+            if (chunkedReply->cond.wait_for(lock, chunkedReply->timeout) ==
+                std::cv_status::timeout) {
+                chunkedReply->closed = true;
+            }
+        }
+        if (chunkedReply->closed) {
+            return;
+        }
+        chunkedReply->pending += chunk.size();
+    }
+    struct evbuffer *evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, chunk.data(), chunk.size());
+    auto req_copy = req;
+    auto chunked = chunkedReply;
+    const size_t size{chunk.size()};
+    HTTPEvent *ev = new HTTPEvent(base, true, [req_copy, evb, chunked, size] {
+        {
+            LOCK(chunked->mutex);
+            if (!evhttp_request_get_connection(req_copy)) {
+                // The client is gone, stop producing the reply
+                chunked->closed = true;
+                chunked->cond.notify_all();
             }
+            chunked->handed += size;
         }
+        // Called once the output buffer of the connection is drained
+        const auto written_cb = [](evhttp_connection *conn, void *arg) {
+            auto *written = static_cast<ChunkedReply *>(arg);
+            LOCK(written->mutex);
+            written->pending -= written->handed;
+            written->handed = 0;
+            written->cond.notify_all();
+        };
+        evhttp_send_reply_chunk_with_cb(req_copy, evb, written_cb,
+                                        chunked.get());
+        evbuffer_free(evb);
+    });
+    ev->trigger(nullptr);
+}
+
+void HTTPRequest::EndReply() {
+    assert(replyStarted && !replySent && req);
+    auto req_copy = req;
+    // Keep the reply state alive until evhttp_send_reply_end replaced the
+    // write callback referring to it.
+    auto chunked = chunkedReply;
+    HTTPEvent *ev = new HTTPEvent(base, true, [req_copy, chunked] {
+        evhttp_send_reply_end(req_copy);
+        ReenableReading(req_copy);
     });
     ev->trigger(nullptr);
     replySent = true;
@@ -676,6 +1090,10 @@ void RegisterHTTPHandler(const std::string &prefix, bool exactMatch,
     pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
 }
 
+void SetHTTPAuthenticator(const HTTPAuthenticator &authenticator) {
+    g_authenticator = authenticator;
+}
+
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch) {
     std::vector<HTTPPathHandler>::iterator i = pathHandlers.begin();
     std::vector<HTTPPathHandler>::iterator iend = pathHandlers.end();
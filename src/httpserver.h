@@ -6,12 +6,25 @@
 #ifndef BITCOIN_HTTPSERVER_H
 #define BITCOIN_HTTPSERVER_H
 
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 static const int DEFAULT_HTTP_THREADS = 4;
 static const int DEFAULT_HTTP_WORKQUEUE = 16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT = 30;
+static const int DEFAULT_HTTP_EVENT_THREADS = 1;
+/**
+ * RPC methods whose requests are run before the other queued requests, unless
+ * -rpcprioritymethod is set
+ */
+static const std::array<std::string_view, 3> DEFAULT_HTTP_PRIORITY_METHODS{
+    {"getblocktemplate", "submitblock", "sendrawtransaction"}};
 
 struct evhttp_request;
 struct event_base;
@@ -39,6 +52,34 @@ void InterruptHTTPServer();
 /** Stop HTTP server */
 void StopHTTPServer();
 
+/** Statistics of the queue of requests waiting for a worker thread */
+struct HTTPWorkQueueStats {
+    //! Number of queued requests
+    size_t depth{0};
+    //! Number of queued requests for priority methods
+    size_t priority_depth{0};
+    //! Number of clients with queued requests
+    size_t clients{0};
+    //! Number of requests taken by a worker thread
+    uint64_t served{0};
+    //! Number of requests rejected because the queue was full
+    uint64_t rejected{0};
+    //! Number of queued requests dropped to make room for other clients
+    uint64_t evicted{0};
+    //! Total and maximum time the served requests waited in the queue
+    std::chrono::microseconds total_wait{0};
+    std::chrono::microseconds max_wait{0};
+};
+
+/** Get the statistics of the HTTP work queue */
+HTTPWorkQueueStats GetHTTPWorkQueueStats();
+
+/**
+ * Get the number of requests received by each event loop thread, the main one
+ * first (see -rpceventthreads)
+ */
+std::vector<uint64_t> GetHTTPEventLoopRequests();
+
 /**
  * Change logging level for libevent. Removes BCLog::LIBEVENT from
  * log categories if libevent doesn't support debug logging.
@@ -61,6 +102,20 @@ void RegisterHTTPHandler(const std::string &prefix, bool exactMatch,
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/**
+ * Check the credentials of a request. Returns true and sets user if they are
+ * valid.
+ */
+typedef std::function<bool(const HTTPRequest &req, std::string &user)>
+    HTTPAuthenticator;
+
+/**
+ * Set the credentials check used before queueing a request: the requests with
+ * valid credentials are queued per user and can run the priority methods
+ * first, the others are queued per client address. Pass nullptr to unset.
+ */
+void SetHTTPAuthenticator(const HTTPAuthenticator &authenticator);
+
 /**
  * Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
@@ -74,7 +129,13 @@ struct event_base *EventBase();
 class HTTPRequest {
 private:
     struct evhttp_request *req;
+    //! Event base of the event loop handling the request's connection
+    struct event_base *base;
     bool replySent;
+    bool replyStarted{false};
+    struct ChunkedReply;
+    //! Write progress of a reply started with StartReply
+    std::shared_ptr<ChunkedReply> chunkedReply;
 
 public:
     explicit HTTPRequest(struct evhttp_request *req, bool replySent = false);
@@ -123,6 +184,31 @@ public:
      * this.
      */
     void WriteReply(int nStatus, const std::string &strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, for replies too large to be built in
+     * memory first. The body is then sent with WriteReplyChunk and the reply
+     * is completed by EndReply.
+     *
+     * @note Call this instead of WriteReply, after writing the headers.
+     */
+    void StartReply(int nStatus);
+
+    /**
+     * Send a part of the body of a reply started with StartReply. Blocks
+     * while more than HTTP_CHUNKED_REPLY_WATERMARK bytes of the reply are
+     * waiting to be written to the client, so that a slow client doesn't make
+     * the reply pile up in memory.
+     */
+    void WriteReplyChunk(const std::string &chunk);
+
+    /**
+     * Complete a reply started with StartReply.
+     *
+     * @note Like WriteReply, do not call any other HTTPRequest methods after
+     * calling this.
+     */
+    void EndReply();
 };
 
 /** Event handler closure */
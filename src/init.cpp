@@ -48,6 +48,7 @@
 #include <node/chainstate.h>
 #include <node/chainstatemanager_args.h>
 #include <node/context.h>
+#include <node/eventstream.h>
 #include <node/mempool_persist_args.h>
 #include <node/miner.h>
 #include <node/ui_interface.h>
@@ -112,11 +113,14 @@ using kernel::DumpMempool;
 using kernel::ValidationCacheSizes;
 
 using node::ApplyArgsManOptions;
+using node::BlockTemplateSelection;
 using node::CacheSizes;
 using node::CalculateCacheSizes;
 using node::CleanupBlockRevFiles;
+using node::DEFAULT_MMAP_BLOCK_FILES;
 using node::DEFAULT_PERSIST_MEMPOOL;
 using node::DEFAULT_STOPAFTERBLOCKIMPORT;
+using node::fMmapBlockFiles;
 using node::fPruneMode;
 using node::fReindex;
 using node::LoadChainstate;
@@ -124,6 +128,9 @@ using node::MempoolPath;
 using node::NodeContext;
 using node::nPruneTarget;
 using node::ShouldPersistMempool;
+using node::StartBlockFileWriter;
+using node::StopBlockFileWriter;
+using node::TemplateValidityChecker;
 using node::ThreadImport;
 using node::VerifyLoadedChainstate;
 
@@ -256,6 +263,9 @@ void Shutdown(NodeContext &node) {
     if (node.peerman) {
         UnregisterValidationInterface(node.peerman.get());
     }
+    if (node.block_template_selection) {
+        UnregisterValidationInterface(node.block_template_selection.get());
+    }
     if (node.connman) {
         node.connman->Stop();
     }
@@ -275,6 +285,8 @@ void Shutdown(NodeContext &node) {
     // After the threads that potentially access these pointers have been
     // stopped, destruct and reset all to nullptr.
     node.peerman.reset();
+    node.block_template_selection.reset();
+    node.template_checker.reset();
 
     // Destroy various global instances
     g_avalanche.reset();
@@ -335,6 +347,8 @@ void Shutdown(NodeContext &node) {
             }
         }
     }
+    // All block and undo data is on disk after the final flush above
+    StopBlockFileWriter();
     for (const auto &client : node.chain_clients) {
         client->stop();
     }
@@ -351,6 +365,7 @@ void Shutdown(NodeContext &node) {
     UnregisterAllValidationInterfaces();
     GetMainSignals().UnregisterBackgroundSignalScheduler();
     init::UnsetGlobals();
+    SetRPCStatsLocks(nullptr, nullptr);
     node.mempool.reset();
     node.chainman.reset();
     node.scheduler.reset();
@@ -488,6 +503,14 @@ void SetupServerArgs(NodeContext &node) {
                    "Specify directory to hold blocks subdirectory for *.dat "
                    "files (default: <datadir>)",
                    ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg(
+        "-mmapblockfiles",
+        strprintf("Read finalised block and undo files through read-only "
+                  "memory mappings instead of buffered file reads. An I/O "
+                  "error while reading a mapped file terminates the node "
+                  "(default: %d)",
+                  DEFAULT_MMAP_BLOCK_FILES),
+        ArgsManager::ALLOW_BOOL, OptionsCategory::OPTIONS);
     argsman.AddArg("-fastprune",
                    "Use smaller block files and lower minimum prune height for "
                    "testing purposes",
@@ -552,7 +575,9 @@ void SetupServerArgs(NodeContext &node) {
                    ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-maxorphantx=<n>",
                    strprintf("Keep at most <n> unconnectable transactions in "
-                             "memory (default: %u)",
+                             "memory, a single peer being allowed to fill "
+                             "1/%u of it (default: %u)",
+                             PEER_ORPHAN_SHARE_DIVISOR,
                              DEFAULT_MAX_ORPHAN_TRANSACTIONS),
                    ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-mempoolexpiry=<n>",
@@ -581,6 +606,16 @@ void SetupServerArgs(NodeContext &node) {
                              "on restart (default: %u)",
                              DEFAULT_PERSIST_MEMPOOL),
                    ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg(
+        "-persistmempoolv1",
+        strprintf(
+            "Whether a mempool.dat file created by -persistmempool or the "
+            "savemempool RPC will be written in the legacy format (version 1) "
+            "or the current format (version 2). The legacy format can be "
+            "loaded by older versions of the software. This temporary option "
+            "will be removed in the future. (default: %u)",
+            DEFAULT_PERSIST_V1_DAT),
+        ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg(
         "-pid=<file>",
         strprintf("Specify pid file. Relative paths will be prefixed "
@@ -838,6 +873,13 @@ void SetupServerArgs(NodeContext &node) {
             "connections will still be made; use -noonion or -onion=0 to "
             "disable outbound onion connections in this case",
         ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    argsman.AddArg(
+        "-packagerelay",
+        strprintf("Fetch orphan transactions from the peers that support it "
+                  "together with their unconfirmed ancestors, and serve such "
+                  "packages to them (default: %u)",
+                  DEFAULT_PACKAGE_RELAY),
+        ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-peerbloomfilters",
                    strprintf("Support filtering of blocks and transaction with "
                              "bloom filters (default: %d)",
@@ -1206,6 +1248,12 @@ void SetupServerArgs(NodeContext &node) {
                    strprintf("Accept public REST requests (default: %d)",
                              DEFAULT_REST_ENABLE),
                    ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    argsman.AddArg(
+        "-resteventbuffer=<n>",
+        strprintf("Keep the last <n> mempool and chain events for the REST "
+                  "/rest/events endpoint, 0 to disable it (default: %u)",
+                  node::DEFAULT_REST_EVENT_BUFFER),
+        ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     argsman.AddArg(
         "-rpcbind=<addr>[:port]",
         "Bind to given address to listen for JSON-RPC connections. Do not "
@@ -1274,11 +1322,42 @@ void SetupServerArgs(NodeContext &node) {
             "Set the number of threads to service RPC calls (default: %d)",
             DEFAULT_HTTP_THREADS),
         ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    argsman.AddArg(
+        "-rpcbatchconcurrency=<n>",
+        strprintf("Set the maximum number of read-only calls of a JSON-RPC "
+                  "batch request that are executed concurrently, limited to "
+                  "-rpcthreads (default: %d)",
+                  DEFAULT_RPC_BATCH_CONCURRENCY),
+        ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     argsman.AddArg(
         "-rpccorsdomain=value",
         "Domain from which to accept cross origin requests (browser enforced)",
         ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
 
+    argsman.AddArg(
+        "-rpceventthreads=<n>",
+        strprintf("Set the number of threads handling the network I/O of the "
+                  "RPC and REST connections (default: %d). Not supported on "
+                  "Windows",
+                  DEFAULT_HTTP_EVENT_THREADS),
+        ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    argsman.AddArg(
+        "-rpcmetrics",
+        strprintf("Serve the RPC call counters reported by getrpcstats on "
+                  "the /metrics path, in the Prometheus text format, to the "
+                  "users allowed to call getrpcstats (default: %d)",
+                  DEFAULT_HTTP_METRICS),
+        ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    argsman.AddArg(
+        "-rpcprioritymethod=<method>",
+        strprintf("Run the authenticated requests calling this RPC method "
+                  "before the other queued requests. Can be specified "
+                  "multiple times (default: %s)",
+                  Join(std::vector<std::string>{
+                           DEFAULT_HTTP_PRIORITY_METHODS.begin(),
+                           DEFAULT_HTTP_PRIORITY_METHODS.end()},
+                       ", ")),
+        ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     argsman.AddArg("-rpcworkqueue=<n>",
                    strprintf("Set the depth of the work queue to service RPC "
                              "calls (default: %d)",
@@ -1900,6 +1979,9 @@ bool AppInitParameterInteraction(Config &config, const ArgsManager &args) {
         fPruneMode = true;
     }
 
+    fMmapBlockFiles =
+        args.GetBoolArg("-mmapblockfiles", DEFAULT_MMAP_BLOCK_FILES);
+
     nConnectTimeout = args.GetIntArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0) {
         nConnectTimeout = DEFAULT_CONNECT_TIMEOUT;
@@ -2140,6 +2222,9 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         StartScriptCheckWorkerThreads(script_threads);
     }
 
+    // Write block and undo data behind the validation thread
+    StartBlockFileWriter();
+
     assert(!node.scheduler);
     node.scheduler = std::make_unique<CScheduler>();
 
@@ -2440,6 +2525,7 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
 
     for (bool fLoaded = false; !fLoaded && !ShutdownRequested();) {
         node.mempool = std::make_unique<CTxMemPool>(mempool_opts);
+        SetRPCStatsLocks(&cs_main, &node.mempool->cs);
 
         node.chainman = std::make_unique<ChainstateManager>(chainman_opts);
         ChainstateManager &chainman = *node.chainman;
@@ -2539,6 +2625,13 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         *node.mempool, args.GetBoolArg("-blocksonly", DEFAULT_BLOCKSONLY));
     RegisterValidationInterface(node.peerman.get());
 
+    // Keep the transactions selected for getblocktemplate up to date
+    node.block_template_selection =
+        std::make_unique<BlockTemplateSelection>(*node.mempool);
+    RegisterValidationInterface(node.block_template_selection.get());
+    // Fully validate the getblocktemplate templates in the background
+    node.template_checker = std::make_unique<TemplateValidityChecker>(chainman);
+
     // Encoded addresses using cashaddr instead of base58.
     // We do this by default to avoid confusion with BTC addresses.
     config.SetCashAddrEncoding(args.GetBoolArg("-usecashaddr", true));
@@ -8,14 +8,18 @@
 #include <net.h>
 #include <random.h>
 
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index_container.hpp>
+#include <util/hasher.h>
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <functional>
+#include <limits>
+#include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 namespace {
 
@@ -23,8 +27,7 @@ namespace {
  * The various states a (invid, peer) pair can be in.
  *
  * Note that CANDIDATE is split up into 3 substates (DELAYED, BEST, READY),
- * allowing more efficient implementation. Also note that the sorting order of
- * ByInvIdView relies on the specific order of values in this enum.
+ * allowing more efficient implementation.
  *
  * Expected behaviour is:
  *   - When first announced by a peer, the state is CANDIDATE_DELAYED until
@@ -62,6 +65,33 @@ enum class State : uint8_t {
 //! Type alias for sequence numbers.
 using SequenceNumber = uint64_t;
 
+//! Type alias for priorities.
+using Priority = uint64_t;
+
+/**
+ * A functor with embedded salt that computes priority of an announcement.
+ *
+ * Higher priorities are selected first.
+ */
+class PriorityComputer {
+    const uint64_t m_k0, m_k1;
+
+public:
+    explicit PriorityComputer(bool deterministic)
+        : m_k0{deterministic ? 0 : GetRand(0xFFFFFFFFFFFFFFFF)},
+          m_k1{deterministic ? 0 : GetRand(0xFFFFFFFFFFFFFFFF)} {}
+
+    Priority operator()(const uint256 &invid, NodeId peer,
+                        bool preferred) const {
+        uint64_t low_bits = CSipHasher(m_k0, m_k1)
+                                .Write(invid.begin(), invid.size())
+                                .Write(peer)
+                                .Finalize() >>
+                            1;
+        return low_bits | uint64_t{preferred} << 63;
+    }
+};
+
 /**
  * An announcement. This is the data we track for each invid that is announced
  * to us by each peer.
@@ -76,6 +106,12 @@ struct Announcement {
     std::chrono::microseconds m_time;
     /** What peer the request was from. */
     const NodeId m_peer;
+    /**
+     * The priority of this announcement, computed once as it is compared
+     * with the other candidates for the same invid each time one of them has
+     * to be selected.
+     */
+    const Priority m_priority;
     /** What sequence number this announcement has. */
     const SequenceNumber m_sequence : 60;
     /** Whether the request is preferred. */
@@ -124,160 +160,63 @@ struct Announcement {
      * CANDIDATE_DELAYED state.
      */
     Announcement(const uint256 &invid, NodeId peer, bool preferred,
-                 std::chrono::microseconds reqtime, SequenceNumber sequence)
-        : m_invid(invid), m_time(reqtime), m_peer(peer), m_sequence(sequence),
-          m_preferred(preferred),
+                 std::chrono::microseconds reqtime, SequenceNumber sequence,
+                 Priority priority)
+        : m_invid(invid), m_time(reqtime), m_peer(peer), m_priority(priority),
+          m_sequence(sequence), m_preferred(preferred),
           m_state(static_cast<uint8_t>(State::CANDIDATE_DELAYED)) {}
 };
 
-//! Type alias for priorities.
-using Priority = uint64_t;
-
-/**
- * A functor with embedded salt that computes priority of an announcement.
- *
- * Higher priorities are selected first.
- */
-class PriorityComputer {
-    const uint64_t m_k0, m_k1;
-
-public:
-    explicit PriorityComputer(bool deterministic)
-        : m_k0{deterministic ? 0 : GetRand(0xFFFFFFFFFFFFFFFF)},
-          m_k1{deterministic ? 0 : GetRand(0xFFFFFFFFFFFFFFFF)} {}
-
-    Priority operator()(const uint256 &invid, NodeId peer,
-                        bool preferred) const {
-        uint64_t low_bits = CSipHasher(m_k0, m_k1)
-                                .Write(invid.begin(), invid.size())
-                                .Write(peer)
-                                .Finalize() >>
-                            1;
-        return low_bits | uint64_t{preferred} << 63;
-    }
-
-    Priority operator()(const Announcement &ann) const {
-        return operator()(ann.m_invid, ann.m_peer, ann.m_preferred);
-    }
-};
-
-// Definitions for the 3 indexes used in the main data structure.
-//
-// Each index has a By* type to identify it, a By*View data type to represent
-// the view of announcement it is sorted by, and an By*ViewExtractor type to
-// convert an announcement into the By*View type. See
-// https://www.boost.org/doc/libs/1_58_0/libs/multi_index/doc/reference/key_extraction.html#key_extractors
-// for more information about the key extraction concept.
-
-// The ByPeer index is sorted by (peer, state == CANDIDATE_BEST, invid)
-//
-// Uses:
-// * Looking up existing announcements by peer/invid, by checking both (peer,
-//   false, invid) and (peer, true, invid).
-// * Finding all CANDIDATE_BEST announcements for a given peer in
-//   GetRequestable.
-struct ByPeer {};
-using ByPeerView = std::tuple<NodeId, bool, const uint256 &>;
-struct ByPeerViewExtractor {
-    using result_type = ByPeerView;
-    result_type operator()(const Announcement &ann) const {
-        return ByPeerView{ann.m_peer, ann.GetState() == State::CANDIDATE_BEST,
-                          ann.m_invid};
-    }
+/** Per-peer statistics object. */
+struct PeerInfo {
+    //! Total number of announcements for this peer.
+    size_t m_total = 0;
+    //! Number of COMPLETED announcements for this peer.
+    size_t m_completed = 0;
+    //! Number of REQUESTED announcements for this peer.
+    size_t m_requested = 0;
 };
 
-// The ByInvId index is sorted by (invid, state, priority).
-//
-// Note: priority == 0 whenever state != CANDIDATE_READY.
-//
-// Uses:
-// * Deleting all announcements with a given invid in ForgetInvId.
-// * Finding the best CANDIDATE_READY to convert to CANDIDATE_BEST, when no
-//   other CANDIDATE_READY or REQUESTED announcement exists for that invid.
-// * Determining when no more non-COMPLETED announcements for a given invid
-//   exist, so the COMPLETED ones can be deleted.
-struct ByInvId {};
-using ByInvIdView = std::tuple<const uint256 &, State, Priority>;
-class ByInvIdViewExtractor {
-    const PriorityComputer &m_computer;
-
-public:
-    explicit ByInvIdViewExtractor(const PriorityComputer &computer)
-        : m_computer(computer) {}
-    using result_type = ByInvIdView;
-    result_type operator()(const Announcement &ann) const {
-        const Priority prio =
-            (ann.GetState() == State::CANDIDATE_READY) ? m_computer(ann) : 0;
-        return ByInvIdView{ann.m_invid, ann.GetState(), prio};
-    }
+/** Compare two PeerInfo objects. Only used for sanity checking. */
+bool operator==(const PeerInfo &a, const PeerInfo &b) {
+    return std::tie(a.m_total, a.m_completed, a.m_requested) ==
+           std::tie(b.m_total, b.m_completed, b.m_requested);
 };
 
-enum class WaitState {
-    //! Used for announcements that need efficient testing of "is their
-    //! timestamp in the future?".
-    FUTURE_EVENT,
-    //! Used for announcements whose timestamp is not relevant.
-    NO_EVENT,
-    //! Used for announcements that need efficient testing of "is their
-    //! timestamp in the past?".
-    PAST_EVENT,
+/** The announcements of a peer, which own the Announcement objects. */
+struct PeerData {
+    PeerInfo m_info;
+    //! The announcements of this peer, by invid.
+    std::unordered_map<uint256, Announcement, SaltedUint256Hasher>
+        m_announcements;
+    //! The CANDIDATE_BEST announcements of this peer, to be requested.
+    std::unordered_set<Announcement *> m_best;
 };
 
-WaitState GetWaitState(const Announcement &ann) {
-    if (ann.IsWaiting()) {
-        return WaitState::FUTURE_EVENT;
-    }
-    if (ann.IsSelectable()) {
-        return WaitState::PAST_EVENT;
-    }
-    return WaitState::NO_EVENT;
-}
-
-// The ByTime index is sorted by (wait_state, time).
-//
-// All announcements with a timestamp in the future can be found by iterating
-// the index forward from the beginning. All announcements with a timestamp in
-// the past can be found by iterating the index backwards from the end.
-//
-// Uses:
-// * Finding CANDIDATE_DELAYED announcements whose reqtime has passed, and
-//   REQUESTED announcements whose expiry has passed.
-// * Finding CANDIDATE_READY/BEST announcements whose reqtime is in the future
-//   (when the clock time went backwards).
-struct ByTime {};
-using ByTimeView = std::pair<WaitState, std::chrono::microseconds>;
-struct ByTimeViewExtractor {
-    using result_type = ByTimeView;
-    result_type operator()(const Announcement &ann) const {
-        return ByTimeView{GetWaitState(ann), ann.m_time};
-    }
+/** The announcements of an invid, across all the peers. */
+struct InvIdData {
+    //! The announcements for this invid, at most one per peer.
+    std::vector<Announcement *> m_announcements;
+    //! The CANDIDATE_BEST or REQUESTED announcement, if any.
+    Announcement *m_selected = nullptr;
+    //! Number of announcements for this invid that are not COMPLETED.
+    size_t m_non_completed = 0;
 };
 
 /**
- * Data type for the main data structure (Announcement objects with
- * ByPeer/ByInvId/ByTime indexes).
+ * A point in time at which a CANDIDATE_DELAYED or REQUESTED announcement
+ * should be looked at again. The events of announcements that changed or
+ * were deleted since are skipped when they come up.
  */
-using Index = boost::multi_index_container<
-    Announcement,
-    boost::multi_index::indexed_by<
-        boost::multi_index::ordered_unique<boost::multi_index::tag<ByPeer>,
-                                           ByPeerViewExtractor>,
-        boost::multi_index::ordered_non_unique<boost::multi_index::tag<ByInvId>,
-                                               ByInvIdViewExtractor>,
-        boost::multi_index::ordered_non_unique<boost::multi_index::tag<ByTime>,
-                                               ByTimeViewExtractor>>>;
-
-/** Helper type to simplify syntax of iterator types. */
-template <typename Tag> using Iter = typename Index::index<Tag>::type::iterator;
+struct TimeEvent {
+    std::chrono::microseconds m_time;
+    NodeId m_peer;
+    uint256 m_invid;
 
-/** Per-peer statistics object. */
-struct PeerInfo {
-    //! Total number of announcements for this peer.
-    size_t m_total = 0;
-    //! Number of COMPLETED announcements for this peer.
-    size_t m_completed = 0;
-    //! Number of REQUESTED announcements for this peer.
-    size_t m_requested = 0;
+    //! Order the events by decreasing time, for a min-heap.
+    bool operator<(const TimeEvent &other) const {
+        return m_time > other.m_time;
+    }
 };
 
 /** Per-invid statistics object. Only used for sanity checking. */
@@ -302,54 +241,6 @@ struct InvIdInfo {
     std::vector<NodeId> m_peers;
 };
 
-/** Compare two PeerInfo objects. Only used for sanity checking. */
-bool operator==(const PeerInfo &a, const PeerInfo &b) {
-    return std::tie(a.m_total, a.m_completed, a.m_requested) ==
-           std::tie(b.m_total, b.m_completed, b.m_requested);
-};
-
-/**
- * (Re)compute the PeerInfo map from the index. Only used for sanity checking.
- */
-std::unordered_map<NodeId, PeerInfo> RecomputePeerInfo(const Index &index) {
-    std::unordered_map<NodeId, PeerInfo> ret;
-    for (const Announcement &ann : index) {
-        PeerInfo &info = ret[ann.m_peer];
-        ++info.m_total;
-        info.m_requested += (ann.GetState() == State::REQUESTED);
-        info.m_completed += (ann.GetState() == State::COMPLETED);
-    }
-    return ret;
-}
-
-/** Compute the InvIdInfo map. Only used for sanity checking. */
-std::map<uint256, InvIdInfo>
-ComputeInvIdInfo(const Index &index, const PriorityComputer &computer) {
-    std::map<uint256, InvIdInfo> ret;
-    for (const Announcement &ann : index) {
-        InvIdInfo &info = ret[ann.m_invid];
-        // Classify how many announcements of each state we have for this invid.
-        info.m_candidate_delayed +=
-            (ann.GetState() == State::CANDIDATE_DELAYED);
-        info.m_candidate_ready += (ann.GetState() == State::CANDIDATE_READY);
-        info.m_candidate_best += (ann.GetState() == State::CANDIDATE_BEST);
-        info.m_requested += (ann.GetState() == State::REQUESTED);
-        // And track the priority of the best CANDIDATE_READY/CANDIDATE_BEST
-        // announcements.
-        if (ann.GetState() == State::CANDIDATE_BEST) {
-            info.m_priority_candidate_best = computer(ann);
-        }
-        if (ann.GetState() == State::CANDIDATE_READY) {
-            info.m_priority_best_candidate_ready =
-                std::max(info.m_priority_best_candidate_ready, computer(ann));
-        }
-        // Also keep track of which peers this invid has an announcement for
-        // (so we can detect duplicates).
-        info.m_peers.push_back(ann.m_peer);
-    }
-    return ret;
-}
-
 } // namespace
 
 /** Actual implementation for InvRequestTracker's data structure. */
@@ -361,24 +252,91 @@ class InvRequestTrackerImpl : public InvRequestTrackerImplInterface {
     //! This tracker's priority computer.
     const PriorityComputer m_computer;
 
-    //! This tracker's main data structure. See SanityCheck() for the invariants
-    //! that apply to it.
-    Index m_index;
+    //! This tracker's main data structure, owning the announcements. See
+    //! SanityCheck() for the invariants that apply to it.
+    std::unordered_map<NodeId, PeerData> m_peers;
 
-    //! Map with this tracker's per-peer statistics.
-    std::unordered_map<NodeId, PeerInfo> m_peerinfo;
+    //! The announcements by invid.
+    std::unordered_map<uint256, InvIdData, SaltedUint256Hasher> m_invids;
+
+    //! Total number of announcements.
+    size_t m_size{0};
+
+    //! Min-heap of the times at which the CANDIDATE_DELAYED and REQUESTED
+    //! announcements are due, so that all the due ones are found at once.
+    std::vector<TimeEvent> m_events;
+
+    //! The time of the last SetTimePoint() call. No CANDIDATE_READY or
+    //! CANDIDATE_BEST announcement has a later time.
+    std::chrono::microseconds m_last_time_point{
+        std::chrono::microseconds::min()};
 
 public:
     void SanityCheck() const {
-        // Recompute m_peerdata from m_index. This verifies the data in it as it
-        // should just be caching statistics on m_index. It also verifies the
-        // invariant that no PeerInfo announcements with m_total==0 exist.
-        assert(m_peerinfo == RecomputePeerInfo(m_index));
-
-        // Calculate per-invid statistics from m_index, and validate
-        // invariants.
-        for (auto &item : ComputeInvIdInfo(m_index, m_computer)) {
+        std::unordered_map<NodeId, PeerInfo> peerinfo;
+        std::map<uint256, InvIdInfo> invidinfo;
+        size_t size{0};
+        for (const auto &[peer, peerdata] : m_peers) {
+            // No peer without announcements is kept
+            assert(!peerdata.m_announcements.empty());
+            for (const auto &[invid, ann] : peerdata.m_announcements) {
+                assert(ann.m_peer == peer && ann.m_invid == invid);
+                assert(ann.m_priority ==
+                       m_computer(invid, peer, ann.m_preferred));
+                ++size;
+
+                PeerInfo &info = peerinfo[peer];
+                ++info.m_total;
+                info.m_requested += (ann.GetState() == State::REQUESTED);
+                info.m_completed += (ann.GetState() == State::COMPLETED);
+                Announcement *ptr{const_cast<Announcement *>(&ann)};
+                assert(peerdata.m_best.count(ptr) ==
+                       (ann.GetState() == State::CANDIDATE_BEST));
+
+                InvIdInfo &inv_info = invidinfo[invid];
+                // Classify how many announcements of each state we have for
+                // this invid.
+                inv_info.m_candidate_delayed +=
+                    (ann.GetState() == State::CANDIDATE_DELAYED);
+                inv_info.m_candidate_ready +=
+                    (ann.GetState() == State::CANDIDATE_READY);
+                inv_info.m_candidate_best +=
+                    (ann.GetState() == State::CANDIDATE_BEST);
+                inv_info.m_requested += (ann.GetState() == State::REQUESTED);
+                // And track the priority of the best
+                // CANDIDATE_READY/CANDIDATE_BEST announcements.
+                if (ann.GetState() == State::CANDIDATE_BEST) {
+                    inv_info.m_priority_candidate_best = ann.m_priority;
+                }
+                if (ann.GetState() == State::CANDIDATE_READY) {
+                    inv_info.m_priority_best_candidate_ready = std::max(
+                        inv_info.m_priority_best_candidate_ready,
+                        ann.m_priority);
+                }
+                // Also keep track of which peers this invid has an
+                // announcement for (so we can detect duplicates).
+                inv_info.m_peers.push_back(peer);
+
+                // The announcement is listed for its invid
+                const InvIdData &invdata = m_invids.at(invid);
+                assert(std::count(invdata.m_announcements.begin(),
+                                  invdata.m_announcements.end(), &ann) == 1);
+                assert((invdata.m_selected == &ann) == ann.IsSelected());
+            }
+            // The cached statistics match the announcements
+            assert(peerdata.m_info == peerinfo[peer]);
+            assert(peerdata.m_best.size() <= peerdata.m_announcements.size());
+        }
+        assert(size == m_size);
+        assert(m_invids.size() == invidinfo.size());
+
+        for (auto &item : invidinfo) {
             InvIdInfo &info = item.second;
+            const InvIdData &invdata = m_invids.at(item.first);
+            assert(invdata.m_announcements.size() == info.m_peers.size());
+            assert(invdata.m_non_completed ==
+                   info.m_candidate_delayed + info.m_candidate_ready +
+                       info.m_candidate_best + info.m_requested);
 
             // Cannot have only COMPLETED peer (invid should have been forgotten
             // already)
@@ -412,135 +370,178 @@ public:
     }
 
     void PostGetRequestableSanityCheck(std::chrono::microseconds now) const {
-        for (const Announcement &ann : m_index) {
-            if (ann.IsWaiting()) {
-                // REQUESTED and CANDIDATE_DELAYED must have a time in the
-                // future (they should have been converted to
-                // COMPLETED/CANDIDATE_READY respectively).
-                assert(ann.m_time > now);
-            } else if (ann.IsSelectable()) {
-                // CANDIDATE_READY and CANDIDATE_BEST cannot have a time in the
-                // future (they should have remained CANDIDATE_DELAYED, or
-                // should have been converted back to it if time went
-                // backwards).
-                assert(ann.m_time <= now);
+        for (const auto &[peer, peerdata] : m_peers) {
+            for (const auto &[invid, ann] : peerdata.m_announcements) {
+                if (ann.IsWaiting()) {
+                    // REQUESTED and CANDIDATE_DELAYED must have a time in the
+                    // future (they should have been converted to
+                    // COMPLETED/CANDIDATE_READY respectively).
+                    assert(ann.m_time > now);
+                } else if (ann.IsSelectable()) {
+                    // CANDIDATE_READY and CANDIDATE_BEST cannot have a time in
+                    // the future (they should have remained CANDIDATE_DELAYED,
+                    // or should have been converted back to it if time went
+                    // backwards).
+                    assert(ann.m_time <= now);
+                }
             }
         }
     }
 
 private:
-    //! Wrapper around Index::...::erase that keeps m_peerinfo up to date.
-    template <typename Tag> Iter<Tag> Erase(Iter<Tag> it) {
-        auto peerit = m_peerinfo.find(it->m_peer);
-        peerit->second.m_completed -= it->GetState() == State::COMPLETED;
-        peerit->second.m_requested -= it->GetState() == State::REQUESTED;
-        if (--peerit->second.m_total == 0) {
-            m_peerinfo.erase(peerit);
+    //! Find the announcement of a peer for an invid, or nullptr.
+    Announcement *Find(NodeId peer, const uint256 &invid) {
+        auto peerit = m_peers.find(peer);
+        if (peerit == m_peers.end()) {
+            return nullptr;
         }
-        return m_index.get<Tag>().erase(it);
+        auto it = peerit->second.m_announcements.find(invid);
+        return it == peerit->second.m_announcements.end() ? nullptr
+                                                          : &it->second;
     }
 
-    //! Wrapper around Index::...::modify that keeps m_peerinfo up to date.
-    template <typename Tag, typename Modifier>
-    void Modify(Iter<Tag> it, Modifier modifier) {
-        auto peerit = m_peerinfo.find(it->m_peer);
-        peerit->second.m_completed -= it->GetState() == State::COMPLETED;
-        peerit->second.m_requested -= it->GetState() == State::REQUESTED;
-        m_index.get<Tag>().modify(it, std::move(modifier));
-        peerit->second.m_completed += it->GetState() == State::COMPLETED;
-        peerit->second.m_requested += it->GetState() == State::REQUESTED;
+    //! Schedule a CANDIDATE_DELAYED or REQUESTED announcement to be looked at
+    //! again once its time is reached.
+    void ScheduleEvent(const Announcement &ann) {
+        m_events.push_back(TimeEvent{ann.m_time, ann.m_peer, ann.m_invid});
+        std::push_heap(m_events.begin(), m_events.end());
+        // The events of the announcements that changed or were deleted stay
+        // until their time is reached. Rebuild the heap when they outnumber
+        // the announcements.
+        if (m_events.size() > 2 * m_size + 1024) {
+            m_events.clear();
+            for (const auto &[peer, peerdata] : m_peers) {
+                for (const auto &[invid, other] : peerdata.m_announcements) {
+                    if (other.IsWaiting()) {
+                        m_events.push_back(
+                            TimeEvent{other.m_time, peer, invid});
+                    }
+                }
+            }
+            std::make_heap(m_events.begin(), m_events.end());
+        }
+    }
+
+    //! Change the state of an announcement, keeping the per-peer statistics,
+    //! the CANDIDATE_BEST sets and the per-invid data up to date.
+    void SetState(Announcement &ann, State state) {
+        PeerData &peerdata = m_peers.at(ann.m_peer);
+        InvIdData &invdata = m_invids.at(ann.m_invid);
+        const State old_state{ann.GetState()};
+        peerdata.m_info.m_completed -= old_state == State::COMPLETED;
+        peerdata.m_info.m_requested -= old_state == State::REQUESTED;
+        invdata.m_non_completed -= old_state != State::COMPLETED;
+        if (old_state == State::CANDIDATE_BEST) {
+            peerdata.m_best.erase(&ann);
+        }
+        if (ann.IsSelected()) {
+            invdata.m_selected = nullptr;
+        }
+
+        ann.SetState(state);
+
+        peerdata.m_info.m_completed += state == State::COMPLETED;
+        peerdata.m_info.m_requested += state == State::REQUESTED;
+        invdata.m_non_completed += state != State::COMPLETED;
+        if (state == State::CANDIDATE_BEST) {
+            peerdata.m_best.insert(&ann);
+        }
+        if (ann.IsSelected()) {
+            invdata.m_selected = &ann;
+        }
+    }
+
+    //! Delete all the announcements for an invid.
+    void EraseInvId(const uint256 &invid) {
+        auto invit = m_invids.find(invid);
+        if (invit == m_invids.end()) {
+            return;
+        }
+        for (Announcement *ann : invit->second.m_announcements) {
+            auto peerit = m_peers.find(ann->m_peer);
+            PeerData &peerdata = peerit->second;
+            peerdata.m_info.m_completed -= ann->GetState() == State::COMPLETED;
+            peerdata.m_info.m_requested -= ann->GetState() == State::REQUESTED;
+            peerdata.m_best.erase(ann);
+            --m_size;
+            if (--peerdata.m_info.m_total == 0) {
+                m_peers.erase(peerit);
+            } else {
+                peerdata.m_announcements.erase(invid);
+            }
+        }
+        m_invids.erase(invit);
+    }
+
+    //! Delete a single announcement, which must not be the last non-COMPLETED
+    //! one for its invid.
+    void Erase(Announcement &ann) {
+        // Copied, as erasing the announcement invalidates its m_invid.
+        const uint256 invid{ann.m_invid};
+        SetState(ann, State::COMPLETED);
+        auto invit = m_invids.find(invid);
+        auto &anns = invit->second.m_announcements;
+        *std::find(anns.begin(), anns.end(), &ann) = anns.back();
+        anns.pop_back();
+        if (anns.empty()) {
+            m_invids.erase(invit);
+        }
+
+        auto peerit = m_peers.find(ann.m_peer);
+        PeerData &peerdata = peerit->second;
+        --peerdata.m_info.m_completed;
+        --m_size;
+        if (--peerdata.m_info.m_total == 0) {
+            m_peers.erase(peerit);
+        } else {
+            peerdata.m_announcements.erase(invid);
+        }
     }
 
     //! Convert a CANDIDATE_DELAYED announcement into a CANDIDATE_READY. If this
     //! makes it the new best CANDIDATE_READY (and no REQUESTED exists) and
     //! better than the CANDIDATE_BEST (if any), it becomes the new
     //! CANDIDATE_BEST.
-    void PromoteCandidateReady(Iter<ByInvId> it) {
-        assert(it != m_index.get<ByInvId>().end());
-        assert(it->GetState() == State::CANDIDATE_DELAYED);
-        // Convert CANDIDATE_DELAYED to CANDIDATE_READY first.
-        Modify<ByInvId>(it, [](Announcement &ann) {
-            ann.SetState(State::CANDIDATE_READY);
-        });
-        // The following code relies on the fact that the ByInvId is sorted by
-        // invid, and then by state (first _DELAYED, then _READY, then
-        // _BEST/REQUESTED). Within the _READY announcements, the best one
-        // (highest priority) comes last. Thus, if an existing _BEST exists for
-        // the same invid that this announcement may be preferred over, it must
-        // immediately follow the newly created _READY.
-        auto it_next = std::next(it);
-        if (it_next == m_index.get<ByInvId>().end() ||
-            it_next->m_invid != it->m_invid ||
-            it_next->GetState() == State::COMPLETED) {
+    void PromoteCandidateReady(Announcement &ann) {
+        assert(ann.GetState() == State::CANDIDATE_DELAYED);
+        Announcement *selected = m_invids.at(ann.m_invid).m_selected;
+        if (selected == nullptr) {
             // This is the new best CANDIDATE_READY, and there is no
             // IsSelected() announcement for this invid already.
-            Modify<ByInvId>(it, [](Announcement &ann) {
-                ann.SetState(State::CANDIDATE_BEST);
-            });
-        } else if (it_next->GetState() == State::CANDIDATE_BEST) {
-            Priority priority_old = m_computer(*it_next);
-            Priority priority_new = m_computer(*it);
-            if (priority_new > priority_old) {
-                // There is a CANDIDATE_BEST announcement already, but this one
-                // is better.
-                Modify<ByInvId>(it_next, [](Announcement &ann) {
-                    ann.SetState(State::CANDIDATE_READY);
-                });
-                Modify<ByInvId>(it, [](Announcement &ann) {
-                    ann.SetState(State::CANDIDATE_BEST);
-                });
-            }
+            SetState(ann, State::CANDIDATE_BEST);
+        } else if (selected->GetState() == State::CANDIDATE_BEST &&
+                   ann.m_priority > selected->m_priority) {
+            // There is a CANDIDATE_BEST announcement already, but this one
+            // is better.
+            SetState(*selected, State::CANDIDATE_READY);
+            SetState(ann, State::CANDIDATE_BEST);
+        } else {
+            SetState(ann, State::CANDIDATE_READY);
         }
     }
 
     //! Change the state of an announcement to something non-IsSelected(). If it
     //! was IsSelected(), the next best announcement will be marked
     //! CANDIDATE_BEST.
-    void ChangeAndReselect(Iter<ByInvId> it, State new_state) {
+    void ChangeAndReselect(Announcement &ann, State new_state) {
         assert(new_state == State::COMPLETED ||
                new_state == State::CANDIDATE_DELAYED);
-        assert(it != m_index.get<ByInvId>().end());
-        if (it->IsSelected() && it != m_index.get<ByInvId>().begin()) {
-            auto it_prev = std::prev(it);
-            // The next best CANDIDATE_READY, if any, immediately precedes the
-            // REQUESTED or CANDIDATE_BEST announcement in the ByInvId index.
-            if (it_prev->m_invid == it->m_invid &&
-                it_prev->GetState() == State::CANDIDATE_READY) {
-                // If one such CANDIDATE_READY exists (for this invid), convert
-                // it to CANDIDATE_BEST.
-                Modify<ByInvId>(it_prev, [](Announcement &ann) {
-                    ann.SetState(State::CANDIDATE_BEST);
-                });
+        const bool was_selected{ann.IsSelected()};
+        SetState(ann, new_state);
+        if (was_selected) {
+            // Select the best CANDIDATE_READY for this invid, if any.
+            Announcement *best = nullptr;
+            const InvIdData &invdata = m_invids.at(ann.m_invid);
+            for (Announcement *other : invdata.m_announcements) {
+                if (other->GetState() == State::CANDIDATE_READY &&
+                    (best == nullptr || other->m_priority > best->m_priority)) {
+                    best = other;
+                }
+            }
+            if (best != nullptr) {
+                SetState(*best, State::CANDIDATE_BEST);
             }
         }
-        Modify<ByInvId>(
-            it, [new_state](Announcement &ann) { ann.SetState(new_state); });
-    }
-
-    //! Check if 'it' is the only announcement for a given invid that isn't
-    //! COMPLETED.
-    bool IsOnlyNonCompleted(Iter<ByInvId> it) {
-        assert(it != m_index.get<ByInvId>().end());
-        // Not allowed to call this on COMPLETED announcements.
-        assert(it->GetState() != State::COMPLETED);
-
-        // This announcement has a predecessor that belongs to the same invid.
-        // Due to ordering, and the fact that 'it' is not COMPLETED, its
-        // predecessor cannot be COMPLETED here.
-        if (it != m_index.get<ByInvId>().begin() &&
-            std::prev(it)->m_invid == it->m_invid) {
-            return false;
-        }
-
-        // This announcement has a successor that belongs to the same invid,
-        // and is not COMPLETED.
-        if (std::next(it) != m_index.get<ByInvId>().end() &&
-            std::next(it)->m_invid == it->m_invid &&
-            std::next(it)->GetState() != State::COMPLETED) {
-            return false;
-        }
-
-        return true;
     }
 
     /**
@@ -550,28 +551,22 @@ private:
      * the best one is made CANDIDATE_BEST. Returns whether the announcement
      * still exists.
      */
-    bool MakeCompleted(Iter<ByInvId> it) {
-        assert(it != m_index.get<ByInvId>().end());
-
+    bool MakeCompleted(Announcement &ann) {
         // Nothing to be done if it's already COMPLETED.
-        if (it->GetState() == State::COMPLETED) {
+        if (ann.GetState() == State::COMPLETED) {
             return true;
         }
 
-        if (IsOnlyNonCompleted(it)) {
+        if (m_invids.at(ann.m_invid).m_non_completed == 1) {
             // This is the last non-COMPLETED announcement for this invid.
             // Delete all.
-            uint256 invid = it->m_invid;
-            do {
-                it = Erase<ByInvId>(it);
-            } while (it != m_index.get<ByInvId>().end() &&
-                     it->m_invid == invid);
+            EraseInvId(uint256(ann.m_invid));
             return false;
         }
 
         // Mark the announcement COMPLETED, and select the next best
         // announcement (the first CANDIDATE_READY) if needed.
-        ChangeAndReselect(it, State::COMPLETED);
+        ChangeAndReselect(ann, State::COMPLETED);
 
         return true;
     }
@@ -586,132 +581,111 @@ private:
                       ClearExpiredFun clearExpired,
                       EmplaceExpiredFun emplaceExpired) {
         clearExpired();
-        // Iterate over all CANDIDATE_DELAYED and REQUESTED from old to new, as
-        // long as they're in the past, and convert them to CANDIDATE_READY andc
-        // COMPLETED respectively.
-        while (!m_index.empty()) {
-            auto it = m_index.get<ByTime>().begin();
-            if (it->GetState() == State::CANDIDATE_DELAYED &&
-                it->m_time <= now) {
-                PromoteCandidateReady(m_index.project<ByInvId>(it));
-            } else if (it->GetState() == State::REQUESTED &&
-                       it->m_time <= now) {
-                emplaceExpired(it->m_peer, it->m_invid);
-                MakeCompleted(m_index.project<ByInvId>(it));
+        // Handle all the CANDIDATE_DELAYED and REQUESTED announcements whose
+        // time has passed, and convert them to CANDIDATE_READY and COMPLETED
+        // respectively. The outcome doesn't depend on the order they are
+        // handled in.
+        while (!m_events.empty() && m_events.front().m_time <= now) {
+            std::pop_heap(m_events.begin(), m_events.end());
+            const TimeEvent event{std::move(m_events.back())};
+            m_events.pop_back();
+
+            Announcement *ann = Find(event.m_peer, event.m_invid);
+            if (ann == nullptr || !ann->IsWaiting() || ann->m_time > now) {
+                // This event is outdated
+                continue;
+            }
+            if (ann->GetState() == State::CANDIDATE_DELAYED) {
+                PromoteCandidateReady(*ann);
             } else {
-                break;
+                emplaceExpired(ann->m_peer, ann->m_invid);
+                MakeCompleted(*ann);
             }
         }
 
-        while (!m_index.empty()) {
+        if (now < m_last_time_point) {
             // If time went backwards, we may need to demote CANDIDATE_BEST and
             // CANDIDATE_READY announcements back to CANDIDATE_DELAYED. This is
             // an unusual edge case, and unlikely to matter in production.
             // However, it makes it much easier to specify and test
             // InvRequestTracker::Impl's behaviour.
-            auto it = std::prev(m_index.get<ByTime>().end());
-            if (it->IsSelectable() && it->m_time > now) {
-                ChangeAndReselect(m_index.project<ByInvId>(it),
-                                  State::CANDIDATE_DELAYED);
-            } else {
-                break;
+            std::vector<Announcement *> demoted;
+            for (auto &[peer, peerdata] : m_peers) {
+                for (auto &[invid, ann] : peerdata.m_announcements) {
+                    if (ann.IsSelectable() && ann.m_time > now) {
+                        demoted.push_back(&ann);
+                    }
+                }
+            }
+            for (Announcement *ann : demoted) {
+                // A demoted announcement may have been selected again by
+                // ChangeAndReselect() in the meantime, but stays selectable.
+                ChangeAndReselect(*ann, State::CANDIDATE_DELAYED);
+                ScheduleEvent(*ann);
             }
         }
+        m_last_time_point = now;
     }
 
 public:
     explicit InvRequestTrackerImpl(bool deterministic)
-        : m_computer(deterministic),
-          // Explicitly initialize m_index as we need to pass a reference to
-          // m_computer to ByInvIdViewExtractor.
-          m_index(boost::make_tuple(
-              boost::make_tuple(ByPeerViewExtractor(), std::less<ByPeerView>()),
-              boost::make_tuple(ByInvIdViewExtractor(m_computer),
-                                std::less<ByInvIdView>()),
-              boost::make_tuple(ByTimeViewExtractor(),
-                                std::less<ByTimeView>()))) {}
-
-    // Disable copying and assigning (a default copy won't work due the stateful
-    // ByInvIdViewExtractor).
+        : m_computer(deterministic) {}
+
     InvRequestTrackerImpl(const InvRequestTrackerImpl &) = delete;
     InvRequestTrackerImpl &operator=(const InvRequestTrackerImpl &) = delete;
 
     ~InvRequestTrackerImpl() = default;
 
     void DisconnectedPeer(NodeId peer) {
-        auto &index = m_index.get<ByPeer>();
-        auto it =
-            index.lower_bound(ByPeerView{peer, false, uint256(uint256::ZERO)});
-        while (it != index.end() && it->m_peer == peer) {
-            // Check what to continue with after this iteration. 'it' will be
-            // deleted in what follows, so we need to decide what to continue
-            // with afterwards. There are a number of cases to consider:
-            // - std::next(it) is end() or belongs to a different peer. In that
-            //   case, this is the last iteration of the loop (denote this by
-            //   setting it_next to end()).
-            // - 'it' is not the only non-COMPLETED announcement for its invid.
-            //   This means it will be deleted, but no other Announcement
-            //   objects will be modified. Continue with std::next(it) if it
-            //   belongs to the same peer, but decide this ahead of time (as
-            //   'it' may change position in what follows).
-            // - 'it' is the only non-COMPLETED announcement for its invid. This
-            //   means it will be deleted along with all other announcements for
-            //   the same invid - which may include std::next(it). However,
-            //   other than 'it', no announcements for the same peer can be
-            //   affected (due to (peer, invid) uniqueness). In other words, the
-            //   situation where std::next(it) is deleted can only occur if
-            //   std::next(it) belongs to a different peer but the same invid as
-            //   'it'. This is covered by the first bulletpoint already, and
-            //   we'll have set it_next to end().
-            auto it_next =
-                (std::next(it) == index.end() || std::next(it)->m_peer != peer)
-                    ? index.end()
-                    : std::next(it);
+        auto peerit = m_peers.find(peer);
+        if (peerit == m_peers.end()) {
+            return;
+        }
+        // Deleting the announcements may delete the peer's data, so collect
+        // them first. Other than the announcement itself, no announcement for
+        // the same peer can be affected (due to (peer, invid) uniqueness).
+        std::vector<uint256> invids;
+        invids.reserve(peerit->second.m_announcements.size());
+        for (const auto &[invid, ann] : peerit->second.m_announcements) {
+            invids.push_back(invid);
+        }
+        for (const uint256 &invid : invids) {
+            Announcement *ann = Find(peer, invid);
             // If the announcement isn't already COMPLETED, first make it
             // COMPLETED (which will mark other CANDIDATEs as CANDIDATE_BEST, or
             // delete all of a invid's announcements if no non-COMPLETED ones
             // are left).
-            if (MakeCompleted(m_index.project<ByInvId>(it))) {
+            if (MakeCompleted(*ann)) {
                 // Then actually delete the announcement (unless it was already
                 // deleted by MakeCompleted).
-                Erase<ByPeer>(it);
+                Erase(*ann);
             }
-            it = it_next;
         }
     }
 
-    void ForgetInvId(const uint256 &invid) {
-        auto it = m_index.get<ByInvId>().lower_bound(
-            ByInvIdView{invid, State::CANDIDATE_DELAYED, 0});
-        while (it != m_index.get<ByInvId>().end() && it->m_invid == invid) {
-            it = Erase<ByInvId>(it);
-        }
-    }
+    void ForgetInvId(const uint256 &invid) { EraseInvId(invid); }
 
     void ReceivedInv(NodeId peer, const uint256 &invid, bool preferred,
                      std::chrono::microseconds reqtime) {
-        // Bail out if we already have a CANDIDATE_BEST announcement for this
-        // (invid, peer) combination. The case where there is a
-        // non-CANDIDATE_BEST announcement already will be caught by the
-        // uniqueness property of the ByPeer index when we try to emplace the
-        // new object below.
-        if (m_index.get<ByPeer>().count(ByPeerView{peer, true, invid})) {
-            return;
-        }
-
-        // Try creating the announcement with CANDIDATE_DELAYED state (which
-        // will fail due to the uniqueness of the ByPeer index if a
-        // non-CANDIDATE_BEST announcement already exists with the same invid
-        // and peer). Bail out in that case.
-        auto ret = m_index.get<ByPeer>().emplace(invid, peer, preferred,
-                                                 reqtime, m_current_sequence);
-        if (!ret.second) {
+        // Bail out if we already have an announcement for this (invid, peer)
+        // combination.
+        PeerData &peerdata = m_peers[peer];
+        auto [it, inserted] = peerdata.m_announcements.try_emplace(
+            invid, invid, peer, preferred, reqtime, m_current_sequence,
+            m_computer(invid, peer, preferred));
+        if (!inserted) {
             return;
         }
 
         // Update accounting metadata.
-        ++m_peerinfo[peer].m_total;
+        Announcement &ann = it->second;
+        InvIdData &invdata = m_invids[invid];
+        invdata.m_announcements.push_back(&ann);
+        ++invdata.m_non_completed;
+        ++peerdata.m_info.m_total;
+        ++m_size;
         ++m_current_sequence;
+        ScheduleEvent(ann);
     }
 
     //! Find the InvIds to request now from peer.
@@ -723,15 +697,12 @@ public:
         SetTimePoint(now, clearExpired, emplaceExpired);
 
         // Find all CANDIDATE_BEST announcements for this peer.
-        std::vector<const Announcement *> selected;
-        auto it_peer = m_index.get<ByPeer>().lower_bound(
-            ByPeerView{peer, true, uint256(uint256::ZERO)});
-        while (it_peer != m_index.get<ByPeer>().end() &&
-               it_peer->m_peer == peer &&
-               it_peer->GetState() == State::CANDIDATE_BEST) {
-            selected.emplace_back(&*it_peer);
-            ++it_peer;
+        auto peerit = m_peers.find(peer);
+        if (peerit == m_peers.end()) {
+            return {};
         }
+        std::vector<const Announcement *> selected(
+            peerit->second.m_best.begin(), peerit->second.m_best.end());
 
         // Sort by sequence number.
         std::sort(selected.begin(), selected.end(),
@@ -750,8 +721,11 @@ public:
 
     void RequestedData(NodeId peer, const uint256 &invid,
                        std::chrono::microseconds expiry) {
-        auto it = m_index.get<ByPeer>().find(ByPeerView{peer, true, invid});
-        if (it == m_index.get<ByPeer>().end()) {
+        Announcement *ann = Find(peer, invid);
+        if (ann == nullptr) {
+            return;
+        }
+        if (ann->GetState() != State::CANDIDATE_BEST) {
             // There is no CANDIDATE_BEST announcement, look for a _READY or
             // _DELAYED instead. If the caller only ever invokes RequestedData
             // with the values returned by GetRequestable, and no other
@@ -759,11 +733,8 @@ public:
             // between, this branch will never execute (as invids returned by
             // GetRequestable always correspond to CANDIDATE_BEST
             // announcements).
-
-            it = m_index.get<ByPeer>().find(ByPeerView{peer, false, invid});
-            if (it == m_index.get<ByPeer>().end() ||
-                (it->GetState() != State::CANDIDATE_DELAYED &&
-                 it->GetState() != State::CANDIDATE_READY)) {
+            if (ann->GetState() != State::CANDIDATE_DELAYED &&
+                ann->GetState() != State::CANDIDATE_READY) {
                 // There is no CANDIDATE announcement tracked for this peer, so
                 // we have nothing to do. Either this invid wasn't tracked at
                 // all (and the caller should have called ReceivedInv), or it
@@ -773,14 +744,10 @@ public:
             }
 
             // Look for an existing CANDIDATE_BEST or REQUESTED with the same
-            // invid. We only need to do this if the found announcement had a
-            // different state than CANDIDATE_BEST. If it did, invariants
-            // guarantee that no other CANDIDATE_BEST or REQUESTED can exist.
-            auto it_old = m_index.get<ByInvId>().lower_bound(
-                ByInvIdView{invid, State::CANDIDATE_BEST, 0});
-            if (it_old != m_index.get<ByInvId>().end() &&
-                it_old->m_invid == invid) {
-                if (it_old->GetState() == State::CANDIDATE_BEST) {
+            // invid.
+            Announcement *old = m_invids.at(invid).m_selected;
+            if (old != nullptr) {
+                if (old->GetState() == State::CANDIDATE_BEST) {
                     // The data structure's invariants require that there can be
                     // at most one CANDIDATE_BEST or one REQUESTED announcement
                     // per invid (but not both simultaneously), so we have to
@@ -791,66 +758,55 @@ public:
                     // GetRequestable() time. If time only goes forward, it will
                     // always be _READY, so pick that to avoid extra work in
                     // SetTimePoint().
-                    Modify<ByInvId>(it_old, [](Announcement &ann) {
-                        ann.SetState(State::CANDIDATE_READY);
-                    });
-                } else if (it_old->GetState() == State::REQUESTED) {
+                    SetState(*old, State::CANDIDATE_READY);
+                } else {
                     // As we're no longer waiting for a response to the previous
                     // REQUESTED announcement, convert it to COMPLETED. This
                     // also helps guaranteeing progress.
-                    Modify<ByInvId>(it_old, [](Announcement &ann) {
-                        ann.SetState(State::COMPLETED);
-                    });
+                    SetState(*old, State::COMPLETED);
                 }
             }
         }
 
-        Modify<ByPeer>(it, [expiry](Announcement &ann) {
-            ann.SetState(State::REQUESTED);
-            ann.m_time = expiry;
-        });
+        SetState(*ann, State::REQUESTED);
+        ann->m_time = expiry;
+        ScheduleEvent(*ann);
     }
 
     void ReceivedResponse(NodeId peer, const uint256 &invid) {
-        // We need to search the ByPeer index for both (peer, false, invid) and
-        // (peer, true, invid).
-        auto it = m_index.get<ByPeer>().find(ByPeerView{peer, false, invid});
-        if (it == m_index.get<ByPeer>().end()) {
-            it = m_index.get<ByPeer>().find(ByPeerView{peer, true, invid});
-        }
-        if (it != m_index.get<ByPeer>().end()) {
-            MakeCompleted(m_index.project<ByInvId>(it));
+        if (Announcement *ann = Find(peer, invid)) {
+            MakeCompleted(*ann);
         }
     }
 
     size_t CountInFlight(NodeId peer) const {
-        auto it = m_peerinfo.find(peer);
-        if (it != m_peerinfo.end()) {
-            return it->second.m_requested;
+        auto it = m_peers.find(peer);
+        if (it != m_peers.end()) {
+            return it->second.m_info.m_requested;
         }
         return 0;
     }
 
     size_t CountCandidates(NodeId peer) const {
-        auto it = m_peerinfo.find(peer);
-        if (it != m_peerinfo.end()) {
-            return it->second.m_total - it->second.m_requested -
-                   it->second.m_completed;
+        auto it = m_peers.find(peer);
+        if (it != m_peers.end()) {
+            return it->second.m_info.m_total - it->second.m_info.m_requested -
+                   it->second.m_info.m_completed;
         }
         return 0;
     }
 
     size_t Count(NodeId peer) const {
-        auto it = m_peerinfo.find(peer);
-        if (it != m_peerinfo.end()) {
-            return it->second.m_total;
+        auto it = m_peers.find(peer);
+        if (it != m_peers.end()) {
+            return it->second.m_info.m_total;
         }
         return 0;
     }
 
     //! Count how many announcements are being tracked in total across all peers
     //! and transactions.
-    size_t Size() const { return m_index.size(); }
+    size_t Size() const { return m_size; }
 
     uint64_t ComputePriority(const uint256 &invid, NodeId peer,
                              bool preferred) const {
@@ -112,9 +112,10 @@
  * - Memory usage is proportional to the total number of tracked announcements
  *   (Size()) plus the number of peers with a nonzero number of tracked
  *   announcements.
- * - CPU usage is generally logarithmic in the total number of tracked
- *   announcements, plus the number of announcements affected by an operation
- *   (amortized O(1) per announcement).
+ * - CPU usage is generally constant per announcement affected by an
+ *   operation, plus logarithmic in the number of pending reqtime and expiry
+ *   events when time moves forward. Selecting a new CANDIDATE_BEST is linear
+ *   in the number of peers announcing the same invid.
  */
 
 // Avoid littering this header file with implementation details.
@@ -13,8 +13,17 @@
 #include <validation.h>
 #include <validationinterface.h>
 
+#include <algorithm>
+#include <vector>
+
 /** Maximum bytes for transactions to store for processing during reorg */
 static const size_t MAX_DISCONNECTED_TX_POOL_SIZE = 20 * DEFAULT_MAX_BLOCK_SIZE;
+/**
+ * Number of transactions whose scripts are verified together when they are
+ * added back to the mempool, bounding the memory used and keeping the results
+ * in the script cache until they are looked up.
+ */
+static const size_t REORG_SCRIPT_CHECK_BATCH_SIZE = 1000;
 
 const DisconnectedBlockTransactions::TxInfo *
 DisconnectedBlockTransactions::getTxInfo(const CTransactionRef &tx) const {
@@ -150,22 +159,7 @@ void DisconnectedBlockTransactions::removeForBlock(
         return;
     }
 
-    addForBlock(vtx, pool);
-
-    for (const CTransactionRef &tx :
-         reverse_iterate(queuedTx.get<insertion_order>())) {
-        CTxMemPool::txiter it = pool.mapTx.find(tx->GetId());
-        if (it != pool.mapTx.end()) {
-            CTxMemPool::setEntries stage;
-            stage.insert(it);
-            pool.RemoveStaged(stage, MemPoolRemovalReason::BLOCK);
-        } else {
-            // Conflicting txs can only exist if the tx was not in the mempool
-            pool.removeConflicts(*tx);
-        }
-        pool.ClearPrioritisation(tx->GetId());
-    }
-
+    pool.removeForBlock(vtx);
     pool.updateFeeForBlock();
 
     removeForBlock(vtx);
@@ -183,31 +177,52 @@ void DisconnectedBlockTransactions::updateMempoolForReorg(
         // Iterate disconnectpool in reverse, so that we add transactions back
         // to the mempool starting with the earliest transaction that had been
         // previously seen in a block.
+        std::vector<CTransactionRef> txs;
+        txs.reserve(queuedTx.size());
         for (const CTransactionRef &tx :
              reverse_iterate(queuedTx.get<insertion_order>())) {
-            if (tx->IsCoinBase()) {
-                continue;
-            }
-            // restore saved PrioritiseTransaction state and nAcceptTime
-            const auto ptxInfo = getTxInfo(tx);
-            bool hasFeeDelta = false;
-            if (ptxInfo && ptxInfo->feeDelta != Amount::zero()) {
-                // manipulate mapDeltas directly (faster than calling
-                // PrioritiseTransaction)
-                pool.mapDeltas[tx->GetId()] = ptxInfo->feeDelta;
-                hasFeeDelta = true;
+            if (!tx->IsCoinBase()) {
+                txs.push_back(tx);
             }
-            // ignore validation errors in resurrected transactions
-            auto result = AcceptToMemoryPool(
-                active_chainstate, tx,
-                /*accept_time=*/ptxInfo ? ptxInfo->time.count() : GetTime(),
-                /*bypass_limits=*/true, /*test_accept=*/false,
-                /*heightOverride=*/ptxInfo ? ptxInfo->height : 0);
-            if (result.m_result_type !=
-                    MempoolAcceptResult::ResultType::VALID &&
-                hasFeeDelta) {
-                // tx not accepted: undo mapDelta insertion from above
-                pool.mapDeltas.erase(tx->GetId());
+        }
+
+        for (size_t batch_start = 0; batch_start < txs.size();
+             batch_start += REORG_SCRIPT_CHECK_BATCH_SIZE) {
+            const size_t batch_size{std::min(
+                REORG_SCRIPT_CHECK_BATCH_SIZE, txs.size() - batch_start)};
+            const auto batch_begin = txs.cbegin() + batch_start;
+            const auto batch_end = batch_begin + batch_size;
+
+            // Verify the scripts of the whole batch in parallel, so that the
+            // transactions are then added back one by one from the script
+            // cache.
+            PreCheckTransactionScripts(active_chainstate, pool,
+                                       {batch_begin, batch_end});
+
+            for (auto it = batch_begin; it != batch_end; ++it) {
+                const CTransactionRef &tx = *it;
+                // restore saved PrioritiseTransaction state and nAcceptTime
+                const auto ptxInfo = getTxInfo(tx);
+                bool hasFeeDelta = false;
+                if (ptxInfo && ptxInfo->feeDelta != Amount::zero()) {
+                    // manipulate mapDeltas directly (faster than calling
+                    // PrioritiseTransaction)
+                    pool.mapDeltas[tx->GetId()] = ptxInfo->feeDelta;
+                    hasFeeDelta = true;
+                }
+                // ignore validation errors in resurrected transactions
+                auto result = AcceptToMemoryPool(
+                    active_chainstate, tx,
+                    /*accept_time=*/ptxInfo ? ptxInfo->time.count()
+                                            : GetTime(),
+                    /*bypass_limits=*/true, /*test_accept=*/false,
+                    /*heightOverride=*/ptxInfo ? ptxInfo->height : 0);
+                if (result.m_result_type !=
+                        MempoolAcceptResult::ResultType::VALID &&
+                    hasFeeDelta) {
+                    // tx not accepted: undo mapDelta insertion from above
+                    pool.mapDeltas.erase(tx->GetId());
+                }
             }
         }
     }
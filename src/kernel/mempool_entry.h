@@ -9,6 +9,7 @@
 #include <core_memusage.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
+#include <prevector.h>
 #include <primitives/transaction.h>
 #include <rcu.h>
 
@@ -55,6 +56,27 @@ struct CompareIteratorByRevEntryId {
 class CTxMemPoolEntry;
 using CTxMemPoolEntryRef = RCUPtr<CTxMemPoolEntry>;
 
+/**
+ * Link to another mempool entry, referring to the CTxMemPoolEntryRef stored in
+ * the mempool. Unlike a std::reference_wrapper it is default constructible, so
+ * the links can be stored in a prevector.
+ */
+class CTxMemPoolEntryLink {
+    const CTxMemPoolEntryRef *m_ref{nullptr};
+
+public:
+    CTxMemPoolEntryLink() = default;
+    CTxMemPoolEntryLink(const CTxMemPoolEntryRef &ref) : m_ref(&ref) {}
+
+    const CTxMemPoolEntryRef &get() const { return *m_ref; }
+    operator const CTxMemPoolEntryRef &() const { return *m_ref; }
+
+    friend bool operator==(const CTxMemPoolEntryLink &a,
+                           const CTxMemPoolEntryLink &b) {
+        return a.m_ref->get() == b.m_ref->get();
+    }
+};
+
 /** \class CTxMemPoolEntry
  *
  * CTxMemPoolEntry stores data about the corresponding transaction, as well as
@@ -64,13 +86,12 @@ using CTxMemPoolEntryRef = RCUPtr<CTxMemPoolEntry>;
 
 class CTxMemPoolEntry {
 public:
-    // two aliases, should the types ever diverge
-    typedef std::set<std::reference_wrapper<const CTxMemPoolEntryRef>,
-                     CompareIteratorById>
-        Parents;
-    typedef std::set<std::reference_wrapper<const CTxMemPoolEntryRef>,
-                     CompareIteratorById>
-        Children;
+    // two aliases, should the types ever diverge. Most transactions have few
+    // in-mempool parents and children: the links are unordered and stored
+    // inline up to LINKS_INLINE, which saves a tree node allocation per link.
+    static constexpr unsigned int LINKS_INLINE{2};
+    typedef prevector<LINKS_INLINE, CTxMemPoolEntryLink> Parents;
+    typedef prevector<LINKS_INLINE, CTxMemPoolEntryLink> Children;
 
 private:
     //! Unique identifier -- used for topological sorting
@@ -97,6 +118,11 @@ private:
     //! Track the height and time at which tx was final
     LockPoints lockPoints;
 
+public:
+    //! Index in the mempool's txns_randomized vector
+    mutable size_t idx_randomized{0};
+
+private:
     IMPLEMENT_RCU_REFCOUNT(uint64_t);
 
 public:
@@ -116,6 +142,7 @@ public:
           nTime(other.nTime), entryHeight(other.entryHeight),
           sigChecks(other.sigChecks), feeDelta(other.feeDelta),
           lockPoints(std::move(other.lockPoints)),
+          idx_randomized(other.idx_randomized),
           refcount(other.refcount.load()){};
 
     uint64_t GetEntryId() const { return entryId; }
@@ -16,6 +16,8 @@ static constexpr unsigned int DEFAULT_MAX_MEMPOOL_SIZE_MB{300};
  * Default for -mempoolexpiry, expiration time for mempool transactions in hours
  */
 static constexpr unsigned int DEFAULT_MEMPOOL_EXPIRY_HOURS{336};
+/** Default for -persistmempoolv1 */
+static constexpr bool DEFAULT_PERSIST_V1_DAT{false};
 
 namespace kernel {
 /**
@@ -50,6 +52,11 @@ struct MemPoolOptions {
                                    : std::nullopt};
     bool permit_bare_multisig{DEFAULT_PERMIT_BAREMULTISIG};
     bool require_standard{true};
+    /**
+     * Whether mempool.dat is written in the version 1 format, which can be
+     * loaded by older versions of the software
+     */
+    bool persist_v1_dat{DEFAULT_PERSIST_V1_DAT};
 };
 } // namespace kernel
 
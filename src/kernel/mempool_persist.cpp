@@ -6,6 +6,7 @@
 
 #include <clientversion.h>
 #include <consensus/amount.h>
+#include <feerate.h>
 #include <fs.h>
 #include <logging.h>
 #include <primitives/transaction.h>
@@ -19,6 +20,7 @@
 #include <util/time.h>
 #include <validation.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
@@ -26,6 +28,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <set>
 #include <stdexcept>
 #include <utility>
@@ -34,7 +37,92 @@
 using fsbridge::FopenFn;
 
 namespace kernel {
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+/**
+ * Version 2 stores the fee and the entry height of the transactions in
+ * addition to the version 1 fields. Both versions store the transactions in
+ * topological order.
+ */
+static const uint64_t MEMPOOL_DUMP_VERSION_NO_METADATA = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+
+/**
+ * Number of transactions read from the file and verified together on the
+ * transaction checking threads before being added to the mempool.
+ */
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 1000;
+
+namespace {
+struct MempoolRecord {
+    CTransactionRef tx;
+    int64_t time;
+    //! Unknown for version 1 files
+    std::optional<Amount> fee;
+    //! Height at which the transaction entered the mempool. Version 1 files
+    //! don't store it, the transaction is then given the current height.
+    unsigned int height{0};
+};
+
+struct LoadCounts {
+    int64_t count{0};
+    int64_t failed{0};
+    int64_t already_there{0};
+};
+} // namespace
+
+/**
+ * Add a batch of transactions read from mempool.dat to the mempool. The
+ * scripts of the whole batch are verified in parallel first, without holding
+ * cs_main, so that the transactions are then accepted one by one from the
+ * script cache.
+ */
+static void LoadMempoolBatch(CTxMemPool &pool, Chainstate &active_chainstate,
+                             const std::vector<MempoolRecord> &batch,
+                             LoadCounts &counts) {
+    std::vector<CTransactionRef> txs;
+    {
+        LOCK(pool.cs);
+        const CFeeRate min_feerate{
+            std::max(pool.GetMinFee(), pool.m_min_relay_feerate)};
+        txs.reserve(batch.size());
+        for (const MempoolRecord &record : batch) {
+            // Don't verify the scripts of the transactions that are rejected
+            // for their fee anyway. The size is a lower bound of the virtual
+            // size, so no transaction is wrongly skipped.
+            if (record.fee) {
+                Amount fee{*record.fee};
+                pool.ApplyDelta(record.tx->GetId(), fee);
+                if (fee < min_feerate.GetFee(record.tx->GetTotalSize())) {
+                    continue;
+                }
+            }
+            txs.push_back(record.tx);
+        }
+    }
+    // The coins are looked up under cs_main, which is released while the
+    // scripts are verified.
+    active_chainstate.m_chainman.PreCheckTransactionScripts(txs);
+
+    for (const MempoolRecord &record : batch) {
+        LOCK(cs_main);
+        const auto &accepted = AcceptToMemoryPool(
+            active_chainstate, record.tx, record.time,
+            /*bypass_limits=*/false, /*test_accept=*/false,
+            /*heightOverride=*/record.height);
+        if (accepted.m_result_type == MempoolAcceptResult::ResultType::VALID) {
+            ++counts.count;
+        } else {
+            // mempool may contain the transaction already, e.g. from
+            // wallet(s) having loaded it while we were processing
+            // mempool transactions; consider these as valid, instead of
+            // failed, but mark them as 'already there'
+            if (pool.exists(record.tx->GetId())) {
+                ++counts.already_there;
+            } else {
+                ++counts.failed;
+            }
+        }
+    }
+}
 
 bool LoadMempool(CTxMemPool &pool, const fs::path &load_path,
                  Chainstate &active_chainstate,
@@ -51,60 +139,55 @@ bool LoadMempool(CTxMemPool &pool, const fs::path &load_path,
         return false;
     }
 
-    int64_t count = 0;
+    LoadCounts counts;
     int64_t expired = 0;
-    int64_t failed = 0;
-    int64_t already_there = 0;
     int64_t unbroadcast = 0;
     auto now = NodeClock::now();
+    auto start = SteadyClock::now();
 
     try {
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
+        if (version != MEMPOOL_DUMP_VERSION &&
+            version != MEMPOOL_DUMP_VERSION_NO_METADATA) {
             return false;
         }
 
         uint64_t num;
         file >> num;
+        std::vector<MempoolRecord> batch;
         while (num) {
             --num;
-            CTransactionRef tx;
-            int64_t nTime;
+            MempoolRecord record;
             int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
+            file >> record.tx;
+            file >> record.time;
             file >> nFeeDelta;
+            if (version == MEMPOOL_DUMP_VERSION) {
+                Amount fee;
+                uint32_t height;
+                file >> fee;
+                file >> height;
+                record.fee = fee;
+                record.height = height;
+            }
 
             Amount amountdelta = nFeeDelta * SATOSHI;
             if (amountdelta != Amount::zero()) {
-                pool.PrioritiseTransaction(tx->GetId(), amountdelta);
+                pool.PrioritiseTransaction(record.tx->GetId(), amountdelta);
             }
-            if (nTime >
+            if (record.time >
                 TicksSinceEpoch<std::chrono::seconds>(now - pool.m_expiry)) {
-                LOCK(cs_main);
-                const auto &accepted =
-                    AcceptToMemoryPool(active_chainstate, tx, nTime,
-                                       /*bypass_limits=*/false,
-                                       /*test_accept=*/false);
-                if (accepted.m_result_type ==
-                    MempoolAcceptResult::ResultType::VALID) {
-                    ++count;
-                } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (pool.exists(tx->GetId())) {
-                        ++already_there;
-                    } else {
-                        ++failed;
-                    }
-                }
+                batch.push_back(std::move(record));
             } else {
                 ++expired;
             }
 
+            if (batch.size() >= MEMPOOL_LOAD_BATCH_SIZE || num == 0) {
+                LoadMempoolBatch(pool, active_chainstate, batch, counts);
+                batch.clear();
+            }
+
             if (ShutdownRequested()) {
                 return false;
             }
@@ -135,8 +218,9 @@ bool LoadMempool(CTxMemPool &pool, const fs::path &load_path,
 
     LogPrintf("Imported mempool transactions from disk: %i succeeded, %i "
               "failed, %i expired, %i already there, %i waiting for initial "
-              "broadcast\n",
-              count, failed, expired, already_there, unbroadcast);
+              "broadcast (%.2fs)\n",
+              counts.count, counts.failed, expired, counts.already_there,
+              unbroadcast, Ticks<SecondsDouble>(SteadyClock::now() - start));
     return true;
 }
 
@@ -171,7 +255,9 @@ bool DumpMempool(const CTxMemPool &pool, const fs::path &dump_path,
 
         CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
 
-        uint64_t version = MEMPOOL_DUMP_VERSION;
+        const uint64_t version{pool.m_persist_v1_dat
+                                   ? MEMPOOL_DUMP_VERSION_NO_METADATA
+                                   : MEMPOOL_DUMP_VERSION};
         file << version;
 
         file << uint64_t(vinfo.size());
@@ -179,6 +265,10 @@ bool DumpMempool(const CTxMemPool &pool, const fs::path &dump_path,
             file << *(i.tx);
             file << int64_t(count_seconds(i.m_time));
             file << i.nFeeDelta;
+            if (version == MEMPOOL_DUMP_VERSION) {
+                file << i.fee;
+                file << uint32_t(i.height);
+            }
             mapDeltas.erase(i.tx->GetId());
         }
 
@@ -75,5 +75,8 @@ ApplyArgsManOptions(const ArgsManager &argsman, const CChainParams &chainparams,
             chainparams.NetworkIDString());
     }
 
+    mempool_opts.persist_v1_dat =
+        argsman.GetBoolArg("-persistmempoolv1", mempool_opts.persist_v1_dat);
+
     return std::nullopt;
 }
@@ -32,6 +32,7 @@
 #include <netmessagemaker.h>
 #include <node/blockstorage.h>
 #include <policy/fees.h>
+#include <policy/packages.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
 #include <primitives/block.h>
@@ -183,6 +184,26 @@ static constexpr DataRequestParameters PROOF_REQUEST_PARAMS{
  * for compatibility.
  */
 static const unsigned int MAX_GETDATA_SZ = 1000;
+/**
+ * How long to wait for the ancestor package of an orphan transaction before
+ * requesting its missing parents one by one.
+ */
+static constexpr auto PACKAGE_RELAY_FALLBACK_DELAY{2s};
+/** How long an unanswered getpkgtxns request is kept track of. */
+static constexpr auto PACKAGE_REQUEST_TIMEOUT{1min};
+/** Maximum number of getpkgtxns requests in flight to a single peer. */
+static constexpr size_t MAX_PEER_PACKAGE_REQUESTS{100};
+/**
+ * The maximum rate of getpkgtxns requests from a single peer we're willing to
+ * serve on average. The others are answered with a notfound.
+ */
+static constexpr double MAX_PACKAGE_REQUEST_RATE_PER_SECOND{1.0};
+/**
+ * The limit of the getpkgtxns token bucket, so a peer can always get the
+ * replies to as many requests as we keep in flight to it.
+ */
+static constexpr size_t MAX_PACKAGE_REQUEST_TOKEN_BUCKET{
+    MAX_PEER_PACKAGE_REQUESTS};
 /**
  * Number of blocks that can be requested at any given time from a single peer.
  */
@@ -313,6 +334,11 @@ static constexpr double MAX_ADDR_RATE_PER_SECOND{0.1};
 static constexpr size_t MAX_ADDR_PROCESSING_TOKEN_BUCKET{MAX_ADDR_TO_SEND};
 /** The compactblocks version we support. See BIP 152. */
 static constexpr uint64_t CMPCTBLOCKS_VERSION{1};
+/**
+ * Maximum number of queued transactions whose scripts are verified at once,
+ * ahead of the processing of their messages.
+ */
+static constexpr size_t MAX_TX_PRECHECK_BATCH{1000};
 
 inline size_t GetMaxAddrToSend() {
     return gArgs.GetIntArg("-maxaddrtosend", MAX_ADDR_TO_SEND);
@@ -603,7 +629,27 @@ struct Peer {
      * Set of txids to reconsider once their parent transactions have been
      * accepted
      */
-    std::set<TxId> m_orphan_work_set GUARDED_BY(g_cs_orphans);
+    std::set<TxId> m_orphan_work_set
+        GUARDED_BY(NetEventsInterface::g_msgproc_mutex);
+
+    /**
+     * Whether this peer has signaled support for the getpkgtxns and pkgtxns
+     * messages, and we relay packages too.
+     */
+    std::atomic_bool m_package_relay{false};
+    /**
+     * The orphan transactions whose ancestor package we requested from this
+     * peer, with the time of the request.
+     */
+    std::map<TxId, std::chrono::microseconds> m_package_requests
+        GUARDED_BY(NetEventsInterface::g_msgproc_mutex);
+    /** Number of getpkgtxns requests from this peer that can be served. */
+    double m_package_request_token_bucket GUARDED_BY(
+        NetEventsInterface::g_msgproc_mutex){MAX_PACKAGE_REQUEST_TOKEN_BUCKET};
+    /** When m_package_request_token_bucket was last updated */
+    std::chrono::microseconds m_package_request_token_timestamp GUARDED_BY(
+        NetEventsInterface::g_msgproc_mutex){
+        GetTime<std::chrono::microseconds>()};
 
     /**
      * Whether we've sent this peer a getheaders in response to an inv prior to
@@ -918,8 +964,46 @@ private:
     bool MaybeDiscourageAndDisconnect(CNode &pnode, Peer &peer);
 
     void ProcessOrphanTx(const Config &config, std::set<TxId> &orphan_work_set)
-        EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_msgproc_mutex)
             EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex);
+
+    /**
+     * Ask a peer that sent us an orphan transaction for its ancestor package,
+     * if the peer relays packages.
+     *
+     * @returns whether the package was requested
+     */
+    bool MaybeRequestPackage(CNode &node, Peer &peer, const TxId &txid,
+                             std::chrono::microseconds current_time)
+        EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex);
+
+    /**
+     * Verify the scripts of a transaction received from a peer together with
+     * the scripts of the transactions still queued in the messages of all the
+     * peers, so that the admission of each of them only has to find its
+     * scripts in the script cache.
+     */
+    void PreCheckQueuedTransactions(const CTransactionRef &ptx)
+        EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex,
+                                 !m_recent_confirmed_transactions_mutex)
+            LOCKS_EXCLUDED(cs_main);
+
+    /**
+     * Transactions whose scripts were verified with the last batch and whose
+     * messages were not processed yet.
+     */
+    std::unordered_set<TxId, SaltedTxIdHasher>
+        m_prechecked_txids GUARDED_BY(g_msgproc_mutex);
+
+    /**
+     * Validate the ancestor package of an orphan transaction received from a
+     * peer, and relay its transactions that are accepted to the mempool.
+     */
+    void ProcessPackage(const Config &config, CNode &pfrom, Peer &peer,
+                        const Package &package)
+        EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex, !m_peer_mutex)
+            LOCKS_EXCLUDED(cs_main);
+
     /**
      * Process a single headers message from a peer.
      *
@@ -942,7 +1026,8 @@ private:
      * (DoS points assigned on failure)
      */
     bool CheckHeadersPoW(const std::vector<CBlockHeader> &headers,
-                         const Consensus::Params &consensusParams, Peer &peer);
+                         const Consensus::Params &consensusParams, Peer &peer,
+                         std::vector<BlockHash> &hashes);
     /** Calculate an anti-DoS work threshold for headers chains */
     arith_uint256 GetAntiDoSWorkThreshold();
     /**
@@ -1115,6 +1200,9 @@ private:
     /** Whether this node is running in blocks only mode */
     const bool m_ignore_incoming_txs;
 
+    /** Whether this node relays packages with the peers that support it */
+    const bool m_enable_package_relay;
+
     /**
      * Whether we've completed initial sync yet, for determining when to turn
      * on extra block-relay-only peers.
@@ -1221,6 +1309,30 @@ private:
     NextInvToInbounds(std::chrono::microseconds now,
                       std::chrono::seconds average_interval);
 
+    /**
+     * Mempool information of the transactions queued for announcement, shared
+     * by all the peers so that each transaction is looked up in the mempool
+     * once per broadcast interval rather than once per peer. It is reset after
+     * INBOUND_INVENTORY_BROADCAST_INTERVAL or when the tip changes to bound
+     * its size, and the transactions are checked to still be in the mempool
+     * before they are announced.
+     */
+    std::unordered_map<TxId, TxMempoolInfo, SaltedTxIdHasher>
+        m_inv_candidates GUARDED_BY(g_msgproc_mutex);
+    std::chrono::microseconds
+        m_inv_candidates_expiry GUARDED_BY(g_msgproc_mutex){0us};
+    const CBlockIndex *m_inv_candidates_tip GUARDED_BY(g_msgproc_mutex){
+        nullptr};
+
+    /**
+     * Get the mempool information of the transactions queued for announcement
+     * to a peer. The transactions that are no longer in the mempool are
+     * removed from the queue.
+     */
+    std::vector<TxMempoolInfo> GetInvCandidates(std::set<TxId> &to_send,
+                                                std::chrono::microseconds now)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_msgproc_mutex);
+
     // All of the following cache a recent block, and are protected by
     // m_most_recent_block_mutex
     Mutex m_most_recent_block_mutex;
@@ -1309,6 +1421,18 @@ private:
         LOCKS_EXCLUDED(cs_main)
             EXCLUSIVE_LOCKS_REQUIRED(NetEventsInterface::g_msgproc_mutex);
 
+    /**
+     * Determine whether or not a peer can request the ancestor package of a
+     * transaction, and return the transaction preceded by its unconfirmed
+     * ancestors in topological order (or an empty package if not found, not
+     * allowed or too large).
+     */
+    Package FindPackageForGetData(const Peer &peer, const TxId &txid,
+                                  const std::chrono::seconds mempool_req,
+                                  const std::chrono::seconds now)
+        LOCKS_EXCLUDED(cs_main)
+            EXCLUSIVE_LOCKS_REQUIRED(NetEventsInterface::g_msgproc_mutex);
+
     void ProcessGetData(const Config &config, CNode &pfrom, Peer &peer,
                         const std::atomic<bool> &interruptMsgProc)
         EXCLUSIVE_LOCKS_REQUIRED(!m_most_recent_block_mutex,
@@ -1351,7 +1475,7 @@ private:
     TxOrphanage m_orphanage;
 
     void AddToCompactExtraTransactions(const CTransactionRef &tx)
-        EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+        EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex);
 
     /**
      * Orphan/conflicted/etc transactions that are kept for compact block
@@ -1361,9 +1485,9 @@ private:
      * these are kept in a ring buffer
      */
     std::vector<std::pair<TxHash, CTransactionRef>>
-        vExtraTxnForCompact GUARDED_BY(g_cs_orphans);
+        vExtraTxnForCompact GUARDED_BY(g_msgproc_mutex);
     /** Offset into vExtraTxnForCompact to insert the next tx */
-    size_t vExtraTxnForCompactIt GUARDED_BY(g_cs_orphans) = 0;
+    size_t vExtraTxnForCompactIt GUARDED_BY(g_msgproc_mutex) = 0;
 
     /**
      * Check whether the last unknown block a peer advertised is not yet known.
@@ -1584,6 +1708,34 @@ static bool IsLimitedPeer(const Peer &peer) {
             (peer.m_their_services & NODE_NETWORK_LIMITED));
 }
 
+std::vector<TxMempoolInfo>
+PeerManagerImpl::GetInvCandidates(std::set<TxId> &to_send,
+                                  std::chrono::microseconds now) {
+    const CBlockIndex *tip{m_chainman.ActiveChain().Tip()};
+    if (now >= m_inv_candidates_expiry || tip != m_inv_candidates_tip) {
+        m_inv_candidates.clear();
+        m_inv_candidates_expiry = now + INBOUND_INVENTORY_BROADCAST_INTERVAL;
+        m_inv_candidates_tip = tip;
+    }
+
+    std::vector<TxMempoolInfo> candidates;
+    candidates.reserve(to_send.size());
+    for (auto it = to_send.begin(); it != to_send.end();) {
+        auto [candidate, inserted] = m_inv_candidates.try_emplace(*it);
+        if (inserted) {
+            candidate->second = m_mempool.info(*it);
+        }
+        // Not in the mempool anymore? don't bother sending it.
+        if (!candidate->second.tx) {
+            it = to_send.erase(it);
+            continue;
+        }
+        candidates.push_back(candidate->second);
+        ++it;
+    }
+    return candidates;
+}
+
 std::chrono::microseconds
 PeerManagerImpl::NextInvToInbounds(std::chrono::microseconds now,
                                    std::chrono::seconds average_interval) {
@@ -2284,7 +2436,7 @@ void PeerManagerImpl::FinalizeNode(const Config &config, const CNode &node) {
         for (const QueuedBlock &entry : state->vBlocksInFlight) {
             mapBlocksInFlight.erase(entry.pindex->GetBlockHash());
         }
-        WITH_LOCK(g_cs_orphans, m_orphanage.EraseForPeer(nodeid));
+        m_orphanage.EraseForPeer(nodeid);
         m_txrequest.DisconnectedPeer(nodeid);
         m_num_preferred_download_peers -= state->fPreferredDownload;
         m_peers_downloading_from -= (state->nBlocksInFlight != 0);
@@ -2605,7 +2757,10 @@ PeerManagerImpl::PeerManagerImpl(CConnman &connman, AddrMan &addrman,
                                  CTxMemPool &pool, bool ignore_incoming_txs)
     : m_chainparams(chainman.GetParams()), m_connman(connman),
       m_addrman(addrman), m_banman(banman), m_chainman(chainman),
-      m_mempool(pool), m_ignore_incoming_txs(ignore_incoming_txs) {}
+      m_mempool(pool), m_ignore_incoming_txs(ignore_incoming_txs),
+      m_enable_package_relay(
+          !ignore_incoming_txs &&
+          gArgs.GetBoolArg("-packagerelay", DEFAULT_PACKAGE_RELAY)) {}
 
 void PeerManagerImpl::StartScheduledTasks(CScheduler &scheduler) {
     // Stale tip checking and peer eviction are on two different timers, but we
@@ -3196,6 +3351,50 @@ PeerManagerImpl::FindTxForGetData(const Peer &peer, const TxId &txid,
     return {};
 }
 
+Package PeerManagerImpl::FindPackageForGetData(
+    const Peer &peer, const TxId &txid, const std::chrono::seconds mempool_req,
+    const std::chrono::seconds now) {
+    // The ancestors are served along with the transaction, like they are made
+    // requestable when the transaction alone is requested.
+    CTransactionRef tx = FindTxForGetData(peer, txid, mempool_req, now);
+    if (!tx) {
+        return {};
+    }
+
+    LOCK(m_mempool.cs);
+    auto txiter = m_mempool.GetIter(txid);
+    if (!txiter) {
+        return {};
+    }
+    // Stop walking the ancestors as soon as the package is too large
+    const uint64_t max_package_size{MAX_PACKAGE_SIZE * 1000};
+    if (uint64_t(tx->GetTotalSize()) > max_package_size) {
+        return {};
+    }
+    CTxMemPool::setEntries ancestors;
+    if (!m_mempool.CalculateMemPoolAncestors(
+            **txiter, ancestors, /*fSearchForParents=*/false,
+            /*limit_count=*/MAX_PACKAGE_COUNT - 1,
+            /*limit_size=*/max_package_size - tx->GetTotalSize()) ||
+        ancestors.empty()) {
+        return {};
+    }
+
+    // The entry ids are a topological order of the mempool
+    std::vector<CTxMemPool::txiter> sorted(ancestors.begin(), ancestors.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const CTxMemPool::txiter &a, const CTxMemPool::txiter &b) {
+                  return (*a)->GetEntryId() < (*b)->GetEntryId();
+              });
+    Package package;
+    package.reserve(sorted.size() + 1);
+    for (const CTxMemPool::txiter &it : sorted) {
+        package.push_back((*it)->GetSharedTx());
+    }
+    package.push_back(std::move(tx));
+    return package;
+}
+
 //! Determine whether or not a peer can request a proof, and return it (or
 //! nullptr if not found or not allowed).
 avalanche::ProofRef
@@ -3398,9 +3597,10 @@ void PeerManagerImpl::SendBlockTransactions(
 
 bool PeerManagerImpl::CheckHeadersPoW(const std::vector<CBlockHeader> &headers,
                                       const Consensus::Params &consensusParams,
-                                      Peer &peer) {
+                                      Peer &peer,
+                                      std::vector<BlockHash> &hashes) {
     // Do these headers have proof-of-work matching what's claimed?
-    if (!HasValidProofOfWork(headers, consensusParams)) {
+    if (!HasValidProofOfWork(headers, consensusParams, hashes)) {
         Misbehaving(peer, 100, "header with invalid proof of work");
         return false;
     }
@@ -3837,7 +4037,11 @@ void PeerManagerImpl::ProcessHeadersMessage(const Config &config, CNode &pfrom,
     // We'll rely on headers having valid proof-of-work further down, as an
     // anti-DoS criteria (note: this check is required before passing any
     // headers into HeadersSyncState).
-    if (!CheckHeadersPoW(headers, m_chainparams.GetConsensus(), peer)) {
+    // The hashes are computed once here and reused below, as long as the
+    // headers are not replaced by the headers sync.
+    std::vector<BlockHash> hashes;
+    if (!CheckHeadersPoW(headers, m_chainparams.GetConsensus(), peer,
+                         hashes)) {
         // Misbehaving() calls are handled within CheckHeadersPoW(), so we can
         // just return. (Note that even if a header is announced via compact
         // block, the header itself should be valid, so this type of error can
@@ -3861,6 +4065,10 @@ void PeerManagerImpl::ProcessHeadersMessage(const Config &config, CNode &pfrom,
 
         already_validated_work =
             IsContinuationOfLowWorkHeadersSync(peer, pfrom, headers);
+        if (already_validated_work) {
+            // The headers were replaced by the ones of the sync
+            hashes.clear();
+        }
 
         // The headers we passed in may have been:
         // - untouched, perhaps if no headers-sync was in progress, or some
@@ -3904,8 +4112,8 @@ void PeerManagerImpl::ProcessHeadersMessage(const Config &config, CNode &pfrom,
     const CBlockIndex *last_received_header{nullptr};
     {
         LOCK(cs_main);
-        last_received_header =
-            m_chainman.m_blockman.LookupBlockIndex(headers.back().GetHash());
+        last_received_header = m_chainman.m_blockman.LookupBlockIndex(
+            hashes.empty() ? headers.back().GetHash() : hashes.back());
         if (IsAncestorOfBestHeaderOrTip(last_received_header)) {
             already_validated_work = true;
         }
@@ -3931,8 +4139,10 @@ void PeerManagerImpl::ProcessHeadersMessage(const Config &config, CNode &pfrom,
 
     // Now process all the headers.
     BlockValidationState state;
-    if (!m_chainman.ProcessNewBlockHeaders(headers, /*min_pow_checked=*/true,
-                                           state, &pindexLast)) {
+    if (!m_chainman.ProcessNewBlockHeaders(
+            headers, /*min_pow_checked=*/true, state, &pindexLast,
+            /*test_checkpoints=*/std::nullopt,
+            hashes.empty() ? nullptr : &hashes)) {
         if (state.IsInvalid()) {
             MaybePunishNodeForBlock(pfrom.GetId(), state, via_compact_block,
                                     "invalid header received");
@@ -3973,7 +4183,6 @@ void PeerManagerImpl::ProcessHeadersMessage(const Config &config, CNode &pfrom,
 void PeerManagerImpl::ProcessOrphanTx(const Config &config,
                                       std::set<TxId> &orphan_work_set) {
     AssertLockHeld(cs_main);
-    AssertLockHeld(g_cs_orphans);
     while (!orphan_work_set.empty()) {
         const TxId orphanTxId = *orphan_work_set.begin();
         orphan_work_set.erase(orphan_work_set.begin());
@@ -4014,6 +4223,174 @@ void PeerManagerImpl::ProcessOrphanTx(const Config &config,
     }
 }
 
+bool PeerManagerImpl::MaybeRequestPackage(
+    CNode &node, Peer &peer, const TxId &txid,
+    std::chrono::microseconds current_time) {
+    if (!peer.m_package_relay) {
+        return false;
+    }
+
+    // Forget about the requests the peer didn't answer
+    for (auto it = peer.m_package_requests.begin();
+         it != peer.m_package_requests.end();) {
+        if (it->second + PACKAGE_REQUEST_TIMEOUT < current_time) {
+            it = peer.m_package_requests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (peer.m_package_requests.size() >= MAX_PEER_PACKAGE_REQUESTS ||
+        !peer.m_package_requests.emplace(txid, current_time).second) {
+        return false;
+    }
+
+    m_connman.PushMessage(&node, CNetMsgMaker(node.GetCommonVersion())
+                                     .Make(NetMsgType::GETPKGTXNS, txid));
+    return true;
+}
+
+void PeerManagerImpl::PreCheckQueuedTransactions(const CTransactionRef &ptx) {
+    // The entries of the last batch that were not processed yet are still
+    // queued and get collected again below.
+    m_prechecked_txids.clear();
+    m_prechecked_txids.insert(ptx->GetId());
+
+    std::vector<CTransactionRef> txs{ptx};
+    m_connman.ForEachNode(
+        [&](CNode *pnode) EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex) {
+            if (pnode->fDisconnect || pnode->IsBlockOnlyConn() ||
+                (m_ignore_incoming_txs &&
+                 !pnode->HasPermission(NetPermissionFlags::Relay))) {
+                return;
+            }
+
+            LOCK(pnode->cs_vProcessMsg);
+            for (const CNetMessage &msg : pnode->vProcessMsg) {
+                if (txs.size() >= MAX_TX_PRECHECK_BATCH) {
+                    return;
+                }
+                if (msg.m_type != NetMsgType::TX) {
+                    continue;
+                }
+
+                // The message is left in the queue, its processing deals with
+                // any error.
+                CDataStream stream{msg.m_recv};
+                CTransactionRef tx;
+                try {
+                    stream >> tx;
+                } catch (const std::exception &) {
+                    continue;
+                }
+                if (m_prechecked_txids.insert(tx->GetId()).second) {
+                    txs.push_back(std::move(tx));
+                }
+            }
+        });
+    m_prechecked_txids.erase(ptx->GetId());
+
+    // Don't verify the transactions that are going to be ignored
+    std::vector<CTransactionRef> new_txs;
+    new_txs.reserve(txs.size());
+    {
+        LOCK(cs_main);
+        for (CTransactionRef &tx : txs) {
+            if (tx == ptx || !AlreadyHaveTx(tx->GetId())) {
+                new_txs.push_back(std::move(tx));
+            }
+        }
+    }
+
+    m_chainman.PreCheckTransactionScripts(new_txs);
+}
+
+void PeerManagerImpl::ProcessPackage(const Config &config, CNode &pfrom,
+                                     Peer &peer, const Package &package) {
+    for (const CTransactionRef &tx : package) {
+        AddKnownTx(peer, tx->GetId());
+    }
+
+    // The context-free checks come first, so that no script of a malformed
+    // package gets verified. We only get the packages we asked for, which an
+    // honest peer builds as a sorted child and ancestors package.
+    PackageValidationState package_state;
+    if (!CheckPackage(package, package_state)) {
+        Misbehaving(peer, 20,
+                    strprintf("invalid package %s: %s",
+                              package.back()->GetId().ToString(),
+                              package_state.ToString()));
+        return;
+    }
+    if (!IsAncestorPackage(package)) {
+        Misbehaving(peer, 20,
+                    strprintf("package %s is not a child with ancestors",
+                              package.back()->GetId().ToString()));
+        return;
+    }
+
+    // Verify the scripts of the whole package on the transaction checking
+    // threads before taking cs_main, like for a single transaction.
+    m_chainman.PreCheckTransactionScripts(package);
+
+    LOCK(cs_main);
+
+    const PackageMempoolAcceptResult result = ProcessNewAncestorPackage(
+        m_chainman.ActiveChainstate(), m_mempool, package);
+
+    for (const CTransactionRef &tx : package) {
+        const TxId &txid = tx->GetId();
+        m_txrequest.ReceivedResponse(pfrom.GetId(), txid);
+
+        auto it = result.m_tx_results.find(txid);
+        if (it == result.m_tx_results.end()) {
+            continue;
+        }
+        const MempoolAcceptResult &tx_result = it->second;
+        if (tx_result.m_result_type ==
+            MempoolAcceptResult::ResultType::VALID) {
+            m_txrequest.ForgetInvId(txid);
+            m_orphanage.EraseTx(txid);
+            RelayTransaction(txid);
+            m_orphanage.AddChildrenToWorkSet(*tx, peer.m_orphan_work_set);
+        } else if (tx_result.m_state.IsInvalid()) {
+            LogPrint(BCLog::MEMPOOLREJ,
+                     "%s from peer=%d was not accepted in package: %s\n",
+                     txid.ToString(), pfrom.GetId(),
+                     tx_result.m_state.ToString());
+            if (tx_result.m_state.GetResult() !=
+                TxValidationResult::TX_MISSING_INPUTS) {
+                // Don't download or validate the transaction again, like
+                // when it is received on its own
+                m_recent_rejects.insert(txid);
+                m_txrequest.ForgetInvId(txid);
+                m_orphanage.EraseTx(txid);
+            }
+            MaybePunishNodeForTx(pfrom.GetId(), tx_result.m_state);
+        }
+    }
+
+    if (result.m_state.IsInvalid()) {
+        // The orphan stays in the orphanage and its missing parents are
+        // requested one by one.
+        LogPrint(BCLog::MEMPOOLREJ,
+                 "package %s from peer=%d was not accepted: %s\n",
+                 package.back()->GetId().ToString(), pfrom.GetId(),
+                 result.m_state.ToString());
+        return;
+    }
+
+    pfrom.m_last_tx_time = GetTime<std::chrono::seconds>();
+    LogPrint(BCLog::MEMPOOL,
+             "AcceptToMemoryPool: peer=%d: accepted package of %u txs for %s "
+             "(poolsz %u txn, %u kB)\n",
+             pfrom.GetId(), package.size(),
+             package.back()->GetId().ToString(), m_mempool.size(),
+             m_mempool.DynamicMemoryUsage() / 1000);
+
+    // Process the orphans that depended on the package
+    ProcessOrphanTx(config, peer.m_orphan_work_set);
+}
+
 bool PeerManagerImpl::PrepareBlockFilterRequest(
     CNode &node, Peer &peer, BlockFilterType filter_type, uint32_t start_height,
     const BlockHash &stop_hash, uint32_t max_height_diff,
@@ -4656,6 +5033,12 @@ void PeerManagerImpl::ProcessMessage(
                               /*version=*/CMPCTBLOCKS_VERSION));
         }
 
+        if (m_enable_package_relay && peer->GetTxRelay() != nullptr) {
+            // Tell our peer we can relay packages of transactions with it.
+            m_connman.PushMessage(&pfrom,
+                                  msgMaker.Make(NetMsgType::SENDPACKAGES));
+        }
+
         if (g_avalanche && isAvalancheEnabled(gArgs)) {
             if (g_avalanche->sendHello(&pfrom)) {
                 auto localProof = g_avalanche->getLocalProof();
@@ -4816,6 +5199,12 @@ void PeerManagerImpl::ProcessMessage(
         return;
     }
 
+    if (msg_type == NetMsgType::SENDPACKAGES) {
+        peer->m_package_relay =
+            m_enable_package_relay && peer->GetTxRelay() != nullptr;
+        return;
+    }
+
     if (msg_type == NetMsgType::SENDCMPCT) {
         bool sendcmpct_hb{false};
         uint64_t sendcmpct_version{0};
@@ -5145,6 +5534,56 @@ void PeerManagerImpl::ProcessMessage(
         return;
     }
 
+    if (msg_type == NetMsgType::GETPKGTXNS) {
+        TxId txid;
+        vRecv >> txid;
+
+        auto tx_relay = peer->GetTxRelay();
+        if (!peer->m_package_relay || tx_relay == nullptr) {
+            LogPrint(BCLog::NET,
+                     "getpkgtxns sent in violation of protocol peer=%d\n",
+                     pfrom.GetId());
+            return;
+        }
+
+        // Update the rate limiting bucket, the requests over the limit are
+        // not served
+        const auto current_time = GetTime<std::chrono::microseconds>();
+        const auto time_diff = std::max(
+            current_time - peer->m_package_request_token_timestamp, 0us);
+        peer->m_package_request_token_bucket = std::min<double>(
+            peer->m_package_request_token_bucket +
+                CountSecondsDouble(time_diff) *
+                    MAX_PACKAGE_REQUEST_RATE_PER_SECOND,
+            MAX_PACKAGE_REQUEST_TOKEN_BUCKET);
+        peer->m_package_request_token_timestamp = current_time;
+
+        Package package;
+        if (peer->m_package_request_token_bucket >= 1.0) {
+            peer->m_package_request_token_bucket -= 1.0;
+            package = FindPackageForGetData(*peer, txid,
+                                            tx_relay->m_last_mempool_req,
+                                            GetTime<std::chrono::seconds>());
+        } else {
+            LogPrint(BCLog::NET, "getpkgtxns rate limited peer=%d\n",
+                     pfrom.GetId());
+        }
+        if (package.empty()) {
+            // Let the peer request the missing parents one by one instead
+            m_connman.PushMessage(
+                &pfrom, msgMaker.Make(NetMsgType::NOTFOUND,
+                                      std::vector<CInv>{CInv(MSG_TX, txid)}));
+            return;
+        }
+
+        m_connman.PushMessage(&pfrom,
+                              msgMaker.Make(NetMsgType::PKGTXNS, package));
+        for (const CTransactionRef &tx : package) {
+            m_mempool.RemoveUnbroadcastTx(tx->GetId());
+        }
+        return;
+    }
+
     if (msg_type == NetMsgType::GETHEADERS) {
         CBlockLocator locator;
         BlockHash hashStop;
@@ -5269,29 +5708,41 @@ void PeerManagerImpl::ProcessMessage(
         const TxId &txid = tx.GetId();
         AddKnownTx(*peer, txid);
 
-        LOCK2(cs_main, g_cs_orphans);
-
-        m_txrequest.ReceivedResponse(pfrom.GetId(), txid);
+        {
+            LOCK(cs_main);
 
-        if (AlreadyHaveTx(txid)) {
-            if (pfrom.HasPermission(NetPermissionFlags::ForceRelay)) {
-                // Always relay transactions received from peers with
-                // forcerelay permission, even if they were already in the
-                // mempool, allowing the node to function as a gateway for
-                // nodes hidden behind it.
-                if (!m_mempool.exists(tx.GetId())) {
-                    LogPrintf("Not relaying non-mempool transaction %s from "
-                              "forcerelay peer=%d\n",
-                              tx.GetId().ToString(), pfrom.GetId());
-                } else {
-                    LogPrintf("Force relaying tx %s from peer=%d\n",
-                              tx.GetId().ToString(), pfrom.GetId());
-                    RelayTransaction(tx.GetId());
+            m_txrequest.ReceivedResponse(pfrom.GetId(), txid);
+
+            if (AlreadyHaveTx(txid)) {
+                if (pfrom.HasPermission(NetPermissionFlags::ForceRelay)) {
+                    // Always relay transactions received from peers with
+                    // forcerelay permission, even if they were already in the
+                    // mempool, allowing the node to function as a gateway for
+                    // nodes hidden behind it.
+                    if (!m_mempool.exists(tx.GetId())) {
+                        LogPrintf("Not relaying non-mempool transaction %s "
+                                  "from forcerelay peer=%d\n",
+                                  tx.GetId().ToString(), pfrom.GetId());
+                    } else {
+                        LogPrintf("Force relaying tx %s from peer=%d\n",
+                                  tx.GetId().ToString(), pfrom.GetId());
+                        RelayTransaction(tx.GetId());
+                    }
                 }
+                return;
             }
-            return;
         }
 
+        // Verify the transaction scripts on the transaction checking threads
+        // before taking cs_main again, so that the mempool admission below
+        // only has to find them in the script cache. This is skipped if they
+        // were verified with the transactions of an earlier message.
+        if (m_prechecked_txids.erase(txid) == 0) {
+            PreCheckQueuedTransactions(ptx);
+        }
+
+        LOCK(cs_main);
+
         const MempoolAcceptResult result = m_chainman.ProcessTransaction(ptx);
         const TxValidationState &state = result.m_state;
 
@@ -5338,12 +5789,18 @@ void PeerManagerImpl::ProcessMessage(
             }
             if (!fRejectedParents) {
                 const auto current_time{GetTime<std::chrono::microseconds>()};
+                // If the parents come along with the package, there is no need
+                // to request them one by one unless the package is late.
+                const auto parents_time =
+                    MaybeRequestPackage(pfrom, *peer, txid, current_time)
+                        ? current_time + PACKAGE_RELAY_FALLBACK_DELAY
+                        : current_time;
 
                 for (const TxId &parent_txid : unique_parents) {
                     // FIXME: MSG_TX should use a TxHash, not a TxId.
                     AddKnownTx(*peer, parent_txid);
                     if (!AlreadyHaveTx(parent_txid)) {
-                        AddTxAnnouncement(pfrom, parent_txid, current_time);
+                        AddTxAnnouncement(pfrom, parent_txid, parents_time);
                     }
                 }
 
@@ -5361,7 +5818,9 @@ void PeerManagerImpl::ProcessMessage(
                     int64_t(0),
                     gArgs.GetIntArg("-maxorphantx",
                                     DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-                unsigned int nEvicted = m_orphanage.LimitOrphans(nMaxOrphanTx);
+                unsigned int nEvicted = m_orphanage.LimitOrphans(
+                    nMaxOrphanTx, GetMaxPeerOrphans(nMaxOrphanTx),
+                    GetMaxPeerOrphanBytes(nMaxOrphanTx));
                 if (nEvicted > 0) {
                     LogPrint(BCLog::MEMPOOL,
                              "orphanage overflow, removed %u tx\n", nEvicted);
@@ -5410,6 +5869,36 @@ void PeerManagerImpl::ProcessMessage(
         return;
     }
 
+    if (msg_type == NetMsgType::PKGTXNS) {
+        if ((m_ignore_incoming_txs &&
+             !pfrom.HasPermission(NetPermissionFlags::Relay)) ||
+            pfrom.IsBlockOnlyConn()) {
+            LogPrint(BCLog::NET,
+                     "package sent in violation of protocol peer=%d\n",
+                     pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        }
+
+        Package package;
+        vRecv >> package;
+        if (package.empty() || package.size() > MAX_PACKAGE_COUNT) {
+            Misbehaving(*peer, 20,
+                        strprintf("pkgtxns message size = %u", package.size()));
+            return;
+        }
+
+        // Only the packages we asked for are validated
+        if (peer->m_package_requests.erase(package.back()->GetId()) == 0) {
+            LogPrint(BCLog::NET, "unsolicited package %s from peer=%d\n",
+                     package.back()->GetId().ToString(), pfrom.GetId());
+            return;
+        }
+
+        ProcessPackage(config, pfrom, *peer, package);
+        return;
+    }
+
     if (msg_type == NetMsgType::CMPCTBLOCK) {
         // Ignore cmpctblock received while importing
         if (m_chainman.m_blockman.LoadingBlocks()) {
@@ -5493,7 +5982,7 @@ void PeerManagerImpl::ProcessMessage(
         bool fBlockReconstructed = false;
 
         {
-            LOCK2(cs_main, g_cs_orphans);
+            LOCK(cs_main);
             // If AcceptBlockHeader returned true, it set pindex
             assert(pindex);
             UpdateBlockAvailability(pfrom.GetId(), pindex->GetBlockHash());
@@ -6841,6 +7330,7 @@ void PeerManagerImpl::ProcessMessage(
                     // If we receive a NOTFOUND message for a tx we requested,
                     // mark the announcement for it as completed in
                     // InvRequestTracker.
+                    peer->m_package_requests.erase(TxId(inv.hash));
                     LOCK(::cs_main);
                     m_txrequest.ReceivedResponse(pfrom.GetId(), TxId(inv.hash));
                     continue;
@@ -6934,11 +7424,9 @@ bool PeerManagerImpl::ProcessMessages(const Config &config, CNode *pfrom,
         }
     }
 
-    {
-        LOCK2(cs_main, g_cs_orphans);
-        if (!peer->m_orphan_work_set.empty()) {
-            ProcessOrphanTx(config, peer->m_orphan_work_set);
-        }
+    if (!peer->m_orphan_work_set.empty()) {
+        LOCK(cs_main);
+        ProcessOrphanTx(config, peer->m_orphan_work_set);
     }
 
     if (pfrom->fDisconnect) {
@@ -6954,11 +7442,8 @@ bool PeerManagerImpl::ProcessMessages(const Config &config, CNode *pfrom,
         }
     }
 
-    {
-        LOCK(g_cs_orphans);
-        if (!peer->m_orphan_work_set.empty()) {
-            return true;
-        }
+    if (!peer->m_orphan_work_set.empty()) {
+        return true;
     }
 
     // Don't bother if send buffer is too full to respond anyway
@@ -7528,23 +8013,6 @@ void PeerManagerImpl::MaybeSendFeefilter(
     }
 }
 
-namespace {
-class CompareInvMempoolOrder {
-    CTxMemPool *mp;
-
-public:
-    explicit CompareInvMempoolOrder(CTxMemPool *_mempool) : mp(_mempool) {}
-
-    bool operator()(std::set<TxId>::iterator a, std::set<TxId>::iterator b) {
-        /**
-         * As std::make_heap produces a max-heap, we want the entries which
-         * are topologically earlier to sort later.
-         */
-        return mp->CompareTopologically(*b, *a);
-    }
-};
-} // namespace
-
 bool PeerManagerImpl::SetupAddressRelay(const CNode &node, Peer &peer) {
     // We don't participate in addr relay with outbound block-relay-only
     // connections to prevent providing adversaries with the additional
@@ -7978,20 +8446,20 @@ bool PeerManagerImpl::SendMessages(const Config &config, CNode *pto) {
             // Determine transactions to relay
             if (fSendTrickle) {
                 // Produce a vector with all candidates for sending
-                std::vector<std::set<TxId>::iterator> vInvTx;
-                vInvTx.reserve(tx_relay->m_tx_inventory_to_send.size());
-                for (std::set<TxId>::iterator it =
-                         tx_relay->m_tx_inventory_to_send.begin();
-                     it != tx_relay->m_tx_inventory_to_send.end(); it++) {
-                    vInvTx.push_back(it);
-                }
+                std::vector<TxMempoolInfo> vInvTx = GetInvCandidates(
+                    tx_relay->m_tx_inventory_to_send, current_time);
                 const CFeeRate filterrate{
                     tx_relay->m_fee_filter_received.load()};
                 // Send out the inventory in the order of admission to our
                 // mempool, which is guaranteed to be a topological sort order.
                 // A heap is used so that not all items need sorting if only a
-                // few are being sent.
-                CompareInvMempoolOrder compareInvMempoolOrder(&m_mempool);
+                // few are being sent. As std::make_heap produces a max-heap, we
+                // want the entries which are topologically earlier to sort
+                // later.
+                auto compareInvMempoolOrder = [](const TxMempoolInfo &a,
+                                                 const TxMempoolInfo &b) {
+                    return a.entry_id > b.entry_id;
+                };
                 std::make_heap(vInvTx.begin(), vInvTx.end(),
                                compareInvMempoolOrder);
                 // No reason to drain out at many times the network's
@@ -8006,20 +8474,15 @@ bool PeerManagerImpl::SendMessages(const Config &config, CNode *pto) {
                     // Fetch the top element from the heap
                     std::pop_heap(vInvTx.begin(), vInvTx.end(),
                                   compareInvMempoolOrder);
-                    std::set<TxId>::iterator it = vInvTx.back();
+                    TxMempoolInfo txinfo = std::move(vInvTx.back());
                     vInvTx.pop_back();
-                    const TxId txid = *it;
+                    const TxId txid = txinfo.tx->GetId();
                     // Remove it from the to-be-sent set
-                    tx_relay->m_tx_inventory_to_send.erase(it);
+                    tx_relay->m_tx_inventory_to_send.erase(txid);
                     // Check if not in the filter already
                     if (tx_relay->m_tx_inventory_known_filter.contains(txid)) {
                         continue;
                     }
-                    // Not in the mempool anymore? don't bother sending it.
-                    auto txinfo = m_mempool.info(txid);
-                    if (!txinfo.tx) {
-                        continue;
-                    }
                     // Peer told you to not send transactions at that
                     // feerate? Don't bother sending it.
                     if (txinfo.fee < filterrate.GetFee(txinfo.vsize)) {
@@ -8030,6 +8493,12 @@ bool PeerManagerImpl::SendMessages(const Config &config, CNode *pto) {
                             *txinfo.tx)) {
                         continue;
                     }
+                    // The shared lookup may predate the removal of the
+                    // transaction from the mempool
+                    if (!m_mempool.exists(txid)) {
+                        m_inv_candidates.erase(txid);
+                        continue;
+                    }
                     // Send
                     tx_relay->m_recently_announced_invs.insert(txid);
                     addInvAndMaybeFlush(MSG_TX, txid);
@@ -7,9 +7,12 @@
 #define BITCOIN_NET_PROCESSING_H
 
 #include <net.h>
+#include <policy/policy.h>
 #include <sync.h>
 #include <validationinterface.h>
 
+#include <algorithm>
+
 namespace avalanche {
 struct ProofId;
 }
@@ -24,12 +27,45 @@ class Config;
  * memory.
  */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/**
+ * Share of -maxorphantx a single peer can fill in the orphan pool before its
+ * own orphans start being evicted: half of the pool with this divisor.
+ */
+static const unsigned int PEER_ORPHAN_SHARE_DIVISOR = 2;
+/**
+ * Size allowed per orphan in the byte budget of a peer, so a peer can fill its
+ * count budget with 20 kB transactions (1 MB with the default -maxorphantx).
+ */
+static const size_t PEER_ORPHAN_BYTES_PER_TX = 20000;
+
+/**
+ * Maximum number of orphan transactions a single peer can have in the orphan
+ * pool before its own orphans start being evicted, given -maxorphantx.
+ */
+inline unsigned int GetMaxPeerOrphans(unsigned int max_orphans) {
+    return std::max(1u, max_orphans / PEER_ORPHAN_SHARE_DIVISOR);
+}
+/**
+ * Maximum total size of the orphan transactions a single peer can have in the
+ * orphan pool before its own orphans start being evicted, given -maxorphantx.
+ * A peer can always keep at least one orphan of the maximum standard size.
+ */
+inline size_t GetMaxPeerOrphanBytes(unsigned int max_orphans) {
+    return std::max<size_t>(MAX_STANDARD_TX_SIZE,
+                            GetMaxPeerOrphans(max_orphans) *
+                                PEER_ORPHAN_BYTES_PER_TX);
+}
 /**
  * Default number of orphan+recently-replaced txn to keep around for block
  * reconstruction.
  */
 static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
 static const bool DEFAULT_PEERBLOCKFILTERS = false;
+/**
+ * Default for -packagerelay, whether orphan transactions are fetched from our
+ * peers together with their unconfirmed ancestors.
+ */
+static const bool DEFAULT_PACKAGE_RELAY = false;
 /** Threshold for marking a node to be discouraged, e.g. disconnected and added
  * to the discouragement filter. */
 static const int DISCOURAGEMENT_THRESHOLD{100};
@@ -10,6 +10,7 @@
 #include <clientversion.h>
 #include <config.h>
 #include <consensus/validation.h>
+#include <crypto/common.h>
 #include <flatfile.h>
 #include <fs.h>
 #include <hash.h>
@@ -19,21 +20,307 @@
 #include <streams.h>
 #include <undo.h>
 #include <util/system.h>
+#include <util/thread.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
 #include <map>
+#include <memory>
+#include <thread>
 
 namespace node {
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fPruneMode = false;
 uint64_t nPruneTarget = 0;
+std::atomic_bool fMmapBlockFiles(DEFAULT_MMAP_BLOCK_FILES);
 
 static FILE *OpenUndoFile(const FlatFilePos &pos, bool fReadOnly = false);
 
 static FlatFileSeq BlockFileSeq();
 static FlatFileSeq UndoFileSeq();
 
+namespace {
+/**
+ * Bounded cache of read-only mappings of finalised blk/rev files, keyed by
+ * path. A file is only mapped once it has been finalised (it is no longer
+ * preallocated into or truncated); any new write to it drops it from the
+ * cache until it gets finalised again. Readers hold a shared_ptr to the
+ * mapping, so evicting it while a read is in progress is safe.
+ */
+class MappedFileCache {
+private:
+    Mutex m_mutex;
+    std::set<fs::path> m_finalized GUARDED_BY(m_mutex);
+    /** Mappings, most recently used first */
+    std::list<std::pair<fs::path, std::shared_ptr<const MappedFlatFile>>>
+        m_maps GUARDED_BY(m_mutex);
+
+    void EraseMap(const fs::path &path) EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+        m_maps.remove_if(
+            [&](const auto &entry) { return entry.first == path; });
+    }
+
+public:
+    void MarkFinalized(const fs::path &path)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        LOCK(m_mutex);
+        m_finalized.insert(path);
+        // The file may have been truncated
+        EraseMap(path);
+    }
+
+    void Forget(const fs::path &path) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        LOCK(m_mutex);
+        m_finalized.erase(path);
+        EraseMap(path);
+    }
+
+    /**
+     * Return a mapping of the file containing pos if mmap reads are enabled
+     * and the file is finalised, nullptr otherwise.
+     */
+    std::shared_ptr<const MappedFlatFile> Get(const FlatFileSeq &seq,
+                                              const FlatFilePos &pos)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        if (!fMmapBlockFiles || pos.IsNull()) {
+            return nullptr;
+        }
+        const fs::path path = seq.FileName(pos);
+
+        LOCK(m_mutex);
+        if (m_finalized.count(path) == 0) {
+            return nullptr;
+        }
+        for (auto it = m_maps.begin(); it != m_maps.end(); ++it) {
+            if (it->first == path) {
+                m_maps.splice(m_maps.begin(), m_maps, it);
+                return it->second;
+            }
+        }
+
+        std::shared_ptr<const MappedFlatFile> map = seq.Map(pos);
+        if (!map) {
+            return nullptr;
+        }
+        m_maps.emplace_front(path, map);
+        if (m_maps.size() > MAX_MAPPED_BLOCK_FILES) {
+            m_maps.pop_back();
+        }
+        return map;
+    }
+};
+
+MappedFileCache g_mapped_files;
+
+/** Identifies a blk (false) or rev (true) file */
+using BlockFileKey = std::pair<bool, int>;
+
+BlockFileKey BlockFileKeyFor(const FlatFilePos &pos) {
+    return {false, pos.nFile};
+}
+BlockFileKey UndoFileKeyFor(const FlatFilePos &pos) {
+    return {true, pos.nFile};
+}
+
+/**
+ * Write-behind queue persisting block and undo data on a dedicated thread, so
+ * that the validation thread does not block on disk writes or fsync. Jobs run
+ * in submission order, so a flush queued after some writes is an ordered
+ * durability barrier for them. Readers of a record wait until the job
+ * writing it is done, but not for the other jobs on the same file. While the
+ * thread is not running (e.g. in tests and during shutdown) jobs run
+ * synchronously in the submitting thread.
+ */
+class BlockFileWriter {
+private:
+    struct Job {
+        BlockFileKey file;
+        /** The job writes the bytes [begin, begin + bytes) of the file */
+        uint32_t begin;
+        size_t bytes;
+        /** Returns false on failure (having already aborted the node) */
+        std::function<bool()> func;
+
+        bool Writes(const BlockFileKey &key, uint32_t pos) const {
+            return file == key && begin <= pos && pos - begin < bytes;
+        }
+    };
+
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    /**
+     * Queued jobs, in submission order. The running job stays at the front
+     * until it is done (references to deque elements are stable on push_back).
+     */
+    std::deque<Job> m_jobs GUARDED_BY(m_mutex);
+    /** Size of the data held by the queued and running jobs */
+    size_t m_queued_bytes GUARDED_BY(m_mutex){0};
+    bool m_running GUARDED_BY(m_mutex){false};
+    bool m_request_stop GUARDED_BY(m_mutex){false};
+    /** Whether any job has failed */
+    bool m_failed GUARDED_BY(m_mutex){false};
+    std::thread m_thread;
+
+    void Loop() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        WAIT_LOCK(m_mutex, lock);
+        while (true) {
+            while (m_jobs.empty() && !m_request_stop) {
+                m_cond.wait(lock);
+            }
+            if (m_jobs.empty()) {
+                // Stop requested and everything is written
+                m_running = false;
+                return;
+            }
+            Job &job{m_jobs.front()};
+            bool ok;
+            {
+                REVERSE_LOCK(lock);
+                ok = job.func();
+            }
+            m_failed |= !ok;
+            m_queued_bytes -= job.bytes;
+            m_jobs.pop_front();
+            m_cond.notify_all();
+        }
+    }
+
+public:
+    void Start() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        LOCK(m_mutex);
+        if (m_running) {
+            return;
+        }
+        m_request_stop = false;
+        m_running = true;
+        m_thread = std::thread(&util::TraceThread, "blkwrite",
+                               [this] { Loop(); });
+    }
+
+    void Stop() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        {
+            LOCK(m_mutex);
+            if (!m_thread.joinable()) {
+                return;
+            }
+            m_request_stop = true;
+        }
+        m_cond.notify_all();
+        m_thread.join();
+    }
+
+    /**
+     * Queue a job writing bytes bytes at offset begin of the given file (none
+     * for a flush). Blocks while the queue holds more than
+     * MAX_BLOCK_WRITE_QUEUE_BYTES of data.
+     */
+    void Enqueue(const BlockFileKey &file, uint32_t begin, size_t bytes,
+                 std::function<bool()> func)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        {
+            WAIT_LOCK(m_mutex, lock);
+            if (m_running) {
+                // A job is always accepted when no data is queued, however
+                // large
+                while (m_queued_bytes != 0 &&
+                       m_queued_bytes + bytes > MAX_BLOCK_WRITE_QUEUE_BYTES) {
+                    m_cond.wait(lock);
+                }
+                m_jobs.push_back({file, begin, bytes, std::move(func)});
+                m_queued_bytes += bytes;
+                m_cond.notify_all();
+                return;
+            }
+        }
+        if (!func()) {
+            LOCK(m_mutex);
+            m_failed = true;
+        }
+    }
+
+    /**
+     * Wait until the job writing the byte at offset pos of the file, if any,
+     * is done. As a job writes a whole record, the record starting at pos can
+     * then be read while the later records of the file are still queued.
+     */
+    void WaitForPos(const BlockFileKey &file, uint32_t pos)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        WAIT_LOCK(m_mutex, lock);
+        while (std::any_of(m_jobs.begin(), m_jobs.end(), [&](const Job &job) {
+            return job.Writes(file, pos);
+        })) {
+            m_cond.wait(lock);
+        }
+    }
+
+    /** Wait until there is no queued or running job touching the file */
+    void WaitForFile(const BlockFileKey &file)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        WAIT_LOCK(m_mutex, lock);
+        while (std::any_of(m_jobs.begin(), m_jobs.end(), [&](const Job &job) {
+            return job.file == file;
+        })) {
+            m_cond.wait(lock);
+        }
+    }
+
+    /**
+     * Wait until every queued job is done. Returns false if any job has ever
+     * failed.
+     */
+    bool WaitForIdle() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        WAIT_LOCK(m_mutex, lock);
+        while (!m_jobs.empty()) {
+            m_cond.wait(lock);
+        }
+        return !m_failed;
+    }
+};
+
+BlockFileWriter g_block_writer;
+
+/** Append a record to a blk or rev file, aborting the node on failure */
+bool WriteRecord(FILE *file, const std::vector<uint8_t> &data,
+                 const char *error_message) {
+    AutoFile fileout{file};
+    if (fileout.IsNull()) {
+        return AbortNode(error_message);
+    }
+    try {
+        fileout.write(reinterpret_cast<const char *>(data.data()),
+                      data.size());
+    } catch (const std::exception &e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+        return AbortNode(error_message);
+    }
+    return true;
+}
+
+/**
+ * Return the span of a record written at pos (just after its
+ * BLOCK_SERIALIZATION_HEADER_SIZE bytes header) in a mapped file, followed by
+ * trailer_size bytes. Returns an empty span if the record does not fit.
+ */
+Span<const uint8_t> GetMappedRecord(const MappedFlatFile &map,
+                                    const FlatFilePos &pos,
+                                    size_t trailer_size) {
+    if (pos.nPos < sizeof(uint32_t) || pos.nPos > map.size()) {
+        return {};
+    }
+    const Span<const uint8_t> file{map.GetSpan()};
+    const uint64_t size{ReadLE32(file.data() + pos.nPos - sizeof(uint32_t))};
+    if (size + trailer_size > map.size() - pos.nPos) {
+        return {};
+    }
+    return file.subspan(pos.nPos, size + trailer_size);
+}
+} // namespace
+
 std::vector<CBlockIndex *> BlockManager::GetAllBlockIndices() {
     AssertLockHeld(cs_main);
     std::vector<CBlockIndex *> rv;
@@ -57,11 +344,12 @@ const CBlockIndex *BlockManager::LookupBlockIndex(const BlockHash &hash) const {
 }
 
 CBlockIndex *BlockManager::AddToBlockIndex(const CBlockHeader &block,
+                                           const BlockHash &hash,
                                            CBlockIndex *&best_header) {
     AssertLockHeld(cs_main);
+    assert(hash == block.GetHash());
 
-    const auto [mi, inserted] =
-        m_block_index.try_emplace(block.GetHash(), block);
+    const auto [mi, inserted] = m_block_index.try_emplace(hash, block);
     if (!inserted) {
         return &mi->second;
     }
@@ -334,6 +622,13 @@ bool BlockManager::LoadBlockIndexDB(const Consensus::Params &consensus_params) {
             break;
         }
     }
+    // Files before the last one are no longer appended to, so they can be
+    // memory mapped for reading
+    for (int nFile = 0; nFile < m_last_blockfile; nFile++) {
+        const FlatFilePos pos(nFile, 0);
+        g_mapped_files.MarkFinalized(BlockFileSeq().FileName(pos));
+        g_mapped_files.MarkFinalized(UndoFileSeq().FileName(pos));
+    }
 
     // Check presence of blk files
     LogPrintf("Checking all blk files are present...\n");
@@ -420,6 +715,7 @@ void CleanupBlockRevFiles() {
             if (path.substr(0, 3) == "blk") {
                 mapBlockFiles[path.substr(3, 5)] = file.path();
             } else if (path.substr(0, 3) == "rev") {
+                g_mapped_files.Forget(file.path());
                 remove(file.path());
             }
         }
@@ -445,34 +741,51 @@ CBlockFileInfo *BlockManager::GetBlockFileInfo(size_t n) {
     return &m_blockfile_info.at(n);
 }
 
-static bool UndoWriteToDisk(const CBlockUndo &blockundo, FlatFilePos &pos,
+static void UndoWriteToDisk(const CBlockUndo &blockundo, FlatFilePos &pos,
                             const BlockHash &hashBlock,
                             const CMessageHeader::MessageMagic &messageStart) {
-    // Open history file to append
-    CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull()) {
-        return error("%s: OpenUndoFile failed", __func__);
-    }
-
-    // Write index header
-    unsigned int nSize = GetSerializeSize(blockundo, fileout.GetVersion());
-    fileout << messageStart << nSize;
-
-    // Write undo data
-    long fileOutPos = ftell(fileout.Get());
-    if (fileOutPos < 0) {
-        return error("%s: ftell failed", __func__);
-    }
-    pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    // Serialize index header and undo data here, the block file writer
+    // appends them to the history file
+    unsigned int nSize = GetSerializeSize(blockundo, CLIENT_VERSION);
+    std::vector<uint8_t> data;
+    data.reserve(BLOCK_SERIALIZATION_HEADER_SIZE + nSize + sizeof(uint256));
+    CVectorWriter{SER_DISK, CLIENT_VERSION, data, 0, messageStart, nSize,
+                  blockundo};
 
     // calculate & write checksum
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
     hasher << hashBlock;
     hasher << blockundo;
-    fileout << hasher.GetHash();
+    CVectorWriter{SER_DISK, CLIENT_VERSION, data, data.size(),
+                  hasher.GetHash()};
+
+    const FlatFilePos record_pos{pos};
+    pos.nPos += BLOCK_SERIALIZATION_HEADER_SIZE;
+    // The size is read before the data is moved into the job, as the order
+    // of evaluation of the arguments is unspecified
+    const size_t bytes{data.size()};
+    g_block_writer.Enqueue(UndoFileKeyFor(pos), record_pos.nPos, bytes,
+                           [record_pos, data = std::move(data)] {
+                               return WriteRecord(OpenUndoFile(record_pos),
+                                                  data,
+                                                  "Failed to write undo data");
+                           });
+}
 
-    return true;
+/**
+ * Read undo data and its checksum from filein, returning whether the checksum
+ * matches. Throws on deserialization errors.
+ */
+template <typename Stream>
+static bool ReadUndoWithChecksum(Stream &filein, CBlockUndo &blockundo,
+                                 const BlockHash &hashPrevBlock) {
+    uint256 hashChecksum;
+    // We need a CHashVerifier as reserializing may lose data
+    CHashVerifier<Stream> verifier(&filein);
+    verifier << hashPrevBlock;
+    verifier >> blockundo;
+    filein >> hashChecksum;
+    return hashChecksum == verifier.GetHash();
 }
 
 bool UndoReadFromDisk(CBlockUndo &blockundo, const CBlockIndex *pindex) {
@@ -481,27 +794,34 @@ bool UndoReadFromDisk(CBlockUndo &blockundo, const CBlockIndex *pindex) {
     if (pos.IsNull()) {
         return error("%s: no undo data available", __func__);
     }
-
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("%s: OpenUndoFile failed", __func__);
-    }
+    g_block_writer.WaitForPos(UndoFileKeyFor(pos), pos.nPos);
 
     // Read block
-    uint256 hashChecksum;
-    // We need a CHashVerifier as reserializing may lose data
-    CHashVerifier<CAutoFile> verifier(&filein);
+    bool checksum_ok;
     try {
-        verifier << pindex->pprev->GetBlockHash();
-        verifier >> blockundo;
-        filein >> hashChecksum;
+        if (auto map{g_mapped_files.Get(UndoFileSeq(), pos)}) {
+            // Deserialize straight from the mapped file
+            SpanReader filein{
+                SER_DISK, CLIENT_VERSION,
+                GetMappedRecord(*map, pos, sizeof(uint256))};
+            checksum_ok = ReadUndoWithChecksum(filein, blockundo,
+                                               pindex->pprev->GetBlockHash());
+        } else {
+            // Open history file to read
+            CAutoFile filein(OpenUndoFile(pos, true), SER_DISK,
+                             CLIENT_VERSION);
+            if (filein.IsNull()) {
+                return error("%s: OpenUndoFile failed", __func__);
+            }
+            checksum_ok = ReadUndoWithChecksum(filein, blockundo,
+                                               pindex->pprev->GetBlockHash());
+        }
     } catch (const std::exception &e) {
         return error("%s: Deserialize or I/O error - %s", __func__, e.what());
     }
 
     // Verify checksum
-    if (hashChecksum != verifier.GetHash()) {
+    if (!checksum_ok) {
         return error("%s: Checksum mismatch", __func__);
     }
 
@@ -511,37 +831,63 @@ bool UndoReadFromDisk(CBlockUndo &blockundo, const CBlockIndex *pindex) {
 void BlockManager::FlushUndoFile(int block_file, bool finalize) {
     FlatFilePos undo_pos_old(block_file,
                              m_blockfile_info[block_file].nUndoSize);
-    if (!UndoFileSeq().Flush(undo_pos_old, finalize)) {
-        AbortNode("Flushing undo file to disk failed. This is likely the "
-                  "result of an I/O error.");
-    }
+    g_block_writer.Enqueue(
+        UndoFileKeyFor(undo_pos_old), undo_pos_old.nPos, 0,
+        [undo_pos_old, finalize] {
+            if (!UndoFileSeq().Flush(undo_pos_old, finalize)) {
+                return AbortNode("Flushing undo file to disk failed. This is "
+                                 "likely the result of an I/O error.");
+            }
+            if (finalize) {
+                g_mapped_files.MarkFinalized(
+                    UndoFileSeq().FileName(undo_pos_old));
+            }
+            return true;
+        });
 }
 
-void BlockManager::FlushBlockFile(bool fFinalize, bool finalize_undo) {
-    LOCK(cs_LastBlockFile);
-
-    if (m_blockfile_info.empty()) {
-        // Return if we haven't loaded any blockfiles yet. This happens during
-        // chainstate init, when we call
-        // ChainstateManager::MaybeRebalanceCaches() (which then calls
-        // FlushStateToDisk()), resulting in a call to this function before we
-        // have populated `m_blockfile_info` via LoadBlockIndexDB().
-        return;
+bool BlockManager::FlushBlockFile(bool fFinalize, bool finalize_undo) {
+    {
+        LOCK(cs_LastBlockFile);
+
+        if (m_blockfile_info.empty()) {
+            // Return if we haven't loaded any blockfiles yet. This happens
+            // during chainstate init, when we call
+            // ChainstateManager::MaybeRebalanceCaches() (which then calls
+            // FlushStateToDisk()), resulting in a call to this function before
+            // we have populated `m_blockfile_info` via LoadBlockIndexDB().
+            return true;
+        }
+        assert(static_cast<int>(m_blockfile_info.size()) > m_last_blockfile);
+
+        FlatFilePos block_pos_old(m_last_blockfile,
+                                  m_blockfile_info[m_last_blockfile].nSize);
+        g_block_writer.Enqueue(
+            BlockFileKeyFor(block_pos_old), block_pos_old.nPos, 0,
+            [block_pos_old, fFinalize] {
+                if (!BlockFileSeq().Flush(block_pos_old, fFinalize)) {
+                    return AbortNode("Flushing block file to disk failed. "
+                                     "This is likely the result of an I/O "
+                                     "error.");
+                }
+                if (fFinalize) {
+                    g_mapped_files.MarkFinalized(
+                        BlockFileSeq().FileName(block_pos_old));
+                }
+                return true;
+            });
+        // we do not always flush the undo file, as the chain tip may be
+        // lagging behind the incoming blocks,
+        // e.g. during IBD or a sync after a node going offline
+        if (!fFinalize || finalize_undo) {
+            FlushUndoFile(m_last_blockfile, finalize_undo);
+        }
     }
-    assert(static_cast<int>(m_blockfile_info.size()) > m_last_blockfile);
 
-    FlatFilePos block_pos_old(m_last_blockfile,
-                              m_blockfile_info[m_last_blockfile].nSize);
-    if (!BlockFileSeq().Flush(block_pos_old, fFinalize)) {
-        AbortNode("Flushing block file to disk failed. This is likely the "
-                  "result of an I/O error.");
-    }
-    // we do not always flush the undo file, as the chain tip may be lagging
-    // behind the incoming blocks,
-    // e.g. during IBD or a sync after a node going offline
-    if (!fFinalize || finalize_undo) {
-        FlushUndoFile(m_last_blockfile, finalize_undo);
-    }
+    // Finalizing a file when moving to the next one is left to the block file
+    // writer, but a plain flush is a durability barrier: all the block and
+    // undo data written so far must be on disk when it returns.
+    return fFinalize || g_block_writer.WaitForIdle();
 }
 
 uint64_t BlockManager::CalculateCurrentUsage() {
@@ -556,8 +902,12 @@ uint64_t BlockManager::CalculateCurrentUsage() {
 }
 
 void UnlinkPrunedFiles(const std::set<int> &setFilesToPrune) {
+    // Don't unlink files from under the block file writer
+    g_block_writer.WaitForIdle();
     for (const int i : setFilesToPrune) {
         FlatFilePos pos(i, 0);
+        g_mapped_files.Forget(BlockFileSeq().FileName(pos));
+        g_mapped_files.Forget(UndoFileSeq().FileName(pos));
         fs::remove(BlockFileSeq().FileName(pos));
         fs::remove(UndoFileSeq().FileName(pos));
         LogPrint(BCLog::BLOCKSTORE, "Prune: %s deleted blk/rev (%05u)\n",
@@ -577,11 +927,18 @@ static FlatFileSeq UndoFileSeq() {
 }
 
 FILE *OpenBlockFile(const FlatFilePos &pos, bool fReadOnly) {
+    if (fReadOnly) {
+        // Don't read data that is still queued in the block file writer
+        g_block_writer.WaitForPos(BlockFileKeyFor(pos), pos.nPos);
+    }
     return BlockFileSeq().Open(pos, fReadOnly);
 }
 
 /** Open an undo file (rev?????.dat) */
 static FILE *OpenUndoFile(const FlatFilePos &pos, bool fReadOnly) {
+    if (fReadOnly) {
+        g_block_writer.WaitForPos(UndoFileKeyFor(pos), pos.nPos);
+    }
     return UndoFileSeq().Open(pos, fReadOnly);
 }
 
@@ -664,6 +1021,9 @@ bool BlockManager::FindUndoPos(BlockValidationState &state, int nFile,
     m_blockfile_info[nFile].nUndoSize += nAddSize;
     m_dirty_fileinfo.insert(nFile);
 
+    // The undo file is appended to (and preallocated into) again
+    g_mapped_files.Forget(UndoFileSeq().FileName(pos));
+
     bool out_of_space;
     size_t bytes_allocated =
         UndoFileSeq().Allocate(pos, nAddSize, out_of_space);
@@ -678,28 +1038,26 @@ bool BlockManager::FindUndoPos(BlockValidationState &state, int nFile,
     return true;
 }
 
-static bool WriteBlockToDisk(const CBlock &block, FlatFilePos &pos,
+static void WriteBlockToDisk(const CBlock &block, FlatFilePos &pos,
                              const CMessageHeader::MessageMagic &messageStart) {
-    // Open history file to append
-    CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull()) {
-        return error("WriteBlockToDisk: OpenBlockFile failed");
-    }
-
-    // Write index header
-    unsigned int nSize = GetSerializeSize(block, fileout.GetVersion());
-    fileout << messageStart << nSize;
-
-    // Write block
-    long fileOutPos = ftell(fileout.Get());
-    if (fileOutPos < 0) {
-        return error("WriteBlockToDisk: ftell failed");
-    }
-
-    pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
-
-    return true;
+    // Serialize index header and block here, the block file writer appends
+    // them to the history file
+    unsigned int nSize = GetSerializeSize(block, CLIENT_VERSION);
+    std::vector<uint8_t> data;
+    data.reserve(BLOCK_SERIALIZATION_HEADER_SIZE + nSize);
+    CVectorWriter{SER_DISK, CLIENT_VERSION, data, 0, messageStart, nSize,
+                  block};
+
+    const FlatFilePos record_pos{pos};
+    pos.nPos += BLOCK_SERIALIZATION_HEADER_SIZE;
+    // Not data.size(), which may be evaluated after the move of data
+    const size_t bytes{data.size()};
+    g_block_writer.Enqueue(BlockFileKeyFor(pos), record_pos.nPos, bytes,
+                           [record_pos, data = std::move(data)] {
+                               return WriteRecord(OpenBlockFile(record_pos),
+                                                  data,
+                                                  "Failed to write block");
+                           });
 }
 
 bool BlockManager::WriteUndoDataForBlock(const CBlockUndo &blockundo,
@@ -714,10 +1072,8 @@ bool BlockManager::WriteUndoDataForBlock(const CBlockUndo &blockundo,
                          ::GetSerializeSize(blockundo, CLIENT_VERSION) + 40)) {
             return error("ConnectBlock(): FindUndoPos failed");
         }
-        if (!UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(),
-                             chainparams.DiskMagic())) {
-            return AbortNode(state, "Failed to write undo data");
-        }
+        UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(),
+                        chainparams.DiskMagic());
         // rev files are written in block height order, whereas blk files are
         // written as blocks come in (often out of order) we want to flush the
         // rev (undo) file once we've written the last block, which is indicated
@@ -743,17 +1099,25 @@ bool BlockManager::WriteUndoDataForBlock(const CBlockUndo &blockundo,
 bool ReadBlockFromDisk(CBlock &block, const FlatFilePos &pos,
                        const Consensus::Params &params) {
     block.SetNull();
-
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s",
-                     pos.ToString());
-    }
+    g_block_writer.WaitForPos(BlockFileKeyFor(pos), pos.nPos);
 
     // Read block
     try {
-        filein >> block;
+        if (auto map{g_mapped_files.Get(BlockFileSeq(), pos)}) {
+            // Deserialize straight from the mapped file
+            SpanReader{SER_DISK, CLIENT_VERSION,
+                       GetMappedRecord(*map, pos, 0)} >>
+                block;
+        } else {
+            // Open history file to read
+            CAutoFile filein(OpenBlockFile(pos, true), SER_DISK,
+                             CLIENT_VERSION);
+            if (filein.IsNull()) {
+                return error("ReadBlockFromDisk: OpenBlockFile failed for %s",
+                             pos.ToString());
+            }
+            filein >> block;
+        }
     } catch (const std::exception &e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__,
                      e.what(), pos.ToString());
@@ -786,17 +1150,33 @@ bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex,
     return true;
 }
 
-bool ReadTxFromDisk(CMutableTransaction &tx, const FlatFilePos &pos) {
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("ReadTxFromDisk: OpenBlockFile failed for %s",
-                     pos.ToString());
+/** The mapped bytes from pos to the end of the file */
+static Span<const uint8_t> GetMappedTail(const MappedFlatFile &map,
+                                         const FlatFilePos &pos) {
+    if (pos.nPos > map.size()) {
+        return {};
     }
+    return map.GetSpan().subspan(pos.nPos);
+}
+
+bool ReadTxFromDisk(CMutableTransaction &tx, const FlatFilePos &pos) {
+    g_block_writer.WaitForPos(BlockFileKeyFor(pos), pos.nPos);
 
     // Read tx
     try {
-        filein >> tx;
+        if (auto map{g_mapped_files.Get(BlockFileSeq(), pos)}) {
+            SpanReader{SER_DISK, CLIENT_VERSION, GetMappedTail(*map, pos)} >>
+                tx;
+        } else {
+            // Open history file to read
+            CAutoFile filein(OpenBlockFile(pos, true), SER_DISK,
+                             CLIENT_VERSION);
+            if (filein.IsNull()) {
+                return error("ReadTxFromDisk: OpenBlockFile failed for %s",
+                             pos.ToString());
+            }
+            filein >> tx;
+        }
     } catch (const std::exception &e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__,
                      e.what(), pos.ToString());
@@ -806,16 +1186,23 @@ bool ReadTxFromDisk(CMutableTransaction &tx, const FlatFilePos &pos) {
 }
 
 bool ReadTxUndoFromDisk(CTxUndo &tx_undo, const FlatFilePos &pos) {
-    // Open undo file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("ReadTxUndoFromDisk: OpenUndoFile failed for %s",
-                     pos.ToString());
-    }
+    g_block_writer.WaitForPos(UndoFileKeyFor(pos), pos.nPos);
 
     // Read undo data
     try {
-        filein >> tx_undo;
+        if (auto map{g_mapped_files.Get(UndoFileSeq(), pos)}) {
+            SpanReader{SER_DISK, CLIENT_VERSION, GetMappedTail(*map, pos)} >>
+                tx_undo;
+        } else {
+            // Open undo file to read
+            CAutoFile filein(OpenUndoFile(pos, true), SER_DISK,
+                             CLIENT_VERSION);
+            if (filein.IsNull()) {
+                return error("ReadTxUndoFromDisk: OpenUndoFile failed for %s",
+                             pos.ToString());
+            }
+            filein >> tx_undo;
+        }
     } catch (const std::exception &e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__,
                      e.what(), pos.ToString());
@@ -849,14 +1236,19 @@ FlatFilePos BlockManager::SaveBlockToDisk(const CBlock &block, int nHeight,
         return FlatFilePos();
     }
     if (!position_known) {
-        if (!WriteBlockToDisk(block, blockPos, chainparams.DiskMagic())) {
-            AbortNode("Failed to write block");
-            return FlatFilePos();
-        }
+        WriteBlockToDisk(block, blockPos, chainparams.DiskMagic());
     }
     return blockPos;
 }
 
+void StartBlockFileWriter() {
+    g_block_writer.Start();
+}
+
+void StopBlockFileWriter() {
+    g_block_writer.Stop();
+}
+
 struct CImportingNow {
     CImportingNow() {
         assert(fImporting == false);
@@ -890,6 +1282,8 @@ void ThreadImport(ChainstateManager &chainman,
                     // No block files left to reindex
                     break;
                 }
+                // The whole file is read, not only the record at pos
+                g_block_writer.WaitForFile(BlockFileKeyFor(pos));
                 FILE *file = OpenBlockFile(pos, true);
                 if (!file) {
                     // This error is logged in OpenBlockFile
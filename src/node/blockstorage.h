@@ -43,6 +43,17 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 
+/** Default for -mmapblockfiles */
+static constexpr bool DEFAULT_MMAP_BLOCK_FILES{false};
+/** Maximum number of finalised blk/rev files kept memory mapped for reading */
+static constexpr size_t MAX_MAPPED_BLOCK_FILES{16};
+
+/**
+ * Maximum size of the block and undo data queued for the block file writer
+ * thread before the validation thread waits for it to catch up
+ */
+static constexpr size_t MAX_BLOCK_WRITE_QUEUE_BYTES{256 * 1024 * 1024};
+
 /** Size of header written by WriteBlockToDisk before a serialized CBlock */
 static constexpr size_t BLOCK_SERIALIZATION_HEADER_SIZE =
     CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int);
@@ -51,6 +62,8 @@ extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern bool fPruneMode;
 extern uint64_t nPruneTarget;
+/** Read finalised block and undo files through read-only memory mappings */
+extern std::atomic_bool fMmapBlockFiles;
 
 // Because validation code takes pointers to the map's CBlockIndex objects, if
 // we ever switch to another associative container, we need to either use a
@@ -77,7 +90,12 @@ private:
      */
     bool LoadBlockIndex(const Consensus::Params &consensus_params)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
-    void FlushBlockFile(bool fFinalize = false, bool finalize_undo = false);
+    /**
+     * Flush the last block file, and optionally its undo file. Unless
+     * finalizing, this waits for all the queued block and undo data to be on
+     * disk and returns false if writing any of it failed.
+     */
+    bool FlushBlockFile(bool fFinalize = false, bool finalize_undo = false);
     void FlushUndoFile(int block_file, bool finalize = false);
     bool FindBlockPos(FlatFilePos &pos, unsigned int nAddSize,
                       unsigned int nHeight, CChain &active_chain,
@@ -154,6 +172,12 @@ public:
 
     CBlockIndex *AddToBlockIndex(const CBlockHeader &block,
                                  CBlockIndex *&best_header)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+        return AddToBlockIndex(block, block.GetHash(), best_header);
+    }
+    CBlockIndex *AddToBlockIndex(const CBlockHeader &block,
+                                 const BlockHash &hash,
+                                 CBlockIndex *&best_header)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
     CBlockIndex *InsertBlockIndex(const BlockHash &hash)
@@ -217,7 +241,10 @@ const CBlockIndex *GetFirstStoredBlock(const CBlockIndex *start_block)
 
 void CleanupBlockRevFiles();
 
-/** Open a block file (blk?????.dat) */
+/**
+ * Open a block file (blk?????.dat). When opened read-only, waits until the
+ * block file writer is done with the queued writes to the file.
+ */
 FILE *OpenBlockFile(const FlatFilePos &pos, bool fReadOnly = false);
 /** Translation to a filesystem path. */
 fs::path GetBlockPosFilename(const FlatFilePos &pos);
@@ -238,6 +265,14 @@ bool UndoReadFromDisk(CBlockUndo &blockundo, const CBlockIndex *pindex);
 bool ReadTxFromDisk(CMutableTransaction &tx, const FlatFilePos &pos);
 bool ReadTxUndoFromDisk(CTxUndo &tx, const FlatFilePos &pos);
 
+/**
+ * Start the thread writing block and undo data behind the validation thread.
+ * When it is not running, block and undo data are written synchronously.
+ */
+void StartBlockFileWriter();
+/** Write out all the queued block and undo data and stop the writer thread */
+void StopBlockFileWriter();
+
 void ThreadImport(ChainstateManager &chainman,
                   std::vector<fs::path> vImportFiles, const ArgsManager &args,
                   const fs::path &mempool_path);
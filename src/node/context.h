@@ -25,6 +25,9 @@ class WalletClient;
 } // namespace interfaces
 
 namespace node {
+class BlockTemplateSelection;
+class TemplateValidityChecker;
+
 //! NodeContext struct containing references to chain state and connection
 //! state.
 //!
@@ -42,6 +45,8 @@ struct NodeContext {
     std::unique_ptr<PeerManager> peerman;
     std::unique_ptr<ChainstateManager> chainman;
     std::unique_ptr<BanMan> banman;
+    std::unique_ptr<BlockTemplateSelection> block_template_selection;
+    std::unique_ptr<TemplateValidityChecker> template_checker;
     // Currently a raw pointer because the memory is not managed by this struct
     ArgsManager *args{nullptr};
     std::unique_ptr<interfaces::Chain> chain;
@@ -0,0 +1,153 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/eventstream.h>
+
+#include <chain.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <tinyformat.h>
+#include <txmempool.h>
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace node {
+
+static const char *RemovalReasonName(MemPoolRemovalReason reason) {
+    switch (reason) {
+        case MemPoolRemovalReason::EXPIRY:
+            return "expiry";
+        case MemPoolRemovalReason::SIZELIMIT:
+            return "sizelimit";
+        case MemPoolRemovalReason::REORG:
+            return "reorg";
+        case MemPoolRemovalReason::BLOCK:
+            return "block";
+        case MemPoolRemovalReason::CONFLICT:
+            return "conflict";
+        case MemPoolRemovalReason::REPLACED:
+            return "replaced";
+        case MemPoolRemovalReason::AVALANCHE:
+            return "avalanche";
+    }
+    assert(false);
+}
+
+static UniValue BlockEvent(const char *type, const CBlockIndex &index) {
+    UniValue event(UniValue::VOBJ);
+    event.pushKV("type", type);
+    event.pushKV("hash", index.GetBlockHash().GetHex());
+    event.pushKV("height", index.nHeight);
+    return event;
+}
+
+EventStream::EventStream(size_t capacity, size_t max_waiters)
+    : m_capacity(capacity), m_max_waiters(max_waiters),
+      m_stream(strprintf("%016x", GetRand<uint64_t>())) {}
+
+void EventStream::Push(UniValue event) {
+    {
+        LOCK(m_mutex);
+        // The sequence comes first so consumers can read it at a glance
+        UniValue sequenced(UniValue::VOBJ);
+        sequenced.pushKV("sequence", m_next++);
+        sequenced.pushKVs(event);
+        m_events.push_back(sequenced.write());
+        if (m_events.size() > m_capacity) {
+            m_events.pop_front();
+        }
+    }
+    m_cond.notify_all();
+}
+
+EventStream::Events EventStream::GetEvents(uint64_t start, size_t max_events,
+                                           std::chrono::milliseconds timeout) {
+    WAIT_LOCK(m_mutex, lock);
+    const uint64_t oldest{m_next - m_events.size()};
+    if (start == 0 || start > m_next) {
+        // Start with the oldest event, also if the sequence restarted since
+        // the consumer got its last event
+        start = oldest;
+    }
+    if (m_waiters < m_max_waiters) {
+        ++m_waiters;
+        m_cond.wait_for(lock, timeout,
+                        [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+                            return m_interrupted || m_next > start;
+                        });
+        --m_waiters;
+    }
+
+    Events result;
+    result.stream = m_stream;
+    result.missed = m_next - m_events.size() > start
+                        ? m_next - m_events.size() - start
+                        : 0;
+    result.start = start + result.missed;
+    const uint64_t end{
+        std::min<uint64_t>(m_next, result.start + uint64_t(max_events))};
+    const uint64_t offset{m_next - m_events.size()};
+    for (uint64_t i = result.start; i < end; i++) {
+        result.events.push_back(m_events[i - offset]);
+    }
+    result.next = end;
+    return result;
+}
+
+void EventStream::Interrupt() {
+    WITH_LOCK(m_mutex, m_interrupted = true);
+    m_cond.notify_all();
+}
+
+void EventStream::TransactionAddedToMempool(
+    const CTransactionRef &tx, std::shared_ptr<const std::vector<Coin>>,
+    uint64_t mempool_sequence) {
+    UniValue event(UniValue::VOBJ);
+    event.pushKV("type", "txadded");
+    event.pushKV("txid", tx->GetId().GetHex());
+    event.pushKV("size", uint64_t(tx->GetTotalSize()));
+    event.pushKV("mempool_sequence", mempool_sequence);
+    Push(std::move(event));
+}
+
+void EventStream::TransactionRemovedFromMempool(const CTransactionRef &tx,
+                                                MemPoolRemovalReason reason,
+                                                uint64_t mempool_sequence) {
+    UniValue event(UniValue::VOBJ);
+    event.pushKV("type", "txremoved");
+    event.pushKV("txid", tx->GetId().GetHex());
+    event.pushKV("reason", RemovalReasonName(reason));
+    event.pushKV("mempool_sequence", mempool_sequence);
+    Push(std::move(event));
+}
+
+void EventStream::BlockConnected(const std::shared_ptr<const CBlock> &block,
+                                 const CBlockIndex *pindex) {
+    UniValue event{BlockEvent("blockconnected", *pindex)};
+    // The transactions included in the block leave the mempool without a
+    // txremoved event
+    UniValue txids(UniValue::VARR);
+    txids.reserve(block->vtx.size());
+    for (const CTransactionRef &tx : block->vtx) {
+        txids.push_back(tx->GetId().GetHex());
+    }
+    event.pushKV("tx", std::move(txids));
+    Push(std::move(event));
+}
+
+void EventStream::BlockDisconnected(const std::shared_ptr<const CBlock> &block,
+                                    const CBlockIndex *pindex) {
+    Push(BlockEvent("blockdisconnected", *pindex));
+}
+
+void EventStream::BlockFinalized(const CBlockIndex *pindex) {
+    if (pindex) {
+        Push(BlockEvent("blockfinalized", *pindex));
+    }
+}
+
+} // namespace node
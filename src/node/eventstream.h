@@ -0,0 +1,109 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_EVENTSTREAM_H
+#define BITCOIN_NODE_EVENTSTREAM_H
+
+#include <sync.h>
+#include <validationinterface.h>
+
+#include <univalue.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace node {
+
+/**
+ * Default for -resteventbuffer, the number of events kept for /rest/events
+ */
+static constexpr size_t DEFAULT_REST_EVENT_BUFFER{10000};
+/** Maximum time a /rest/events request waits for a new event */
+static constexpr std::chrono::seconds MAX_EVENT_WAIT{60};
+
+/**
+ * Keeps the latest mempool and chain events as JSON objects with increasing
+ * sequence numbers, so that external consumers can follow the mempool without
+ * polling its whole content. Consumers resume after a reconnection by asking
+ * for the events from the next sequence number they have not seen.
+ */
+class EventStream final : public CValidationInterface {
+public:
+    /**
+     * Keep up to capacity events, and let at most max_waiters requests wait
+     * for an event at the same time.
+     */
+    EventStream(size_t capacity, size_t max_waiters);
+
+    struct Events {
+        /** Identifies this stream, the sequence restarts with the node */
+        std::string stream;
+        /** Sequence number of the first returned event */
+        uint64_t start;
+        /** Sequence number to request to get the following events */
+        uint64_t next;
+        /** Number of requested events that are no longer buffered */
+        uint64_t missed;
+        /** The serialized events */
+        std::vector<std::string> events;
+    };
+
+    /**
+     * Get the buffered events from sequence number start, or from the oldest
+     * buffered one if start is 0. If there is none, wait up to timeout for
+     * one, unless max_waiters requests are already waiting: the request then
+     * returns at once, so the waiters can't take all the HTTP worker threads.
+     */
+    Events GetEvents(uint64_t start, size_t max_events,
+                     std::chrono::milliseconds timeout)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Wake up and stop the requests waiting for an event */
+    void Interrupt() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+protected:
+    // CValidationInterface
+    void TransactionAddedToMempool(
+        const CTransactionRef &tx,
+        std::shared_ptr<const std::vector<Coin>> spent_coins,
+        uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void TransactionRemovedFromMempool(const CTransactionRef &tx,
+                                       MemPoolRemovalReason reason,
+                                       uint64_t mempool_sequence) override
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void BlockConnected(const std::shared_ptr<const CBlock> &block,
+                        const CBlockIndex *pindex) override
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block,
+                           const CBlockIndex *pindex) override
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void BlockFinalized(const CBlockIndex *pindex) override
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    /** Assign the next sequence number to an event and buffer it */
+    void Push(UniValue event) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    const size_t m_capacity;
+    const size_t m_max_waiters;
+    const std::string m_stream;
+
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    /** The buffered events, from sequence number m_next - m_events.size() */
+    std::deque<std::string> m_events GUARDED_BY(m_mutex);
+    uint64_t m_next GUARDED_BY(m_mutex){1};
+    /** Number of requests waiting for an event */
+    size_t m_waiters GUARDED_BY(m_mutex){0};
+    bool m_interrupted GUARDED_BY(m_mutex){false};
+};
+
+} // namespace node
+
+#endif // BITCOIN_NODE_EVENTSTREAM_H
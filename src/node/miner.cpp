@@ -24,14 +24,17 @@
 #include <pow/pow.h>
 #include <primitives/transaction.h>
 #include <timedata.h>
+#include <util/hasher.h>
 #include <util/moneystr.h>
 #include <util/system.h>
+#include <util/thread.h>
 #include <validation.h>
 #include <versionbits.h>
 
 #include <algorithm>
 #include <queue>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 namespace node {
@@ -61,11 +64,14 @@ BlockAssembler::Options::Options()
 
 BlockAssembler::BlockAssembler(Chainstate &chainstate,
                                const CTxMemPool *mempool,
-                               const Options &options)
+                               const Options &options,
+                               BlockTemplateSelection *selection)
     : chainParams(chainstate.m_chainman.GetParams()), m_mempool(mempool),
-      m_chainstate(chainstate), fPrintPriority(gArgs.GetBoolArg(
-                                    "-printpriority", DEFAULT_PRINTPRIORITY)) {
+      m_chainstate(chainstate), m_selection(selection),
+      fPrintPriority(
+          gArgs.GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY)) {
     blockMinFeeRate = options.blockMinFeeRate;
+    m_test_block_validity = options.testBlockValidity;
     // Limit size to between 1K and options.nExcessiveBlockSize -1K for sanity:
     nMaxGeneratedBlockSize = std::max<uint64_t>(
         1000, std::min<uint64_t>(options.nExcessiveBlockSize - 1000,
@@ -79,7 +85,7 @@ BlockAssembler::BlockAssembler(Chainstate &chainstate,
     nMaxGeneratedBlockSigChecks = nMaxBlockSigChecks;
 }
 
-static BlockAssembler::Options DefaultOptions(const Config &config) {
+BlockAssembler::Options DefaultBlockAssemblerOptions(const Config &config) {
     // Block resource limits
     // If -blockmaxsize is not given, limit to DEFAULT_MAX_GENERATED_BLOCK_SIZE
     // If only one is given, only restrict the specified resource.
@@ -103,8 +109,10 @@ static BlockAssembler::Options DefaultOptions(const Config &config) {
 }
 
 BlockAssembler::BlockAssembler(const Config &config, Chainstate &chainstate,
-                               const CTxMemPool *mempool)
-    : BlockAssembler(chainstate, mempool, DefaultOptions(config)) {}
+                               const CTxMemPool *mempool,
+                               BlockTemplateSelection *selection)
+    : BlockAssembler(chainstate, mempool, DefaultBlockAssemblerOptions(config),
+                     selection) {}
 
 void BlockAssembler::resetBlock() {
     // Reserve space for coinbase tx.
@@ -153,12 +161,40 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn) {
     pblock->nTime = TicksSinceEpoch<std::chrono::seconds>(GetAdjustedTime());
     m_lock_time_cutoff = pindexPrev->GetMedianTimePast();
 
+    // The selection is kept in CTOR order, so it can only be used once
+    // transactions are canonically ordered.
+    BlockTemplateSelection *const selection{
+        IsMagneticAnomalyEnabled(consensusParams, pindexPrev) ? m_selection
+                                                              : nullptr};
+    bool from_selection{false};
     if (m_mempool) {
         LOCK(m_mempool->cs);
-        addTxs(*m_mempool);
+        const BlockTemplateSelection::Limits limits{
+            nMaxGeneratedBlockSize, nMaxGeneratedBlockSigChecks,
+            blockMinFeeRate};
+        if (selection) {
+            if (const auto totals{selection->Get(pindexPrev, limits,
+                                                 pblocktemplate->entries)}) {
+                nBlockSize = totals->size;
+                nBlockSigChecks = totals->sigChecks;
+                nBlockTx = totals->txCount;
+                nFees = totals->fees;
+                from_selection = true;
+            }
+        }
+        if (!from_selection) {
+            addTxs(*m_mempool);
+            if (selection) {
+                selection->Reset(
+                    pindexPrev, limits, consensusParams, nHeight,
+                    m_lock_time_cutoff, pblocktemplate->entries,
+                    {nBlockSize, nBlockSigChecks, nBlockTx, nFees});
+            }
+        }
     }
 
-    if (IsMagneticAnomalyEnabled(consensusParams, pindexPrev)) {
+    if (!from_selection &&
+        IsMagneticAnomalyEnabled(consensusParams, pindexPrev)) {
         // If magnetic anomaly is enabled, we make sure transaction are
         // canonically ordered.
         std::sort(std::begin(pblocktemplate->entries) + 1,
@@ -234,7 +270,23 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn) {
     pblocktemplate->entries[0].sigChecks = 0;
 
     BlockValidationState state;
-    if (!TestBlockValidity(state, chainParams, m_chainstate, *pblock,
+    // Templates of mempool transactions can skip the full validation if they
+    // are consistent, the transactions were validated on mempool entry.
+    const bool check_template_only{
+        !m_test_block_validity && m_mempool &&
+        IsMagneticAnomalyEnabled(consensusParams, pindexPrev)};
+    bool checked{false};
+    if (check_template_only) {
+        checked = CheckTemplate(*pblock, pindexPrev, state);
+        if (!checked) {
+            LogPrintf("%s: CheckTemplate failed: %s, falling back to "
+                      "TestBlockValidity\n",
+                      __func__, state.ToString());
+            state = BlockValidationState();
+        }
+    }
+    if (!checked &&
+        !TestBlockValidity(state, chainParams, m_chainstate, *pblock,
                            pindexPrev, GetAdjustedTime,
                            BlockValidationOptions(nMaxGeneratedBlockSize)
                                .withCheckPoW(false)
@@ -242,13 +294,15 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn) {
         throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s",
                                            __func__, state.ToString()));
     }
+    pblocktemplate->fullyValidated = !checked;
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint(
-        BCLog::BENCH,
-        "CreateNewBlock() addTxs: %.2fms, validity: %.2fms (total %.2fms)\n",
-        0.001 * (nTime1 - nTimeStart), 0.001 * (nTime2 - nTime1),
-        0.001 * (nTime2 - nTimeStart));
+    LogPrint(BCLog::BENCH,
+             "CreateNewBlock() addTxs: %.2fms%s, validity: %.2fms (total "
+             "%.2fms)\n",
+             0.001 * (nTime1 - nTimeStart),
+             from_selection ? " (from selection)" : "",
+             0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
@@ -287,6 +341,85 @@ bool BlockAssembler::CheckTx(const CTransaction &tx) const {
                                       nHeight, m_lock_time_cutoff);
 }
 
+bool BlockAssembler::CheckTemplate(const CBlock &block,
+                                   const CBlockIndex *pindexPrev,
+                                   BlockValidationState &state) const {
+    AssertLockHeld(::cs_main);
+    assert(pindexPrev == m_chainstate.m_chain.Tip());
+
+    if (!CheckBlock(block, state, chainParams.GetConsensus(),
+                    BlockValidationOptions(nMaxGeneratedBlockSize)
+                        .withCheckPoW(false)
+                        .withCheckMerkleRoot(false))) {
+        return false;
+    }
+
+    const std::vector<CBlockTemplateEntry> &entries{pblocktemplate->entries};
+    if (entries.size() != block.vtx.size()) {
+        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                             "bad-template-entries");
+    }
+
+    // The transactions must be in canonical order and each input must spend
+    // a coin from the UTXO set or from another transaction of the template.
+    std::unordered_set<TxId, SaltedTxIdHasher> txids;
+    std::unordered_set<COutPoint, SaltedOutpointHasher> spent;
+    txids.reserve(block.vtx.size());
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        const CTransaction &tx = *block.vtx[i];
+        if (i > 1 && tx.GetId() <= block.vtx[i - 1]->GetId()) {
+            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                                 tx.GetId() == block.vtx[i - 1]->GetId()
+                                     ? "tx-duplicate"
+                                     : "tx-ordering");
+        }
+        txids.insert(tx.GetId());
+    }
+
+    const CCoinsViewCache &view = m_chainstate.CoinsTip();
+    Amount fees{Amount::zero()};
+    uint64_t sigChecks{0};
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        const CTransaction &tx = *block.vtx[i];
+        for (const CTxIn &in : tx.vin) {
+            if (!spent.insert(in.prevout).second) {
+                return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                                     "bad-txns-inputs-duplicate");
+            }
+            if (txids.count(in.prevout.GetTxId())) {
+                const auto parent{std::lower_bound(
+                    block.vtx.begin() + 1, block.vtx.end(),
+                    in.prevout.GetTxId(),
+                    [](const CTransactionRef &a, const TxId &txid) {
+                        return a->GetId() < txid;
+                    })};
+                if (in.prevout.GetN() < (*parent)->vout.size()) {
+                    continue;
+                }
+            } else if (view.HaveCoin(in.prevout)) {
+                continue;
+            }
+            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                                 "bad-txns-inputs-missingorspent");
+        }
+        fees += entries[i].fees;
+        sigChecks += entries[i].sigChecks;
+    }
+
+    if (sigChecks > nMaxGeneratedBlockSigChecks) {
+        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                             "bad-blk-sigchecks");
+    }
+    if (fees != nFees ||
+        block.vtx[0]->GetValueOut() >
+            fees + GetBlockSubsidy(nHeight, chainParams.GetConsensus())) {
+        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                             "bad-cb-amount");
+    }
+
+    return true;
+}
+
 /**
  * addTxs includes transactions paying a fee by ensuring that
  * the partial ordering of transactions is maintained.  That is to say
@@ -412,4 +545,222 @@ void BlockAssembler::addTxs(const CTxMemPool &mempool) {
         }
     }
 }
+
+std::optional<BlockTemplateSelection::Totals>
+BlockTemplateSelection::Get(const CBlockIndex *pindexPrev, const Limits &limits,
+                            std::vector<CBlockTemplateEntry> &entries) {
+    AssertLockHeld(m_mempool.cs);
+    LOCK(m_mutex);
+    if (m_tip.IsNull() || m_tip != pindexPrev->GetBlockHash() ||
+        !(m_limits == limits)) {
+        return std::nullopt;
+    }
+    // The additions are queued in acceptance order, so the parents are
+    // applied before their children.
+    for (const CTransactionRef &tx : m_added) {
+        ApplyAddedTx(tx);
+    }
+    m_added.clear();
+    if (m_missed_txs && GetTime<std::chrono::seconds>() >=
+                            m_last_rebuild +
+                                TEMPLATE_SELECTION_REBUILD_INTERVAL) {
+        return std::nullopt;
+    }
+
+    // The mempool notifications are processed asynchronously, so the
+    // selection may still contain transactions that already left the mempool.
+    const size_t first{entries.size()};
+    entries.reserve(first + m_entries.size());
+    for (const auto &[txid, selected] : m_entries) {
+        if (!m_mempool.exists(txid)) {
+            entries.erase(entries.begin() + first, entries.end());
+            return std::nullopt;
+        }
+        entries.push_back(selected.entry);
+    }
+    return m_totals;
+}
+
+void BlockTemplateSelection::Reset(
+    const CBlockIndex *pindexPrev, const Limits &limits,
+    const Consensus::Params &params, int height, int64_t lock_time_cutoff,
+    const std::vector<CBlockTemplateEntry> &entries, const Totals &totals) {
+    AssertLockHeld(m_mempool.cs);
+    LOCK(m_mutex);
+    m_entries.clear();
+    m_added.clear();
+    for (const CBlockTemplateEntry &entry : entries) {
+        // Skip the coinbase placeholder
+        if (!entry.tx) {
+            continue;
+        }
+        m_entries.emplace(entry.tx->GetId(),
+                          Entry{entry, entry.tx->GetTotalSize()});
+    }
+    m_totals = totals;
+    m_tip = pindexPrev->GetBlockHash();
+    m_limits = limits;
+    m_params = &params;
+    m_height = height;
+    m_lock_time_cutoff = lock_time_cutoff;
+    m_last_rebuild = GetTime<std::chrono::seconds>();
+    m_missed_txs = false;
+}
+
+void BlockTemplateSelection::Invalidate() {
+    LOCK(m_mutex);
+    m_tip.SetNull();
+    m_entries.clear();
+    m_added.clear();
+}
+
+void BlockTemplateSelection::UpdatedBlockTip(const CBlockIndex *pindexNew,
+                                             const CBlockIndex *pindexFork,
+                                             bool fInitialDownload) {
+    // The next template rebuilds the selection for the new tip
+    Invalidate();
+}
+
+void BlockTemplateSelection::TransactionAddedToMempool(
+    const CTransactionRef &tx,
+    std::shared_ptr<const std::vector<Coin>> spent_coins,
+    uint64_t mempool_sequence) {
+    // Don't take the mempool lock on every accepted transaction, the addition
+    // is applied by the next template.
+    LOCK(m_mutex);
+    if (m_tip.IsNull()) {
+        return;
+    }
+    m_added.push_back(tx);
+}
+
+void BlockTemplateSelection::ApplyAddedTx(const CTransactionRef &tx) {
+    AssertLockHeld(m_mempool.cs);
+    AssertLockHeld(m_mutex);
+    if (m_entries.count(tx->GetId())) {
+        return;
+    }
+
+    const auto it{m_mempool.GetIter(tx->GetId())};
+    if (!it) {
+        // Already gone
+        return;
+    }
+    const CTxMemPoolEntryRef &entry{**it};
+    if (entry->GetModifiedFeeRate() < m_limits.minFeeRate) {
+        // Would not be selected by a full rebuild either
+        return;
+    }
+
+    // Same checks as BlockAssembler::addTxs
+    for (const auto &parent : entry->GetMemPoolParentsConst()) {
+        if (!m_entries.count(parent.get()->GetTx().GetId())) {
+            m_missed_txs = true;
+            return;
+        }
+    }
+    if (m_totals.size + entry->GetTxSize() >= m_limits.maxSize ||
+        m_totals.sigChecks + entry->GetSigChecks() >= m_limits.maxSigChecks) {
+        m_missed_txs = true;
+        return;
+    }
+    TxValidationState state;
+    if (!ContextualCheckTransaction(*m_params, *tx, state, m_height,
+                                    m_lock_time_cutoff)) {
+        return;
+    }
+
+    m_entries.emplace(tx->GetId(),
+                      Entry{{entry->GetSharedTx(), entry->GetFee(),
+                             entry->GetSigChecks()},
+                            entry->GetTxSize()});
+    m_totals.size += entry->GetTxSize();
+    m_totals.sigChecks += entry->GetSigChecks();
+    ++m_totals.txCount;
+    m_totals.fees += entry->GetFee();
+}
+
+void BlockTemplateSelection::TransactionRemovedFromMempool(
+    const CTransactionRef &tx, MemPoolRemovalReason reason,
+    uint64_t mempool_sequence) {
+    LOCK(m_mutex);
+    const auto it{m_entries.find(tx->GetId())};
+    if (it == m_entries.end()) {
+        return;
+    }
+    // The in-mempool descendants are removed as well and get their own
+    // notification.
+    const Entry &removed{it->second};
+    m_totals.size -= removed.size;
+    m_totals.sigChecks -= removed.entry.sigChecks;
+    --m_totals.txCount;
+    m_totals.fees -= removed.entry.fees;
+    m_entries.erase(it);
+}
+
+bool TestBlockTemplateValidity(ChainstateManager &chainman,
+                               const CBlock &block,
+                               uint64_t max_generated_block_size) {
+    LOCK(::cs_main);
+    Chainstate &chainstate = chainman.ActiveChainstate();
+    CBlockIndex *pindexPrev = chainstate.m_chain.Tip();
+    if (!pindexPrev || block.hashPrevBlock != pindexPrev->GetBlockHash()) {
+        // The template is stale, there is nothing left to check.
+        return true;
+    }
+
+    BlockValidationState state;
+    if (!TestBlockValidity(state, chainman.GetParams(), chainstate, block,
+                           pindexPrev, GetAdjustedTime,
+                           BlockValidationOptions(max_generated_block_size)
+                               .withCheckPoW(false)
+                               .withCheckMerkleRoot(false))) {
+        LogPrintf("ERROR: %s: block template %s is invalid: %s\n", __func__,
+                  block.GetHash().ToString(), state.ToString());
+        return false;
+    }
+    return true;
+}
+
+TemplateValidityChecker::TemplateValidityChecker(ChainstateManager &chainman)
+    : m_chainman(chainman) {
+    m_thread =
+        std::thread(&util::TraceThread, "tmplcheck", [this] { Loop(); });
+}
+
+TemplateValidityChecker::~TemplateValidityChecker() {
+    WITH_LOCK(m_mutex, m_request_stop = true);
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+void TemplateValidityChecker::Schedule(uint64_t template_id,
+                                       const CBlock &block,
+                                       uint64_t max_generated_block_size) {
+    {
+        LOCK(m_mutex);
+        m_pending = Check{template_id, block, max_generated_block_size};
+    }
+    m_cond.notify_all();
+}
+
+void TemplateValidityChecker::Loop() {
+    while (true) {
+        std::optional<Check> check;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            while (!m_pending && !m_request_stop) {
+                m_cond.wait(lock);
+            }
+            if (m_request_stop) {
+                return;
+            }
+            check.swap(m_pending);
+        }
+        if (!TestBlockTemplateValidity(m_chainman, check->block,
+                                       check->max_generated_block_size)) {
+            m_invalid_template_id = check->template_id;
+        }
+    }
+}
 } // namespace node
@@ -9,17 +9,26 @@
 #include <consensus/amount.h>
 #include <kernel/mempool_entry.h>
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
+#include <validationinterface.h>
 
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index_container.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <optional>
+#include <thread>
 
+class BlockValidationState;
 class CBlockIndex;
 class CChainParams;
+class ChainstateManager;
 class Config;
 class CScript;
 
@@ -29,6 +38,11 @@ struct Params;
 
 namespace node {
 static const bool DEFAULT_PRINTPRIORITY = false;
+/**
+ * Minimum age of a block template selection that missed some transactions
+ * before it is rebuilt from the whole mempool
+ */
+static constexpr std::chrono::seconds TEMPLATE_SELECTION_REBUILD_INTERVAL{30};
 
 struct CBlockTemplateEntry {
     CTransactionRef tx;
@@ -43,6 +57,126 @@ struct CBlockTemplate {
     CBlock block;
 
     std::vector<CBlockTemplateEntry> entries;
+
+    /**
+     * Whether the block went through TestBlockValidity, as opposed to only
+     * the CheckTemplate consistency checks
+     */
+    bool fullyValidated{true};
+};
+
+/**
+ * Long-lived selection of mempool transactions for block templates.
+ *
+ * A full BlockAssembler run seeds the selection, which is then kept up to date
+ * from the mempool notifications: accepted transactions are queued and
+ * appended by the next template while they fit and all their in-mempool
+ * parents are selected, and removed transactions are dropped from it along
+ * with their size, sigchecks and fees.
+ * Templates on the same tip reuse the selection instead of walking the whole
+ * mempool again. If some transaction could not be appended (block full or
+ * parent not selected), the selection gets rebuilt at most every
+ * TEMPLATE_SELECTION_REBUILD_INTERVAL.
+ */
+class BlockTemplateSelection final : public CValidationInterface {
+public:
+    /** Limits the selection was made with */
+    struct Limits {
+        uint64_t maxSize;
+        uint64_t maxSigChecks;
+        CFeeRate minFeeRate;
+
+        bool operator==(const Limits &other) const {
+            return maxSize == other.maxSize &&
+                   maxSigChecks == other.maxSigChecks &&
+                   minFeeRate == other.minFeeRate;
+        }
+    };
+
+    /** Running totals of the block, including the coinbase reservation */
+    struct Totals {
+        uint64_t size;
+        uint64_t sigChecks;
+        uint64_t txCount;
+        Amount fees;
+    };
+
+    explicit BlockTemplateSelection(const CTxMemPool &mempool)
+        : m_mempool(mempool) {}
+
+    /**
+     * Append the selected entries, in CTOR order, to entries and return the
+     * totals if the selection is up to date for a template on top of
+     * pindexPrev with these limits.
+     */
+    std::optional<Totals> Get(const CBlockIndex *pindexPrev,
+                              const Limits &limits,
+                              std::vector<CBlockTemplateEntry> &entries)
+        EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs, !m_mutex);
+
+    /** Replace the selection with the result of a full BlockAssembler run */
+    void Reset(const CBlockIndex *pindexPrev, const Limits &limits,
+               const Consensus::Params &params, int height,
+               int64_t lock_time_cutoff,
+               const std::vector<CBlockTemplateEntry> &entries,
+               const Totals &totals)
+        EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs, !m_mutex);
+
+    /** Drop the selection, the next template rebuilds it */
+    void Invalidate() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Number of selected transactions, not counting the queued additions */
+    size_t size() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        LOCK(m_mutex);
+        return m_entries.size();
+    }
+
+protected:
+    // CValidationInterface
+    void UpdatedBlockTip(const CBlockIndex *pindexNew,
+                         const CBlockIndex *pindexFork,
+                         bool fInitialDownload) override
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void TransactionAddedToMempool(
+        const CTransactionRef &tx,
+        std::shared_ptr<const std::vector<Coin>> spent_coins,
+        uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void TransactionRemovedFromMempool(const CTransactionRef &tx,
+                                       MemPoolRemovalReason reason,
+                                       uint64_t mempool_sequence) override
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    const CTxMemPool &m_mempool;
+
+    mutable Mutex m_mutex;
+
+    struct Entry {
+        CBlockTemplateEntry entry;
+        uint64_t size;
+    };
+    /** Selected transactions, ordered by txid (CTOR) */
+    std::map<TxId, Entry> m_entries GUARDED_BY(m_mutex);
+    Totals m_totals GUARDED_BY(m_mutex);
+
+    /** Accepted transactions not yet appended to the selection */
+    std::vector<CTransactionRef> m_added GUARDED_BY(m_mutex);
+
+    /** Append an accepted transaction to the selection if it fits */
+    void ApplyAddedTx(const CTransactionRef &tx)
+        EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs, m_mutex);
+
+    /** Tip the selection was built on, or null if there is no selection */
+    BlockHash m_tip GUARDED_BY(m_mutex);
+    Limits m_limits GUARDED_BY(m_mutex);
+    const Consensus::Params *m_params GUARDED_BY(m_mutex){nullptr};
+    int m_height GUARDED_BY(m_mutex);
+    int64_t m_lock_time_cutoff GUARDED_BY(m_mutex);
+
+    /** When the selection was last rebuilt from the whole mempool */
+    std::chrono::seconds m_last_rebuild GUARDED_BY(m_mutex);
+    /** Whether a transaction could not be appended since the last rebuild */
+    bool m_missed_txs GUARDED_BY(m_mutex){false};
 };
 
 /** Generate a new block, without valid proof-of-work */
@@ -55,6 +189,7 @@ private:
     uint64_t nMaxGeneratedBlockSize;
     uint64_t nMaxGeneratedBlockSigChecks;
     CFeeRate blockMinFeeRate;
+    bool m_test_block_validity;
 
     // Information on the current status of the block
     uint64_t nBlockSize;
@@ -69,6 +204,7 @@ private:
 
     const CTxMemPool *const m_mempool;
     Chainstate &m_chainstate;
+    BlockTemplateSelection *const m_selection;
 
     const bool fPrintPriority;
 
@@ -78,12 +214,25 @@ public:
         uint64_t nExcessiveBlockSize;
         uint64_t nMaxGeneratedBlockSize;
         CFeeRate blockMinFeeRate;
+        /**
+         * Run TestBlockValidity on every template. When false, templates of
+         * mempool transactions only get the cheap CheckTemplate consistency
+         * checks, and the caller is expected to fully validate them later
+         * (see TestBlockTemplateValidity).
+         */
+        bool testBlockValidity{true};
     };
 
+    /**
+     * If a selection is given, it is used (and maintained) instead of
+     * selecting the transactions from the whole mempool for every template.
+     */
     BlockAssembler(const Config &config, Chainstate &chainstate,
-                   const CTxMemPool *mempool);
+                   const CTxMemPool *mempool,
+                   BlockTemplateSelection *selection = nullptr);
     BlockAssembler(Chainstate &chainstate, const CTxMemPool *mempool,
-                   const Options &options);
+                   const Options &options,
+                   BlockTemplateSelection *selection = nullptr);
 
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate>
@@ -113,6 +262,68 @@ private:
 
     /// Check the transaction for finality, etc before adding to block
     bool CheckTx(const CTransaction &tx) const;
+
+    /**
+     * Check the consistency of a template of already validated mempool
+     * transactions: block structure and limits, CTOR ordering, coinbase
+     * amount, fee and sigcheck totals, and that every input is either in the
+     * UTXO set or an output of another template transaction. Scripts are not
+     * checked.
+     */
+    bool CheckTemplate(const CBlock &block, const CBlockIndex *pindexPrev,
+                       BlockValidationState &state) const
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+};
+
+/** The BlockAssembler options from the configuration and -blockmaxsize etc */
+BlockAssembler::Options DefaultBlockAssemblerOptions(const Config &config);
+
+/**
+ * Fully validate a template built without TestBlockValidity, if it still
+ * builds on the active tip. Returns false and logs an error if it is invalid.
+ */
+bool TestBlockTemplateValidity(ChainstateManager &chainman,
+                               const CBlock &block,
+                               uint64_t max_generated_block_size)
+    EXCLUSIVE_LOCKS_REQUIRED(!cs_main);
+
+/**
+ * Runs TestBlockTemplateValidity on its own thread for the getblocktemplate
+ * templates built without TestBlockValidity, so the check neither delays the
+ * RPC reply nor the validation interface callbacks on the scheduler thread.
+ * At most one check is pending, a newer template replaces the one waiting to
+ * be checked.
+ */
+class TemplateValidityChecker {
+public:
+    explicit TemplateValidityChecker(ChainstateManager &chainman);
+    /** Stops the thread, dropping the pending check if any */
+    ~TemplateValidityChecker();
+
+    /** Queue the template with this (non zero) id for validation */
+    void Schedule(uint64_t template_id, const CBlock &block,
+                  uint64_t max_generated_block_size)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Id of the last template which failed its validation, 0 if none */
+    uint64_t LastInvalidTemplateId() const { return m_invalid_template_id; }
+
+private:
+    struct Check {
+        uint64_t template_id;
+        CBlock block;
+        uint64_t max_generated_block_size;
+    };
+
+    ChainstateManager &m_chainman;
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::optional<Check> m_pending GUARDED_BY(m_mutex);
+    bool m_request_stop GUARDED_BY(m_mutex){false};
+    std::atomic<uint64_t> m_invalid_template_id{0};
+    std::thread m_thread;
+
+    void Loop() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex, !::cs_main);
 };
 
 int64_t UpdateTime(CBlockHeader *pblock, const CChainParams &chainParams,
@@ -51,6 +51,10 @@ TransactionError BroadcastTransaction(const NodeContext &node,
     TxId txid = tx->GetId();
     bool callback_set = false;
 
+    // Verify the scripts before taking cs_main, so the mempool admission
+    // below doesn't hold it while checking the signatures
+    node.chainman->PreCheckTransactionScripts({tx});
+
     {
         LOCK(cs_main);
 
@@ -96,3 +96,29 @@ bool IsChildWithParents(const Package &package) {
                            return input_txids.count(ptx->GetId()) > 0;
                        });
 }
+
+bool IsAncestorPackage(const Package &package) {
+    assert(std::all_of(package.cbegin(), package.cend(),
+                       [](const auto &tx) { return tx != nullptr; }));
+    if (package.size() < 2) {
+        return false;
+    }
+
+    // Walk the package backwards from the child: every transaction must be
+    // spent by the child or by one of the transactions already walked.
+    std::unordered_set<TxId, SaltedTxIdHasher> ancestor_txids;
+    const auto add_parents = [&ancestor_txids](const auto &tx) {
+        std::transform(
+            tx->vin.cbegin(), tx->vin.cend(),
+            std::inserter(ancestor_txids, ancestor_txids.end()),
+            [](const auto &input) { return input.prevout.GetTxId(); });
+    };
+    add_parents(package.back());
+    for (auto it = package.crbegin() + 1; it != package.crend(); ++it) {
+        if (ancestor_txids.count((*it)->GetId()) == 0) {
+            return false;
+        }
+        add_parents(*it);
+    }
+    return true;
+}
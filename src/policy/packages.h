@@ -59,4 +59,14 @@ bool CheckPackage(const Package &txns, PackageValidationState &state);
  */
 bool IsChildWithParents(const Package &package);
 
+/**
+ * Context-free check that a package is exactly one child and some of its
+ * ancestors, i.e. every other transaction of the package is spent by the child
+ * or by another transaction of the package that is itself an ancestor. Unlike
+ * IsChildWithParents(), the ancestors can be several generations deep.
+ * It is expected to be sorted, which means the last transaction must be the
+ * child.
+ */
+bool IsAncestorPackage(const Package &package);
+
 #endif // BITCOIN_POLICY_PACKAGES_H
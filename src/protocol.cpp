@@ -47,6 +47,9 @@ const char *GETCFHEADERS = "getcfheaders";
 const char *CFHEADERS = "cfheaders";
 const char *GETCFCHECKPT = "getcfcheckpt";
 const char *CFCHECKPT = "cfcheckpt";
+const char *SENDPACKAGES = "sendpackages";
+const char *GETPKGTXNS = "getpkgtxns";
+const char *PKGTXNS = "pkgtxns";
 const char *AVAHELLO = "avahello";
 const char *AVAPOLL = "avapoll";
 const char *AVARESPONSE = "avaresponse";
@@ -79,6 +82,7 @@ static const std::string allNetMessageTypes[] = {
     NetMsgType::CMPCTBLOCK,  NetMsgType::GETBLOCKTXN,  NetMsgType::BLOCKTXN,
     NetMsgType::GETCFILTERS, NetMsgType::CFILTER,      NetMsgType::GETCFHEADERS,
     NetMsgType::CFHEADERS,   NetMsgType::GETCFCHECKPT, NetMsgType::CFCHECKPT,
+    NetMsgType::SENDPACKAGES, NetMsgType::GETPKGTXNS,  NetMsgType::PKGTXNS,
 };
 static const std::vector<std::string>
     allNetMessageTypesVec(std::begin(allNetMessageTypes),
@@ -273,6 +273,23 @@ extern const char *GETCFCHECKPT;
  * evenly spaced filter headers for blocks on the requested chain.
  */
 extern const char *CFCHECKPT;
+/**
+ * The sendpackages message signals that the node supports the getpkgtxns and
+ * pkgtxns messages. It is sent after the verack message.
+ */
+extern const char *SENDPACKAGES;
+/**
+ * The getpkgtxns message requests a transaction together with its unconfirmed
+ * ancestors, typically when the transaction is an orphan for the requester.
+ * Peer should respond with a "pkgtxns" message, or a "notfound" message for
+ * the transaction.
+ */
+extern const char *GETPKGTXNS;
+/**
+ * The pkgtxns message contains a transaction preceded by its unconfirmed
+ * ancestors in topological order, which are validated as a package.
+ */
+extern const char *PKGTXNS;
 /**
  * Contains a delegation and a signature.
  */
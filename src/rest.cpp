@@ -11,6 +11,7 @@
 #include <index/txindex.h>
 #include <node/blockstorage.h>
 #include <node/context.h>
+#include <node/eventstream.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <rpc/blockchain.h>
@@ -21,6 +22,8 @@
 #include <streams.h>
 #include <sync.h>
 #include <txmempool.h>
+#include <util/strencodings.h>
+#include <util/string.h>
 #include <util/system.h>
 #include <validation.h>
 #include <version.h>
@@ -28,6 +31,7 @@
 #include <univalue.h>
 
 #include <any>
+#include <memory>
 
 using node::GetTransaction;
 using node::NodeContext;
@@ -35,6 +39,10 @@ using node::ReadBlockFromDisk;
 
 // Allow a max of 15 outpoints to be queried at once.
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15;
+// Allow a max of 1000 events to be returned at once.
+static const size_t MAX_REST_EVENTS = 1000;
+
+static std::shared_ptr<node::EventStream> g_event_stream;
 
 enum class RetFormat {
     UNDEF,
@@ -74,6 +82,34 @@ static bool RESTERR(HTTPRequest *req, enum HTTPStatusCode status,
     return false;
 }
 
+/**
+ * Send the JSON written by write_json, as a chunked reply if it gets large so
+ * that it never needs to be held in memory as a whole.
+ */
+static bool WriteJSONReply(
+    HTTPRequest *req,
+    const std::function<void(UniValueWriter &writer)> &write_json) {
+    bool started{false};
+    UniValueWriter writer{[req, &started](const std::string &chunk) {
+        if (!started) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartReply(HTTP_OK);
+            started = true;
+        }
+        req->WriteReplyChunk(chunk);
+    }};
+    write_json(writer);
+    if (!started) {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, writer.release() + "\n");
+        return true;
+    }
+    writer.flush();
+    req->WriteReplyChunk("\n");
+    req->EndReply();
+    return true;
+}
+
 /**
  * Get the node context.
  *
@@ -340,12 +376,10 @@ static bool rest_block(const Config &config, const std::any &context,
         }
 
         case RetFormat::JSON: {
-            UniValue objBlock = blockToJSON(chainman.m_blockman, block, tip,
-                                            pblockindex, showTxDetails);
-            std::string strJSON = objBlock.write() + "\n";
-            req->WriteHeader("Content-Type", "application/json");
-            req->WriteReply(HTTP_OK, strJSON);
-            return true;
+            return WriteJSONReply(req, [&](UniValueWriter &writer) {
+                blockToJSON(chainman.m_blockman, block, tip, pblockindex,
+                            showTxDetails, writer);
+            });
         }
 
         default: {
@@ -442,17 +476,26 @@ static bool rest_mempool_contents(Config &config, const std::any &context,
     const RetFormat rf = ParseDataFormat(param, strURIPart);
 
     switch (rf) {
-        case RetFormat::JSON: {
-            UniValue mempoolObject = MempoolToJSON(*mempool, true);
-
-            std::string strJSON = mempoolObject.write() + "\n";
-            req->WriteHeader("Content-Type", "application/json");
-            req->WriteReply(HTTP_OK, strJSON);
+        case RetFormat::BINARY: {
+            const std::vector<uint8_t> data{MempoolToBinary(*mempool)};
+            req->WriteHeader("Content-Type", "application/octet-stream");
+            req->WriteReply(HTTP_OK, std::string(data.begin(), data.end()));
             return true;
         }
+        case RetFormat::HEX: {
+            req->WriteHeader("Content-Type", "text/plain");
+            req->WriteReply(HTTP_OK, HexStr(MempoolToBinary(*mempool)) + "\n");
+            return true;
+        }
+        case RetFormat::JSON: {
+            return WriteJSONReply(req, [&](UniValueWriter &writer) {
+                MempoolToJSON(*mempool, writer);
+            });
+        }
         default: {
             return RESTERR(req, HTTP_NOT_FOUND,
-                           "output format not found (available: json)");
+                           "output format not found (available: " +
+                               AvailableDataFormatsString() + ")");
         }
     }
 }
@@ -815,6 +858,53 @@ static bool rest_blockhash_by_height(Config &config, const std::any &context,
     }
 }
 
+static bool rest_events(node::EventStream &stream, HTTPRequest *req,
+                        const std::string &strURIPart) {
+    if (!CheckWarmup(req)) {
+        return false;
+    }
+
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path = SplitString(param, '/');
+
+    if (path.empty() || path.size() > 2) {
+        return RESTERR(req, HTTP_BAD_REQUEST,
+                       "Invalid URI format. Use "
+                       "/rest/events/<start>[/<wait>].json.");
+    }
+    uint64_t start;
+    if (!ParseUInt64(path[0], &start)) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid start: " + path[0]);
+    }
+    uint32_t wait{0};
+    if (path.size() == 2 && !ParseUInt32(path[1], &wait)) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid wait: " + path[1]);
+    }
+
+    switch (rf) {
+        case RetFormat::JSON: {
+            const node::EventStream::Events events{stream.GetEvents(
+                start, MAX_REST_EVENTS,
+                std::min<std::chrono::milliseconds>(
+                    std::chrono::seconds{wait}, node::MAX_EVENT_WAIT))};
+            // The events are already serialized
+            const std::string strJSON{strprintf(
+                "{\"stream\":\"%s\",\"start\":%d,\"next\":%d,"
+                "\"missed\":%d,\"events\":[%s]}\n",
+                events.stream, events.start, events.next, events.missed,
+                Join(events.events, ","))};
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReply(HTTP_OK, strJSON);
+            return true;
+        }
+        default: {
+            return RESTERR(req, HTTP_NOT_FOUND,
+                           "output format not found (available: json)");
+        }
+    }
+}
+
 static const struct {
     const char *prefix;
     bool (*handler)(Config &config, const std::any &context, HTTPRequest *req,
@@ -839,12 +929,40 @@ void StartREST(const std::any &context) {
         };
         RegisterHTTPHandler(up.prefix, false, handler);
     }
+
+    const int64_t event_buffer{gArgs.GetIntArg(
+        "-resteventbuffer", int64_t(node::DEFAULT_REST_EVENT_BUFFER))};
+    if (event_buffer > 0) {
+        // At most half of the HTTP worker threads wait for events, so that
+        // the long polls don't starve the other REST and RPC requests
+        const int64_t rpc_threads{std::max<int64_t>(
+            gArgs.GetIntArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1)};
+        g_event_stream =
+            std::make_shared<node::EventStream>(event_buffer, rpc_threads / 2);
+        RegisterSharedValidationInterface(g_event_stream);
+        // The handler keeps the stream alive for the requests in flight
+        RegisterHTTPHandler("/rest/events/", false,
+                            [stream = g_event_stream](
+                                Config &config, HTTPRequest *req,
+                                const std::string &prefix) {
+                                return rest_events(*stream, req, prefix);
+                            });
+    }
 }
 
-void InterruptREST() {}
+void InterruptREST() {
+    if (g_event_stream) {
+        g_event_stream->Interrupt();
+    }
+}
 
 void StopREST() {
     for (const auto &up : uri_prefixes) {
         UnregisterHTTPHandler(up.prefix, false);
     }
+    if (g_event_stream) {
+        UnregisterHTTPHandler("/rest/events/", false);
+        UnregisterSharedValidationInterface(g_event_stream);
+        g_event_stream.reset();
+    }
 }
@@ -162,13 +162,14 @@ UniValue blockheaderToJSON(const CBlockIndex *tip,
     return result;
 }
 
-UniValue blockToJSON(BlockManager &blockman, const CBlock &block,
-                     const CBlockIndex *tip, const CBlockIndex *blockindex,
-                     bool txDetails) {
-    UniValue result = blockheaderToJSON(tip, blockindex);
-
-    result.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
-    UniValue txs(UniValue::VARR);
+/**
+ * Call fn with the description of each transaction of the block, as found in
+ * the "tx" array of blockToJSON.
+ */
+template <typename Fn>
+static void ForEachTxToJSON(BlockManager &blockman, const CBlock &block,
+                            const CBlockIndex *blockindex, bool txDetails,
+                            Fn &&fn) {
     if (txDetails) {
         CBlockUndo blockUndo;
         const bool is_not_pruned{
@@ -183,18 +184,44 @@ UniValue blockToJSON(BlockManager &blockman, const CBlock &block,
             UniValue objTx(UniValue::VOBJ);
             TxToUniv(*tx, BlockHash(), objTx, true, RPCSerializationFlags(),
                      txundo);
-            txs.push_back(objTx);
+            fn(objTx);
         }
     } else {
         for (const CTransactionRef &tx : block.vtx) {
-            txs.push_back(tx->GetId().GetHex());
+            fn(tx->GetId().GetHex());
         }
     }
+}
+
+UniValue blockToJSON(BlockManager &blockman, const CBlock &block,
+                     const CBlockIndex *tip, const CBlockIndex *blockindex,
+                     bool txDetails) {
+    UniValue result = blockheaderToJSON(tip, blockindex);
+
+    result.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
+    UniValue txs(UniValue::VARR);
+    ForEachTxToJSON(blockman, block, blockindex, txDetails,
+                    [&](const UniValue &tx) { txs.push_back(tx); });
     result.pushKV("tx", txs);
 
     return result;
 }
 
+void blockToJSON(BlockManager &blockman, const CBlock &block,
+                 const CBlockIndex *tip, const CBlockIndex *blockindex,
+                 bool txDetails, UniValueWriter &writer) {
+    writer.beginObject();
+    writer.pushKVs(blockheaderToJSON(tip, blockindex));
+    writer.key("size");
+    writer.value((int)::GetSerializeSize(block, PROTOCOL_VERSION));
+    writer.key("tx");
+    writer.beginArray();
+    ForEachTxToJSON(blockman, block, blockindex, txDetails,
+                    [&](const UniValue &tx) { writer.value(tx); });
+    writer.endArray();
+    writer.endObject();
+}
+
 static RPCHelpMan getblockcount() {
     return RPCHelpMan{
         "getblockcount",
@@ -621,6 +648,18 @@ static RPCHelpMan getblockheader() {
                                    "Block not found");
             }
 
+            if (request.resultBinary) {
+                const CBlockIndex *pnext;
+                const int confirmations{
+                    ComputeNextBlockAndDepth(tip, pblockindex, pnext)};
+                CVectorWriter{SER_NETWORK, PROTOCOL_VERSION,
+                              *request.resultBinary, 0}
+                    << RPC_BINARY_VERSION << pblockindex->GetBlockHash()
+                    << int32_t(pblockindex->nHeight) << int32_t(confirmations)
+                    << pblockindex->GetBlockHeader();
+                return NullUniValue;
+            }
+
             if (!fVerbose) {
                 CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
                 ssBlock << pblockindex->GetBlockHeader();
@@ -799,6 +838,21 @@ static RPCHelpMan getblock() {
             const CBlock block =
                 GetBlockChecked(config, chainman.m_blockman, pblockindex);
 
+            if (request.resultBinary) {
+                const CBlockIndex *pnext;
+                const int confirmations{
+                    ComputeNextBlockAndDepth(tip, pblockindex, pnext)};
+                CVectorWriter writer{SER_NETWORK, PROTOCOL_VERSION,
+                                     *request.resultBinary, 0};
+                writer << RPC_BINARY_VERSION << pblockindex->GetBlockHash()
+                       << int32_t(pblockindex->nHeight)
+                       << int32_t(confirmations);
+                WriteCompactSize(writer,
+                                 GetSerializeSize(block, PROTOCOL_VERSION));
+                writer << block;
+                return NullUniValue;
+            }
+
             if (verbosity <= 0) {
                 CDataStream ssBlock(SER_NETWORK,
                                     PROTOCOL_VERSION | RPCSerializationFlags());
@@ -807,6 +861,12 @@ static RPCHelpMan getblock() {
                 return strHex;
             }
 
+            if (request.resultWriter) {
+                // Stream the description of potentially large blocks
+                blockToJSON(chainman.m_blockman, block, tip, pblockindex,
+                            verbosity >= 2, *request.resultWriter);
+                return NullUniValue;
+            }
             return blockToJSON(chainman.m_blockman, block, tip, pblockindex,
                                verbosity >= 2);
         },
@@ -1140,6 +1200,15 @@ static RPCHelpMan gettxoutsetinfo() {
     };
 }
 
+/** The result of gettxout for an output that is not found */
+static UniValue TxOutNotFound(const JSONRPCRequest &request) {
+    if (request.resultBinary) {
+        CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, *request.resultBinary, 0}
+            << RPC_BINARY_VERSION << false;
+    }
+    return NullUniValue;
+}
+
 RPCHelpMan gettxout() {
     return RPCHelpMan{
         "gettxout",
@@ -1215,17 +1284,28 @@ RPCHelpMan gettxout() {
                 LOCK(mempool.cs);
                 CCoinsViewMemPool view(coins_view, mempool);
                 if (!view.GetCoin(out, coin) || mempool.isSpent(out)) {
-                    return NullUniValue;
+                    return TxOutNotFound(request);
                 }
             } else {
                 if (!coins_view->GetCoin(out, coin)) {
-                    return NullUniValue;
+                    return TxOutNotFound(request);
                 }
             }
 
             const CBlockIndex *pindex =
                 active_chainstate.m_blockman.LookupBlockIndex(
                     coins_view->GetBestBlock());
+            if (request.resultBinary) {
+                const int32_t confirmations{
+                    coin.GetHeight() == MEMPOOL_HEIGHT
+                        ? 0
+                        : int32_t(pindex->nHeight - coin.GetHeight() + 1)};
+                CVectorWriter{SER_NETWORK, PROTOCOL_VERSION,
+                              *request.resultBinary, 0}
+                    << RPC_BINARY_VERSION << true << pindex->GetBlockHash()
+                    << confirmations << coin.GetTxOut() << coin.IsCoinBase();
+                return NullUniValue;
+            }
             ret.pushKV("bestblock", pindex->GetBlockHash().GetHex());
             if (coin.GetHeight() == MEMPOOL_HEIGHT) {
                 ret.pushKV("confirmations", 0);
@@ -2714,26 +2794,26 @@ UniValue CreateUTXOSnapshot(NodeContext &node, Chainstate &chainstate,
 void RegisterBlockchainRPCCommands(CRPCTable &t) {
     // clang-format off
     static const CRPCCommand commands[] = {
-        //  category            actor (function)
-        //  ------------------  ----------------------
-        { "blockchain",         getbestblockhash,                  },
-        { "blockchain",         getblock,                          },
+        //  category            actor (function)                   concurrent
+        //  ------------------  ---------------------------------  ----------
+        { "blockchain",         getbestblockhash,                  true },
+        { "blockchain",         getblock,                          true },
         { "blockchain",         getblockfrompeer,                  },
         { "blockchain",         getblockchaininfo,                 },
-        { "blockchain",         getblockcount,                     },
-        { "blockchain",         getblockhash,                      },
-        { "blockchain",         getblockheader,                    },
-        { "blockchain",         getblockstats,                     },
-        { "blockchain",         getchaintips,                      },
-        { "blockchain",         getchaintxstats,                   },
-        { "blockchain",         getdifficulty,                     },
-        { "blockchain",         gettxout,                          },
+        { "blockchain",         getblockcount,                     true },
+        { "blockchain",         getblockhash,                      true },
+        { "blockchain",         getblockheader,                    true },
+        { "blockchain",         getblockstats,                     true },
+        { "blockchain",         getchaintips,                      true },
+        { "blockchain",         getchaintxstats,                   true },
+        { "blockchain",         getdifficulty,                     true },
+        { "blockchain",         gettxout,                          true },
         { "blockchain",         gettxoutsetinfo,                   },
         { "blockchain",         pruneblockchain,                   },
         { "blockchain",         verifychain,                       },
         { "blockchain",         preciousblock,                     },
         { "blockchain",         scantxoutset,                      },
-        { "blockchain",         getblockfilter,                    },
+        { "blockchain",         getblockfilter,                    true },
 
         /* Not shown in help */
         { "hidden",             invalidateblock,                   },
@@ -40,6 +40,15 @@ UniValue blockToJSON(node::BlockManager &blockman, const CBlock &block,
                      const CBlockIndex *tip, const CBlockIndex *blockindex,
                      bool txDetails = false) LOCKS_EXCLUDED(cs_main);
 
+/**
+ * Block description to JSON, written to a streaming writer so that the
+ * description of a large block is never held in memory as a whole
+ */
+void blockToJSON(node::BlockManager &blockman, const CBlock &block,
+                 const CBlockIndex *tip, const CBlockIndex *blockindex,
+                 bool txDetails, UniValueWriter &writer)
+    LOCKS_EXCLUDED(cs_main);
+
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex *tip,
                            const CBlockIndex *blockindex)
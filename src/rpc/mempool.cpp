@@ -3,6 +3,8 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <rpc/mempool.h>
+
 #include <kernel/mempool_entry.h>
 #include <kernel/mempool_persist.h>
 
@@ -15,6 +17,7 @@
 #include <rpc/server.h>
 #include <rpc/server_util.h>
 #include <rpc/util.h>
+#include <streams.h>
 #include <txmempool.h>
 #include <univalue.h>
 #include <validation.h>
@@ -91,9 +94,16 @@ static void entryToJSON(const CTxMemPool &pool, UniValue &info,
 
     info.pushKV("depends", depends);
 
-    UniValue spent(UniValue::VARR);
+    // The children are unordered, list them by txid
+    std::vector<TxId> spentby;
     for (const auto &child : e->GetMemPoolChildrenConst()) {
-        spent.push_back(child.get()->GetTx().GetId().ToString());
+        spentby.push_back(child.get()->GetTx().GetId());
+    }
+    std::sort(spentby.begin(), spentby.end());
+
+    UniValue spent(UniValue::VARR);
+    for (const TxId &child : spentby) {
+        spent.push_back(child.ToString());
     }
 
     info.pushKV("spentby", spent);
@@ -144,6 +154,78 @@ UniValue MempoolToJSON(const CTxMemPool &pool, bool verbose,
     }
 }
 
+/**
+ * Number of entries serialized at a time by the streaming MempoolToJSON,
+ * before the mempool lock is released to write them out
+ */
+static constexpr size_t MEMPOOL_JSON_BATCH_SIZE{1000};
+
+void MempoolToJSON(const CTxMemPool &pool, UniValueWriter &writer) {
+    // Writing to the client may block, so the mempool lock is only held while
+    // a batch of entries is serialized. Transactions removed in the meantime
+    // are skipped.
+    std::vector<TxId> txids;
+    pool.getAllTxIds(txids);
+    writer.beginObject();
+    std::vector<std::pair<TxId, UniValue>> batch;
+    for (size_t start = 0; start < txids.size();
+         start += MEMPOOL_JSON_BATCH_SIZE) {
+        const size_t end{
+            std::min(txids.size(), start + MEMPOOL_JSON_BATCH_SIZE)};
+        batch.clear();
+        {
+            LOCK(pool.cs);
+            for (size_t i = start; i < end; ++i) {
+                const auto it{pool.GetIter(txids[i])};
+                if (!it) {
+                    continue;
+                }
+                UniValue info(UniValue::VOBJ);
+                entryToJSON(pool, info, **it);
+                batch.emplace_back(txids[i], std::move(info));
+            }
+        }
+        for (const auto &[txid, info] : batch) {
+            writer.key(txid.ToString());
+            writer.value(info);
+        }
+    }
+    writer.endObject();
+}
+
+std::vector<uint8_t> MempoolToBinary(const CTxMemPool &pool) {
+    std::vector<uint8_t> data;
+    CVectorWriter writer(SER_NETWORK, PROTOCOL_VERSION, data, 0);
+    LOCK(pool.cs);
+    writer << MEMPOOL_BINARY_VERSION << pool.GetSequence();
+    WriteCompactSize(writer, pool.mapTx.size());
+
+    std::vector<uint8_t> record;
+    for (const CTxMemPoolEntryRef &e : pool.mapTx) {
+        const CTransaction &tx = e->GetTx();
+        std::set<TxId> depends;
+        for (const CTxIn &txin : tx.vin) {
+            if (pool.exists(txin.prevout.GetTxId())) {
+                depends.insert(txin.prevout.GetTxId());
+            }
+        }
+        std::vector<TxId> spentby;
+        for (const auto &child : e->GetMemPoolChildrenConst()) {
+            spentby.push_back(child.get()->GetTx().GetId());
+        }
+        std::sort(spentby.begin(), spentby.end());
+
+        record.clear();
+        CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, record, 0}
+            << tx.GetId() << e->GetFee() << e->GetModifiedFee()
+            << uint32_t(e->GetTxSize()) << int64_t(count_seconds(e->GetTime()))
+            << uint32_t(e->GetHeight()) << depends << spentby
+            << pool.IsUnbroadcastTx(tx.GetId());
+        writer << record;
+    }
+    return data;
+}
+
 RPCHelpMan getrawmempool() {
     return RPCHelpMan{
         "getrawmempool",
@@ -204,8 +286,31 @@ RPCHelpMan getrawmempool() {
                 include_mempool_sequence = request.params[1].get_bool();
             }
 
-            return MempoolToJSON(EnsureAnyMemPool(request.context), fVerbose,
-                                 include_mempool_sequence);
+            const CTxMemPool &mempool = EnsureAnyMemPool(request.context);
+            if (request.resultBinary) {
+                if (fVerbose) {
+                    *request.resultBinary = MempoolToBinary(mempool);
+                    return NullUniValue;
+                }
+                std::vector<TxId> txids;
+                uint64_t mempool_sequence;
+                {
+                    LOCK(mempool.cs);
+                    mempool.getAllTxIds(txids);
+                    mempool_sequence = mempool.GetSequence();
+                }
+                CVectorWriter{SER_NETWORK, PROTOCOL_VERSION,
+                              *request.resultBinary, 0}
+                    << RPC_BINARY_VERSION << mempool_sequence << txids;
+                return NullUniValue;
+            }
+            if (fVerbose && !include_mempool_sequence &&
+                request.resultWriter) {
+                // Stream the potentially large verbose result
+                MempoolToJSON(mempool, *request.resultWriter);
+                return NullUniValue;
+            }
+            return MempoolToJSON(mempool, fVerbose, include_mempool_sequence);
         },
     };
 }
@@ -401,6 +506,29 @@ UniValue MempoolInfoToJSON(const CTxMemPool &pool) {
         std::max(pool.GetMinFee(), pool.m_min_relay_feerate).GetFeePerK());
     ret.pushKV("minrelaytxfee", pool.m_min_relay_feerate.GetFeePerK());
     ret.pushKV("unbroadcastcount", uint64_t{pool.GetUnbroadcastTxs().size()});
+
+    // Non empty buckets, highest feerate first
+    UniValue fee_histogram(UniValue::VARR);
+    const std::vector<FeeRateBucket> &buckets =
+        pool.GetFeeRateHistogram().GetBuckets();
+    for (size_t i = buckets.size(); i-- > 0;) {
+        const FeeRateBucket &bucket = buckets[i];
+        if (bucket.count == 0) {
+            continue;
+        }
+
+        UniValue bucket_info(UniValue::VOBJ);
+        bucket_info.pushKV("min_feerate", bucket.min_feerate.GetFeePerK());
+        if (i + 1 < buckets.size()) {
+            bucket_info.pushKV("max_feerate",
+                               buckets[i + 1].min_feerate.GetFeePerK());
+        }
+        bucket_info.pushKV("count", bucket.count);
+        bucket_info.pushKV("size", bucket.size);
+        bucket_info.pushKV("sigchecks", bucket.sigchecks);
+        fee_histogram.push_back(std::move(bucket_info));
+    }
+    ret.pushKV("fee_histogram", std::move(fee_histogram));
     return ret;
 }
 
@@ -435,6 +563,32 @@ RPCHelpMan getmempoolinfo() {
                 {RPCResult::Type::NUM, "unbroadcastcount",
                  "Current number of transactions that haven't passed initial "
                  "broadcast yet"},
+                {RPCResult::Type::ARR,
+                 "fee_histogram",
+                 "The mempool transactions grouped by modified fee rate, "
+                 "highest fee rate first. Only the non empty fee rate ranges "
+                 "are listed",
+                 {
+                     {RPCResult::Type::OBJ,
+                      "",
+                      "",
+                      {
+                          {RPCResult::Type::STR_AMOUNT, "min_feerate",
+                           "Lowest fee rate of the range in " + ticker +
+                               "/kB, inclusive"},
+                          {RPCResult::Type::STR_AMOUNT, "max_feerate",
+                           /* optional */ true,
+                           "Highest fee rate of the range in " + ticker +
+                               "/kB, exclusive. Omitted for the highest "
+                               "range"},
+                          {RPCResult::Type::NUM, "count",
+                           "Number of transactions"},
+                          {RPCResult::Type::NUM, "size",
+                           "Sum of the transaction sizes"},
+                          {RPCResult::Type::NUM, "sigchecks",
+                           "Sum of the transaction sigchecks"},
+                      }},
+                 }},
             }},
         RPCExamples{HelpExampleCli("getmempoolinfo", "") +
                     HelpExampleRpc("getmempoolinfo", "")},
@@ -487,13 +641,13 @@ RPCHelpMan savemempool() {
 
 void RegisterMempoolRPCCommands(CRPCTable &t) {
     static const CRPCCommand commands[]{
-        // category     actor (function)
-        // --------     ----------------
-        {"blockchain", getmempoolancestors},
-        {"blockchain", getmempooldescendants},
-        {"blockchain", getmempoolentry},
-        {"blockchain", getmempoolinfo},
-        {"blockchain", getrawmempool},
+        // category     actor (function)     concurrent
+        // --------     ----------------     ----------
+        {"blockchain", getmempoolancestors, true},
+        {"blockchain", getmempooldescendants, true},
+        {"blockchain", getmempoolentry, true},
+        {"blockchain", getmempoolinfo, true},
+        {"blockchain", getrawmempool, true},
         {"blockchain", savemempool},
     };
     for (const auto &c : commands) {
@@ -5,8 +5,12 @@
 #ifndef BITCOIN_RPC_MEMPOOL_H
 #define BITCOIN_RPC_MEMPOOL_H
 
+#include <cstdint>
+#include <vector>
+
 class CTxMemPool;
 class UniValue;
+class UniValueWriter;
 
 /** Mempool information to JSON */
 UniValue MempoolInfoToJSON(const CTxMemPool &pool);
@@ -15,4 +19,21 @@ UniValue MempoolInfoToJSON(const CTxMemPool &pool);
 UniValue MempoolToJSON(const CTxMemPool &pool, bool verbose = false,
                        bool include_mempool_sequence = false);
 
+/** Verbose mempool to JSON, written to a streaming writer */
+void MempoolToJSON(const CTxMemPool &pool, UniValueWriter &writer);
+
+/** Version of the binary mempool contents format, see MempoolToBinary */
+static constexpr uint8_t MEMPOOL_BINARY_VERSION{1};
+
+/**
+ * Verbose mempool contents in a compact binary format: the format version,
+ * the mempool sequence (uint64), then the number of entries followed by
+ * each entry as a length prefixed record. Version 1 records hold the txid,
+ * base and modified fees, size (uint32), time (int64 seconds), height
+ * (uint32), the in-mempool parents and children txids and the unbroadcast
+ * flag. Later versions only append fields to the records, so that older
+ * readers can skip them.
+ */
+std::vector<uint8_t> MempoolToBinary(const CTxMemPool &pool);
+
 #endif // BITCOIN_RPC_MEMPOOL_H
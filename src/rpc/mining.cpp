@@ -960,7 +960,16 @@ static RPCHelpMan getblocktemplate() {
             static CBlockIndex *pindexPrev;
             static int64_t nStart;
             static std::unique_ptr<CBlockTemplate> pblocktemplate;
-            if (pindexPrev != active_chain.Tip() ||
+            static uint64_t template_id{0};
+            // The cached template failed its full validation in the
+            // background, build and fully validate a new one from scratch.
+            const bool template_invalid{
+                pblocktemplate && node.template_checker &&
+                node.template_checker->LastInvalidTemplateId() == template_id};
+            if (template_invalid && node.block_template_selection) {
+                node.block_template_selection->Invalidate();
+            }
+            if (pindexPrev != active_chain.Tip() || template_invalid ||
                 (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast &&
                  GetTime() - nStart > 5)) {
                 // Clear pindexPrev so future calls make a new block, despite
@@ -975,12 +984,26 @@ static RPCHelpMan getblocktemplate() {
 
                 // Create new block
                 CScript scriptDummy = CScript() << OP_TRUE;
+                // The mempool transactions were already validated, so the
+                // template only gets consistency checks here and the full
+                // TestBlockValidity runs in the background.
+                BlockAssembler::Options options{
+                    node::DefaultBlockAssemblerOptions(config)};
+                options.testBlockValidity =
+                    !node.template_checker || template_invalid;
                 pblocktemplate =
-                    BlockAssembler{config, active_chainstate, &mempool}
+                    BlockAssembler{active_chainstate, &mempool, options,
+                                   node.block_template_selection.get()}
                         .CreateNewBlock(scriptDummy);
                 if (!pblocktemplate) {
                     throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
                 }
+                ++template_id;
+                if (!pblocktemplate->fullyValidated) {
+                    node.template_checker->Schedule(
+                        template_id, pblocktemplate->block,
+                        options.nMaxGeneratedBlockSize);
+                }
 
                 // Need to update only after we know CreateNewBlock succeeded
                 pindexPrev = pindexPrevNew;
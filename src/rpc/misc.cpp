@@ -931,11 +931,11 @@ static RPCHelpMan gettime() {
 void RegisterMiscRPCCommands(CRPCTable &t) {
     // clang-format off
     static const CRPCCommand commands[] = {
-        //  category            actor (function)
-        //  ------------------  ----------------------
+        //  category            actor (function)         concurrent
+        //  ------------------  -----------------------  ----------
         { "control",            getmemoryinfo,           },
         { "control",            logging,                 },
-        { "util",               validateaddress,         },
+        { "util",               validateaddress,         true },
         { "util",               createmultisig,          },
         { "util",               deriveaddresses,         },
         { "util",               getdescriptorinfo,       },
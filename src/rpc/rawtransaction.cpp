@@ -31,6 +31,7 @@
 #include <script/sign.h>
 #include <script/signingprovider.h>
 #include <script/standard.h>
+#include <streams.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util/bip32.h>
@@ -273,6 +274,15 @@ static RPCHelpMan getrawtransaction() {
                     errmsg + ". Use gettransaction for wallet transactions.");
             }
 
+            if (request.resultBinary) {
+                CVectorWriter writer{SER_NETWORK, PROTOCOL_VERSION,
+                                     *request.resultBinary, 0};
+                writer << RPC_BINARY_VERSION << hash_block;
+                WriteCompactSize(writer, tx->GetTotalSize());
+                writer << *tx;
+                return NullUniValue;
+            }
+
             if (!fVerbose) {
                 return EncodeHexTx(*tx, RPCSerializationFlags());
             }
@@ -2092,12 +2102,12 @@ RPCHelpMan analyzepsbt() {
 void RegisterRawTransactionRPCCommands(CRPCTable &t) {
     // clang-format off
     static const CRPCCommand commands[] = {
-        //  category            actor (function)
-        //  ------------------  ----------------------
-        { "rawtransactions",    getrawtransaction,          },
+        //  category            actor (function)            concurrent
+        //  ------------------  --------------------------  ----------
+        { "rawtransactions",    getrawtransaction,          true },
         { "rawtransactions",    createrawtransaction,       },
-        { "rawtransactions",    decoderawtransaction,       },
-        { "rawtransactions",    decodescript,               },
+        { "rawtransactions",    decoderawtransaction,       true },
+        { "rawtransactions",    decodescript,               true },
         { "rawtransactions",    sendrawtransaction,         },
         { "rawtransactions",    combinerawtransaction,      },
         { "rawtransactions",    signrawtransactionwithkey,  },
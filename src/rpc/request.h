@@ -8,7 +8,9 @@
 #include <univalue.h>
 
 #include <any>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 UniValue JSONRPCRequestObj(const std::string &strMethod, const UniValue &params,
                            const UniValue &id);
@@ -37,6 +39,28 @@ public:
     std::string authUser;
     std::string peerAddr;
     std::any context;
+    /**
+     * When set, handlers of large results may write their result to it, as
+     * the value of the reply's "result" key, instead of returning it.
+     */
+    UniValueWriter *resultWriter{nullptr};
+
+    /** Whether the handler wrote its result to resultWriter */
+    bool IsResultStreamed() const {
+        return resultWriter && !resultWriter->expectingValue();
+    }
+
+    /**
+     * When set, handlers of the calls that have a binary encoding write their
+     * result to it in that encoding, starting with RPC_BINARY_VERSION,
+     * instead of returning it.
+     */
+    std::vector<uint8_t> *resultBinary{nullptr};
+
+    /** Whether the handler wrote its result to resultBinary */
+    bool IsResultBinary() const {
+        return resultBinary && !resultBinary->empty();
+    }
 
     void parse(const UniValue &valRequest);
 };
@@ -7,21 +7,34 @@
 #include <rpc/server.h>
 
 #include <config.h>
+#include <httpserver.h>
 #include <rpc/util.h>
 #include <shutdown.h>
 #include <sync.h>
 #include <util/strencodings.h>
 #include <util/string.h>
+#include <util/system.h>
+#include <util/threadnames.h>
 #include <util/time.h>
 
 #include <boost/signals2/signal.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 using SteadyClock = std::chrono::steady_clock;
 
@@ -48,24 +61,73 @@ struct RPCCommandExecutionInfo {
 struct RPCServerInfo {
     Mutex mutex;
     std::list<RPCCommandExecutionInfo> active_commands GUARDED_BY(mutex);
+    std::map<std::string, RPCMethodStats> method_stats GUARDED_BY(mutex);
 };
 
 static RPCServerInfo g_rpc_server_info;
 
+/** Mutexes whose wait time is accounted in the method stats */
+static std::atomic<const void *> g_rpc_stats_cs_main{nullptr};
+static std::atomic<const void *> g_rpc_stats_mempool_cs{nullptr};
+
 struct RPCCommandExecution {
     std::list<RPCCommandExecutionInfo>::iterator it;
-    explicit RPCCommandExecution(const std::string &method) {
+    /** Whether the call is accounted in the method stats */
+    bool record;
+    const int uncaught_exceptions{std::uncaught_exceptions()};
+    LockWaitRecorder lock_waits;
+
+    explicit RPCCommandExecution(const std::string &method, bool record_in)
+        : record(record_in) {
         LOCK(g_rpc_server_info.mutex);
         it = g_rpc_server_info.active_commands.insert(
             g_rpc_server_info.active_commands.cend(),
             {method, SteadyClock::now()});
     }
     ~RPCCommandExecution() {
+        const auto duration{SteadyClock::now() - it->start};
+        // The execution failed if it is being unwound by an exception
+        const bool failed{std::uncaught_exceptions() > uncaught_exceptions};
+        const auto cs_main_wait{lock_waits.Get(g_rpc_stats_cs_main)};
+        const auto mempool_wait{lock_waits.Get(g_rpc_stats_mempool_cs)};
+
         LOCK(g_rpc_server_info.mutex);
+        if (record) {
+            RPCMethodStats &stats{g_rpc_server_info.method_stats[it->method]};
+            stats.calls++;
+            stats.errors += failed;
+            stats.time += duration;
+            const int64_t micros{Ticks<std::chrono::microseconds>(duration)};
+            stats.latency[std::lower_bound(RPC_LATENCY_BUCKETS.begin(),
+                                           RPC_LATENCY_BUCKETS.end(), micros) -
+                          RPC_LATENCY_BUCKETS.begin()]++;
+            stats.cs_main_wait += cs_main_wait;
+            stats.mempool_wait += mempool_wait;
+        }
         g_rpc_server_info.active_commands.erase(it);
     }
 };
 
+std::map<std::string, RPCMethodStats> GetRPCMethodStats() {
+    LOCK(g_rpc_server_info.mutex);
+    return g_rpc_server_info.method_stats;
+}
+
+void RecordRPCBytes(const std::string &method, size_t bytes_in,
+                    size_t bytes_out) {
+    LOCK(g_rpc_server_info.mutex);
+    auto it = g_rpc_server_info.method_stats.find(method);
+    if (it != g_rpc_server_info.method_stats.end()) {
+        it->second.bytes_in += bytes_in;
+        it->second.bytes_out += bytes_out;
+    }
+}
+
+void SetRPCStatsLocks(const void *cs_main, const void *mempool_cs) {
+    g_rpc_stats_cs_main = cs_main;
+    g_rpc_stats_mempool_cs = mempool_cs;
+}
+
 UniValue RPCServer::ExecuteCommand(const Config &config,
                                    const JSONRPCRequest &request) const {
     // Return immediately if in warmup
@@ -84,6 +146,8 @@ UniValue RPCServer::ExecuteCommand(const Config &config,
         auto commandsReadView = commands.getReadView();
         auto iter = commandsReadView->find(commandName);
         if (iter != commandsReadView.end()) {
+            RPCCommandExecution execution(
+                commandName, request.mode == JSONRPCRequest::EXECUTE);
             return iter->second.get()->Execute(request);
         }
     }
@@ -103,6 +167,14 @@ void RPCServer::RegisterCommand(std::unique_ptr<RPCCommand> command) {
     }
 }
 
+bool RPCServer::IsConcurrent(const std::string &commandName) const {
+    // The commands registered here take precedence over the table
+    if (commands.getReadView()->count(commandName)) {
+        return false;
+    }
+    return tableRPC.isConcurrent(commandName);
+}
+
 static struct CRPCSignals {
     boost::signals2::signal<void()> Started;
     boost::signals2::signal<void()> Stopped;
@@ -280,6 +352,37 @@ static RPCHelpMan getrpcinfo() {
                        }},
                       {RPCResult::Type::STR, "logpath",
                        "The complete file path to the debug log"},
+                      {RPCResult::Type::OBJ,
+                       "work_queue",
+                       "The queue of requests waiting for a worker thread",
+                       {
+                           {RPCResult::Type::NUM, "depth",
+                            "The number of queued requests"},
+                           {RPCResult::Type::NUM, "priority_depth",
+                            "The number of queued requests for priority "
+                            "methods (see -rpcprioritymethod)"},
+                           {RPCResult::Type::NUM, "clients",
+                            "The number of clients with queued requests"},
+                           {RPCResult::Type::NUM, "served",
+                            "The number of requests taken by a worker thread"},
+                           {RPCResult::Type::NUM, "rejected",
+                            "The number of requests rejected because the "
+                            "queue was full"},
+                           {RPCResult::Type::NUM, "evicted",
+                            "The number of queued requests dropped to make "
+                            "room for the requests of other clients"},
+                           {RPCResult::Type::NUM, "average_wait",
+                            "The average time the served requests waited in "
+                            "the queue, in microseconds"},
+                           {RPCResult::Type::NUM, "max_wait",
+                            "The maximum time a served request waited in the "
+                            "queue, in microseconds"},
+                       }},
+                      {RPCResult::Type::ARR,
+                       "event_loops",
+                       "The number of requests received by each HTTP event "
+                       "thread, the main one first (see -rpceventthreads)",
+                       {{RPCResult::Type::NUM, "", "The number of requests"}}},
                   }},
         RPCExamples{HelpExampleCli("getrpcinfo", "") +
                     HelpExampleRpc("getrpcinfo", "")},
@@ -305,6 +408,117 @@ static RPCHelpMan getrpcinfo() {
             UniValue log_path(UniValue::VSTR, path);
             result.pushKV("logpath", log_path);
 
+            const HTTPWorkQueueStats stats{GetHTTPWorkQueueStats()};
+            UniValue work_queue(UniValue::VOBJ);
+            work_queue.pushKV("depth", uint64_t(stats.depth));
+            work_queue.pushKV("priority_depth", uint64_t(stats.priority_depth));
+            work_queue.pushKV("clients", uint64_t(stats.clients));
+            work_queue.pushKV("served", stats.served);
+            work_queue.pushKV("rejected", stats.rejected);
+            work_queue.pushKV("evicted", stats.evicted);
+            work_queue.pushKV(
+                "average_wait",
+                int64_t{stats.served ? count_microseconds(stats.total_wait) /
+                                           int64_t(stats.served)
+                                     : 0});
+            work_queue.pushKV("max_wait",
+                              int64_t{count_microseconds(stats.max_wait)});
+            result.pushKV("work_queue", work_queue);
+
+            UniValue event_loops(UniValue::VARR);
+            for (const uint64_t requests : GetHTTPEventLoopRequests()) {
+                event_loops.push_back(requests);
+            }
+            result.pushKV("event_loops", event_loops);
+
+            return result;
+        }};
+}
+
+static RPCHelpMan getrpcstats() {
+    return RPCHelpMan{
+        "getrpcstats",
+        "Returns counters of the calls to each RPC method since the node "
+        "started.\n",
+        {},
+        RPCResult{
+            RPCResult::Type::OBJ,
+            "",
+            "",
+            {
+                {RPCResult::Type::ARR,
+                 "latency_buckets",
+                 "The upper bounds of the latency histogram buckets, in "
+                 "microseconds",
+                 {{RPCResult::Type::NUM, "", "The upper bound"}}},
+                {RPCResult::Type::OBJ_DYN,
+                 "methods",
+                 "The methods that were called at least once",
+                 {
+                     {RPCResult::Type::OBJ,
+                      "method",
+                      "The counters of the method",
+                      {
+                          {RPCResult::Type::NUM, "calls",
+                           "The number of calls"},
+                          {RPCResult::Type::NUM, "errors",
+                           "The number of calls that failed"},
+                          {RPCResult::Type::NUM, "time",
+                           "The total execution time in microseconds"},
+                          {RPCResult::Type::ARR,
+                           "latency",
+                           "The number of calls per latency bucket, the "
+                           "last one is for the calls slower than all the "
+                           "bucket bounds",
+                           {{RPCResult::Type::NUM, "", "The number of calls"}}},
+                          {RPCResult::Type::NUM, "bytes_in",
+                           "The total size of the requests"},
+                          {RPCResult::Type::NUM, "bytes_out",
+                           "The total size of the replies"},
+                          {RPCResult::Type::NUM, "cs_main_wait",
+                           "The total time spent waiting for the chain "
+                           "state lock, in microseconds"},
+                          {RPCResult::Type::NUM, "mempool_wait",
+                           "The total time spent waiting for the mempool "
+                           "lock, in microseconds"},
+                      }},
+                 }},
+            }},
+        RPCExamples{HelpExampleCli("getrpcstats", "") +
+                    HelpExampleRpc("getrpcstats", "")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            UniValue buckets(UniValue::VARR);
+            for (const int64_t bound : RPC_LATENCY_BUCKETS) {
+                buckets.push_back(bound);
+            }
+
+            UniValue methods(UniValue::VOBJ);
+            for (const auto &[method, stats] : GetRPCMethodStats()) {
+                UniValue latency(UniValue::VARR);
+                for (const uint64_t count : stats.latency) {
+                    latency.push_back(count);
+                }
+                UniValue entry(UniValue::VOBJ);
+                entry.pushKV("calls", stats.calls);
+                entry.pushKV("errors", stats.errors);
+                entry.pushKV("time", int64_t{Ticks<std::chrono::microseconds>(
+                                         stats.time)});
+                entry.pushKV("latency", latency);
+                entry.pushKV("bytes_in", stats.bytes_in);
+                entry.pushKV("bytes_out", stats.bytes_out);
+                entry.pushKV("cs_main_wait",
+                             int64_t{Ticks<std::chrono::microseconds>(
+                                 stats.cs_main_wait)});
+                entry.pushKV("mempool_wait",
+                             int64_t{Ticks<std::chrono::microseconds>(
+                                 stats.mempool_wait)});
+                methods.pushKV(method, entry);
+            }
+
+            UniValue result(UniValue::VOBJ);
+            result.pushKV("latency_buckets", buckets);
+            result.pushKV("methods", methods);
             return result;
         }};
 }
@@ -315,6 +529,7 @@ static const CRPCCommand vRPCCommands[] = {
     //  -------------------  ----------------------
     /* Overall control/query calls */
     { "control",             getrpcinfo,           },
+    { "control",             getrpcstats,          },
     { "control",             help,                 },
     { "control",             stop,                 },
     { "control",             uptime,               },
@@ -348,9 +563,92 @@ bool CRPCTable::removeCommand(const std::string &name,
     return false;
 }
 
+/**
+ * Threads helping the HTTP worker threads with the execution of the
+ * independent elements of batch requests.
+ */
+class RPCBatchExecutor {
+public:
+    void Start(int num_threads) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        LOCK(m_mutex);
+        assert(m_threads.empty());
+        m_running = true;
+        for (int i = 0; i < num_threads; i++) {
+            m_threads.emplace_back([this, i] {
+                util::ThreadRename(strprintf("rpcbatch.%i", i));
+                Run();
+            });
+        }
+    }
+
+    void Stop() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        std::vector<std::thread> threads;
+        {
+            LOCK(m_mutex);
+            m_running = false;
+            // Callers execute their own remaining elements.
+            m_tasks.clear();
+            threads.swap(m_threads);
+        }
+        m_cond.notify_all();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    /** Queue a task, returns false if the executor is not running */
+    bool Submit(std::function<void()> task) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        {
+            LOCK(m_mutex);
+            if (!m_running) {
+                return false;
+            }
+            m_tasks.push_back(std::move(task));
+        }
+        m_cond.notify_one();
+        return true;
+    }
+
+private:
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::function<void()>> m_tasks GUARDED_BY(m_mutex);
+    bool m_running GUARDED_BY(m_mutex){false};
+    std::vector<std::thread> m_threads GUARDED_BY(m_mutex);
+
+    void Run() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        while (true) {
+            std::function<void()> task;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+                    return !m_running || !m_tasks.empty();
+                });
+                if (!m_running) {
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+static RPCBatchExecutor g_rpc_batch_executor;
+static std::atomic<int> g_rpc_batch_concurrency{DEFAULT_RPC_BATCH_CONCURRENCY};
+
 void StartRPC() {
     LogPrint(BCLog::RPC, "Starting RPC\n");
     g_rpc_running = true;
+    const int rpc_threads{static_cast<int>(std::max<int64_t>(
+        gArgs.GetIntArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1))};
+    g_rpc_batch_concurrency =
+        std::clamp<int64_t>(gArgs.GetIntArg("-rpcbatchconcurrency",
+                                            DEFAULT_RPC_BATCH_CONCURRENCY),
+                            1, rpc_threads);
+    // The thread executing a batch takes part in its execution.
+    g_rpc_batch_executor.Start(g_rpc_batch_concurrency - 1);
     g_rpcSignals.Started();
 }
 
@@ -373,6 +671,7 @@ void StopRPC() {
     std::call_once(g_rpc_stop_flag, []() {
         LogPrint(BCLog::RPC, "Stopping RPC\n");
         WITH_LOCK(g_deadline_timers_mutex, deadlineTimers.clear());
+        g_rpc_batch_executor.Stop();
         DeleteAuthCookie();
         g_rpcSignals.Stopped();
     });
@@ -416,8 +715,20 @@ bool IsDeprecatedRPCEnabled(const ArgsManager &args,
            enabled_methods.end();
 }
 
-static UniValue JSONRPCExecOne(const Config &config, RPCServer &rpcServer,
-                               JSONRPCRequest jreq, const UniValue &req) {
+/**
+ * Share of the raw size of a batch request accounted to one of its elements.
+ * The elements are not serialized again to get their own size, the batch size
+ * is split evenly instead and the first element gets the remainder.
+ */
+static size_t BatchElementSize(size_t request_size, size_t count,
+                               size_t index) {
+    return request_size / count + (index == 0 ? request_size % count : 0);
+}
+
+/** Execute a batch element and return its serialized reply */
+static std::string JSONRPCExecOne(const Config &config, RPCServer &rpcServer,
+                                  JSONRPCRequest jreq, const UniValue &req,
+                                  size_t request_size) {
     UniValue rpc_result(UniValue::VOBJ);
 
     try {
@@ -432,17 +743,114 @@ static UniValue JSONRPCExecOne(const Config &config, RPCServer &rpcServer,
             NullUniValue, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
     }
 
-    return rpc_result;
+    std::string reply{rpc_result.write()};
+    RecordRPCBytes(jreq.strMethod, request_size, reply.size());
+    return reply;
 }
 
+static bool CanExecuteConcurrently(const RPCServer &rpcServer,
+                                   const UniValue &req) {
+    if (!req.isObject()) {
+        return false;
+    }
+    const UniValue &method = req.find_value("method");
+    return method.isStr() && rpcServer.IsConcurrent(method.get_str());
+}
+
+/** Shared state of the concurrent execution of a range of batch elements */
+struct BatchRange {
+    BatchRange(const Config &config_in, RPCServer &server_in,
+               const JSONRPCRequest &jreq_in, const UniValue &vReq_in,
+               size_t request_size_in, std::vector<std::string> &results_in,
+               size_t begin, size_t end_in)
+        : config(config_in), server(server_in), jreq(jreq_in), vReq(vReq_in),
+          request_size(request_size_in), results(results_in), next(begin),
+          end(end_in), remaining(end_in - begin) {}
+
+    const Config &config;
+    RPCServer &server;
+    const JSONRPCRequest &jreq;
+    const UniValue &vReq;
+    const size_t request_size;
+    std::vector<std::string> &results;
+    std::atomic<size_t> next;
+    const size_t end;
+
+    Mutex mutex;
+    std::condition_variable cond;
+    size_t remaining GUARDED_BY(mutex);
+
+    /** Execute elements until there are none left to claim */
+    void Work() EXCLUSIVE_LOCKS_REQUIRED(!mutex) {
+        size_t done{0};
+        for (size_t i = next++; i < end; i = next++) {
+            results[i] = JSONRPCExecOne(
+                config, server, jreq, vReq[i],
+                BatchElementSize(request_size, vReq.size(), i));
+            done++;
+        }
+        if (done) {
+            LOCK(mutex);
+            remaining -= done;
+            if (remaining == 0) {
+                cond.notify_all();
+            }
+        }
+    }
+};
+
 std::string JSONRPCExecBatch(const Config &config, RPCServer &rpcServer,
-                             const JSONRPCRequest &jreq, const UniValue &vReq) {
-    UniValue ret(UniValue::VARR);
-    for (size_t i = 0; i < vReq.size(); i++) {
-        ret.push_back(JSONRPCExecOne(config, rpcServer, jreq, vReq[i]));
+                             const JSONRPCRequest &jreq, const UniValue &vReq,
+                             size_t request_size) {
+    std::vector<std::string> results(vReq.size());
+    size_t i = 0;
+    while (i < vReq.size()) {
+        size_t end = i;
+        while (end < vReq.size() &&
+               CanExecuteConcurrently(rpcServer, vReq[end])) {
+            end++;
+        }
+        if (end - i < 2) {
+            // Other methods are executed alone, in order.
+            results[i] = JSONRPCExecOne(
+                config, rpcServer, jreq, vReq[i],
+                BatchElementSize(request_size, vReq.size(), i));
+            i++;
+            continue;
+        }
+
+        // The helpers hold the range so that a helper starting late can still
+        // find there is nothing left to do, but the range references the
+        // results so this thread waits until all the elements are executed.
+        auto range{std::make_shared<BatchRange>(
+            config, rpcServer, jreq, vReq, request_size, results, i, end)};
+        const size_t num_helpers{std::min<size_t>(
+            g_rpc_batch_concurrency - 1, end - i - 1)};
+        for (size_t h = 0; h < num_helpers; h++) {
+            if (!g_rpc_batch_executor.Submit([range] { range->Work(); })) {
+                break;
+            }
+        }
+        range->Work();
+        {
+            WAIT_LOCK(range->mutex, lock);
+            range->cond.wait(lock,
+                             [&]() EXCLUSIVE_LOCKS_REQUIRED(range->mutex) {
+                                 return range->remaining == 0;
+                             });
+        }
+        i = end;
     }
 
-    return ret.write() + "\n";
+    // The replies were serialized by the threads that executed them
+    std::string ret{"["};
+    for (size_t j = 0; j < results.size(); j++) {
+        if (j > 0) {
+            ret += ',';
+        }
+        ret += results[j];
+    }
+    return ret + "]\n";
 }
 
 /**
@@ -533,15 +941,20 @@ static bool ExecuteCommand(const Config &config, const CRPCCommand &command,
                            const JSONRPCRequest &request, UniValue &result,
                            bool last_handler) {
     try {
-        RPCCommandExecution execution(request.strMethod);
+        RPCCommandExecution execution(request.strMethod,
+                                      request.mode == JSONRPCRequest::EXECUTE);
         // Execute, convert arguments to array if necessary
+        bool handled;
         if (request.params.isObject()) {
-            return command.actor(
+            handled = command.actor(
                 config, transformNamedArguments(request, command.argNames),
                 result, last_handler);
         } else {
-            return command.actor(config, request, result, last_handler);
+            handled = command.actor(config, request, result, last_handler);
         }
+        // Only the handler that executed the call accounts it
+        execution.record &= handled;
+        return handled;
     } catch (const std::exception &e) {
         throw JSONRPCError(RPC_MISC_ERROR, e.what());
     }
@@ -555,6 +968,16 @@ std::vector<std::string> CRPCTable::listCommands() const {
     return commandList;
 }
 
+bool CRPCTable::isConcurrent(const std::string &name) const {
+    const auto it = mapCommands.find(name);
+    if (it == mapCommands.end()) {
+        return false;
+    }
+    return std::all_of(
+        it->second.begin(), it->second.end(),
+        [](const CRPCCommand *command) { return command->concurrent; });
+}
+
 UniValue CRPCTable::dumpArgMap(const Config &config,
                                const JSONRPCRequest &args_request) const {
     JSONRPCRequest request = args_request;
@@ -15,12 +15,19 @@
 
 #include <univalue.h>
 
+#include <array>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <map>
 #include <string>
 
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
+/**
+ * Default for -rpcbatchconcurrency, the maximum number of elements of a batch
+ * request that are executed concurrently
+ */
+static const int DEFAULT_RPC_BATCH_CONCURRENCY = 4;
 
 class CRPCCommand;
 
@@ -57,6 +64,12 @@ public:
      * Register an RPC command.
      */
     void RegisterCommand(std::unique_ptr<RPCCommand> command);
+
+    /**
+     * Whether consecutive calls of a command in a batch request can be
+     * executed concurrently.
+     */
+    bool IsConcurrent(const std::string &commandName) const;
 };
 
 /**
@@ -154,13 +167,15 @@ public:
 
     //! Constructor taking Actor callback supporting multiple handlers.
     CRPCCommand(std::string _category, std::string _name, Actor _actor,
-                std::vector<std::string> _args, intptr_t _unique_id)
+                std::vector<std::string> _args, intptr_t _unique_id,
+                bool _concurrent = false)
         : category(std::move(_category)), name(std::move(_name)),
           actor(std::move(_actor)), argNames(std::move(_args)),
-          unique_id(_unique_id) {}
+          unique_id(_unique_id), concurrent(_concurrent) {}
 
     //! Simplified constructor taking plain RpcMethodFnType function pointer.
-    CRPCCommand(std::string _category, RpcMethodFnType _fn)
+    CRPCCommand(std::string _category, RpcMethodFnType _fn,
+                bool _concurrent = false)
         : CRPCCommand(
               _category, _fn().m_name,
               [_fn](const Config &config, const JSONRPCRequest &request,
@@ -168,13 +183,17 @@ public:
                   result = _fn().HandleRequest(config, request);
                   return true;
               },
-              _fn().GetArgNames(), intptr_t(_fn)) {}
+              _fn().GetArgNames(), intptr_t(_fn), _concurrent) {}
 
     std::string category;
     std::string name;
     Actor actor;
     std::vector<std::string> argNames;
     intptr_t unique_id;
+    //! Whether the command only reads the node state, so that consecutive
+    //! calls in a batch request can be executed concurrently without changing
+    //! their results.
+    bool concurrent;
 };
 
 /**
@@ -203,6 +222,12 @@ public:
      */
     std::vector<std::string> listCommands() const;
 
+    /**
+     * Whether all the handlers of a method are concurrent, see
+     * CRPCCommand::concurrent.
+     */
+    bool isConcurrent(const std::string &name) const;
+
     /**
      * Return all named arguments that need to be converted by the client from
      * string to another JSON type
@@ -233,8 +258,51 @@ extern CRPCTable tableRPC;
 void StartRPC();
 void InterruptRPC();
 void StopRPC();
+/**
+ * Execute a batch request. Consecutive elements calling read-only methods are
+ * executed concurrently, the results are returned in the request order.
+ * request_size is the size of the raw batch request, accounted to its elements
+ * in the RPC statistics.
+ */
 std::string JSONRPCExecBatch(const Config &config, RPCServer &rpcServer,
-                             const JSONRPCRequest &req, const UniValue &vReq);
+                             const JSONRPCRequest &req, const UniValue &vReq,
+                             size_t request_size);
+
+/** Upper bounds of the RPC latency histogram buckets, in microseconds */
+static constexpr std::array<int64_t, 7> RPC_LATENCY_BUCKETS{
+    {100, 1'000, 10'000, 100'000, 1'000'000, 10'000'000, 60'000'000}};
+
+/** Counters of the calls to a RPC method, see getrpcstats */
+struct RPCMethodStats {
+    uint64_t calls{0};
+    /** Calls that failed with an error */
+    uint64_t errors{0};
+    std::chrono::nanoseconds time{0};
+    /** Calls per latency bucket, the last one is for the slower calls */
+    std::array<uint64_t, RPC_LATENCY_BUCKETS.size() + 1> latency{};
+    /** Size of the requests and of the replies */
+    uint64_t bytes_in{0};
+    uint64_t bytes_out{0};
+    /** Time spent blocked on cs_main and on the mempool lock */
+    std::chrono::nanoseconds cs_main_wait{0};
+    std::chrono::nanoseconds mempool_wait{0};
+};
+
+/** Counters of all the RPC methods that were called at least once */
+std::map<std::string, RPCMethodStats> GetRPCMethodStats();
+
+/**
+ * Account the size of a request and of its reply to a method, once it was
+ * executed. Unknown methods are ignored.
+ */
+void RecordRPCBytes(const std::string &method, size_t bytes_in,
+                    size_t bytes_out);
+
+/**
+ * Set the mutexes whose wait time is reported by getrpcstats. They are only
+ * compared with the contended mutexes, never locked.
+ */
+void SetRPCStatsLocks(const void *cs_main, const void *mempool_cs);
 
 /**
  * Retrieves any serialization flags requested in command line argument
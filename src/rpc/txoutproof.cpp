@@ -215,10 +215,10 @@ static RPCHelpMan verifytxoutproof() {
 
 void RegisterTxoutProofRPCCommands(CRPCTable &t) {
     static const CRPCCommand commands[]{
-        // category     actor (function)
-        // --------     ----------------
-        {"blockchain", gettxoutproof},
-        {"blockchain", verifytxoutproof},
+        // category     actor (function)     concurrent
+        // --------     ----------------     ----------
+        {"blockchain", gettxoutproof, true},
+        {"blockchain", verifytxoutproof, true},
     };
     for (const auto &c : commands) {
         t.appendCommand(c.name, &c);
@@ -598,6 +598,9 @@ UniValue RPCHelpMan::HandleRequest(const Config &config,
         throw std::runtime_error(ToString());
     }
     const UniValue ret = m_fun(*this, config, request);
+    if (request.IsResultStreamed() || request.IsResultBinary()) {
+        return ret;
+    }
     CHECK_NONFATAL(std::any_of(
         m_results.m_results.begin(), m_results.m_results.end(),
         [ret](const RPCResult &res) { return res.MatchesType(ret); }));
@@ -37,6 +37,12 @@ extern const std::string UNIX_EPOCH_TIME;
  */
 extern const std::string EXAMPLE_ADDRESS;
 
+/**
+ * Version of the binary encoding of the RPC results, written as their first
+ * byte. The encodings are documented in doc/JSON-RPC-interface.md.
+ */
+static constexpr uint8_t RPC_BINARY_VERSION{1};
+
 /**
  * Wrapper for UniValue::VType, which includes typeAny: used to denote don't
  * care type.
@@ -340,3 +340,24 @@ bool LockStackEmpty() {
 bool g_debug_lockorder_abort = true;
 
 #endif /* DEBUG_LOCKORDER */
+
+thread_local LockWaitRecorder *LockWaitRecorder::g_current{nullptr};
+
+void LockWaitRecorder::Add(const void *mutex, std::chrono::nanoseconds wait) {
+    for (auto &[waited_mutex, total] : m_waits) {
+        if (waited_mutex == mutex) {
+            total += wait;
+            return;
+        }
+    }
+    m_waits.emplace_back(mutex, wait);
+}
+
+std::chrono::nanoseconds LockWaitRecorder::Get(const void *mutex) const {
+    for (const auto &[waited_mutex, total] : m_waits) {
+        if (waited_mutex == mutex) {
+            return total;
+        }
+    }
+    return std::chrono::nanoseconds{0};
+}
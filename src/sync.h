@@ -14,10 +14,13 @@
 #include <threadsafety.h>
 #include <util/macros.h>
 
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 /////////////////////////////////////////////////
 //                                             //
@@ -163,21 +166,57 @@ inline void AssertLockNotHeldInline(const char *name, const char *file,
 #define AssertLockNotHeld(cs)                                                  \
     AssertLockNotHeldInline(#cs, __FILE__, __LINE__, &cs)
 
+/**
+ * Accumulates, per mutex, the time the current thread spends blocked on
+ * contended locks while the recorder is alive. Recorders nest: the innermost
+ * one receives the wait times until it is destroyed. The recorder is only
+ * looked up when a lock is contended, so uncontended locks don't pay for it.
+ */
+class LockWaitRecorder {
+public:
+    LockWaitRecorder() : m_prev(g_current) { g_current = this; }
+    ~LockWaitRecorder() { g_current = m_prev; }
+    LockWaitRecorder(const LockWaitRecorder &) = delete;
+    LockWaitRecorder &operator=(const LockWaitRecorder &) = delete;
+
+    /** The recorder installed on this thread, if any */
+    static LockWaitRecorder *Current() { return g_current; }
+
+    void Add(const void *mutex, std::chrono::nanoseconds wait);
+
+    /** Time spent waiting for the given mutex */
+    std::chrono::nanoseconds Get(const void *mutex) const;
+
+private:
+    static thread_local LockWaitRecorder *g_current;
+
+    LockWaitRecorder *const m_prev;
+    /** Few mutexes are contended during a recording, so a vector is enough */
+    std::vector<std::pair<const void *, std::chrono::nanoseconds>> m_waits;
+};
+
 /** Wrapper around std::unique_lock style lock for Mutex. */
 template <typename Mutex, typename Base = typename Mutex::UniqueLock>
 class SCOPED_LOCKABLE UniqueLock : public Base {
 private:
     void Enter(const char *pszName, const char *pszFile, int nLine) {
         EnterCritical(pszName, pszFile, nLine, Base::mutex());
-#ifdef DEBUG_LOCKCONTENTION
         if (Base::try_lock()) {
             return;
         }
+        LockWaitRecorder *const recorder{LockWaitRecorder::Current()};
+        const auto start{recorder ? std::chrono::steady_clock::now()
+                                  : std::chrono::steady_clock::time_point{}};
+#ifdef DEBUG_LOCKCONTENTION
         LOG_TIME_MICROS_WITH_CATEGORY(
             strprintf("lock contention %s, %s:%d", pszName, pszFile, nLine),
             BCLog::LOCK);
 #endif
         Base::lock();
+        if (recorder) {
+            recorder->Add(Base::mutex(),
+                          std::chrono::steady_clock::now() - start);
+        }
     }
 
     bool TryEnter(const char *pszName, const char *pszFile, int nLine) {
@@ -12,6 +12,10 @@
 
 using node::BLOCK_SERIALIZATION_HEADER_SIZE;
 using node::BlockManager;
+using node::fMmapBlockFiles;
+using node::ReadBlockFromDisk;
+using node::StartBlockFileWriter;
+using node::StopBlockFileWriter;
 
 // use BasicTestingSetup here for the data directory configuration, setup, and
 // cleanup
@@ -55,4 +59,73 @@ BOOST_AUTO_TEST_CASE(blockmanager_find_block_pos) {
             BLOCK_SERIALIZATION_HEADER_SIZE);
 }
 
+BOOST_AUTO_TEST_CASE(blockmanager_mmap_read) {
+    const auto params{CreateChainParams(CBaseChainParams::MAIN)};
+    const CBlock &genesis{params->GenesisBlock()};
+    gArgs.ForceSetArg("-fastprune", "1");
+    BlockManager blockman{};
+    CBlockIndex tip{genesis};
+    CChain chain{};
+    chain.SetTip(&tip);
+
+    // Fill the first (64kb with -fastprune) block file so it gets finalised.
+    std::vector<FlatFilePos> positions;
+    do {
+        positions.push_back(
+            blockman.SaveBlockToDisk(genesis, 0, chain, *params, nullptr));
+    } while (positions.back().nFile == 0);
+    BOOST_CHECK_GT(positions.size(), 2U);
+
+    fMmapBlockFiles = true;
+    for (const FlatFilePos &pos : positions) {
+        // Blocks in the finalised file are read through the mapping, the
+        // block in the current file is read from the file.
+        CBlock block;
+        BOOST_CHECK(ReadBlockFromDisk(block, pos, params->GetConsensus()));
+        BOOST_CHECK_EQUAL(block.GetHash(), genesis.GetHash());
+    }
+
+    // A corrupted position fails to read rather than going out of bounds.
+    CBlock block;
+    BOOST_CHECK(!ReadBlockFromDisk(block, FlatFilePos{0, 1},
+                                   params->GetConsensus()));
+    BOOST_CHECK(!ReadBlockFromDisk(block, FlatFilePos{0, 0x10000},
+                                   params->GetConsensus()));
+
+    fMmapBlockFiles = node::DEFAULT_MMAP_BLOCK_FILES;
+    gArgs.ForceSetArg("-fastprune", "0");
+}
+
+BOOST_AUTO_TEST_CASE(blockmanager_async_write) {
+    const auto params{CreateChainParams(CBaseChainParams::MAIN)};
+    const CBlock &genesis{params->GenesisBlock()};
+    BlockManager blockman{};
+    CChain chain{};
+
+    StartBlockFileWriter();
+    std::vector<FlatFilePos> positions;
+    for (int i = 0; i < 100; ++i) {
+        positions.push_back(
+            blockman.SaveBlockToDisk(genesis, i, chain, *params, nullptr));
+        BOOST_CHECK_EQUAL(positions.back().nPos,
+                          (i + 1) * BLOCK_SERIALIZATION_HEADER_SIZE +
+                              i * ::GetSerializeSize(genesis, CLIENT_VERSION));
+    }
+    // Reads wait for the pending write of their record, the later records
+    // of the file may still be queued.
+    for (const FlatFilePos &pos : positions) {
+        CBlock block;
+        BOOST_CHECK(ReadBlockFromDisk(block, pos, params->GetConsensus()));
+        BOOST_CHECK_EQUAL(block.GetHash(), genesis.GetHash());
+    }
+    StopBlockFileWriter();
+
+    // Once stopped, writes are synchronous again.
+    const FlatFilePos pos{
+        blockman.SaveBlockToDisk(genesis, 100, chain, *params, nullptr)};
+    CBlock block;
+    BOOST_CHECK(ReadBlockFromDisk(block, pos, params->GetConsensus()));
+    BOOST_CHECK_EQUAL(block.GetHash(), genesis.GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -323,20 +323,32 @@ BOOST_AUTO_TEST_CASE(DoS_bantime) {
 
 class TxOrphanageTest : public TxOrphanage {
 public:
-    inline size_t CountOrphans() const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans) {
+    inline size_t CountOrphans() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        LOCK(m_mutex);
         return m_orphans.size();
     }
 
-    CTransactionRef RandomOrphan() EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans) {
-        std::map<TxId, OrphanTx>::iterator it;
-        it = m_orphans.lower_bound(TxId{InsecureRand256()});
-        if (it == m_orphans.end()) {
-            it = m_orphans.begin();
-        }
+    CTransactionRef RandomOrphan() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        LOCK(m_mutex);
+        auto it = m_orphans.begin();
+        std::advance(it, InsecureRandRange(m_orphans.size()));
         return it->second.tx;
     }
 };
 
+static CTransactionRef MakeOrphan(size_t num_outputs = 1) {
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(TxId(InsecureRand256()), 0);
+    tx.vin[0].scriptSig << OP_1;
+    tx.vout.resize(num_outputs);
+    for (CTxOut &out : tx.vout) {
+        out.nValue = 1 * CENT;
+        out.scriptPubKey = CScript() << OP_TRUE;
+    }
+    return MakeTransactionRef(tx);
+}
+
 BOOST_AUTO_TEST_CASE(DoS_mapOrphans) {
     TxOrphanageTest orphanage;
     CKey key;
@@ -344,8 +356,6 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans) {
     FillableSigningProvider keystore;
     BOOST_CHECK(keystore.AddKey(key));
 
-    LOCK(g_cs_orphans);
-
     // 50 orphan transactions:
     for (int i = 0; i < 50; i++) {
         CMutableTransaction tx;
@@ -409,12 +419,116 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans) {
     }
 
     // Test LimitOrphanTxSize() function:
-    orphanage.LimitOrphans(40);
+    const size_t max_peer_bytes =
+        GetMaxPeerOrphanBytes(DEFAULT_MAX_ORPHAN_TRANSACTIONS);
+    orphanage.LimitOrphans(40, 100, max_peer_bytes);
     BOOST_CHECK(orphanage.CountOrphans() <= 40);
-    orphanage.LimitOrphans(10);
+    orphanage.LimitOrphans(10, 100, max_peer_bytes);
     BOOST_CHECK(orphanage.CountOrphans() <= 10);
-    orphanage.LimitOrphans(0);
+    orphanage.LimitOrphans(0, 100, max_peer_bytes);
     BOOST_CHECK(orphanage.CountOrphans() == 0);
+    BOOST_CHECK_EQUAL(orphanage.TotalBytes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(orphanage_peer_budgets) {
+    TxOrphanageTest orphanage;
+
+    // Peer 0 floods the orphanage, peer 1 only sends a few orphans.
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK(orphanage.AddTx(MakeOrphan(), 0));
+    }
+    std::vector<CTransactionRef> honest_orphans;
+    for (int i = 0; i < 5; i++) {
+        honest_orphans.push_back(MakeOrphan());
+        BOOST_CHECK(orphanage.AddTx(honest_orphans.back(), 1));
+    }
+    BOOST_CHECK_EQUAL(orphanage.CountOrphans(), 105);
+    BOOST_CHECK_EQUAL(orphanage.PeerUsage(0).first, 100);
+    BOOST_CHECK_EQUAL(orphanage.PeerUsage(1).first, 5);
+
+    size_t total_bytes = 0;
+    for (const auto &tx : honest_orphans) {
+        total_bytes += tx->GetTotalSize();
+    }
+    BOOST_CHECK_EQUAL(orphanage.PeerUsage(1).second, total_bytes);
+
+    // The per peer count budget only evicts from the flooding peer.
+    const size_t max_peer_bytes =
+        GetMaxPeerOrphanBytes(DEFAULT_MAX_ORPHAN_TRANSACTIONS);
+    BOOST_CHECK_EQUAL(orphanage.LimitOrphans(1000, 50, max_peer_bytes), 50);
+    BOOST_CHECK_EQUAL(orphanage.PeerUsage(0).first, 50);
+    BOOST_CHECK_EQUAL(orphanage.PeerUsage(1).first, 5);
+
+    // So does the global limit, as the flooding peer uses the most memory.
+    BOOST_CHECK_EQUAL(orphanage.LimitOrphans(25, 50, max_peer_bytes), 30);
+    BOOST_CHECK_EQUAL(orphanage.PeerUsage(0).first, 20);
+    for (const auto &tx : honest_orphans) {
+        BOOST_CHECK(orphanage.HaveTx(tx->GetId()));
+    }
+
+    // The per peer byte budget.
+    const size_t orphan_size = honest_orphans[0]->GetTotalSize();
+    BOOST_CHECK_EQUAL(orphanage.LimitOrphans(25, 50, 2 * orphan_size), 21);
+    BOOST_CHECK_EQUAL(orphanage.PeerUsage(0).first, 2);
+    BOOST_CHECK_EQUAL(orphanage.PeerUsage(1).first, 2);
+
+    orphanage.EraseForPeer(0);
+    BOOST_CHECK_EQUAL(orphanage.PeerUsage(0).first, 0);
+    BOOST_CHECK_EQUAL(orphanage.PeerUsage(0).second, 0);
+    BOOST_CHECK_EQUAL(orphanage.CountOrphans(), 2);
+
+    // The per peer budgets scale with -maxorphantx.
+    BOOST_CHECK_EQUAL(GetMaxPeerOrphans(DEFAULT_MAX_ORPHAN_TRANSACTIONS), 50);
+    BOOST_CHECK_EQUAL(max_peer_bytes, 1000000);
+    BOOST_CHECK_EQUAL(GetMaxPeerOrphans(1000), 500);
+    BOOST_CHECK_EQUAL(GetMaxPeerOrphanBytes(1000), 10000000);
+    // A peer can always keep one orphan of the maximum standard size.
+    BOOST_CHECK_EQUAL(GetMaxPeerOrphans(1), 1);
+    BOOST_CHECK_EQUAL(GetMaxPeerOrphanBytes(1), MAX_STANDARD_TX_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(orphanage_children_and_block) {
+    TxOrphanageTest orphanage;
+
+    // A parent (not in the orphanage) with two outputs, each spent by an
+    // orphan.
+    const CTransactionRef parent = MakeOrphan(2);
+    std::vector<CTransactionRef> children;
+    for (uint32_t i = 0; i < 2; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(parent->GetId(), i);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 1 * CENT;
+        children.push_back(MakeTransactionRef(tx));
+        BOOST_CHECK(orphanage.AddTx(children.back(), i));
+    }
+    // An unrelated orphan.
+    BOOST_CHECK(orphanage.AddTx(MakeOrphan(), 2));
+
+    std::set<TxId> work_set;
+    orphanage.AddChildrenToWorkSet(*parent, work_set);
+    BOOST_CHECK_EQUAL(work_set.size(), 2);
+    for (const auto &child : children) {
+        BOOST_CHECK(work_set.count(child->GetId()));
+    }
+
+    // A block conflicting with the first child evicts it.
+    CMutableTransaction conflict;
+    conflict.vin.resize(1);
+    conflict.vin[0].prevout = COutPoint(parent->GetId(), 0);
+    conflict.vout.resize(1);
+    conflict.vout[0].nValue = 2 * CENT;
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(conflict));
+    orphanage.EraseForBlock(block);
+    BOOST_CHECK(!orphanage.HaveTx(children[0]->GetId()));
+    BOOST_CHECK(orphanage.HaveTx(children[1]->GetId()));
+    BOOST_CHECK_EQUAL(orphanage.CountOrphans(), 2);
+
+    work_set.clear();
+    orphanage.AddChildrenToWorkSet(*parent, work_set);
+    BOOST_CHECK_EQUAL(work_set.size(), 1);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -125,4 +125,46 @@ BOOST_AUTO_TEST_CASE(flatfile_flush) {
     BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(0, 1))), 1U);
 }
 
+BOOST_AUTO_TEST_CASE(flatfile_map) {
+    const auto data_dir = m_args.GetDataDirBase();
+    FlatFileSeq seq(data_dir, "a", 100);
+
+    // Missing and empty files cannot be mapped.
+    BOOST_CHECK(!seq.Map(FlatFilePos(0, 0)));
+    bool out_of_space;
+    seq.Allocate(FlatFilePos(0, 0), 1, out_of_space);
+    seq.Flush(FlatFilePos(0, 0), true);
+    BOOST_CHECK(!seq.Map(FlatFilePos(0, 0)));
+
+    const std::string line(
+        "It should be noted that fraudulent transactions are not the only "
+        "concern.");
+    {
+        AutoFile file{seq.Open(FlatFilePos(0, 0))};
+        file << line << line;
+    }
+
+    auto map{seq.Map(FlatFilePos(0, 0))};
+#ifdef WIN32
+    BOOST_CHECK(!map);
+#else
+    BOOST_REQUIRE(map);
+    BOOST_CHECK_EQUAL(map->size(), 2 * GetSerializeSize(line, CLIENT_VERSION));
+
+    std::string text;
+    SpanReader reader{SER_DISK, CLIENT_VERSION, map->GetSpan()};
+    reader >> text;
+    BOOST_CHECK_EQUAL(text, line);
+    reader >> text;
+    BOOST_CHECK_EQUAL(text, line);
+    BOOST_CHECK(reader.empty());
+    BOOST_CHECK_THROW(reader >> text, std::ios_base::failure);
+
+    // The mapping outlives the file.
+    fs::remove(seq.FileName(FlatFilePos(0, 0)));
+    SpanReader{SER_DISK, CLIENT_VERSION, map->GetSpan()} >> text;
+    BOOST_CHECK_EQUAL(text, line);
+#endif
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,10 +6,13 @@
 
 #include <kernel/disconnected_transactions.h>
 #include <kernel/mempool_entry.h>
+#include <kernel/mempool_persist.h>
 #include <policy/settings.h>
 #include <reverse_iterator.h>
+#include <script/standard.h>
 #include <util/system.h>
 #include <util/time.h>
+#include <validation.h>
 
 #include <test/util/setup_common.h>
 
@@ -22,6 +25,17 @@ BOOST_FIXTURE_TEST_SUITE(mempool_tests, TestingSetup)
 
 static constexpr auto REMOVAL_REASON_DUMMY = MemPoolRemovalReason::REPLACED;
 
+static void CheckTxnsRandomized(const CTxMemPool &pool)
+    EXCLUSIVE_LOCKS_REQUIRED(pool.cs) {
+    BOOST_CHECK_EQUAL(pool.txns_randomized.size(), pool.mapTx.size());
+    for (size_t i = 0; i < pool.txns_randomized.size(); ++i) {
+        const auto &[txhash, it] = pool.txns_randomized[i];
+        BOOST_CHECK_EQUAL((*it)->idx_randomized, i);
+        BOOST_CHECK(txhash == (*it)->GetTx().GetHash());
+        BOOST_CHECK(pool.mapTx.find((*it)->GetTx().GetId()) == it);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(MempoolRemoveTest) {
     // Test CTxMemPool::remove functionality
 
@@ -78,6 +92,7 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest) {
     poolSize = testPool.size();
     testPool.removeRecursive(CTransaction(txChild[0]), REMOVAL_REASON_DUMMY);
     BOOST_CHECK_EQUAL(testPool.size(), poolSize - 2);
+    CheckTxnsRandomized(testPool);
     // ... make sure grandchild and child are gone:
     poolSize = testPool.size();
     testPool.removeRecursive(CTransaction(txGrandChild[0]),
@@ -91,6 +106,7 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest) {
     testPool.removeRecursive(CTransaction(txParent), REMOVAL_REASON_DUMMY);
     BOOST_CHECK_EQUAL(testPool.size(), poolSize - 5);
     BOOST_CHECK_EQUAL(testPool.size(), 0UL);
+    CheckTxnsRandomized(testPool);
 
     // Add children and grandchildren, but NOT the parent (simulate the parent
     // being in a block)
@@ -107,6 +123,81 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest) {
     BOOST_CHECK_EQUAL(testPool.size(), 0UL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolRemoveForBlockTest) {
+    TestMemPoolEntryHelper entry;
+    // Parent transaction with three children, and three grand-children:
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(3);
+    for (int i = 0; i < 3; i++) {
+        txParent.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txParent.vout[i].nValue = 33000 * SATOSHI;
+    }
+    CMutableTransaction txChild[3];
+    CMutableTransaction txGrandChild[3];
+    for (int i = 0; i < 3; i++) {
+        txChild[i].vin.resize(1);
+        txChild[i].vin[0].scriptSig = CScript() << OP_11;
+        txChild[i].vin[0].prevout = COutPoint(txParent.GetId(), i);
+        txChild[i].vout.resize(1);
+        txChild[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txChild[i].vout[0].nValue = 11000 * SATOSHI;
+
+        txGrandChild[i].vin.resize(1);
+        txGrandChild[i].vin[0].scriptSig = CScript() << OP_11;
+        txGrandChild[i].vin[0].prevout = COutPoint(txChild[i].GetId(), 0);
+        txGrandChild[i].vout.resize(1);
+        txGrandChild[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txGrandChild[i].vout[0].nValue = 11000 * SATOSHI;
+    }
+    // A transaction that is not in the mempool and conflicts with txChild[1]
+    CMutableTransaction txConflict{txChild[1]};
+    txConflict.vout[0].nValue = 10000 * SATOSHI;
+
+    CTxMemPool &testPool = *Assert(m_node.mempool);
+    LOCK2(::cs_main, testPool.cs);
+
+    testPool.addUnchecked(entry.FromTx(txParent));
+    for (int i = 0; i < 3; i++) {
+        testPool.addUnchecked(entry.FromTx(txChild[i]));
+        testPool.addUnchecked(entry.FromTx(txGrandChild[i]));
+    }
+    testPool.PrioritiseTransaction(txChild[1].GetId(), 1000 * SATOSHI);
+    testPool.PrioritiseTransaction(txParent.GetId(), 1000 * SATOSHI);
+
+    // A block with the parent, the first child and the conflict
+    const std::vector<CTransactionRef> vtx{MakeTransactionRef(txParent),
+                                           MakeTransactionRef(txChild[0]),
+                                           MakeTransactionRef(txConflict)};
+    testPool.removeForBlock(vtx);
+
+    // The second child and its descendant are removed as conflicts
+    BOOST_CHECK_EQUAL(testPool.size(), 3U);
+    BOOST_CHECK(!testPool.exists(txParent.GetId()));
+    BOOST_CHECK(!testPool.exists(txChild[0].GetId()));
+    BOOST_CHECK(!testPool.exists(txChild[1].GetId()));
+    BOOST_CHECK(!testPool.exists(txGrandChild[1].GetId()));
+    BOOST_CHECK_EQUAL(testPool.mapDeltas.count(txParent.GetId()), 0U);
+    BOOST_CHECK_EQUAL(testPool.mapDeltas.count(txChild[1].GetId()), 0U);
+    CheckTxnsRandomized(testPool);
+
+    // The remaining transactions no longer link to the removed ones
+    const auto &grandchild0 = *testPool.GetIter(txGrandChild[0].GetId());
+    BOOST_CHECK((*grandchild0)->GetMemPoolParentsConst().empty());
+    const auto &child2 = *testPool.GetIter(txChild[2].GetId());
+    BOOST_CHECK((*child2)->GetMemPoolParentsConst().empty());
+    BOOST_CHECK_EQUAL((*child2)->GetMemPoolChildrenConst().size(), 1U);
+    const auto &grandchild2 = *testPool.GetIter(txGrandChild[2].GetId());
+    BOOST_CHECK_EQUAL((*grandchild2)->GetMemPoolParentsConst().size(), 1U);
+
+    // Removing a set including both ends of a link leaves the others intact
+    CTxMemPool::setEntries stage{grandchild0, child2, grandchild2};
+    testPool.RemoveStaged(stage, REMOVAL_REASON_DUMMY);
+    BOOST_CHECK_EQUAL(testPool.size(), 0U);
+    CheckTxnsRandomized(testPool);
+}
+
 BOOST_AUTO_TEST_CASE(MempoolClearTest) {
     // Test CTxMemPool::clear functionality
 
@@ -216,6 +307,100 @@ BOOST_AUTO_TEST_CASE(MempoolIndexingTest) {
     CheckSort<modified_feerate>(pool, sortedOrder, "MempoolIndexingTest1");
 }
 
+BOOST_AUTO_TEST_CASE(MempoolFeeRateHistogramTest) {
+    CTxMemPool &pool = *Assert(m_node.mempool);
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+    // The test transactions have the same virtual size, set by their sigchecks
+    entry.SigChecks(2);
+
+    const std::vector<FeeRateBucket> &buckets =
+        pool.GetFeeRateHistogram().GetBuckets();
+    BOOST_CHECK(buckets.front().min_feerate == CFeeRate());
+    for (size_t i = 1; i < buckets.size(); ++i) {
+        BOOST_CHECK(buckets[i - 1].min_feerate < buckets[i].min_feerate);
+    }
+
+    auto get_bucket = [&](const TxId &txid) -> const FeeRateBucket & {
+        const CFeeRate feerate =
+            (*pool.mapTx.find(txid))->GetModifiedFeeRate();
+        auto it = std::find_if(buckets.rbegin(), buckets.rend(),
+                               [&](const FeeRateBucket &bucket) {
+                                   return bucket.min_feerate <= feerate;
+                               });
+        return it == buckets.rend() ? buckets.front() : *it;
+    };
+    // The histogram matches the one built from the mempool content
+    auto check_histogram = [&]() EXCLUSIVE_LOCKS_REQUIRED(pool.cs) {
+        FeeRateHistogram expected;
+        for (const CTxMemPoolEntryRef &e : pool.mapTx) {
+            expected.AddTx(*e);
+        }
+        BOOST_CHECK(pool.GetFeeRateHistogram() == expected);
+    };
+    auto count_txs = [&]() {
+        uint64_t count = 0;
+        for (const FeeRateBucket &bucket : buckets) {
+            count += bucket.count;
+        }
+        return count;
+    };
+    BOOST_CHECK_EQUAL(count_txs(), 0);
+
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_1;
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(entry.Fee(20000 * SATOSHI).FromTx(tx1));
+
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vin.resize(1);
+    tx2.vin[0].scriptSig = CScript() << OP_2;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+    tx2.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(entry.Fee(100 * SATOSHI).FromTx(tx2));
+
+    const FeeRateBucket &bucket1 = get_bucket(tx1.GetId());
+    const FeeRateBucket &bucket2 = get_bucket(tx2.GetId());
+    BOOST_CHECK(&bucket1 != &bucket2);
+    BOOST_CHECK_EQUAL(bucket1.count, 1);
+    BOOST_CHECK_EQUAL(bucket1.size, CTransaction(tx1).GetTotalSize());
+    BOOST_CHECK_EQUAL(bucket1.sigchecks, 2);
+    BOOST_CHECK_EQUAL(bucket2.count, 1);
+    BOOST_CHECK_EQUAL(bucket2.sigchecks, 2);
+    BOOST_CHECK_EQUAL(count_txs(), 2);
+    check_histogram();
+
+    // Prioritising moves the transaction to the bucket of its modified feerate
+    pool.PrioritiseTransaction(tx2.GetId(), 19900 * SATOSHI);
+    BOOST_CHECK(&get_bucket(tx2.GetId()) == &bucket1);
+    BOOST_CHECK_EQUAL(bucket1.count, 2);
+    BOOST_CHECK_EQUAL(bucket1.sigchecks, 4);
+    BOOST_CHECK_EQUAL(bucket2.count, 0);
+    check_histogram();
+
+    // A negative modified fee goes to the lowest bucket
+    pool.PrioritiseTransaction(tx2.GetId(), -40000 * SATOSHI);
+    BOOST_CHECK(&get_bucket(tx2.GetId()) == &buckets.front());
+    BOOST_CHECK_EQUAL(buckets.front().count, 1);
+    BOOST_CHECK_EQUAL(bucket1.count, 1);
+    check_histogram();
+
+    pool.removeRecursive(CTransaction(tx1), REMOVAL_REASON_DUMMY);
+    BOOST_CHECK_EQUAL(bucket1.count, 0);
+    BOOST_CHECK_EQUAL(bucket1.size, 0);
+    BOOST_CHECK_EQUAL(bucket1.sigchecks, 0);
+    BOOST_CHECK_EQUAL(count_txs(), 1);
+    check_histogram();
+
+    pool.clear();
+    BOOST_CHECK_EQUAL(count_txs(), 0);
+    check_histogram();
+}
+
 BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest) {
     CTxMemPool &pool = *Assert(m_node.mempool);
     LOCK2(cs_main, pool.cs);
@@ -388,6 +573,124 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest) {
     // ... with a 1/4 halflife when mempool is < 1/4 its target size
 }
 
+BOOST_AUTO_TEST_CASE(MempoolSizeLimitPackageTest) {
+    CTxMemPool &pool = *Assert(m_node.mempool);
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    auto make_tx = [](const COutPoint &prevout, int n) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = prevout;
+        tx.vin[0].scriptSig = CScript() << n;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << n << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        return tx;
+    };
+
+    // A low feerate parent whose child pays for both
+    CMutableTransaction parent = make_tx(COutPoint(), 1);
+    CMutableTransaction child = make_tx(COutPoint(parent.GetId(), 0), 2);
+    // An isolated transaction paying more than the parent but less than the
+    // package
+    CMutableTransaction other = make_tx(COutPoint(), 3);
+    pool.addUnchecked(entry.Fee(1000 * SATOSHI).FromTx(parent));
+    pool.addUnchecked(entry.Fee(19000 * SATOSHI).FromTx(child));
+    pool.addUnchecked(entry.Fee(5000 * SATOSHI).FromTx(other));
+
+    // The isolated transaction is evicted instead of the package
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(pool.exists(parent.GetId()));
+    BOOST_CHECK(pool.exists(child.GetId()));
+    BOOST_CHECK(!pool.exists(other.GetId()));
+
+    // Once the isolated transaction is gone, the package goes as a whole
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+    // The rolling minimum fee is the package feerate
+    const CFeeRate package_feerate(
+        20000 * SATOSHI,
+        CTransaction(parent).GetTotalSize() +
+            CTransaction(child).GetTotalSize());
+    BOOST_CHECK_EQUAL(pool.GetMinFee(1).GetFeePerK(),
+                      package_feerate.GetFeePerK() +
+                          MEMPOOL_FULL_FEE_INCREMENT.GetFeePerK());
+
+    // A transaction paying for two low feerate parents
+    CMutableTransaction parent1 = make_tx(COutPoint(), 4);
+    CMutableTransaction parent2 = make_tx(COutPoint(), 5);
+    CMutableTransaction shared_child =
+        make_tx(COutPoint(parent1.GetId(), 0), 6);
+    shared_child.vin.emplace_back(COutPoint(parent2.GetId(), 0));
+    pool.addUnchecked(entry.Fee(3000 * SATOSHI).FromTx(parent1));
+    pool.addUnchecked(entry.Fee(4200 * SATOSHI).FromTx(other));
+    auto add_package = [&]() EXCLUSIVE_LOCKS_REQUIRED(pool.cs) {
+        pool.addUnchecked(entry.Fee(Amount::zero()).FromTx(parent2));
+        pool.addUnchecked(entry.Fee(10000 * SATOSHI).FromTx(shared_child));
+    };
+
+    // The package of the free parent has the lowest score, it is evicted
+    // along with the shared child
+    add_package();
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(!pool.exists(parent2.GetId()));
+    BOOST_CHECK(!pool.exists(shared_child.GetId()));
+    BOOST_CHECK(pool.exists(parent1.GetId()));
+    BOOST_CHECK(pool.exists(other.GetId()));
+    const size_t usage_without_package = pool.DynamicMemoryUsage();
+
+    // Once the shared child is evicted, the other parent is only scored by its
+    // own feerate and goes next, before the isolated transaction
+    add_package();
+    pool.TrimToSize(usage_without_package - 1);
+    BOOST_CHECK(!pool.exists(parent2.GetId()));
+    BOOST_CHECK(!pool.exists(shared_child.GetId()));
+    BOOST_CHECK(!pool.exists(parent1.GetId()));
+    BOOST_CHECK(pool.exists(other.GetId()));
+}
+
+BOOST_AUTO_TEST_CASE(CalculateMemPoolAncestorsLimitTest) {
+    CTxMemPool &pool = *Assert(m_node.mempool);
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // A chain of 4 transactions
+    std::vector<CTransactionRef> chain;
+    COutPoint prevout;
+    for (int i = 0; i < 4; i++) {
+        CMutableTransaction tx;
+        tx.vin.emplace_back(prevout);
+        tx.vout.emplace_back(10 * SATOSHI, CScript() << OP_TRUE);
+        chain.push_back(MakeTransactionRef(tx));
+        prevout = COutPoint(chain.back()->GetId(), 0);
+        pool.addUnchecked(entry.FromTx(chain.back()));
+    }
+    const CTxMemPoolEntryRef &last = **pool.GetIter(chain.back()->GetId());
+    uint64_t ancestors_size{0};
+    for (size_t i = 0; i < 3; i++) {
+        ancestors_size += chain[i]->GetTotalSize();
+    }
+
+    CTxMemPool::setEntries ancestors;
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(last, ancestors, false));
+    BOOST_CHECK_EQUAL(ancestors.size(), 3U);
+
+    // The limits are inclusive
+    ancestors.clear();
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(last, ancestors, false, 3,
+                                               ancestors_size));
+    BOOST_CHECK_EQUAL(ancestors.size(), 3U);
+
+    // The walk stops as soon as a limit is exceeded
+    ancestors.clear();
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(last, ancestors, false, 1));
+    BOOST_CHECK_EQUAL(ancestors.size(), 2U);
+    ancestors.clear();
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(
+        last, ancestors, false, 3, ancestors_size - 1));
+}
+
 // expectedSize can be smaller than correctlyOrderedIds.size(), since we
 // might be testing intermediary states. Just avoiding some slice operations,
 void CheckDisconnectPoolOrder(DisconnectedBlockTransactions &disconnectPool,
@@ -581,4 +884,57 @@ BOOST_AUTO_TEST_CASE(CompareTxMemPoolEntryByModifiedFeeRateTest) {
     checkOrdering(entryB, entryA);
 }
 
+BOOST_FIXTURE_TEST_CASE(MempoolPersistTest, TestChain100Setup) {
+    const CScript spk{
+        GetScriptForDestination(PKHash(coinbaseKey.GetPubKey()))};
+    const CTransactionRef parent =
+        MakeTransactionRef(CreateValidMempoolTransaction(
+            m_coinbase_txns[0], /*input_vout=*/0, /*input_height=*/0,
+            coinbaseKey, spk, /*output_amount=*/49 * COIN,
+            /*submit=*/false));
+    const CTransactionRef child =
+        MakeTransactionRef(CreateValidMempoolTransaction(
+            parent, /*input_vout=*/0, /*input_height=*/101, coinbaseKey, spk,
+            /*output_amount=*/48 * COIN, /*submit=*/false));
+    const int64_t time{GetTime()};
+    const fs::path path{m_args.GetDataDirNet() / "mempool_test.dat"};
+    CTxMemPool &pool = *Assert(m_node.mempool);
+    Chainstate &chainstate = m_node.chainman->ActiveChainstate();
+    const int tip_height{
+        WITH_LOCK(cs_main, return chainstate.m_chain.Height())};
+
+    for (const bool persist_v1_dat : {false, true}) {
+        // Dump a mempool whose transactions entered it at an earlier height
+        CTxMemPool::Options opts{MemPoolOptionsForTest(m_node)};
+        opts.persist_v1_dat = persist_v1_dat;
+        CTxMemPool dump_pool{opts};
+        {
+            LOCK2(cs_main, dump_pool.cs);
+            TestMemPoolEntryHelper entry;
+            entry.Time(time).Height(tip_height - 10);
+            dump_pool.addUnchecked(entry.Fee(COIN).FromTx(parent));
+            dump_pool.addUnchecked(entry.Fee(COIN).FromTx(child));
+        }
+        BOOST_CHECK(kernel::DumpMempool(dump_pool, path, fsbridge::fopen,
+                                        /*skip_file_commit=*/true));
+
+        pool.clear();
+        BOOST_CHECK(kernel::LoadMempool(pool, path, chainstate));
+
+        // Version 1 files don't store the entry height, the transactions are
+        // given the current one instead
+        const unsigned int height(persist_v1_dat ? tip_height
+                                                 : tip_height - 10);
+        LOCK(pool.cs);
+        BOOST_CHECK_EQUAL(pool.size(), 2U);
+        for (const CTransactionRef &tx : {parent, child}) {
+            const auto it = pool.GetIter(tx->GetId());
+            BOOST_REQUIRE(it);
+            BOOST_CHECK_EQUAL((**it)->GetHeight(), height);
+            BOOST_CHECK_EQUAL((**it)->GetFee(), COIN);
+            BOOST_CHECK_EQUAL((**it)->GetTime().count(), time);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
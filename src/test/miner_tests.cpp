@@ -23,6 +23,7 @@
 #include <util/system.h>
 #include <util/time.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 #include <test/util/mining.h>
 #include <test/util/setup_common.h>
@@ -32,8 +33,11 @@
 #include <memory>
 
 using node::BlockAssembler;
+using node::BlockTemplateSelection;
 using node::CBlockTemplate;
 using node::CBlockTemplateEntry;
+using node::TemplateValidityChecker;
+using node::TestBlockTemplateValidity;
 
 namespace miner_tests {
 struct MinerTestingSetup : public TestingSetup {
@@ -828,4 +832,146 @@ BOOST_AUTO_TEST_CASE(TestCBlockTemplateEntry) {
     BOOST_CHECK_EQUAL(txEntry.sigChecks, 10);
 }
 
+BOOST_FIXTURE_TEST_CASE(BlockTemplateSelection_incremental,
+                        TestChain100Setup) {
+    const CScript script{CScript() << OP_TRUE};
+    BlockTemplateSelection selection{*m_node.mempool};
+    RegisterValidationInterface(&selection);
+
+    const auto create_template = [&](BlockTemplateSelection *sel) {
+        BlockAssembler::Options options;
+        options.blockMinFeeRate = blockMinFeeRate;
+        return BlockAssembler{m_node.chainman->ActiveChainstate(),
+                              m_node.mempool.get(), options, sel}
+            .CreateNewBlock(script);
+    };
+    const auto check_same_txs = [&](const CBlockTemplate &a,
+                                    const CBlockTemplate &b) {
+        BOOST_REQUIRE_EQUAL(a.block.vtx.size(), b.block.vtx.size());
+        for (size_t i = 1; i < a.block.vtx.size(); ++i) {
+            BOOST_CHECK_EQUAL(a.block.vtx[i]->GetId(), b.block.vtx[i]->GetId());
+            BOOST_CHECK_EQUAL(a.entries[i].fees, b.entries[i].fees);
+        }
+        BOOST_CHECK_EQUAL(a.entries[0].fees, b.entries[0].fees);
+    };
+
+    // Seed the selection with an empty mempool, once the notifications of the
+    // setup blocks are processed so they don't reset it.
+    SyncWithValidationInterfaceQueue();
+    create_template(&selection);
+    BOOST_CHECK_EQUAL(selection.size(), 0U);
+
+    // A parent and its child are queued as they enter the mempool and appended
+    // by the next template.
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript spk{GetScriptForDestination(PKHash(key.GetPubKey()))};
+    const CTransactionRef parent{
+        MakeTransactionRef(CreateValidMempoolTransaction(
+            m_coinbase_txns[0], 0, 0, coinbaseKey, spk, 49 * COIN))};
+    const CTransactionRef child{MakeTransactionRef(
+        CreateValidMempoolTransaction(parent, 0, 101, key, spk, 48 * COIN))};
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(selection.size(), 0U);
+
+    const auto incremental{create_template(&selection)};
+    BOOST_CHECK_EQUAL(selection.size(), 2U);
+    BOOST_CHECK_EQUAL(incremental->block.vtx.size(), 3U);
+    check_same_txs(*incremental, *create_template(nullptr));
+
+    // Removing the parent removes the child as well.
+    {
+        LOCK(m_node.mempool->cs);
+        m_node.mempool->removeRecursive(*parent,
+                                        MemPoolRemovalReason::CONFLICT);
+    }
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(selection.size(), 0U);
+    BOOST_CHECK_EQUAL(create_template(&selection)->block.vtx.size(), 1U);
+
+    // A new tip drops the selection, it is rebuilt by the next template. The
+    // coinbase spent by the removed parent is the only mature one.
+    CreateValidMempoolTransaction(m_coinbase_txns[0], 0, 0, coinbaseKey, spk,
+                                  47 * COIN);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(create_template(&selection)->block.vtx.size(), 2U);
+    BOOST_CHECK_EQUAL(selection.size(), 1U);
+    CreateAndProcessBlock({}, script);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(selection.size(), 0U);
+    check_same_txs(*create_template(&selection), *create_template(nullptr));
+    BOOST_CHECK_EQUAL(selection.size(), 1U);
+
+    UnregisterValidationInterface(&selection);
+}
+
+BOOST_FIXTURE_TEST_CASE(CreateNewBlock_checktemplate, TestChain100Setup) {
+    const CScript script{CScript() << OP_TRUE};
+    const auto create_template = [&](bool test_block_validity) {
+        BlockAssembler::Options options;
+        options.blockMinFeeRate = blockMinFeeRate;
+        options.testBlockValidity = test_block_validity;
+        return BlockAssembler{m_node.chainman->ActiveChainstate(),
+                              m_node.mempool.get(), options}
+            .CreateNewBlock(script);
+    };
+
+    // Mature the second coinbase
+    CreateAndProcessBlock({}, script);
+
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript spk{GetScriptForDestination(PKHash(key.GetPubKey()))};
+    const CTransactionRef parent{
+        MakeTransactionRef(CreateValidMempoolTransaction(
+            m_coinbase_txns[0], 0, 0, coinbaseKey, spk, 49 * COIN))};
+    CreateValidMempoolTransaction(parent, 0, 101, key, spk, 48 * COIN);
+    CreateValidMempoolTransaction(m_coinbase_txns[1], 0, 0, coinbaseKey, spk,
+                                  49 * COIN);
+
+    // The template only gets the consistency checks and is the same as the
+    // fully validated one.
+    const auto checked{create_template(false)};
+    const auto validated{create_template(true)};
+    BOOST_CHECK(!checked->fullyValidated);
+    BOOST_CHECK(validated->fullyValidated);
+    BOOST_REQUIRE_EQUAL(checked->block.vtx.size(), 4U);
+    BOOST_REQUIRE_EQUAL(checked->block.vtx.size(),
+                        validated->block.vtx.size());
+    for (size_t i = 0; i < checked->block.vtx.size(); ++i) {
+        BOOST_CHECK_EQUAL(checked->block.vtx[i]->GetId(),
+                          validated->block.vtx[i]->GetId());
+        BOOST_CHECK_EQUAL(checked->entries[i].fees, validated->entries[i].fees);
+    }
+    const uint64_t max_size{DEFAULT_MAX_GENERATED_BLOCK_SIZE};
+    BOOST_CHECK(
+        TestBlockTemplateValidity(*m_node.chainman, checked->block, max_size));
+
+    // A template missing a parent fails the background validation.
+    CBlock block{checked->block};
+    const auto it{std::find_if(block.vtx.begin(), block.vtx.end(),
+                               [&](const CTransactionRef &tx) {
+                                   return tx->GetId() == parent->GetId();
+                               })};
+    BOOST_REQUIRE(it != block.vtx.end());
+    block.vtx.erase(it);
+    BOOST_CHECK(!TestBlockTemplateValidity(*m_node.chainman, block, max_size));
+
+    // The checker runs the same validation on its own thread.
+    {
+        TemplateValidityChecker checker{*m_node.chainman};
+        checker.Schedule(1, checked->block, max_size);
+        checker.Schedule(2, block, max_size);
+        while (checker.LastInvalidTemplateId() != 2) {
+            UninterruptibleSleep(std::chrono::milliseconds{10});
+        }
+        // A valid template does not reset the last invalid template id.
+        checker.Schedule(3, checked->block, max_size);
+    }
+
+    // A stale template is not checked.
+    block.hashPrevBlock = BlockHash();
+    BOOST_CHECK(TestBlockTemplateValidity(*m_node.chainman, block, max_size));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -22,11 +22,13 @@
 #include <test/util/validation.h>
 #include <threadsafety.h>
 #include <timedata.h>
+#include <txmempool.h>
 #include <util/strencodings.h>
 #include <util/string.h>
 #include <util/translation.h> // for bilingual_str
 #include <version.h>
 
+#include <test/util/net.h>
 #include <test/util/setup_common.h>
 
 #include <boost/test/unit_test.hpp>
@@ -39,6 +41,7 @@
 #include <functional>
 #include <ios>
 #include <memory>
+#include <set>
 #include <string>
 
 using namespace std::literals;
@@ -1375,6 +1378,97 @@ BOOST_AUTO_TEST_CASE(initial_advertise_from_version_message) {
     TestOnlyResetTimeData();
 }
 
+BOOST_AUTO_TEST_CASE(inv_skips_transactions_removed_from_mempool) {
+    LOCK(NetEventsInterface::g_msgproc_mutex);
+
+    const Config &config = GetConfig();
+    ConnmanTestMsg &connman = static_cast<ConnmanTestMsg &>(*m_node.connman);
+    PeerManager &peerman = *m_node.peerman;
+    CTxMemPool &mempool = *m_node.mempool;
+    m_node.args->ForceSetArg("-capturemessages", "1");
+
+    const int64_t start_time{GetTime()};
+    SetMockTime(start_time);
+
+    // Two outbound peers, which are announced the transactions each time
+    // SendMessages is called at a new time
+    std::vector<std::unique_ptr<CNode>> peers;
+    for (uint32_t i = 0; i < 2; ++i) {
+        peers.push_back(std::make_unique<CNode>(
+            /*id=*/i, /*hSocketIn=*/INVALID_SOCKET,
+            /*addrIn=*/CAddress{CService{ip(0x01020304 + i), 8333}, NODE_NONE},
+            /*nKeyedNetGroupIn=*/0, /*nLocalHostNonceIn=*/0,
+            /*nLocalExtraEntropyIn=*/0, /*addrBindIn=*/CAddress{},
+            /*addrNameIn=*/std::string{},
+            /*conn_type_in=*/ConnectionType::OUTBOUND_FULL_RELAY,
+            /*inbound_onion=*/false));
+        connman.Handshake(
+            /*node=*/*peers.back(),
+            /*successfully_connected=*/true,
+            /*remote_services=*/ServiceFlags(NODE_NETWORK),
+            /*local_services=*/ServiceFlags(NODE_NETWORK),
+            /*permission_flags=*/NetPermissionFlags::None,
+            /*version=*/PROTOCOL_VERSION,
+            /*relay_txs=*/true);
+    }
+    TestOnlyResetTimeData();
+
+    std::vector<CMutableTransaction> txs(2);
+    {
+        LOCK2(cs_main, mempool.cs);
+        TestMemPoolEntryHelper entry;
+        for (size_t i = 0; i < txs.size(); ++i) {
+            txs[i].vin.resize(1);
+            txs[i].vin[0].scriptSig = CScript() << int64_t(i);
+            txs[i].vout.resize(1);
+            txs[i].vout[0].scriptPubKey = CScript() << OP_TRUE;
+            txs[i].vout[0].nValue = COIN;
+            mempool.addUnchecked(entry.Fee(1000 * SATOSHI).FromTx(txs[i]));
+        }
+    }
+    for (const CMutableTransaction &tx : txs) {
+        peerman.RelayTransaction(tx.GetId());
+    }
+
+    std::map<CService, std::set<TxId>> announced;
+    const auto CaptureMessageOrig = CaptureMessage;
+    CaptureMessage = [&announced](const CAddress &addr,
+                                  const std::string &msg_type,
+                                  Span<const uint8_t> data,
+                                  bool is_incoming) -> void {
+        if (!is_incoming && msg_type == NetMsgType::INV) {
+            CDataStream s(data, SER_NETWORK, PROTOCOL_VERSION);
+            std::vector<CInv> invs;
+            s >> invs;
+            for (const CInv &inv : invs) {
+                if (inv.IsMsgTx()) {
+                    announced[addr].insert(TxId(inv.hash));
+                }
+            }
+        }
+    };
+
+    SetMockTime(start_time + 1);
+    peerman.SendMessages(config, peers[0].get());
+    BOOST_CHECK(announced[peers[0]->addr] ==
+                std::set<TxId>({txs[0].GetId(), txs[1].GetId()}));
+
+    // The transaction removed after the first peer was served is not
+    // announced to the second one
+    WITH_LOCK(mempool.cs, mempool.removeRecursive(
+                              CTransaction(txs[0]),
+                              MemPoolRemovalReason::CONFLICT));
+    peerman.SendMessages(config, peers[1].get());
+    BOOST_CHECK(announced[peers[1]->addr] == std::set<TxId>({txs[1].GetId()}));
+
+    CaptureMessage = CaptureMessageOrig;
+    for (auto &peer : peers) {
+        peerman.FinalizeNode(config, *peer);
+    }
+    SetMockTime(0);
+    m_node.args->ForceSetArg("-capturemessages", "0");
+}
+
 BOOST_AUTO_TEST_CASE(already_connected_to_address) {
     CConnmanTest connman(GetConfig(), 0x1337, 0x1337, *m_node.addrman);
 
@@ -20,6 +20,9 @@
 #include <univalue.h>
 
 #include <any>
+#include <chrono>
+#include <set>
+#include <thread>
 
 class RPCTestingSetup : public TestingSetup {
 public:
@@ -558,4 +561,130 @@ BOOST_AUTO_TEST_CASE(help_example) {
                    HelpExampleRpcNamed("foo", {{"arg", "true"}}));
 }
 
+BOOST_AUTO_TEST_CASE(rpc_batch_order) {
+    if (RPCIsInWarmup(nullptr)) {
+        SetRPCWarmupFinished();
+    }
+    GlobalConfig config;
+    RPCServer server;
+    JSONRPCRequest jreq;
+    jreq.context = &m_node;
+
+    // Runs of read-only calls and other calls are answered in request order.
+    UniValue batch(UniValue::VARR);
+    for (int i = 0; i < 10; i++) {
+        const UniValue params{i == 5 ? UniValue(UniValue::VARR)
+                                     : UniValue(UniValue::VOBJ)};
+        batch.push_back(JSONRPCRequestObj(
+            i == 5 ? "getbestblockhash" : "getblockcount", params, i));
+    }
+    batch.push_back(JSONRPCRequestObj("uptime", NullUniValue, 10));
+    batch.push_back(JSONRPCRequestObj("getblockhash", NullUniValue, 11));
+    batch.push_back(JSONRPCRequestObj("getblockhash", NullUniValue, 12));
+
+    UniValue replies;
+    BOOST_REQUIRE(replies.read(JSONRPCExecBatch(config, server, jreq, batch,
+                                                batch.write().size())));
+    BOOST_REQUIRE_EQUAL(replies.size(), batch.size());
+    for (size_t i = 0; i < replies.size(); i++) {
+        BOOST_CHECK_EQUAL(replies[i].find_value("id").get_int(), int(i));
+        const UniValue &error = replies[i].find_value("error");
+        BOOST_CHECK_EQUAL(error.isNull(), i < 11);
+    }
+    BOOST_CHECK_EQUAL(replies[0].find_value("result").get_int(), 0);
+    BOOST_CHECK(replies[5].find_value("result").isStr());
+    BOOST_CHECK(replies[10].find_value("result").isNum());
+
+    // With the executor started, the concurrent calls run on several threads
+    // and are still answered in request order.
+    Mutex threads_mutex;
+    std::set<std::thread::id> threads;
+    const CRPCCommand echo_concurrent{
+        "test",
+        "echoconcurrent",
+        [&](const Config &, const JSONRPCRequest &request, UniValue &result,
+            bool) {
+            WITH_LOCK(threads_mutex,
+                      threads.insert(std::this_thread::get_id()));
+            UninterruptibleSleep(std::chrono::milliseconds{20});
+            result = request.params[0];
+            return true;
+        },
+        {"arg"},
+        /*unique_id=*/0,
+        /*concurrent=*/true};
+    tableRPC.appendCommand(echo_concurrent.name, &echo_concurrent);
+    BOOST_CHECK(server.IsConcurrent("echoconcurrent"));
+    BOOST_CHECK(!server.IsConcurrent("uptime"));
+
+    batch = UniValue(UniValue::VARR);
+    for (int i = 0; i < 20; i++) {
+        UniValue params(UniValue::VARR);
+        params.push_back(i);
+        batch.push_back(JSONRPCRequestObj(
+            i == 10 ? "uptime" : "echoconcurrent", params, i));
+    }
+    StartRPC();
+    BOOST_REQUIRE(replies.read(JSONRPCExecBatch(config, server, jreq, batch,
+                                                batch.write().size())));
+    InterruptRPC();
+    StopRPC();
+    tableRPC.removeCommand(echo_concurrent.name, &echo_concurrent);
+
+    BOOST_REQUIRE_EQUAL(replies.size(), batch.size());
+    for (size_t i = 0; i < replies.size(); i++) {
+        BOOST_CHECK_EQUAL(replies[i].find_value("id").get_int(), int(i));
+        if (i != 10) {
+            BOOST_CHECK_EQUAL(replies[i].find_value("result").get_int(),
+                              int(i));
+        }
+    }
+    BOOST_CHECK(replies[10].find_value("error").isObject());
+    BOOST_CHECK_GT(WITH_LOCK(threads_mutex, return threads.size()), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(rpc_method_stats) {
+    auto calls = [this](const std::string &method) {
+        const UniValue stats{
+            CallRPC("getrpcstats").find_value("methods").find_value(method)};
+        return stats.isNull() ? std::make_pair(0, 0)
+                              : std::make_pair(
+                                    stats.find_value("calls").get_int(),
+                                    stats.find_value("errors").get_int());
+    };
+
+    const auto before{calls("getblockhash")};
+    BOOST_CHECK_NO_THROW(CallRPC("getblockhash 0"));
+    BOOST_CHECK_THROW(CallRPC("getblockhash -1"), std::runtime_error);
+    const auto after{calls("getblockhash")};
+    BOOST_CHECK_EQUAL(after.first, before.first + 2);
+    BOOST_CHECK_EQUAL(after.second, before.second + 1);
+
+    // Help requests are not accounted
+    JSONRPCRequest help;
+    help.strMethod = "getblockhash";
+    help.mode = JSONRPCRequest::GET_HELP;
+    BOOST_CHECK_THROW(tableRPC.execute(GlobalConfig(), help), UniValue);
+    BOOST_CHECK(calls("getblockhash") == after);
+
+    // The batch elements are accounted to their method with the batch size
+    // split between them
+    GlobalConfig config;
+    RPCServer server;
+    JSONRPCRequest jreq;
+    jreq.context = &m_node;
+    UniValue batch(UniValue::VARR);
+    batch.push_back(JSONRPCRequestObj("getblockcount", NullUniValue, 0));
+    CallRPC("getblockcount");
+    const RPCMethodStats prev{GetRPCMethodStats().at("getblockcount")};
+    const size_t request_size{100};
+    const std::string reply{
+        JSONRPCExecBatch(config, server, jreq, batch, request_size)};
+    const RPCMethodStats stats{GetRPCMethodStats().at("getblockcount")};
+    BOOST_CHECK_EQUAL(stats.calls, prev.calls + 1);
+    BOOST_CHECK_EQUAL(stats.bytes_in, prev.bytes_in + request_size);
+    // The reply is wrapped into "[...]\n"
+    BOOST_CHECK_EQUAL(stats.bytes_out, prev.bytes_out + reply.size() - 3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -103,6 +103,13 @@ BOOST_AUTO_TEST_CASE(processing_items) {
         BOOST_CHECK(p.getItem(8) == nullptr);
         BOOST_CHECK(p.getItem(9) == nullptr);
 
+        for (uint64_t shortid : shortids) {
+            BOOST_CHECK(p.hasShortId(shortid));
+        }
+        for (uint64_t shortid : {0, 1, 2, 5, 10}) {
+            BOOST_CHECK(!p.hasShortId(shortid));
+        }
+
         // Add a missing shortid
         auto item3 = std::make_shared<uint32_t>(3);
         BOOST_CHECK_EQUAL(p.matchKnownItem(3, item3), 1);
@@ -7,7 +7,10 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <mutex>
+#include <thread>
 
 namespace {
 template <typename MutexType>
@@ -138,4 +141,40 @@ BOOST_AUTO_TEST_CASE(double_lock_recursive_mutex) {
 }
 #endif /* DEBUG_LOCKORDER */
 
+BOOST_AUTO_TEST_CASE(lock_wait_recorder) {
+    Mutex mutex;
+    Mutex other;
+    LockWaitRecorder recorder;
+    BOOST_CHECK_EQUAL(LockWaitRecorder::Current(), &recorder);
+
+    // Uncontended locks are not accounted
+    {
+        LOCK(other);
+    }
+    BOOST_CHECK(recorder.Get(&other) == std::chrono::nanoseconds{0});
+
+    std::atomic<bool> locked{false};
+    std::thread holder([&] {
+        LOCK(mutex);
+        locked = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    });
+    while (!locked) {
+        std::this_thread::yield();
+    }
+    {
+        LOCK(mutex);
+    }
+    holder.join();
+    BOOST_CHECK(recorder.Get(&mutex) > std::chrono::nanoseconds{0});
+    BOOST_CHECK(recorder.Get(&other) == std::chrono::nanoseconds{0});
+
+    {
+        // The innermost recorder gets the wait times
+        LockWaitRecorder nested;
+        BOOST_CHECK_EQUAL(LockWaitRecorder::Current(), &nested);
+    }
+    BOOST_CHECK_EQUAL(LockWaitRecorder::Current(), &recorder);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -229,6 +229,13 @@ BOOST_FIXTURE_TEST_CASE(noncontextual_package_tests, TestChain100Setup) {
         // IsChildWithParents does not detect unsorted parents.
         BOOST_CHECK(
             IsChildWithParents({tx_parent_also_child, tx_parent, tx_child}));
+        BOOST_CHECK(
+            IsAncestorPackage({tx_parent, tx_parent_also_child, tx_child}));
+        BOOST_CHECK(IsAncestorPackage({tx_parent, tx_parent_also_child}));
+        BOOST_CHECK(!IsAncestorPackage({tx_child}));
+        // Not all the ancestors need to be present.
+        BOOST_CHECK(IsAncestorPackage({tx_parent, tx_child}));
+        BOOST_CHECK(!IsAncestorPackage({tx_parent_also_child, tx_parent}));
         BOOST_CHECK(
             CheckPackage({tx_parent, tx_parent_also_child, tx_child}, state));
         BOOST_CHECK(
@@ -420,4 +427,88 @@ BOOST_FIXTURE_TEST_CASE(package_submission_tests, TestChain100Setup) {
                           "txn-already-known");
     }
 }
+BOOST_FIXTURE_TEST_CASE(ancestor_package_submission_tests,
+                        TestChain100Setup) {
+    unsigned int expected_pool_size = m_node.mempool->size();
+
+    // A chain of 3 transactions, each spending the previous one.
+    Package package_3gen;
+    CTransactionRef tx_prev = m_coinbase_txns[0];
+    CKey prev_key = coinbaseKey;
+    int input_height = 0;
+    for (int64_t i = 0; i < 3; ++i) {
+        CKey key;
+        key.MakeNewKey(true);
+        auto mtx = CreateValidMempoolTransaction(
+            /*input_transaction=*/tx_prev, /*input_vout=*/0,
+            /*input_height=*/input_height, /*input_signing_key=*/prev_key,
+            /*output_destination=*/
+            GetScriptForDestination(PKHash(key.GetPubKey())),
+            /*output_amount=*/Amount((49 - i) * COIN), /*submit=*/false);
+        tx_prev = MakeTransactionRef(mtx);
+        prev_key = key;
+        input_height = 101;
+        package_3gen.push_back(tx_prev);
+    }
+
+    // An unrelated transaction is not an ancestor of the child.
+    auto mtx_unrelated = CreateValidMempoolTransaction(
+        /*input_transaction=*/m_coinbase_txns[1], /*input_vout=*/0,
+        /*input_height=*/0, /*input_signing_key=*/coinbaseKey,
+        /*output_destination=*/GetScriptForDestination(
+            PKHash(coinbaseKey.GetPubKey())),
+        /*output_amount=*/Amount(49 * COIN), /*submit=*/false);
+    {
+        LOCK(cs_main);
+        const auto result_unrelated = ProcessNewAncestorPackage(
+            m_node.chainman->ActiveChainstate(), *m_node.mempool,
+            {MakeTransactionRef(mtx_unrelated), package_3gen[0]});
+        BOOST_CHECK_EQUAL(result_unrelated.m_state.GetResult(),
+                          PackageValidationResult::PCKG_POLICY);
+        BOOST_CHECK_EQUAL(result_unrelated.m_state.GetRejectReason(),
+                          "package-not-child-with-ancestors");
+        BOOST_CHECK_EQUAL(m_node.mempool->size(), expected_pool_size);
+    }
+
+    // The child alone misses its ancestors.
+    {
+        LOCK(cs_main);
+        const auto result_missing = ProcessNewAncestorPackage(
+            m_node.chainman->ActiveChainstate(), *m_node.mempool,
+            {package_3gen[1], package_3gen[2]});
+        BOOST_CHECK_EQUAL(result_missing.m_state.GetResult(),
+                          PackageValidationResult::PCKG_TX);
+        BOOST_CHECK_EQUAL(m_node.mempool->size(), expected_pool_size);
+    }
+
+    // Once the grandparent is in the mempool, the parent and the child are
+    // accepted as a package.
+    {
+        LOCK(cs_main);
+        const auto result_grandparent = AcceptToMemoryPool(
+            m_node.chainman->ActiveChainstate(), package_3gen[0], GetTime(),
+            /*bypass_limits=*/false);
+        BOOST_CHECK(result_grandparent.m_result_type ==
+                    MempoolAcceptResult::ResultType::VALID);
+        expected_pool_size += 1;
+
+        const auto result_package = ProcessNewAncestorPackage(
+            m_node.chainman->ActiveChainstate(), *m_node.mempool, package_3gen);
+        BOOST_CHECK_MESSAGE(result_package.m_state.IsValid(),
+                            "Package validation unexpectedly failed: "
+                                << result_package.m_state.GetRejectReason());
+        expected_pool_size += 2;
+        BOOST_CHECK_EQUAL(m_node.mempool->size(), expected_pool_size);
+
+        auto it_grandparent =
+            result_package.m_tx_results.find(package_3gen[0]->GetId());
+        BOOST_CHECK(it_grandparent != result_package.m_tx_results.end());
+        BOOST_CHECK(it_grandparent->second.m_result_type ==
+                    MempoolAcceptResult::ResultType::MEMPOOL_ENTRY);
+        for (const CTransactionRef &tx : package_3gen) {
+            BOOST_CHECK(m_node.mempool->exists(tx->GetId()));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -12,6 +12,7 @@
 #include <script/sighashtype.h>
 #include <script/sign.h>
 #include <script/signingprovider.h>
+#include <script/standard.h>
 #include <txmempool.h>
 #include <validation.h>
 
@@ -684,4 +685,135 @@ BOOST_AUTO_TEST_CASE(scriptcache_values) {
     CHECK_CACHE_HAS(key1A, 42);
 }
 
+BOOST_FIXTURE_TEST_CASE(precheck_transaction_scripts, TestChain100Setup) {
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
+                                     << OP_CHECKSIG;
+    // Mature the first three coinbases, the next ones are immature
+    for (int i = 0; i < 2; ++i) {
+        CreateAndProcessBlock({}, scriptPubKey);
+    }
+
+    const auto MakeSpend = [&](size_t coinbase, Amount value, bool sign) {
+        CMutableTransaction spend;
+        spend.nVersion = 1;
+        spend.vin.resize(1);
+        spend.vin[0].prevout =
+            COutPoint(m_coinbase_txns[coinbase]->GetId(), 0);
+        spend.vout.resize(1);
+        spend.vout[0].nValue = value;
+        spend.vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<uint8_t> vchSig;
+        uint256 hash = SignatureHash(
+            scriptPubKey, CTransaction(spend), 0, SigHashType().withForkId(),
+            m_coinbase_txns[coinbase]->vout[0].nValue);
+        BOOST_CHECK(coinbaseKey.SignECDSA(hash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        if (!sign) {
+            // Invalidate the signature
+            vchSig[10] ^= 0x01;
+        }
+        spend.vin[0].scriptSig << vchSig;
+        return MakeTransactionRef(spend);
+    };
+
+    const CTransactionRef valid = MakeSpend(0, 11 * CENT, true);
+    const CTransactionRef double_spend = MakeSpend(0, 12 * CENT, true);
+    const CTransactionRef invalid = MakeSpend(1, 11 * CENT, false);
+    const CTransactionRef no_fee =
+        MakeSpend(2, m_coinbase_txns[2]->vout[0].nValue, true);
+    // The fourth coinbase is not mature yet
+    const CTransactionRef immature = MakeSpend(3, 11 * CENT, true);
+    CMutableTransaction orphan{*valid};
+    orphan.vin[0].prevout = COutPoint(valid->GetId(), 0);
+
+    // Only the valid transaction gets its scripts verified ahead of its
+    // admission
+    ChainstateManager &chainman = *m_node.chainman;
+    BOOST_CHECK_EQUAL(
+        chainman.PreCheckTransactionScripts({valid, double_spend, invalid,
+                                             no_fee, immature,
+                                             MakeTransactionRef(orphan)}),
+        1U);
+    BOOST_CHECK_EQUAL(chainman.PreCheckTransactionScripts({immature}), 0U);
+    BOOST_CHECK_EQUAL(chainman.PreCheckTransactionScripts({double_spend}),
+                      1U);
+
+    const MempoolAcceptResult valid_result =
+        WITH_LOCK(cs_main, return chainman.ProcessTransaction(valid));
+    BOOST_CHECK(valid_result.m_result_type ==
+                MempoolAcceptResult::ResultType::VALID);
+    // The spends of coins spent by the mempool are not checked
+    BOOST_CHECK_EQUAL(chainman.PreCheckTransactionScripts({double_spend}),
+                      0U);
+
+    LOCK(cs_main);
+    // The others are rejected as if they had not been checked beforehand
+    const MempoolAcceptResult invalid_result =
+        chainman.ProcessTransaction(invalid);
+    BOOST_CHECK(invalid_result.m_state.GetResult() ==
+                TxValidationResult::TX_CONSENSUS);
+    BOOST_CHECK_EQUAL(invalid_result.m_state.GetRejectReason().rfind(
+                          "mandatory-script-verify-flag-failed", 0),
+                      0U);
+    BOOST_CHECK_EQUAL(
+        chainman.ProcessTransaction(no_fee).m_state.GetRejectReason(),
+        "min relay fee not met");
+    BOOST_CHECK_EQUAL(
+        chainman.ProcessTransaction(immature).m_state.GetRejectReason(),
+        "bad-txns-premature-spend-of-coinbase");
+    BOOST_CHECK_EQUAL(
+        chainman.ProcessTransaction(double_spend).m_state.GetRejectReason(),
+        "txn-mempool-conflict");
+
+    // The failure recorded by the precheck is used once, and matches the one
+    // found by verifying the scripts again
+    const MempoolAcceptResult verified_result =
+        chainman.ProcessTransaction(invalid);
+    BOOST_CHECK(verified_result.m_state.GetResult() ==
+                TxValidationResult::TX_CONSENSUS);
+    BOOST_CHECK_EQUAL(verified_result.m_state.GetRejectReason(),
+                      invalid_result.m_state.GetRejectReason());
+}
+
+BOOST_FIXTURE_TEST_CASE(precheck_transaction_batch_scripts,
+                        TestChain100Setup) {
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript spk{GetScriptForDestination(PKHash(key.GetPubKey()))};
+
+    // A parent spending a coinbase and a child spending the parent
+    const CTransactionRef parent =
+        MakeTransactionRef(CreateValidMempoolTransaction(
+            m_coinbase_txns[0], /*input_vout=*/0, /*input_height=*/0,
+            coinbaseKey, spk, /*output_amount=*/49 * COIN,
+            /*submit=*/false));
+    const CTransactionRef child =
+        MakeTransactionRef(CreateValidMempoolTransaction(
+            parent, /*input_vout=*/0, /*input_height=*/101, key, spk,
+            /*output_amount=*/48 * COIN, /*submit=*/false));
+
+    Chainstate &chainstate = m_node.chainman->ActiveChainstate();
+    CTxMemPool &pool = *m_node.mempool;
+    LOCK2(cs_main, pool.cs);
+    // The child can only be checked after its parent
+    BOOST_CHECK_EQUAL(PreCheckTransactionScripts(chainstate, pool,
+                                                 {child, parent}),
+                      1U);
+    BOOST_CHECK_EQUAL(PreCheckTransactionScripts(chainstate, pool,
+                                                 {parent, child}),
+                      2U);
+
+    for (const CTransactionRef &tx : {parent, child}) {
+        BOOST_CHECK(AcceptToMemoryPool(chainstate, tx, GetTime(),
+                                       /*bypass_limits=*/true)
+                        .m_result_type ==
+                    MempoolAcceptResult::ResultType::VALID);
+    }
+    // Transactions already in the mempool are not checked again
+    BOOST_CHECK_EQUAL(PreCheckTransactionScripts(chainstate, pool,
+                                                 {parent, child}),
+                      0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
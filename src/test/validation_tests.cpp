@@ -11,6 +11,7 @@
 #include <consensus/amount.h>
 #include <consensus/consensus.h>
 #include <net.h>
+#include <pow/pow.h>
 #include <primitives/transaction.h>
 #include <streams.h>
 #include <uint256.h>
@@ -76,6 +77,39 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test) {
     BOOST_CHECK_EQUAL(nSum, int64_t(2099999997690000LL) * SATOSHI);
 }
 
+BOOST_AUTO_TEST_CASE(has_valid_proof_of_work) {
+    // The regtest proof of work limit makes valid headers cheap to mine
+    const auto chainParams = CreateChainParams(CBaseChainParams::REGTEST);
+    const Consensus::Params &params = chainParams->GetConsensus();
+    const uint32_t nBits = UintToArith256(params.powLimit).GetCompact();
+
+    // Build a batch of headers with a valid proof of work
+    std::vector<CBlockHeader> headers(500);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        CBlockHeader &header = headers[i];
+        header.nTime = i;
+        header.nBits = nBits;
+        while (!CheckProofOfWork(header.GetHash(), nBits, params)) {
+            ++header.nNonce;
+        }
+    }
+
+    std::vector<BlockHash> hashes;
+    BOOST_CHECK(HasValidProofOfWork(headers, params, hashes));
+    BOOST_CHECK_EQUAL(hashes.size(), headers.size());
+    for (size_t i = 0; i < headers.size(); ++i) {
+        BOOST_CHECK(hashes[i] == headers[i].GetHash());
+    }
+
+    // Invalidate the proof of work of a single header
+    CBlockHeader &header = headers[321];
+    do {
+        ++header.nNonce;
+    } while (CheckProofOfWork(header.GetHash(), nBits, params));
+    BOOST_CHECK(!HasValidProofOfWork(headers, params, hashes));
+    BOOST_CHECK(!HasValidProofOfWork(headers, params));
+}
+
 static CBlock makeLargeDummyBlock(const size_t num_tx) {
     CBlock block;
     block.vtx.reserve(num_tx);
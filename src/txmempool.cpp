@@ -25,16 +25,84 @@
 #include <cmath>
 #include <limits>
 
-bool CTxMemPool::CalculateAncestors(
-    setEntries &setAncestors,
-    CTxMemPoolEntry::Parents &staged_ancestors) const {
+/**
+ * The fee histogram buckets start at these multiples of a power of ten, from
+ * 1000 sat/kB (the default minimum relay feerate) up to the top bucket at
+ * 10,000,000 sat/kB. This gives about 20% feerate resolution.
+ */
+static constexpr int64_t FEE_HISTOGRAM_MANTISSAS[] = {10, 12, 14, 17, 20, 25,
+                                                      30, 40, 50, 60, 70, 80};
+static constexpr int64_t FEE_HISTOGRAM_MIN_FEERATE = 1000;
+static constexpr int64_t FEE_HISTOGRAM_MAX_FEERATE = 10'000'000;
+
+FeeRateHistogram::FeeRateHistogram() {
+    // Below the minimum relay feerate, for prioritised transactions
+    m_buckets.emplace_back();
+    for (int64_t decade = FEE_HISTOGRAM_MIN_FEERATE;
+         decade < FEE_HISTOGRAM_MAX_FEERATE; decade *= 10) {
+        for (const int64_t mantissa : FEE_HISTOGRAM_MANTISSAS) {
+            m_buckets.emplace_back().min_feerate =
+                CFeeRate(mantissa * decade / 10 * SATOSHI);
+        }
+    }
+    m_buckets.emplace_back().min_feerate =
+        CFeeRate(FEE_HISTOGRAM_MAX_FEERATE * SATOSHI);
+}
+
+FeeRateBucket &FeeRateHistogram::GetBucket(const CFeeRate &feerate) {
+    // The last bucket starting at or below the feerate. A negative feerate,
+    // after a negative prioritisation, goes to the first bucket.
+    auto it = std::upper_bound(
+        m_buckets.begin(), m_buckets.end(), feerate,
+        [](const CFeeRate &lhs, const FeeRateBucket &rhs) {
+            return lhs < rhs.min_feerate;
+        });
+    return it == m_buckets.begin() ? *it : *std::prev(it);
+}
+
+void FeeRateHistogram::AddTx(const CTxMemPoolEntry &entry) {
+    FeeRateBucket &bucket = GetBucket(entry.GetModifiedFeeRate());
+    bucket.count++;
+    bucket.size += entry.GetTxSize();
+    bucket.sigchecks += entry.GetSigChecks();
+}
+
+void FeeRateHistogram::RemoveTx(const CTxMemPoolEntry &entry) {
+    FeeRateBucket &bucket = GetBucket(entry.GetModifiedFeeRate());
+    assert(bucket.count > 0);
+    bucket.count--;
+    bucket.size -= entry.GetTxSize();
+    bucket.sigchecks -= entry.GetSigChecks();
+}
+
+void FeeRateHistogram::Clear() {
+    for (FeeRateBucket &bucket : m_buckets) {
+        bucket.count = 0;
+        bucket.size = 0;
+        bucket.sigchecks = 0;
+    }
+}
+
+bool CTxMemPool::CalculateAncestors(setEntries &setAncestors,
+                                    CTxMemPoolEntry::Parents &staged_ancestors,
+                                    uint64_t limit_count,
+                                    uint64_t limit_size) const {
+    uint64_t total_size{0};
     while (!staged_ancestors.empty()) {
-        const auto stage = staged_ancestors.begin()->get();
+        const CTxMemPoolEntryLink stage = staged_ancestors.back();
+        staged_ancestors.pop_back();
 
-        txiter stageit = mapTx.find(stage->GetTx().GetId());
+        txiter stageit = mapTx.find(stage.get()->GetTx().GetId());
         assert(stageit != mapTx.end());
-        setAncestors.insert(stageit);
-        staged_ancestors.erase(staged_ancestors.begin());
+        // An ancestor shared by several staged entries can be staged more than
+        // once, it is only walked the first time.
+        if (!setAncestors.insert(stageit).second) {
+            continue;
+        }
+        total_size += (*stageit)->GetTxSize();
+        if (setAncestors.size() > limit_count || total_size > limit_size) {
+            return false;
+        }
 
         const CTxMemPoolEntry::Parents &parents =
             (*stageit)->GetMemPoolParentsConst();
@@ -44,7 +112,7 @@ bool CTxMemPool::CalculateAncestors(
 
             // If this is a new ancestor, add it.
             if (setAncestors.count(parent_it) == 0) {
-                staged_ancestors.insert(parent);
+                staged_ancestors.push_back(parent);
             }
         }
     }
@@ -54,7 +122,8 @@ bool CTxMemPool::CalculateAncestors(
 
 bool CTxMemPool::CalculateMemPoolAncestors(
     const CTxMemPoolEntryRef &entry, setEntries &setAncestors,
-    bool fSearchForParents /* = true */) const {
+    bool fSearchForParents /* = true */, uint64_t limit_count,
+    uint64_t limit_size) const {
     CTxMemPoolEntry::Parents staged_ancestors;
     const CTransaction &tx = entry->GetTx();
 
@@ -67,7 +136,7 @@ bool CTxMemPool::CalculateMemPoolAncestors(
             if (!piter) {
                 continue;
             }
-            staged_ancestors.insert(**piter);
+            staged_ancestors.push_back(**piter);
         }
     } else {
         // If we're not searching for parents, we require this to be an entry in
@@ -75,7 +144,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(
         staged_ancestors = entry->GetMemPoolParentsConst();
     }
 
-    return CalculateAncestors(setAncestors, staged_ancestors);
+    return CalculateAncestors(setAncestors, staged_ancestors, limit_count,
+                              limit_size);
 }
 
 void CTxMemPool::UpdateParentsOf(bool add, txiter it) {
@@ -87,29 +157,31 @@ void CTxMemPool::UpdateParentsOf(bool add, txiter it) {
     }
 }
 
-void CTxMemPool::UpdateChildrenForRemoval(txiter it) {
-    const CTxMemPoolEntry::Children &children =
-        (*it)->GetMemPoolChildrenConst();
-    for (const auto &child : children) {
-        auto updateIt = mapTx.find(child.get()->GetTx().GetId());
-        assert(updateIt != mapTx.end());
-        UpdateParent(updateIt, it, false);
-    }
-}
-
 void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove) {
+    // Only the entries that stay in the mempool have their links updated: the
+    // links between two removed entries go away along with them. This makes
+    // the removal of a large set, such as the transactions of a block, cost
+    // the same as the removal of isolated transactions.
     for (txiter removeIt : entriesToRemove) {
-        // Note that UpdateParentsOf severs the child links that point to
-        // removeIt in the entries for the parents of removeIt.
-        UpdateParentsOf(false, removeIt);
-    }
+        // Sever the child links that point to removeIt in the entries for the
+        // parents of removeIt.
+        for (const auto &parent : (*removeIt)->GetMemPoolParentsConst()) {
+            auto parent_it = mapTx.find(parent.get()->GetTx().GetId());
+            assert(parent_it != mapTx.end());
+            if (entriesToRemove.count(parent_it) == 0) {
+                UpdateChild(parent_it, removeIt, false);
+            }
+        }
 
-    // After updating all the parent links, we can now sever the link between
-    // each transaction being removed and any mempool children (ie, update
-    // CTxMemPoolEntry::m_parents for each direct child of a transaction being
-    // removed).
-    for (txiter removeIt : entriesToRemove) {
-        UpdateChildrenForRemoval(removeIt);
+        // Sever the link between removeIt and any mempool children that
+        // remain (ie, update CTxMemPoolEntry::m_parents for each of them).
+        for (const auto &child : (*removeIt)->GetMemPoolChildrenConst()) {
+            auto child_it = mapTx.find(child.get()->GetTx().GetId());
+            assert(child_it != mapTx.end());
+            if (entriesToRemove.count(child_it) == 0) {
+                UpdateParent(child_it, removeIt, false);
+            }
+        }
     }
 }
 
@@ -119,7 +191,8 @@ CTxMemPool::CTxMemPool(const Options &opts)
       m_dust_relay_feerate{opts.dust_relay_feerate},
       m_permit_bare_multisig{opts.permit_bare_multisig},
       m_max_datacarrier_bytes{opts.max_datacarrier_bytes},
-      m_require_standard{opts.require_standard} {
+      m_require_standard{opts.require_standard},
+      m_persist_v1_dat{opts.persist_v1_dat} {
     // lock free clear
     _clear();
 }
@@ -160,6 +233,9 @@ void CTxMemPool::addUnchecked(CTxMemPoolEntryRef entry) {
     // entry_id index
     assert(&*mapTx.get<entry_id>().rbegin() == &*newit);
 
+    txns_randomized.emplace_back(entry->GetTx().GetHash(), newit);
+    entry->idx_randomized = txns_randomized.size() - 1;
+
     // Update cachedInnerUsage to include contained transaction's usage.
     // (When we update the entry for in-mempool parents, memory usage will be
     // further updated.)
@@ -185,6 +261,7 @@ void CTxMemPool::addUnchecked(CTxMemPoolEntryRef entry) {
     nTransactionsUpdated++;
     totalTxSize += entry->GetTxSize();
     m_total_fee += entry->GetFee();
+    m_fee_histogram.AddTx(*entry);
 }
 
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
@@ -213,10 +290,25 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
 
     totalTxSize -= (*it)->GetTxSize();
     m_total_fee -= (*it)->GetFee();
+    m_fee_histogram.RemoveTx(**it);
     cachedInnerUsage -= (*it)->DynamicMemoryUsage();
     cachedInnerUsage -=
         memusage::DynamicUsage((*it)->GetMemPoolParentsConst()) +
         memusage::DynamicUsage((*it)->GetMemPoolChildrenConst());
+
+    // Move the last element of txns_randomized into the slot being freed
+    const size_t idx_randomized = (*it)->idx_randomized;
+    assert(txns_randomized[idx_randomized].second == it);
+    if (idx_randomized + 1 != txns_randomized.size()) {
+        txns_randomized[idx_randomized] = std::move(txns_randomized.back());
+        (*txns_randomized[idx_randomized].second)->idx_randomized =
+            idx_randomized;
+    }
+    txns_randomized.pop_back();
+    if (txns_randomized.size() * 2 < txns_randomized.capacity()) {
+        txns_randomized.shrink_to_fit();
+    }
+
     mapTx.erase(it);
     nTransactionsUpdated++;
 }
@@ -300,6 +392,35 @@ void CTxMemPool::removeConflicts(const CTransaction &tx) {
     }
 }
 
+void CTxMemPool::removeForBlock(const std::vector<CTransactionRef> &vtx) {
+    AssertLockHeld(cs);
+    setEntries block_entries;
+    setEntries conflicts;
+    for (const CTransactionRef &tx : vtx) {
+        const TxId &txid = tx->GetId();
+        if (std::optional<txiter> it = GetIter(txid)) {
+            block_entries.insert(*it);
+        } else {
+            // Conflicting txs can only exist if the tx was not in the mempool.
+            // In a valid block, they can't be the ancestors of the other block
+            // transactions, so the two sets don't overlap.
+            for (const CTxIn &txin : tx->vin) {
+                auto next_it = mapNextTx.find(txin.prevout);
+                if (next_it == mapNextTx.end()) {
+                    continue;
+                }
+                const TxId &conflict_txid = next_it->second->GetId();
+                ClearPrioritisation(conflict_txid);
+                CalculateDescendants(mapTx.find(conflict_txid), conflicts);
+            }
+        }
+        ClearPrioritisation(txid);
+    }
+
+    RemoveStaged(conflicts, MemPoolRemovalReason::CONFLICT);
+    RemoveStaged(block_entries, MemPoolRemovalReason::BLOCK);
+}
+
 /**
  * Called when a block is connected. Updates the miner fee estimator.
  */
@@ -312,10 +433,12 @@ void CTxMemPool::updateFeeForBlock() {
 
 void CTxMemPool::_clear() {
     mapTx.clear();
+    txns_randomized.clear();
     mapNextTx.clear();
     totalTxSize = 0;
     m_total_fee = Amount::zero();
     cachedInnerUsage = 0;
+    m_fee_histogram.Clear();
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
@@ -346,6 +469,7 @@ void CTxMemPool::check(const CCoinsViewCache &active_coins_tip,
     uint64_t checkTotal = 0;
     Amount check_total_fee{Amount::zero()};
     uint64_t innerUsage = 0;
+    FeeRateHistogram check_fee_histogram;
 
     CCoinsViewCache mempoolDuplicate(
         const_cast<CCoinsViewCache *>(&active_coins_tip));
@@ -354,11 +478,12 @@ void CTxMemPool::check(const CCoinsViewCache &active_coins_tip,
         checkTotal += entry->GetTxSize();
         check_total_fee += entry->GetFee();
         innerUsage += entry->DynamicMemoryUsage();
+        check_fee_histogram.AddTx(*entry);
         const CTransaction &tx = entry->GetTx();
         innerUsage += memusage::DynamicUsage(entry->GetMemPoolParentsConst()) +
                       memusage::DynamicUsage(entry->GetMemPoolChildrenConst());
 
-        CTxMemPoolEntry::Parents setParentCheck;
+        setEntries setParentCheck;
         for (const CTxIn &txin : tx.vin) {
             // Check that every mempool transaction's inputs refer to available
             // coins, or other mempool tx's.
@@ -367,7 +492,7 @@ void CTxMemPool::check(const CCoinsViewCache &active_coins_tip,
                 const CTransaction &parentTx = (*parentIt)->GetTx();
                 assert(parentTx.vout.size() > txin.prevout.GetN() &&
                        !parentTx.vout[txin.prevout.GetN()].IsNull());
-                setParentCheck.insert(*parentIt);
+                setParentCheck.insert(parentIt);
                 // also check that parents have a topological ordering before
                 // their children
                 assert((*parentIt)->GetEntryId() < entry->GetEntryId());
@@ -383,12 +508,19 @@ void CTxMemPool::check(const CCoinsViewCache &active_coins_tip,
             assert(prevoutNextIt->first == &txin.prevout);
             assert(prevoutNextIt->second == &tx);
         }
-        auto comp = [](const auto &a, const auto &b) -> bool {
-            return a.get()->GetTx().GetId() == b.get()->GetTx().GetId();
+        // The links are unordered, compare them as sets
+        auto link_set = [&](const auto &links) EXCLUSIVE_LOCKS_REQUIRED(cs) {
+            setEntries result;
+            for (const auto &link : links) {
+                txiter linkIt = mapTx.find(link.get()->GetTx().GetId());
+                assert(linkIt != mapTx.end());
+                result.insert(linkIt);
+            }
+            // No duplicated link
+            assert(result.size() == links.size());
+            return result;
         };
-        assert(setParentCheck.size() == entry->GetMemPoolParentsConst().size());
-        assert(std::equal(setParentCheck.begin(), setParentCheck.end(),
-                          entry->GetMemPoolParentsConst().begin(), comp));
+        assert(setParentCheck == link_set(entry->GetMemPoolParentsConst()));
 
         // Verify ancestor state is correct.
         setEntries setAncestors;
@@ -403,7 +535,7 @@ void CTxMemPool::check(const CCoinsViewCache &active_coins_tip,
         }
 
         // Check children against mapNextTx
-        CTxMemPoolEntry::Children setChildrenCheck;
+        setEntries setChildrenCheck;
         auto iter = mapNextTx.lower_bound(COutPoint(entry->GetTx().GetId(), 0));
         for (; iter != mapNextTx.end() &&
                iter->first->GetTxId() == entry->GetTx().GetId();
@@ -411,12 +543,9 @@ void CTxMemPool::check(const CCoinsViewCache &active_coins_tip,
             txiter childIt = mapTx.find(iter->second->GetId());
             // mapNextTx points to in-mempool transactions
             assert(childIt != mapTx.end());
-            setChildrenCheck.insert(*childIt);
+            setChildrenCheck.insert(childIt);
         }
-        assert(setChildrenCheck.size() ==
-               entry->GetMemPoolChildrenConst().size());
-        assert(std::equal(setChildrenCheck.begin(), setChildrenCheck.end(),
-                          entry->GetMemPoolChildrenConst().begin(), comp));
+        assert(setChildrenCheck == link_set(entry->GetMemPoolChildrenConst()));
 
         // Not used. CheckTxInputs() should always pass
         TxValidationState dummy_state;
@@ -436,9 +565,17 @@ void CTxMemPool::check(const CCoinsViewCache &active_coins_tip,
         assert(&(*it)->GetTx() == nextTx);
     }
 
+    assert(txns_randomized.size() == mapTx.size());
+    for (size_t i = 0; i < txns_randomized.size(); ++i) {
+        const auto &[txhash, it] = txns_randomized[i];
+        assert((*it)->idx_randomized == i);
+        assert((*it)->GetTx().GetHash() == txhash);
+    }
+
     assert(totalTxSize == checkTotal);
     assert(m_total_fee == check_total_fee);
     assert(innerUsage == cachedInnerUsage);
+    assert(m_fee_histogram == check_fee_histogram);
 }
 
 bool CTxMemPool::CompareTopologically(const TxId &txida,
@@ -470,7 +607,8 @@ static TxMempoolInfo
 GetInfo(CTxMemPool::indexed_transaction_set::const_iterator it) {
     return TxMempoolInfo{(*it)->GetSharedTx(), (*it)->GetTime(),
                          (*it)->GetFee(), (*it)->GetTxSize(),
-                         (*it)->GetModifiedFee() - (*it)->GetFee()};
+                         (*it)->GetModifiedFee() - (*it)->GetFee(),
+                         (*it)->GetHeight(), (*it)->GetEntryId()};
 }
 
 std::vector<TxMempoolInfo> CTxMemPool::infoAll() const {
@@ -525,9 +663,12 @@ void CTxMemPool::PrioritiseTransaction(const TxId &txid,
         delta += nFeeDelta;
         txiter it = mapTx.find(txid);
         if (it != mapTx.end()) {
+            // The modified feerate moves the entry to another bucket
+            m_fee_histogram.RemoveTx(**it);
             mapTx.modify(it, [&delta](CTxMemPoolEntryRef &e) {
                 e->UpdateFeeDelta(delta);
             });
+            m_fee_histogram.AddTx(**it);
             ++nTransactionsUpdated;
         }
     }
@@ -627,7 +768,8 @@ size_t CTxMemPool::DynamicMemoryUsage() const {
                                  12 * sizeof(void *)) *
                mapTx.size() +
            memusage::DynamicUsage(mapNextTx) +
-           memusage::DynamicUsage(mapDeltas) + cachedInnerUsage;
+           memusage::DynamicUsage(mapDeltas) +
+           memusage::DynamicUsage(txns_randomized) + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveUnbroadcastTx(const TxId &txid, const bool unchecked) {
@@ -688,24 +830,37 @@ void CTxMemPool::LimitSize(CCoinsViewCache &coins_cache) {
     }
 }
 
+/**
+ * Add or remove a link. The links are unordered, so a removed link is replaced
+ * by the last one. The memory usage is accounted for from the allocated size,
+ * which only changes when the links no longer fit inline or in the current
+ * allocation.
+ */
+static void UpdateLinks(CTxMemPoolEntry::Children &links,
+                        const CTxMemPoolEntryRef &entry, bool add,
+                        uint64_t &cachedInnerUsage) {
+    const CTxMemPoolEntryLink link{entry};
+    auto it = std::find(links.begin(), links.end(), link);
+    const size_t usage_before{memusage::DynamicUsage(links)};
+    if (add && it == links.end()) {
+        links.push_back(link);
+    } else if (!add && it != links.end()) {
+        *it = links.back();
+        links.pop_back();
+    }
+    cachedInnerUsage += memusage::DynamicUsage(links);
+    cachedInnerUsage -= usage_before;
+}
+
 void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add) {
     AssertLockHeld(cs);
-    CTxMemPoolEntry::Children s;
-    if (add && (*entry)->GetMemPoolChildren().insert(*child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && (*entry)->GetMemPoolChildren().erase(*child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
-    }
+    UpdateLinks((*entry)->GetMemPoolChildren(), *child, add, cachedInnerUsage);
 }
 
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add) {
     AssertLockHeld(cs);
-    CTxMemPoolEntry::Parents s;
-    if (add && (*entry)->GetMemPoolParents().insert(*parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && (*entry)->GetMemPoolParents().erase(*parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
-    }
+    UpdateLinks((*entry)->GetMemPoolParents(), *parent, add,
+                cachedInnerUsage);
 }
 
 CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const {
@@ -743,25 +898,158 @@ void CTxMemPool::TrimToSize(size_t sizelimit,
                             std::vector<COutPoint> *pvNoSpendsRemaining) {
     AssertLockHeld(cs);
 
+    if (mapTx.empty() || DynamicMemoryUsage() <= sizelimit) {
+        return;
+    }
+
+    // An entry is evicted along with its descendants, so it is scored with the
+    // higher of its own feerate and the feerate of the whole package: a low
+    // feerate parent with a high feerate child is kept over the transactions
+    // that pay less. Tracking these scores in the mempool would need updating
+    // all the ancestors of each new entry, so they are computed here, for the
+    // lowest feerate entries only.
+    //
+    // The fee and size of the packages are cached for the whole trim. The
+    // package of an entry is its own plus the packages of its children, unless
+    // these overlap, so a chain is only walked once.
+    struct Package {
+        Amount fee;
+        size_t size;
+        //! Whether all the descendants have a single parent, so that the
+        //! packages of different children don't overlap
+        bool single_parents;
+    };
+    std::map<txiter, Package, CompareIteratorById> packages;
+    auto get_package = [&](txiter root) EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        // Walk the descendants that are not cached yet in post-order, without
+        // recursing as the chains can be long
+        std::vector<std::pair<txiter, bool>> walk{{root, false}};
+        while (!walk.empty()) {
+            auto &[it, children_walked] = walk.back();
+            if (packages.count(it)) {
+                walk.pop_back();
+                continue;
+            }
+            const CTxMemPoolEntry::Children &children =
+                (*it)->GetMemPoolChildrenConst();
+            if (!children_walked) {
+                children_walked = true;
+                // The references into walk are invalidated from here on
+                for (const auto &child : children) {
+                    const txiter child_it =
+                        mapTx.find(child.get()->GetTx().GetId());
+                    assert(child_it != mapTx.end());
+                    if (!packages.count(child_it)) {
+                        walk.emplace_back(child_it, false);
+                    }
+                }
+                continue;
+            }
+            const txiter entry_it = it;
+            walk.pop_back();
+
+            Package package{(*entry_it)->GetModifiedFee(),
+                            size_t((*entry_it)->GetTxVirtualSize()), true};
+            std::vector<txiter> child_its;
+            child_its.reserve(children.size());
+            for (const auto &child : children) {
+                const txiter child_it =
+                    mapTx.find(child.get()->GetTx().GetId());
+                child_its.push_back(child_it);
+                package.single_parents &=
+                    packages.at(child_it).single_parents &&
+                    (*child_it)->GetMemPoolParentsConst().size() == 1;
+            }
+            if (child_its.size() <= 1 || package.single_parents) {
+                for (const txiter child_it : child_its) {
+                    const Package &child_package = packages.at(child_it);
+                    package.fee += child_package.fee;
+                    package.size += child_package.size;
+                }
+            } else {
+                // Some descendants may be reached through several children
+                setEntries descendants;
+                CalculateDescendants(entry_it, descendants);
+                package.fee = Amount::zero();
+                package.size = 0;
+                for (const txiter descendant : descendants) {
+                    package.fee += (*descendant)->GetModifiedFee();
+                    package.size += (*descendant)->GetTxVirtualSize();
+                }
+            }
+            packages.emplace(entry_it, package);
+        }
+        return packages.at(root);
+    };
+    auto score = [&](txiter it) EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        const Package &package = get_package(it);
+        return std::max((*it)->GetModifiedFeeRate(),
+                        CFeeRate(package.fee, package.size));
+    };
+
+    // The scored entries, lowest score first. The score of an entry is at
+    // least its own feerate, so the lowest one is known once the entries
+    // with a lower own feerate are all scored.
+    std::set<std::pair<CFeeRate, TxId>> scored;
+    std::map<txiter, CFeeRate, CompareIteratorById> scores;
+    auto add_score = [&](txiter it) EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        const CFeeRate entry_score{score(it)};
+        scored.emplace(entry_score, (*it)->GetTx().GetId());
+        scores.emplace(it, entry_score);
+    };
+    auto remove_score = [&](txiter it) EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        const auto entry_score = scores.find(it);
+        if (entry_score == scores.end()) {
+            return false;
+        }
+        scored.erase({entry_score->second, (*it)->GetTx().GetId()});
+        scores.erase(entry_score);
+        return true;
+    };
+    const auto &by_feerate = mapTx.get<modified_feerate>();
+    // The lowest feerate entry that is not scored yet, the index is sorted by
+    // decreasing feerate
+    auto next = by_feerate.end();
+    bool all_scored{false};
+    auto advance = [&]() EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        if (next == by_feerate.begin()) {
+            all_scored = true;
+        } else {
+            --next;
+        }
+    };
+    advance();
+
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(Amount::zero());
     while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
-        auto it = mapTx.get<modified_feerate>().end();
-        --it;
+        while (!all_scored &&
+               (scored.empty() ||
+                (*next)->GetModifiedFeeRate() < scored.begin()->first)) {
+            add_score(mapTx.project<0>(next));
+            advance();
+        }
+        if (scored.empty()) {
+            break;
+        }
 
-        // We set the new mempool min fee to the feerate of the removed
+        const CFeeRate lowest_score{scored.begin()->first};
+        const txiter it = mapTx.find(scored.begin()->second);
+        assert(it != mapTx.end());
+        setEntries stage;
+        CalculateDescendants(it, stage);
+
+        // We set the new mempool min fee to the score of the removed
         // transaction, plus the "minimum reasonable fee rate" (ie some value
         // under which we consider txn to have 0 fee). This way, we don't allow
         // txn to enter mempool with feerate equal to txn which were removed
         // with no block in between.
-        CFeeRate removed = (*it)->GetModifiedFeeRate();
+        CFeeRate removed = lowest_score;
         removed += MEMPOOL_FULL_FEE_INCREMENT;
 
         trackPackageRemoved(removed);
         maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
 
-        setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
         nTxnRemoved += stage.size();
 
         if (pvNoSpendsRemaining) {
@@ -774,7 +1062,41 @@ void CTxMemPool::TrimToSize(size_t sizelimit,
             }
         }
 
+        // The packages of the entries that remain and had evicted descendants
+        // shrink, which can lower their score as well as raise it.
+        CTxMemPoolEntry::Parents staged_ancestors;
+        for (const txiter &iter : stage) {
+            for (const auto &parent : (*iter)->GetMemPoolParentsConst()) {
+                const txiter parent_it =
+                    mapTx.find(parent.get()->GetTx().GetId());
+                if (!stage.count(parent_it)) {
+                    staged_ancestors.push_back(parent);
+                }
+            }
+        }
+        setEntries ancestors;
+        CalculateAncestors(ancestors, staged_ancestors);
+        std::vector<txiter> rescore;
+        for (const txiter &ancestor : ancestors) {
+            packages.erase(ancestor);
+            if (remove_score(ancestor)) {
+                rescore.push_back(ancestor);
+            }
+        }
+        for (const txiter &iter : stage) {
+            packages.erase(iter);
+            remove_score(iter);
+        }
+
+        // Don't keep a reference to an evicted entry
+        while (!all_scored && stage.count(mapTx.project<0>(next))) {
+            advance();
+        }
         RemoveStaged(stage, MemPoolRemovalReason::SIZELIMIT);
+
+        for (const txiter &ancestor : rescore) {
+            add_score(ancestor);
+        }
     }
 
     if (maxFeeRateRemoved > CFeeRate(Amount::zero())) {
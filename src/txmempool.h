@@ -9,6 +9,7 @@
 #include <coins.h>
 #include <consensus/amount.h>
 #include <core_memusage.h>
+#include <feerate.h>
 #include <indirectmap.h>
 #include <kernel/cs_main.h>
 #include <kernel/mempool_entry.h>
@@ -26,6 +27,8 @@
 #include <boost/multi_index_container.hpp>
 
 #include <atomic>
+#include <cstdint>
+#include <limits>
 #include <map>
 #include <optional>
 #include <set>
@@ -139,6 +142,57 @@ struct TxMempoolInfo {
 
     /** The fee delta. */
     Amount nFeeDelta;
+
+    /** Chain height when the transaction entered the mempool. */
+    unsigned int height;
+
+    /** Entry id, which sorts the mempool transactions topologically. */
+    uint64_t entry_id;
+};
+
+/**
+ * Statistics of the mempool transactions whose modified feerate is at least
+ * min_feerate, and lower than the min_feerate of the next bucket.
+ */
+struct FeeRateBucket {
+    CFeeRate min_feerate;
+    //! Number of transactions
+    uint64_t count{0};
+    //! Sum of the transaction sizes
+    uint64_t size{0};
+    //! Sum of the transaction sigchecks
+    int64_t sigchecks{0};
+
+    bool operator==(const FeeRateBucket &other) const {
+        return min_feerate == other.min_feerate && count == other.count &&
+               size == other.size && sigchecks == other.sigchecks;
+    }
+};
+
+/**
+ * Histogram of the mempool transactions by modified feerate, over
+ * exponentially spaced buckets. The mempool updates it as transactions are
+ * added, removed or prioritised, so it can be read without walking mapTx.
+ */
+class FeeRateHistogram {
+private:
+    //! Sorted by increasing min_feerate, the first one starting at zero
+    std::vector<FeeRateBucket> m_buckets;
+
+    FeeRateBucket &GetBucket(const CFeeRate &feerate);
+
+public:
+    FeeRateHistogram();
+
+    void AddTx(const CTxMemPoolEntry &entry);
+    void RemoveTx(const CTxMemPoolEntry &entry);
+    void Clear();
+
+    const std::vector<FeeRateBucket> &GetBuckets() const { return m_buckets; }
+
+    bool operator==(const FeeRateHistogram &other) const {
+        return m_buckets == other.m_buckets;
+    }
 };
 
 /**
@@ -220,6 +274,8 @@ private:
     //! sum of dynamic memory usage of all the map elements (NOT the maps
     //! themselves)
     uint64_t cachedInnerUsage GUARDED_BY(cs);
+    //! mempool tx's by modified feerate
+    FeeRateHistogram m_fee_histogram GUARDED_BY(cs);
 
     mutable int64_t lastRollingFeeUpdate GUARDED_BY(cs);
     mutable bool blockSinceLastRollingFeeBump GUARDED_BY(cs);
@@ -297,6 +353,13 @@ public:
     indexed_transaction_set mapTx GUARDED_BY(cs);
 
     using txiter = indexed_transaction_set::nth_index<0>::type::const_iterator;
+    /**
+     * All the transactions in mapTx with their hash, stored contiguously so
+     * compact block reconstruction can compute the short ids of the whole
+     * mempool without chasing the multi_index nodes. The order is arbitrary,
+     * a removal moves the last element into the freed slot.
+     */
+    std::vector<std::pair<TxHash, txiter>> txns_randomized GUARDED_BY(cs);
     typedef std::set<txiter, CompareIteratorById> setEntries;
     typedef std::set<txiter, CompareIteratorByRevEntryId> setRevTopoEntries;
 
@@ -319,9 +382,15 @@ private:
      * param@[in]   staged_ancestors    Should contain entries in the mempool.
      * param@[out]  setAncestors        Will be populated with all mempool
      *                                  ancestors.
+     * param@[in]   limit_count         Max number of ancestors to add.
+     * param@[in]   limit_size          Max total size of the ancestors added.
+     * Return false, leaving setAncestors partially populated, as soon as one
+     * of the limits is exceeded.
      */
-    bool CalculateAncestors(setEntries &setAncestors,
-                            CTxMemPoolEntry::Parents &staged_ancestors) const
+    bool CalculateAncestors(
+        setEntries &setAncestors, CTxMemPoolEntry::Parents &staged_ancestors,
+        uint64_t limit_count = std::numeric_limits<uint64_t>::max(),
+        uint64_t limit_size = std::numeric_limits<uint64_t>::max()) const
         EXCLUSIVE_LOCKS_REQUIRED(cs);
 
 public:
@@ -337,6 +406,7 @@ public:
     const bool m_permit_bare_multisig;
     const std::optional<unsigned> m_max_datacarrier_bytes;
     const bool m_require_standard;
+    const bool m_persist_v1_dat;
 
     /**
      * Create a new CTxMemPool.
@@ -364,6 +434,15 @@ public:
     void removeRecursive(const CTransaction &tx, MemPoolRemovalReason reason)
         EXCLUSIVE_LOCKS_REQUIRED(cs);
     void removeConflicts(const CTransaction &tx) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /**
+     * Remove the transactions of a newly connected block from the mempool,
+     * along with the transactions that conflict with them and their
+     * descendants, and clear their prioritisation. The affected entries are
+     * gathered first and then removed with a single RemoveStaged() call per
+     * removal reason.
+     */
+    void removeForBlock(const std::vector<CTransactionRef> &vtx)
+        EXCLUSIVE_LOCKS_REQUIRED(cs);
     void updateFeeForBlock() EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     void clear();
@@ -417,10 +496,14 @@ public:
      * fSearchForParents = whether to search a tx's vin for in-mempool parents,
      * or look up parents from m_parents. Must be true for entries not in the
      * mempool
+     * limit_count, limit_size = stop and return false once there are more
+     * ancestors, or their total size is larger, than these limits
      */
-    bool CalculateMemPoolAncestors(const CTxMemPoolEntryRef &entry,
-                                   setEntries &setAncestors,
-                                   bool fSearchForParents = true) const
+    bool CalculateMemPoolAncestors(
+        const CTxMemPoolEntryRef &entry, setEntries &setAncestors,
+        bool fSearchForParents = true,
+        uint64_t limit_count = std::numeric_limits<uint64_t>::max(),
+        uint64_t limit_size = std::numeric_limits<uint64_t>::max()) const
         EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /**
@@ -487,6 +570,12 @@ public:
         return m_total_fee;
     }
 
+    const FeeRateHistogram &GetFeeRateHistogram() const
+        EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        AssertLockHeld(cs);
+        return m_fee_histogram;
+    }
+
     bool exists(const TxId &txid) const {
         LOCK(cs);
         return mapTx.count(txid) != 0;
@@ -554,12 +643,10 @@ private:
     void UpdateParentsOf(bool add, txiter it) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /**
      * For each transaction being removed, update ancestors and any direct
-     * children.
+     * children that are not removed as well.
      */
     void UpdateForRemoveFromMempool(const setEntries &entriesToRemove)
         EXCLUSIVE_LOCKS_REQUIRED(cs);
-    /** Sever link between specified transaction and direct children. */
-    void UpdateChildrenForRemoval(txiter entry) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /**
      * Before calling removeUnchecked for a given transaction,
@@ -8,6 +8,7 @@
 #include <logging.h>
 #include <policy/policy.h>
 
+#include <algorithm>
 #include <cassert>
 
 /** Expiration time for orphan transactions in seconds */
@@ -15,10 +16,8 @@ static constexpr int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
 /** Minimum time between orphan transactions expire time checks in seconds */
 static constexpr int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
 
-RecursiveMutex g_cs_orphans;
-
 bool TxOrphanage::AddTx(const CTransactionRef &tx, NodeId peer) {
-    AssertLockHeld(g_cs_orphans);
+    LOCK(m_mutex);
 
     const TxId &txid = tx->GetId();
     if (m_orphans.count(txid)) {
@@ -39,63 +38,97 @@ bool TxOrphanage::AddTx(const CTransactionRef &tx, NodeId peer) {
         return false;
     }
 
+    PeerOrphans &peer_orphans = m_peer_orphans[peer];
     auto ret = m_orphans.emplace(
-        txid, OrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME,
-                       m_orphan_list.size()});
+        txid, OrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, sz,
+                       peer_orphans.orphans.size()});
     assert(ret.second);
-    m_orphan_list.push_back(ret.first);
+    OrphanTx *orphan = &ret.first->second;
+    peer_orphans.orphans.push_back(orphan);
+    peer_orphans.bytes += sz;
+    m_total_bytes += sz;
     for (const CTxIn &txin : tx->vin) {
-        m_outpoint_to_orphan_it[txin.prevout].insert(ret.first);
+        m_outpoint_to_orphan_it[txin.prevout].push_back(orphan);
     }
 
-    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u outsz %u)\n",
-             txid.ToString(), m_orphans.size(), m_outpoint_to_orphan_it.size());
+    LogPrint(BCLog::MEMPOOL,
+             "stored orphan tx %s (mapsz %u outsz %u peer=%d peersz %u)\n",
+             txid.ToString(), m_orphans.size(), m_outpoint_to_orphan_it.size(),
+             peer, peer_orphans.orphans.size());
     return true;
 }
 
 int TxOrphanage::EraseTx(const TxId &txid) {
-    AssertLockHeld(g_cs_orphans);
-    std::map<TxId, OrphanTx>::iterator it = m_orphans.find(txid);
+    LOCK(m_mutex);
+    return EraseTxNoLock(txid);
+}
+
+int TxOrphanage::EraseTxNoLock(const TxId &txid) {
+    AssertLockHeld(m_mutex);
+    auto it = m_orphans.find(txid);
     if (it == m_orphans.end()) {
         return 0;
     }
-    for (const CTxIn &txin : it->second.tx->vin) {
+    OrphanTx *orphan = &it->second;
+    for (const CTxIn &txin : orphan->tx->vin) {
         auto itPrev = m_outpoint_to_orphan_it.find(txin.prevout);
         if (itPrev == m_outpoint_to_orphan_it.end()) {
             continue;
         }
-        itPrev->second.erase(it);
-        if (itPrev->second.empty()) {
+        std::vector<OrphanTx *> &spenders = itPrev->second;
+        auto itSpender = std::find(spenders.begin(), spenders.end(), orphan);
+        if (itSpender != spenders.end()) {
+            *itSpender = spenders.back();
+            spenders.pop_back();
+        }
+        if (spenders.empty()) {
             m_outpoint_to_orphan_it.erase(itPrev);
         }
     }
 
-    size_t old_pos = it->second.list_pos;
-    assert(m_orphan_list[old_pos] == it);
-    if (old_pos + 1 != m_orphan_list.size()) {
-        // Unless we're deleting the last entry in m_orphan_list, move the last
-        // entry to the position we're deleting.
-        auto it_last = m_orphan_list.back();
-        m_orphan_list[old_pos] = it_last;
-        it_last->second.list_pos = old_pos;
+    auto itPeer = m_peer_orphans.find(orphan->fromPeer);
+    assert(itPeer != m_peer_orphans.end());
+    PeerOrphans &peer_orphans = itPeer->second;
+    size_t old_pos = orphan->peer_list_pos;
+    assert(peer_orphans.orphans[old_pos] == orphan);
+    if (old_pos + 1 != peer_orphans.orphans.size()) {
+        // Unless we're deleting the last entry in the peer's list, move the
+        // last entry to the position we're deleting.
+        OrphanTx *last = peer_orphans.orphans.back();
+        peer_orphans.orphans[old_pos] = last;
+        last->peer_list_pos = old_pos;
+    }
+    peer_orphans.orphans.pop_back();
+    peer_orphans.bytes -= orphan->size;
+    m_total_bytes -= orphan->size;
+    if (peer_orphans.orphans.empty()) {
+        assert(peer_orphans.bytes == 0);
+        m_peer_orphans.erase(itPeer);
     }
-    m_orphan_list.pop_back();
 
     m_orphans.erase(it);
     return 1;
 }
 
 void TxOrphanage::EraseForPeer(NodeId peer) {
-    AssertLockHeld(g_cs_orphans);
+    LOCK(m_mutex);
+
+    auto itPeer = m_peer_orphans.find(peer);
+    if (itPeer == m_peer_orphans.end()) {
+        return;
+    }
+
+    // Copy the txids first, erasing the last orphan of the peer also erases
+    // its accounting entry.
+    std::vector<TxId> vOrphanErase;
+    vOrphanErase.reserve(itPeer->second.orphans.size());
+    for (const OrphanTx *orphan : itPeer->second.orphans) {
+        vOrphanErase.push_back(orphan->tx->GetId());
+    }
 
     int nErased = 0;
-    std::map<TxId, OrphanTx>::iterator iter = m_orphans.begin();
-    while (iter != m_orphans.end()) {
-        std::map<TxId, OrphanTx>::iterator maybeErase =
-            iter++; // increment to avoid iterator becoming invalid
-        if (maybeErase->second.fromPeer == peer) {
-            nErased += EraseTx(maybeErase->second.tx->GetId());
-        }
+    for (const TxId &txid : vOrphanErase) {
+        nErased += EraseTxNoLock(txid);
     }
     if (nErased > 0) {
         LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx from peer=%d\n", nErased,
@@ -103,40 +136,91 @@ void TxOrphanage::EraseForPeer(NodeId peer) {
     }
 }
 
-unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans) {
-    AssertLockHeld(g_cs_orphans);
+void TxOrphanage::EvictFromPeer(NodeId peer, FastRandomContext &rng) {
+    AssertLockHeld(m_mutex);
+
+    auto itPeer = m_peer_orphans.find(peer);
+    assert(itPeer != m_peer_orphans.end());
+    const std::vector<OrphanTx *> &orphans = itPeer->second.orphans;
+    assert(!orphans.empty());
+
+    // Pick two candidates and evict the largest one, so that big orphans are
+    // more likely to go first without making eviction predictable.
+    const OrphanTx *victim = orphans[rng.randrange(orphans.size())];
+    const OrphanTx *other = orphans[rng.randrange(orphans.size())];
+    if (other->size > victim->size) {
+        victim = other;
+    }
+    EraseTxNoLock(victim->tx->GetId());
+}
+
+unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans,
+                                       unsigned int max_peer_orphans,
+                                       size_t max_peer_bytes) {
+    LOCK(m_mutex);
 
     unsigned int nEvicted = 0;
-    static int64_t nNextSweep;
     int64_t nNow = GetTime();
-    if (nNextSweep <= nNow) {
+    if (m_next_sweep <= nNow) {
         // Sweep out expired orphan pool entries:
-        int nErased = 0;
+        std::vector<TxId> vOrphanErase;
         int64_t nMinExpTime =
             nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
-        std::map<TxId, OrphanTx>::iterator iter = m_orphans.begin();
-        while (iter != m_orphans.end()) {
-            std::map<TxId, OrphanTx>::iterator maybeErase = iter++;
-            if (maybeErase->second.nTimeExpire <= nNow) {
-                nErased += EraseTx(maybeErase->second.tx->GetId());
+        for (const auto &[txid, orphan] : m_orphans) {
+            if (orphan.nTimeExpire <= nNow) {
+                vOrphanErase.push_back(txid);
             } else {
-                nMinExpTime =
-                    std::min(maybeErase->second.nTimeExpire, nMinExpTime);
+                nMinExpTime = std::min(orphan.nTimeExpire, nMinExpTime);
             }
         }
+        int nErased = 0;
+        for (const TxId &txid : vOrphanErase) {
+            nErased += EraseTxNoLock(txid);
+        }
         // Sweep again 5 minutes after the next entry that expires in order to
         // batch the linear scan.
-        nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
+        m_next_sweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
         if (nErased > 0) {
             LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx due to expiration\n",
                      nErased);
         }
     }
+
     FastRandomContext rng;
+
+    // Enforce the per peer budgets, so a peer above its share only ever
+    // evicts its own orphans.
+    std::vector<NodeId> over_budget;
+    for (const auto &[peer, peer_orphans] : m_peer_orphans) {
+        if (peer_orphans.orphans.size() > max_peer_orphans ||
+            peer_orphans.bytes > max_peer_bytes) {
+            over_budget.push_back(peer);
+        }
+    }
+    for (const NodeId peer : over_budget) {
+        while (true) {
+            auto itPeer = m_peer_orphans.find(peer);
+            if (itPeer == m_peer_orphans.end() ||
+                (itPeer->second.orphans.size() <= max_peer_orphans &&
+                 itPeer->second.bytes <= max_peer_bytes)) {
+                break;
+            }
+            EvictFromPeer(peer, rng);
+            ++nEvicted;
+        }
+    }
+
+    // Enforce the global limit, evicting from the peer that uses the most
+    // memory. This is linear in the number of peers holding orphans, which is
+    // bounded by the number of connections.
     while (m_orphans.size() > max_orphans) {
-        // Evict a random orphan:
-        size_t randompos = rng.randrange(m_orphan_list.size());
-        EraseTx(m_orphan_list[randompos]->first);
+        auto itHeaviest = std::max_element(
+            m_peer_orphans.begin(), m_peer_orphans.end(),
+            [](const auto &a, const auto &b) {
+                return a.second.bytes < b.second.bytes;
+            });
+        assert(itHeaviest != m_peer_orphans.end());
+        EvictFromPeer(itHeaviest->first, rng);
         ++nEvicted;
     }
     return nEvicted;
@@ -144,25 +228,25 @@ unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans) {
 
 void TxOrphanage::AddChildrenToWorkSet(const CTransaction &tx,
                                        std::set<TxId> &orphan_work_set) const {
-    AssertLockHeld(g_cs_orphans);
+    LOCK(m_mutex);
     for (size_t i = 0; i < tx.vout.size(); i++) {
         const auto it_by_prev =
             m_outpoint_to_orphan_it.find(COutPoint(tx.GetId(), i));
         if (it_by_prev != m_outpoint_to_orphan_it.end()) {
-            for (const auto &elem : it_by_prev->second) {
-                orphan_work_set.insert(elem->first);
+            for (const OrphanTx *orphan : it_by_prev->second) {
+                orphan_work_set.insert(orphan->tx->GetId());
             }
         }
     }
 }
 
 bool TxOrphanage::HaveTx(const TxId &txid) const {
-    LOCK(g_cs_orphans);
+    LOCK(m_mutex);
     return m_orphans.count(txid);
 }
 
 std::pair<CTransactionRef, NodeId> TxOrphanage::GetTx(const TxId &txid) const {
-    AssertLockHeld(g_cs_orphans);
+    LOCK(m_mutex);
 
     const auto it = m_orphans.find(txid);
     if (it == m_orphans.end()) {
@@ -171,8 +255,18 @@ std::pair<CTransactionRef, NodeId> TxOrphanage::GetTx(const TxId &txid) const {
     return {it->second.tx, it->second.fromPeer};
 }
 
+std::pair<size_t, size_t> TxOrphanage::PeerUsage(NodeId peer) const {
+    LOCK(m_mutex);
+
+    const auto it = m_peer_orphans.find(peer);
+    if (it == m_peer_orphans.end()) {
+        return {0, 0};
+    }
+    return {it->second.orphans.size(), it->second.bytes};
+}
+
 void TxOrphanage::EraseForBlock(const CBlock &block) {
-    LOCK(g_cs_orphans);
+    LOCK(m_mutex);
 
     std::vector<TxId> vOrphanErase;
 
@@ -186,11 +280,8 @@ void TxOrphanage::EraseForBlock(const CBlock &block) {
                 continue;
             }
 
-            for (auto mi = itByPrev->second.begin();
-                 mi != itByPrev->second.end(); ++mi) {
-                const CTransaction &orphanTx = *(*mi)->second.tx;
-                const TxId &orphanId = orphanTx.GetId();
-                vOrphanErase.push_back(orphanId);
+            for (const OrphanTx *orphan : itByPrev->second) {
+                vOrphanErase.push_back(orphan->tx->GetId());
             }
         }
     }
@@ -199,7 +290,7 @@ void TxOrphanage::EraseForBlock(const CBlock &block) {
     if (vOrphanErase.size()) {
         int nErased = 0;
         for (const auto &orphanId : vOrphanErase) {
-            nErased += EraseTx(orphanId);
+            nErased += EraseTxNoLock(orphanId);
         }
         LogPrint(BCLog::MEMPOOL,
                  "Erased %d orphan tx included or conflicted by block\n",
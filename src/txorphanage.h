@@ -8,47 +8,65 @@
 #include <net.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <random.h>
 #include <sync.h>
+#include <util/hasher.h>
 
-/** Guards orphan transactions and extra txs for compact blocks */
-extern RecursiveMutex g_cs_orphans;
+#include <set>
+#include <unordered_map>
+#include <vector>
 
 /**
  * A class to track orphan transactions (failed on TX_MISSING_INPUTS)
  * Since we cannot distinguish orphans from bad transactions with
  * non-existent inputs, we heavily limit the number of orphans
  * we keep and the duration we keep them for.
+ *
+ * Orphans are accounted per announcing peer (count and bytes) so that a single
+ * peer flooding the orphanage only evicts its own transactions.
  */
 class TxOrphanage {
 public:
     /** Add a new orphan transaction */
     bool AddTx(const CTransactionRef &tx, NodeId peer)
-        EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /** Check if we already have an orphan transaction */
-    bool HaveTx(const TxId &txid) const LOCKS_EXCLUDED(g_cs_orphans);
+    bool HaveTx(const TxId &txid) const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /**
      * Get an orphan transaction and its originating peer
      * (Transaction ref will be nullptr if not found)
      */
     std::pair<CTransactionRef, NodeId> GetTx(const TxId &txid) const
-        EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /** Erase an orphan by txid */
-    int EraseTx(const TxId &txid) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+    int EraseTx(const TxId &txid) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /**
      * Erase all orphans announced by a peer (eg, after that peer disconnects)
      */
-    void EraseForPeer(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+    void EraseForPeer(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /** Erase all orphans included in or invalidated by a new block */
-    void EraseForBlock(const CBlock &block) LOCKS_EXCLUDED(g_cs_orphans);
+    void EraseForBlock(const CBlock &block) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
-    /** Limit the orphanage to the given maximum */
-    unsigned int LimitOrphans(unsigned int max_orphans)
-        EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+    /**
+     * Limit the orphanage to the given maximums. Expired orphans are removed
+     * first, then any peer above its count or byte budget loses its own
+     * orphans, and finally while the whole pool is above max_orphans the peer
+     * using the most bytes has one of its orphans evicted at random.
+     *
+     * @param[in] max_orphans       Maximum number of orphans in the pool
+     * @param[in] max_peer_orphans  Maximum number of orphans per peer
+     * @param[in] max_peer_bytes    Maximum total size of the orphans per peer
+     * @return The number of evicted orphans (not counting expired ones)
+     */
+    unsigned int LimitOrphans(unsigned int max_orphans,
+                              unsigned int max_peer_orphans,
+                              size_t max_peer_bytes)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /**
      * Add any orphans that list a particular tx as a parent into a peer's work
@@ -57,45 +75,77 @@ public:
      */
     void AddChildrenToWorkSet(const CTransaction &tx,
                               std::set<TxId> &orphan_work_set) const
-        EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /** Return how many entries exist in the orphange */
-    size_t Size() LOCKS_EXCLUDED(::g_cs_orphans) {
-        LOCK(::g_cs_orphans);
+    size_t Size() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        LOCK(m_mutex);
         return m_orphans.size();
     }
 
+    /** Return the total size in bytes of the orphans in the orphanage */
+    size_t TotalBytes() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        LOCK(m_mutex);
+        return m_total_bytes;
+    }
+
+    /** Return how many orphans and bytes are accounted to a peer */
+    std::pair<size_t, size_t> PeerUsage(NodeId peer) const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
 protected:
+    /** Guards the orphan transactions and the indexes below */
+    mutable Mutex m_mutex;
+
     struct OrphanTx {
         CTransactionRef tx;
         NodeId fromPeer;
         int64_t nTimeExpire;
-        size_t list_pos;
+        size_t size;
+        /** Position of this orphan in its peer's PeerOrphans::orphans */
+        size_t peer_list_pos;
     };
 
     /**
      * Map from txid to orphan transaction record. Limited by
      *  -maxorphantx/DEFAULT_MAX_ORPHAN_TRANSACTIONS
+     * The nodes of an unordered_map are stable, so raw pointers to the
+     * OrphanTx values can be stored in the indexes below.
      */
-    std::map<TxId, OrphanTx> m_orphans GUARDED_BY(g_cs_orphans);
-
-    using OrphanMap = decltype(m_orphans);
-
-    struct IteratorComparator {
-        template <typename I> bool operator()(const I &a, const I &b) const {
-            return &(*a) < &(*b);
-        }
-    };
+    std::unordered_map<TxId, OrphanTx, SaltedTxIdHasher>
+        m_orphans GUARDED_BY(m_mutex);
 
     /**
      * Index from the parents' COutPoint into the m_orphans. Used
-     *  to remove orphan transactions from the m_orphans
+     *  to find the children of a transaction and to remove orphan transactions
+     *  from the m_orphans. There is usually a single spender per outpoint so
+     *  a flat vector is used rather than an ordered set.
      */
-    std::map<COutPoint, std::set<OrphanMap ::iterator, IteratorComparator>>
-        m_outpoint_to_orphan_it GUARDED_BY(g_cs_orphans);
+    std::unordered_map<COutPoint, std::vector<OrphanTx *>,
+                       SaltedOutpointHasher>
+        m_outpoint_to_orphan_it GUARDED_BY(m_mutex);
+
+    /** Per peer accounting of the orphans it announced */
+    struct PeerOrphans {
+        /** Orphans announced by this peer, in vector for quick eviction */
+        std::vector<OrphanTx *> orphans;
+        /** Total size of these orphans */
+        size_t bytes{0};
+    };
+    std::unordered_map<NodeId, PeerOrphans> m_peer_orphans GUARDED_BY(m_mutex);
+
+    /** Total size of all the orphans */
+    size_t m_total_bytes GUARDED_BY(m_mutex){0};
+
+    /** Time of the next sweep of expired orphans */
+    int64_t m_next_sweep GUARDED_BY(m_mutex){0};
+
+    /** Erase an orphan by txid */
+    int EraseTxNoLock(const TxId &txid) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
 
-    /** Orphan transactions in vector for quick random eviction */
-    std::vector<OrphanMap::iterator> m_orphan_list GUARDED_BY(g_cs_orphans);
+    /** Evict the larger of two random orphans announced by the given peer */
+    void EvictFromPeer(NodeId peer, FastRandomContext &rng)
+        EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
 };
 
 #endif // BITCOIN_TXORPHANAGE_H
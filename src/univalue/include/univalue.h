@@ -13,6 +13,7 @@
 #include <vector>
 #include <map>
 #include <cassert>
+#include <functional>
 
 #include <utility>        // std::pair
 
@@ -205,6 +206,50 @@ static inline std::pair<std::string,UniValue> Pair(std::string key, const UniVal
     return std::make_pair(key, uVal);
 }
 
+/**
+ * Incrementally writes a compact JSON document, without building a UniValue
+ * tree or a string for the whole of it. The output is handed to the sink in
+ * chunks of about chunkSize bytes; the end of the output is only given to the
+ * sink by flush(), or can be taken back with release().
+ */
+class UniValueWriter {
+public:
+    typedef std::function<void(const std::string&)> Sink;
+
+    explicit UniValueWriter(const Sink& sinkIn, size_t chunkSizeIn = 65536);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const std::string& k);
+    void value(const UniValue& val);
+    /** Write the keys and values of an object into the current object */
+    void pushKVs(const UniValue& obj);
+
+    /** Whether a key was written and is still waiting for its value */
+    bool expectingValue() const { return afterKey; }
+    /** Number of bytes already handed to the sink */
+    size_t bytesFlushed() const { return flushed; }
+
+    /** Hand all the buffered output to the sink */
+    void flush();
+    /** Return the buffered output instead of handing it to the sink */
+    std::string release();
+
+private:
+    Sink sink;
+    size_t chunkSize;
+    std::string buf;
+    size_t flushed;
+    /** For each open object or array, whether it has no element yet */
+    std::vector<bool> empty;
+    bool afterKey;
+
+    void beginValue();
+    void endValue();
+};
+
 enum jtokentype {
     JTOK_ERR        = -1,
     JTOK_NONE       = 0,                           // eof
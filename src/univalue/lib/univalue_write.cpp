@@ -11,21 +11,9 @@
 
 namespace {
 struct UniValueStreamWriter {
-    std::string str;
+    std::string &str;
 
-    UniValueStreamWriter() {
-        str.reserve(1024);
-    }
-
-    std::string getString() {
-#if __cplusplus >= 201103L
-        return std::move(str);
-#else
-        std::string ret;
-        std::swap(ret, str);
-        return ret;
-#endif
-    }
+    explicit UniValueStreamWriter(std::string &strIn) : str(strIn) {}
 
     void put(char c) {
         str.push_back(c);
@@ -157,7 +145,100 @@ void UniValueStreamWriter::writeObject(unsigned int prettyIndent, unsigned int i
 }
 
 std::string UniValue::write(unsigned int prettyIndent, unsigned int indentLevel) const {
-    UniValueStreamWriter ss;
+    std::string str;
+    str.reserve(1024);
+    UniValueStreamWriter ss(str);
     ss.writeAny(prettyIndent, indentLevel, *this);
-    return ss.getString();
+    return str;
+}
+
+UniValueWriter::UniValueWriter(const Sink& sinkIn, size_t chunkSizeIn)
+    : sink(sinkIn), chunkSize(chunkSizeIn), flushed(0), afterKey(false)
+{
+    buf.reserve(chunkSize + 1024);
+}
+
+void UniValueWriter::beginValue() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (!empty.empty()) {
+        if (!empty.back()) {
+            buf.push_back(',');
+        }
+        empty.back() = false;
+    }
+}
+
+void UniValueWriter::endValue() {
+    if (buf.size() >= chunkSize) {
+        flush();
+    }
+}
+
+void UniValueWriter::beginObject() {
+    beginValue();
+    buf.push_back('{');
+    empty.push_back(true);
+}
+
+void UniValueWriter::endObject() {
+    assert(!empty.empty() && !afterKey);
+    empty.pop_back();
+    buf.push_back('}');
+    endValue();
+}
+
+void UniValueWriter::beginArray() {
+    beginValue();
+    buf.push_back('[');
+    empty.push_back(true);
+}
+
+void UniValueWriter::endArray() {
+    assert(!empty.empty() && !afterKey);
+    empty.pop_back();
+    buf.push_back(']');
+    endValue();
+}
+
+void UniValueWriter::key(const std::string& k) {
+    assert(!empty.empty() && !afterKey);
+    beginValue();
+    buf.push_back('"');
+    UniValueStreamWriter(buf).escapeJson(k);
+    buf.append("\":");
+    afterKey = true;
+}
+
+void UniValueWriter::value(const UniValue& val) {
+    beginValue();
+    UniValueStreamWriter(buf).writeAny(0, 0, val);
+    endValue();
+}
+
+void UniValueWriter::pushKVs(const UniValue& obj) {
+    assert(obj.isObject());
+    const std::vector<std::string>& objKeys = obj.getKeys();
+    const std::vector<UniValue>& objValues = obj.getValues();
+    for (size_t i = 0; i < objKeys.size(); ++i) {
+        key(objKeys[i]);
+        value(objValues[i]);
+    }
+}
+
+void UniValueWriter::flush() {
+    if (buf.empty()) {
+        return;
+    }
+    sink(buf);
+    flushed += buf.size();
+    buf.clear();
+}
+
+std::string UniValueWriter::release() {
+    std::string ret;
+    std::swap(ret, buf);
+    return ret;
 }
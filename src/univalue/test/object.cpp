@@ -398,6 +398,49 @@ BOOST_AUTO_TEST_CASE(univalue_readwrite)
     BOOST_CHECK(!v.read("{} 42"));
 }
 
+BOOST_AUTO_TEST_CASE(univalue_streamwrite)
+{
+    UniValue v;
+    BOOST_CHECK(v.read(json1));
+
+    // Write json1 piece by piece, with tiny chunks
+    std::string out;
+    size_t nChunks = 0;
+    UniValueWriter writer([&](const std::string& chunk) {
+        BOOST_CHECK(!chunk.empty());
+        out += chunk;
+        ++nChunks;
+    }, 8);
+    writer.beginArray();
+    writer.value(v[0]);
+    writer.beginObject();
+    writer.key("key1");
+    BOOST_CHECK(writer.expectingValue());
+    writer.value(v[1]["key1"]);
+    BOOST_CHECK(!writer.expectingValue());
+    writer.key("key2");
+    writer.value(v[1]["key2"]);
+    writer.key("key3");
+    writer.beginObject();
+    writer.pushKVs(v[1]["key3"]);
+    writer.endObject();
+    writer.endObject();
+    writer.endArray();
+    BOOST_CHECK(nChunks > 1);
+    BOOST_CHECK_EQUAL(writer.bytesFlushed(), out.size());
+    writer.flush();
+    BOOST_CHECK_EQUAL(out, std::string(json1));
+
+    // Without flushing, the output can be taken back
+    UniValueWriter small([](const std::string&) { assert(false); });
+    small.beginArray();
+    small.endArray();
+    small.beginObject();
+    small.endObject();
+    BOOST_CHECK_EQUAL(small.release(), "[]{}");
+    BOOST_CHECK_EQUAL(small.bytesFlushed(), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 int main (int argc, char *argv[])
@@ -408,6 +451,7 @@ int main (int argc, char *argv[])
     univalue_array();
     univalue_object();
     univalue_readwrite();
+    univalue_streamwrite();
     return 0;
 }
 
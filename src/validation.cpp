@@ -67,6 +67,7 @@
 #include <cassert>
 #include <chrono>
 #include <deque>
+#include <map>
 #include <numeric>
 #include <optional>
 #include <string>
@@ -249,6 +250,55 @@ static bool CheckInputsFromMempoolAndCache(
 
 namespace {
 
+/**
+ * The transactions whose scripts failed the verification ahead of their
+ * mempool admission, with the flags they were verified against and the
+ * resulting rejection, so that their admission doesn't verify them again.
+ * Only the most recent failures are kept.
+ */
+struct ScriptPreCheckFailure {
+    uint32_t flags;
+    TxValidationState state;
+};
+static constexpr size_t MAX_SCRIPT_PRECHECK_FAILURES{1000};
+std::map<TxId, ScriptPreCheckFailure>
+    g_script_precheck_failures GUARDED_BY(cs_main);
+std::deque<TxId> g_script_precheck_failures_order GUARDED_BY(cs_main);
+
+void AddScriptPreCheckFailure(const TxId &txid, uint32_t flags,
+                              TxValidationState &&state)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    AssertLockHeld(cs_main);
+    if (g_script_precheck_failures_order.size() >=
+        MAX_SCRIPT_PRECHECK_FAILURES) {
+        g_script_precheck_failures.erase(
+            g_script_precheck_failures_order.front());
+        g_script_precheck_failures_order.pop_front();
+    }
+    g_script_precheck_failures[txid] = {flags, std::move(state)};
+    g_script_precheck_failures_order.push_back(txid);
+}
+
+/**
+ * Remove the failure recorded for txid, and return true if it was found for
+ * the same flags.
+ */
+bool TakeScriptPreCheckFailure(const TxId &txid, uint32_t flags,
+                               TxValidationState &state)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    AssertLockHeld(cs_main);
+    auto it = g_script_precheck_failures.find(txid);
+    if (it == g_script_precheck_failures.end()) {
+        return false;
+    }
+    const bool found{it->second.flags == flags};
+    if (found) {
+        state = std::move(it->second.state);
+    }
+    g_script_precheck_failures.erase(it);
+    return found;
+}
+
 class MemPoolAccept {
 public:
     MemPoolAccept(CTxMemPool &mempool, Chainstate &active_chainstate)
@@ -322,6 +372,19 @@ public:
                             /*package_submission=*/true};
         }
 
+        /** Parameters for ancestor package validation. */
+        static ATMPArgs
+        PackageWithAncestors(const Config &config, int64_t accept_time,
+                             std::vector<COutPoint> &coins_to_uncache) {
+            return ATMPArgs{config,
+                            accept_time,
+                            /*bypass_limits=*/false,
+                            coins_to_uncache,
+                            /*test_accept=*/false,
+                            /*height_override=*/0,
+                            /*package_submission=*/true};
+        }
+
     private:
         // Private ctor to avoid exposing details to clients and allowing the
         // possibility of mixing up the order of the arguments. Use static
@@ -361,7 +424,26 @@ public:
                                              ATMPArgs &args)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /**
+     * Ancestor package acceptance. Package must be a child with some of its
+     * unconfirmed ancestors, and topologically sorted. The ancestors that are
+     * not in the package must be in the mempool or confirmed.
+     */
+    PackageMempoolAcceptResult AcceptAncestorPackage(const Package &package,
+                                                     ATMPArgs &args)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 private:
+    /**
+     * Accept the transactions of a well-formed package that are not in the
+     * mempool yet with AcceptMultipleTransactions(). The results of the
+     * transactions already in the mempool are included as well.
+     */
+    PackageMempoolAcceptResult AcceptNewPackageTransactions(
+        const Package &package, ATMPArgs &args,
+        PackageValidationState &package_state)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     // All the intermediate state that gets passed between the various levels
     // of checking a given transaction.
     struct Workspace {
@@ -608,6 +690,10 @@ bool MemPoolAccept::PreChecks(ATMPArgs &args, Workspace &ws) {
     // Validate input scripts against standard script flags.
     const uint32_t scriptVerifyFlags =
         ws.m_next_block_script_verify_flags | STANDARD_SCRIPT_VERIFY_FLAGS;
+    if (TakeScriptPreCheckFailure(txid, scriptVerifyFlags, state)) {
+        // The scripts already failed PreCheckTransactionScripts()
+        return false;
+    }
     ws.m_precomputed_txdata = PrecomputedTransactionData{tx};
     if (!CheckInputScripts(tx, state, m_view, scriptVerifyFlags, true, false,
                            ws.m_precomputed_txdata, ws.m_sig_checks_standard)) {
@@ -981,6 +1067,35 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptPackage(const Package &package,
     // needed in PreChecks.
     m_view.SetBackend(m_dummy);
 
+    return AcceptNewPackageTransactions(package, args, package_state);
+}
+
+PackageMempoolAcceptResult
+MemPoolAccept::AcceptAncestorPackage(const Package &package, ATMPArgs &args) {
+    AssertLockHeld(cs_main);
+    PackageValidationState package_state;
+
+    // Context-free package checks.
+    if (!CheckPackage(package, package_state)) {
+        return PackageMempoolAcceptResult(package_state, {});
+    }
+
+    if (!IsAncestorPackage(package)) {
+        package_state.Invalid(PackageValidationResult::PCKG_POLICY,
+                              "package-not-child-with-ancestors");
+        return PackageMempoolAcceptResult(package_state, {});
+    }
+
+    // The ancestors missing from the package are looked up in the mempool
+    // and the chain by the PreChecks of AcceptMultipleTransactions().
+    return AcceptNewPackageTransactions(package, args, package_state);
+}
+
+PackageMempoolAcceptResult MemPoolAccept::AcceptNewPackageTransactions(
+    const Package &package, ATMPArgs &args,
+    PackageValidationState &package_state) {
+    AssertLockHeld(cs_main);
+
     LOCK(m_pool.cs);
     std::map<const TxId, const MempoolAcceptResult> results;
     // Node operators are free to set their mempool policies however they
@@ -1100,6 +1215,35 @@ PackageMempoolAcceptResult ProcessNewPackage(Chainstate &active_chainstate,
     return result;
 }
 
+PackageMempoolAcceptResult
+ProcessNewAncestorPackage(Chainstate &active_chainstate, CTxMemPool &pool,
+                          const Package &package) {
+    AssertLockHeld(cs_main);
+    assert(!package.empty());
+    assert(std::all_of(package.cbegin(), package.cend(),
+                       [](const auto &tx) { return tx != nullptr; }));
+
+    std::vector<COutPoint> coins_to_uncache;
+    auto args = MemPoolAccept::ATMPArgs::PackageWithAncestors(
+        active_chainstate.m_chainman.GetConfig(), GetTime(), coins_to_uncache);
+    const auto result = MemPoolAccept(pool, active_chainstate)
+                            .AcceptAncestorPackage(package, args);
+
+    // Uncache coins pertaining to transactions that were not submitted to the
+    // mempool.
+    if (result.m_state.IsInvalid()) {
+        for (const COutPoint &outpoint : coins_to_uncache) {
+            active_chainstate.CoinsTip().Uncache(outpoint);
+        }
+    }
+    // Ensure the coins cache is still within limits.
+    BlockValidationState state_dummy;
+    active_chainstate.FlushStateToDisk(state_dummy, FlushStateMode::PERIODIC);
+    pool.check(active_chainstate.CoinsTip(),
+               active_chainstate.m_chain.Height() + 1);
+    return result;
+}
+
 Amount GetBlockSubsidy(int nHeight, const Consensus::Params &consensusParams) {
     int halvings = nHeight / consensusParams.nSubsidyHalvingInterval;
     // Force block reward to zero when right shift is undefined.
@@ -1368,6 +1512,32 @@ bool CScriptCheck::operator()() {
     return true;
 }
 
+bool CTxInputPreCheck::operator()() {
+    m_result->standard_ok = m_standard();
+    if (m_result->standard_ok) {
+        m_result->standard_sigchecks =
+            m_standard.GetScriptExecutionMetrics().nSigChecks;
+        // The signatures verified by the check above are found in the
+        // signature cache, so this one mostly runs the script interpreter.
+        m_result->consensus_ok = m_consensus();
+        m_result->consensus_sigchecks =
+            m_consensus.GetScriptExecutionMetrics().nSigChecks;
+    } else {
+        m_result->standard_error = m_standard.GetScriptError();
+        m_result->mandatory_error = m_result->standard_error;
+        // Tell a policy failure from a consensus one, like CheckInputScripts
+        if (m_mandatory_flags != m_standard.nFlags) {
+            CScriptCheck mandatory(m_standard.m_tx_out, *m_standard.ptxTo,
+                                   m_standard.nIn, m_mandatory_flags,
+                                   m_standard.cacheStore, m_standard.txdata);
+            m_result->mandatory_ok = mandatory();
+            m_result->mandatory_error = mandatory.GetScriptError();
+        }
+    }
+    // Never abort the batch, the outcome is reported through m_result
+    return true;
+}
+
 bool CheckInputScripts(const CTransaction &tx, TxValidationState &state,
                        const CCoinsViewCache &inputs, const uint32_t flags,
                        bool sigCacheStore, bool scriptCacheStore,
@@ -1597,15 +1767,202 @@ DisconnectResult ApplyBlockUndo(CBlockUndo &&blockUndo, const CBlock &block,
 }
 
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CCheckQueue<CHeaderPoWCheck> headercheckqueue(128, "headerch");
+static CCheckQueue<CTxInputPreCheck> txcheckqueue(128, "txcheck");
 
 void StartScriptCheckWorkerThreads(int threads_num) {
     scriptcheckqueue.StartWorkerThreads(threads_num);
+    headercheckqueue.StartWorkerThreads(threads_num);
+    txcheckqueue.StartWorkerThreads(threads_num);
 }
 
 void StopScriptCheckWorkerThreads() {
     scriptcheckqueue.StopWorkerThreads();
+    headercheckqueue.StopWorkerThreads();
+    txcheckqueue.StopWorkerThreads();
 }
 
+namespace {
+
+/**
+ * Apply the checks of MemPoolAccept::PreChecks that depend on the coins spent
+ * by tx: finality, conflicts with the mempool transactions, missing or
+ * immature coins and non-standard inputs. The coins are looked up in view.
+ * Returns false if the admission would reject tx before verifying its
+ * scripts, otherwise sets the fees and the outputs spent by tx.
+ */
+bool PreCheckInputs(const CTransaction &tx, Chainstate &active_chainstate,
+                    const CTxMemPool &pool, CCoinsViewCache &view,
+                    uint32_t next_block_flags, Amount &fees,
+                    std::vector<CTxOut> &spent_outputs)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs) {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(pool.cs);
+    const CBlockIndex *tip = active_chainstate.m_chain.Tip();
+    TxValidationState state;
+    if (!ContextualCheckTransactionForCurrentBlock(
+            tip, active_chainstate.m_chainman.GetConsensus(), tx, state)) {
+        return false;
+    }
+    for (const CTxIn &txin : tx.vin) {
+        // The mempool view returns the coins of the chain even if a mempool
+        // transaction spends them.
+        if (pool.GetConflictTx(txin.prevout)) {
+            return false;
+        }
+    }
+    if (!Consensus::CheckTxInputs(tx, state, view, tip->nHeight + 1, fees)) {
+        return false;
+    }
+    if (pool.m_require_standard &&
+        !AreInputsStandard(tx, view, next_block_flags)) {
+        return false;
+    }
+
+    spent_outputs.clear();
+    spent_outputs.reserve(tx.vin.size());
+    for (const CTxIn &txin : tx.vin) {
+        spent_outputs.push_back(view.AccessCoin(txin.prevout).GetTxOut());
+    }
+    return true;
+}
+
+/**
+ * Make the outputs of tx available to the next transactions of a batch, and
+ * its inputs unavailable to them.
+ */
+void PreCheckSpendInputs(const CTransaction &tx, CCoinsViewCache &view) {
+    for (const CTxIn &txin : tx.vin) {
+        view.SpendCoin(txin.prevout);
+    }
+    AddCoins(view, tx, MEMPOOL_HEIGHT);
+}
+
+/**
+ * Transactions whose input scripts are verified in parallel on the
+ * transaction checking worker threads, ahead of their mempool admission.
+ */
+class TxScriptPreChecks {
+private:
+    struct PendingTx {
+        CTransactionRef tx;
+        std::vector<CTxOut> spent_outputs;
+        TxSigCheckLimiter standard_limiter;
+        TxSigCheckLimiter consensus_limiter;
+        size_t first_result;
+    };
+
+    const uint32_t m_next_block_flags;
+    const uint32_t m_standard_flags;
+    std::vector<PendingTx> m_pending;
+    std::vector<CTxInputPreCheck::Result> m_results;
+    size_t m_num_inputs{0};
+
+public:
+    explicit TxScriptPreChecks(uint32_t next_block_flags)
+        : m_next_block_flags(next_block_flags),
+          m_standard_flags(next_block_flags | STANDARD_SCRIPT_VERIFY_FLAGS) {}
+
+    uint32_t GetNextBlockFlags() const { return m_next_block_flags; }
+
+    void Add(const CTransactionRef &tx, std::vector<CTxOut> &&spent_outputs) {
+        assert(spent_outputs.size() == tx->vin.size());
+        m_pending.push_back({tx, std::move(spent_outputs), TxSigCheckLimiter(),
+                             TxSigCheckLimiter(), m_num_inputs});
+        m_num_inputs += tx->vin.size();
+    }
+
+    bool empty() const { return m_pending.empty(); }
+
+    /** Verify the scripts of all the inputs in parallel */
+    void Run() {
+        // The checks keep pointers into m_pending and m_results, which must
+        // not be resized until they complete.
+        m_results.assign(m_num_inputs, CTxInputPreCheck::Result());
+        const uint32_t mandatory_flags{m_standard_flags &
+                                       ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS};
+        std::vector<CTxInputPreCheck> checks;
+        checks.reserve(m_num_inputs);
+        for (PendingTx &ptx : m_pending) {
+            const CTransaction &tx = *ptx.tx;
+            const PrecomputedTransactionData txdata{tx};
+            for (size_t i = 0; i < tx.vin.size(); i++) {
+                checks.emplace_back(
+                    CScriptCheck(ptx.spent_outputs[i], tx, i, m_standard_flags,
+                                 /*cacheIn=*/true, txdata,
+                                 &ptx.standard_limiter),
+                    CScriptCheck(ptx.spent_outputs[i], tx, i,
+                                 m_next_block_flags, /*cacheIn=*/true, txdata,
+                                 &ptx.consensus_limiter),
+                    mandatory_flags, m_results[ptx.first_result + i]);
+            }
+        }
+
+        CCheckQueueControl<CTxInputPreCheck> control(&txcheckqueue);
+        control.Add(checks);
+        control.Wait();
+    }
+
+    /**
+     * Store the transactions whose scripts are valid in the script cache, with
+     * the same signature check counts their admission would compute, and
+     * record the rejection of the others for their admission.
+     * Returns the number of transactions with valid scripts.
+     */
+    size_t StoreInScriptCache() EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+        AssertLockHeld(cs_main);
+        size_t num_verified{0};
+        for (const PendingTx &ptx : m_pending) {
+            const auto begin = m_results.cbegin() + ptx.first_result;
+            const auto end = begin + ptx.tx->vin.size();
+            const auto failed =
+                std::find_if(begin, end, [](const auto &result) {
+                    return !result.standard_ok;
+                });
+            if (failed != end) {
+                // Same rejection as CheckInputScripts for the first failing
+                // input
+                TxValidationState state;
+                if (failed->mandatory_ok) {
+                    state.Invalid(
+                        TxValidationResult::TX_NOT_STANDARD,
+                        strprintf("non-mandatory-script-verify-flag (%s)",
+                                  ScriptErrorString(failed->standard_error)));
+                } else {
+                    state.Invalid(
+                        TxValidationResult::TX_CONSENSUS,
+                        strprintf("mandatory-script-verify-flag-failed (%s)",
+                                  ScriptErrorString(failed->mandatory_error)));
+                }
+                AddScriptPreCheckFailure(ptx.tx->GetId(), m_standard_flags,
+                                         std::move(state));
+                continue;
+            }
+            ++num_verified;
+
+            int standard_sigchecks{0};
+            int consensus_sigchecks{0};
+            bool consensus_ok{true};
+            for (auto it = begin; it != end; ++it) {
+                standard_sigchecks += it->standard_sigchecks;
+                consensus_sigchecks += it->consensus_sigchecks;
+                consensus_ok &= it->consensus_ok;
+            }
+            AddKeyInScriptCache(ScriptCacheKey(*ptx.tx, m_standard_flags),
+                                standard_sigchecks);
+            // A discrepancy is reported by the admission itself
+            if (consensus_ok && consensus_sigchecks == standard_sigchecks) {
+                AddKeyInScriptCache(
+                    ScriptCacheKey(*ptx.tx, m_next_block_flags),
+                    consensus_sigchecks);
+            }
+        }
+        return num_verified;
+    }
+};
+
+} // namespace
+
 // Returns the script flags which should be checked for the block after
 // the given block.
 static uint32_t GetNextBlockScriptFlags(const CBlockIndex *pindex,
@@ -2249,7 +2606,10 @@ bool Chainstate::FlushStateToDisk(BlockValidationState &state,
 
                     // First make sure all block and undo data is flushed to
                     // disk.
-                    m_blockman.FlushBlockFile();
+                    if (!m_blockman.FlushBlockFile()) {
+                        return AbortNode(
+                            state, "Failed to write block and undo data");
+                    }
                 }
                 // Then update all block file information (which may refer to
                 // block and undo files).
@@ -3853,13 +4213,31 @@ bool CheckBlock(const CBlock &block, BlockValidationState &state,
     return true;
 }
 
+bool CHeaderPoWCheck::operator()() {
+    *m_hash = m_header->GetHash();
+    return CheckProofOfWork(*m_hash, m_header->nBits, *m_params);
+}
+
 bool HasValidProofOfWork(const std::vector<CBlockHeader> &headers,
                          const Consensus::Params &consensusParams) {
-    return std::all_of(headers.cbegin(), headers.cend(),
-                       [&](const auto &header) {
-                           return CheckProofOfWork(
-                               header.GetHash(), header.nBits, consensusParams);
-                       });
+    std::vector<BlockHash> hashes;
+    return HasValidProofOfWork(headers, consensusParams, hashes);
+}
+
+bool HasValidProofOfWork(const std::vector<CBlockHeader> &headers,
+                         const Consensus::Params &consensusParams,
+                         std::vector<BlockHash> &hashes) {
+    hashes.assign(headers.size(), BlockHash());
+
+    std::vector<CHeaderPoWCheck> vChecks;
+    vChecks.reserve(headers.size());
+    for (size_t i = 0; i < headers.size(); ++i) {
+        vChecks.emplace_back(headers[i], hashes[i], consensusParams);
+    }
+
+    CCheckQueueControl<CHeaderPoWCheck> control(&headercheckqueue);
+    control.Add(vChecks);
+    return control.Wait();
 }
 
 arith_uint256 CalculateHeadersWork(const std::vector<CBlockHeader> &headers) {
@@ -4085,12 +4463,19 @@ bool ChainstateManager::AcceptBlockHeader(
     const CBlockHeader &block, BlockValidationState &state,
     CBlockIndex **ppindex, bool min_pow_checked,
     const std::optional<CCheckpointData> &test_checkpoints) {
+    return AcceptBlockHeader(block, block.GetHash(), /*pow_checked=*/false,
+                             state, ppindex, min_pow_checked, test_checkpoints);
+}
+
+bool ChainstateManager::AcceptBlockHeader(
+    const CBlockHeader &block, const BlockHash &hash, bool pow_checked,
+    BlockValidationState &state, CBlockIndex **ppindex, bool min_pow_checked,
+    const std::optional<CCheckpointData> &test_checkpoints) {
     AssertLockHeld(cs_main);
     const Config &config = this->GetConfig();
     const CChainParams &chainparams = config.GetChainParams();
 
     // Check for duplicate
-    BlockHash hash = block.GetHash();
     BlockMap::iterator miSelf{m_blockman.m_block_index.find(hash)};
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
         if (miSelf != m_blockman.m_block_index.end()) {
@@ -4110,7 +4495,8 @@ bool ChainstateManager::AcceptBlockHeader(
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(),
+        if (!pow_checked &&
+            !CheckBlockHeader(block, state, chainparams.GetConsensus(),
                               BlockValidationOptions(config))) {
             LogPrint(BCLog::VALIDATION,
                      "%s: Consensus::CheckBlockHeader: %s, %s\n", __func__,
@@ -4201,7 +4587,8 @@ bool ChainstateManager::AcceptBlockHeader(
         return state.Invalid(BlockValidationResult::BLOCK_HEADER_LOW_WORK,
                              "too-little-chainwork");
     }
-    CBlockIndex *pindex{m_blockman.AddToBlockIndex(block, m_best_header)};
+    CBlockIndex *pindex{
+        m_blockman.AddToBlockIndex(block, hash, m_best_header)};
 
     if (ppindex) {
         *ppindex = pindex;
@@ -4214,15 +4601,35 @@ bool ChainstateManager::AcceptBlockHeader(
 bool ChainstateManager::ProcessNewBlockHeaders(
     const std::vector<CBlockHeader> &headers, bool min_pow_checked,
     BlockValidationState &state, const CBlockIndex **ppindex,
-    const std::optional<CCheckpointData> &test_checkpoints) {
+    const std::optional<CCheckpointData> &test_checkpoints,
+    const std::vector<BlockHash> *pow_checked_hashes) {
     AssertLockNotHeld(cs_main);
+
+    // Hash the headers and check their proof of work in parallel before
+    // taking cs_main, so only the block index insertion is serialized. If any
+    // check fails, the headers are processed one by one as usual so they are
+    // accepted up to the invalid one and the state reports the failure.
+    std::vector<BlockHash> computed_hashes;
+    const bool pow_checked =
+        pow_checked_hashes ||
+        HasValidProofOfWork(headers, GetConsensus(), computed_hashes);
+    const std::vector<BlockHash> &hashes =
+        pow_checked_hashes ? *pow_checked_hashes : computed_hashes;
+    assert(!pow_checked || hashes.size() == headers.size());
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader &header : headers) {
+        for (size_t i = 0; i < headers.size(); ++i) {
+            const CBlockHeader &header = headers[i];
             // Use a temp pindex instead of ppindex to avoid a const_cast
             CBlockIndex *pindex = nullptr;
-            bool accepted = AcceptBlockHeader(
-                header, state, &pindex, min_pow_checked, test_checkpoints);
+            bool accepted =
+                pow_checked
+                    ? AcceptBlockHeader(header, hashes[i], /*pow_checked=*/true,
+                                        state, &pindex, min_pow_checked,
+                                        test_checkpoints)
+                    : AcceptBlockHeader(header, state, &pindex,
+                                        min_pow_checked, test_checkpoints);
             ActiveChainstate().CheckBlockIndex();
 
             if (!accepted) {
@@ -4529,6 +4936,130 @@ ChainstateManager::ProcessTransaction(const CTransactionRef &tx,
     return result;
 }
 
+size_t ChainstateManager::PreCheckTransactionScripts(
+    const std::vector<CTransactionRef> &txs) {
+    AssertLockNotHeld(cs_main);
+
+    // Run the context-free checks first, they don't need any lock
+    std::vector<CTransactionRef> candidates;
+    candidates.reserve(txs.size());
+    for (const CTransactionRef &tx : txs) {
+        TxValidationState state;
+        if (CheckRegularTransaction(*tx, state)) {
+            candidates.push_back(tx);
+        }
+    }
+    if (candidates.empty()) {
+        return 0;
+    }
+
+    std::optional<TxScriptPreChecks> prechecks;
+    {
+        LOCK(cs_main);
+        Chainstate &active_chainstate = ActiveChainstate();
+        CTxMemPool *mempool = active_chainstate.GetMempool();
+        if (!mempool) {
+            return 0;
+        }
+        LOCK(mempool->cs);
+
+        prechecks.emplace(
+            GetNextBlockScriptFlags(active_chainstate.m_chain.Tip(), *this));
+        CCoinsViewCache &coins_tip = active_chainstate.CoinsTip();
+        CCoinsViewMemPool view_mempool(&coins_tip, *mempool);
+        CCoinsViewCache view(&view_mempool);
+        // Don't let the coins of transactions that may turn out to be invalid
+        // grow the coins cache, the admission fetches them again if needed.
+        std::vector<COutPoint> coins_to_uncache;
+        const CFeeRate min_feerate{
+            std::max(mempool->m_min_relay_feerate, mempool->GetMinFee())};
+
+        for (const CTransactionRef &tx : candidates) {
+            const TxId &txid = tx->GetId();
+            std::string reason;
+            if (mempool->exists(txid) ||
+                (mempool->m_require_standard &&
+                 !IsStandardTx(*tx, mempool->m_max_datacarrier_bytes,
+                               mempool->m_permit_bare_multisig,
+                               mempool->m_dust_relay_feerate, reason))) {
+                continue;
+            }
+
+            for (const CTxIn &txin : tx->vin) {
+                if (!coins_tip.HaveCoinInCache(txin.prevout)) {
+                    coins_to_uncache.push_back(txin.prevout);
+                }
+            }
+            Amount modified_fees{Amount::zero()};
+            std::vector<CTxOut> spent_outputs;
+            if (!PreCheckInputs(*tx, active_chainstate, *mempool, view,
+                                prechecks->GetNextBlockFlags(), modified_fees,
+                                spent_outputs)) {
+                continue;
+            }
+            // The next transactions can spend the outputs of this one, as
+            // within a package.
+            PreCheckSpendInputs(*tx, view);
+
+            // Skip the transactions that are certain not to pay enough fees
+            // to enter the mempool, their scripts don't need to be verified.
+            mempool->ApplyDelta(txid, modified_fees);
+            if (modified_fees < min_feerate.GetFee(tx->GetTotalSize())) {
+                continue;
+            }
+
+            prechecks->Add(tx, std::move(spent_outputs));
+        }
+
+        for (const COutPoint &outpoint : coins_to_uncache) {
+            coins_tip.Uncache(outpoint);
+        }
+    }
+    if (prechecks->empty()) {
+        return 0;
+    }
+
+    // Verify the scripts without holding any lock
+    prechecks->Run();
+
+    LOCK(cs_main);
+    return prechecks->StoreInScriptCache();
+}
+
+size_t PreCheckTransactionScripts(Chainstate &active_chainstate,
+                                  CTxMemPool &pool,
+                                  const std::vector<CTransactionRef> &txs) {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(pool.cs);
+
+    TxScriptPreChecks prechecks(GetNextBlockScriptFlags(
+        active_chainstate.m_chain.Tip(), active_chainstate.m_chainman));
+    CCoinsViewMemPool view_mempool(&active_chainstate.CoinsTip(), pool);
+    CCoinsViewCache view(&view_mempool);
+    for (const CTransactionRef &tx : txs) {
+        if (tx->IsCoinBase() || pool.exists(tx->GetId())) {
+            continue;
+        }
+        Amount fees{Amount::zero()};
+        std::vector<CTxOut> spent_outputs;
+        if (!PreCheckInputs(*tx, active_chainstate, pool, view,
+                            prechecks.GetNextBlockFlags(), fees,
+                            spent_outputs)) {
+            continue;
+        }
+        // The transactions are in topological order, so the outputs of the
+        // earlier ones can be spent by the next ones.
+        PreCheckSpendInputs(*tx, view);
+        prechecks.Add(tx, std::move(spent_outputs));
+    }
+    if (prechecks.empty()) {
+        return 0;
+    }
+
+    prechecks.Run();
+    return prechecks.StoreInScriptCache();
+}
+
 bool TestBlockValidity(
     BlockValidationState &state, const CChainParams &params,
     Chainstate &chainstate, const CBlock &block, CBlockIndex *pindexPrev,
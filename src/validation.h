@@ -154,12 +154,13 @@ public:
 };
 
 /**
- * Run instances of script checking worker threads
+ * Run instances of script checking worker threads. The same number of header
+ * proof of work checking and of transaction checking threads is started.
  */
 void StartScriptCheckWorkerThreads(int threads_num);
 
 /**
- * Stop all of the script checking worker threads
+ * Stop all of the script, header and transaction checking worker threads
  */
 void StopScriptCheckWorkerThreads();
 
@@ -294,6 +295,23 @@ AcceptToMemoryPool(Chainstate &active_chainstate, const CTransactionRef &tx,
                    bool test_accept = false, unsigned int heightOverride = 0)
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Verify in parallel the input scripts of a batch of transactions about to be
+ * re-submitted to the mempool with AcceptToMemoryPool(), and store the valid
+ * ones in the script cache. The transactions must be in topological order:
+ * they can spend the outputs of the transactions that come before them.
+ *
+ * Unlike ChainstateManager::PreCheckTransactionScripts(), the locks are held
+ * for the whole call, and neither the fees nor the standardness of the
+ * transactions themselves are checked.
+ *
+ * @returns the number of transactions whose scripts were verified.
+ */
+size_t PreCheckTransactionScripts(Chainstate &active_chainstate,
+                                  CTxMemPool &pool,
+                                  const std::vector<CTransactionRef> &txs)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs);
+
 /**
  * Validate (and maybe submit) a package to the mempool.
  * See doc/policy/packages.md for full detailson package validation rules.
@@ -310,6 +328,20 @@ ProcessNewPackage(Chainstate &active_chainstate, CTxMemPool &pool,
                   const Package &txns, bool test_accept)
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Validate and submit a package made of a transaction and some of its
+ * unconfirmed ancestors, as relayed by our peers, to the mempool. The
+ * ancestors missing from the package must be in the mempool already.
+ *
+ * @returns a PackageMempoolAcceptResult which includes a MempoolAcceptResult
+ *     for each transaction. If a transaction fails, validation will exit early
+ *     and some results may be missing.
+ */
+PackageMempoolAcceptResult
+ProcessNewAncestorPackage(Chainstate &active_chainstate, CTxMemPool &pool,
+                          const Package &package)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /**
  * Simple class for regulating resource usage during CheckInputScripts (and
  * CScriptCheck), atomic so as to be compatible with parallel validation.
@@ -494,6 +526,80 @@ public:
     ScriptError GetScriptError() const { return error; }
 
     ScriptExecutionMetrics GetScriptExecutionMetrics() const { return metrics; }
+
+    friend class CTxInputPreCheck;
+};
+
+/**
+ * Closure representing the proof of work check of a single block header. The
+ * hash of the header is written to the provided slot so the caller can reuse
+ * it once all the checks are complete.
+ */
+class CHeaderPoWCheck {
+private:
+    const CBlockHeader *m_header{nullptr};
+    BlockHash *m_hash{nullptr};
+    const Consensus::Params *m_params{nullptr};
+
+public:
+    CHeaderPoWCheck() = default;
+    CHeaderPoWCheck(const CBlockHeader &header, BlockHash &hash,
+                    const Consensus::Params &params)
+        : m_header(&header), m_hash(&hash), m_params(&params) {}
+
+    bool operator()();
+
+    void swap(CHeaderPoWCheck &check) noexcept {
+        std::swap(m_header, check.m_header);
+        std::swap(m_hash, check.m_hash);
+        std::swap(m_params, check.m_params);
+    }
+};
+
+/**
+ * Closure verifying the script of a single transaction input ahead of the
+ * transaction mempool admission, first against the standard script flags and
+ * then against the next block script flags. The outcome is written to the
+ * provided slot rather than returned, so that a failing input does not stop
+ * the checks of the other transactions queued alongside it.
+ */
+class CTxInputPreCheck {
+public:
+    struct Result {
+        bool standard_ok{false};
+        int standard_sigchecks{0};
+        bool consensus_ok{false};
+        int consensus_sigchecks{0};
+        //! When the standard check fails, its error and the outcome of the
+        //! check against the mandatory flags only
+        ScriptError standard_error{ScriptError::OK};
+        bool mandatory_ok{false};
+        ScriptError mandatory_error{ScriptError::OK};
+    };
+
+private:
+    CScriptCheck m_standard;
+    CScriptCheck m_consensus;
+    uint32_t m_mandatory_flags{0};
+    Result *m_result{nullptr};
+
+public:
+    CTxInputPreCheck() = default;
+    CTxInputPreCheck(CScriptCheck &&standard, CScriptCheck &&consensus,
+                     uint32_t mandatory_flags, Result &result)
+        : m_mandatory_flags(mandatory_flags), m_result(&result) {
+        m_standard.swap(standard);
+        m_consensus.swap(consensus);
+    }
+
+    bool operator()();
+
+    void swap(CTxInputPreCheck &check) noexcept {
+        m_standard.swap(check.m_standard);
+        m_consensus.swap(check.m_consensus);
+        std::swap(m_mandatory_flags, check.m_mandatory_flags);
+        std::swap(m_result, check.m_result);
+    }
 };
 
 /** Functions for validating blocks and updating the block tree */
@@ -535,6 +641,15 @@ bool TestBlockValidity(
 bool HasValidProofOfWork(const std::vector<CBlockHeader> &headers,
                          const Consensus::Params &consensusParams);
 
+/**
+ * Same as above, but the headers are hashed and checked in parallel on the
+ * header checking worker threads, and their hashes are returned in hashes
+ * (in the same order as headers) when the proof of work is valid.
+ */
+bool HasValidProofOfWork(const std::vector<CBlockHeader> &headers,
+                         const Consensus::Params &consensusParams,
+                         std::vector<BlockHash> &hashes);
+
 /** Return the sum of the work on a given set of headers */
 arith_uint256 CalculateHeadersWork(const std::vector<CBlockHeader> &headers);
 
@@ -1201,6 +1316,17 @@ private:
         CBlockIndex **ppindex, bool min_pow_checked,
         const std::optional<CCheckpointData> &test_checkpoints = std::nullopt)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /**
+     * Same as above for a header whose hash has already been computed by the
+     * caller. If pow_checked is true the header proof of work is known to be
+     * valid and is not checked again.
+     */
+    bool AcceptBlockHeader(
+        const CBlockHeader &block, const BlockHash &hash, bool pow_checked,
+        BlockValidationState &state, CBlockIndex **ppindex,
+        bool min_pow_checked,
+        const std::optional<CCheckpointData> &test_checkpoints)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     friend Chainstate;
 
     //! Returns nullptr if no snapshot has been loaded.
@@ -1416,12 +1542,17 @@ public:
      * @param[out] ppindex       If set, the pointer will be set to point to the
      *                           last new block index object for the given
      * headers.
+     * @param[in]  pow_checked_hashes  If set, the hashes of the headers, as
+     *                                 returned by HasValidProofOfWork() when
+     *                                 it succeeded, so they are not hashed and
+     *                                 checked again.
      * @return True if block headers were accepted as valid.
      */
     bool ProcessNewBlockHeaders(
         const std::vector<CBlockHeader> &block, bool min_pow_checked,
         BlockValidationState &state, const CBlockIndex **ppindex = nullptr,
-        const std::optional<CCheckpointData> &test_checkpoints = std::nullopt)
+        const std::optional<CCheckpointData> &test_checkpoints = std::nullopt,
+        const std::vector<BlockHash> *pow_checked_hashes = nullptr)
         LOCKS_EXCLUDED(cs_main);
 
     /**
@@ -1436,6 +1567,26 @@ public:
     ProcessTransaction(const CTransactionRef &tx, bool test_accept = false)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /**
+     * Verify the input scripts of transactions about to be submitted to the
+     * mempool, so that their admission only has to look them up in the
+     * script cache.
+     *
+     * The coins spent by the transactions are looked up in the coins tip and
+     * the mempool while briefly holding cs_main, then the scripts of all the
+     * transactions are verified in parallel on the transaction checking
+     * worker threads without any lock held. cs_main is finally taken again
+     * to store the successful results in the script cache. Transactions that
+     * fail a cheap check, spend a missing coin or have an invalid script are
+     * left for ProcessTransaction to reject as usual. The transactions can
+     * spend the outputs of the transactions that come before them, so the
+     * scripts of a topologically sorted package are verified at once.
+     *
+     * @returns the number of transactions whose scripts were verified.
+     */
+    size_t PreCheckTransactionScripts(const std::vector<CTransactionRef> &txs)
+        LOCKS_EXCLUDED(cs_main);
+
     //! Load the block tree and coins database from disk, initializing state if
     //! we're running with -reindex
     bool LoadBlockIndex() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
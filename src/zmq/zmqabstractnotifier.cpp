@@ -40,3 +40,8 @@ bool CZMQAbstractNotifier::NotifyTransactionRemoval(
     const CTransaction & /*transaction*/, uint64_t mempool_sequence) {
     return true;
 }
+
+void CZMQAbstractNotifier::NotifyDroppedEvents() {}
+
+void CZMQAbstractNotifier::SetConnectedBlock(
+    const std::shared_ptr<const CBlock> & /*block*/) {}
@@ -5,9 +5,12 @@
 #ifndef BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
 #define BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 
+class CBlock;
 class CBlockIndex;
 class CTransaction;
 class CZMQAbstractNotifier;
@@ -41,6 +44,9 @@ public:
         }
     }
 
+    /** Number of messages handed to the socket */
+    uint64_t GetPublishedMessages() const { return published_messages; }
+
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
@@ -58,12 +64,17 @@ public:
                                           uint64_t mempool_sequence);
     // Notifies of transactions added to mempool or appearing in blocks
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    // Notifies that validation events were dropped instead of being published
+    virtual void NotifyDroppedEvents();
+    // Remembers the last connected block, which is likely the next new tip
+    virtual void SetConnectedBlock(const std::shared_ptr<const CBlock> &block);
 
 protected:
     void *psocket;
     std::string type;
     std::string address;
     int outbound_message_high_water_mark; // aka SNDHWM
+    std::atomic<uint64_t> published_messages{0};
 };
 
 #endif // BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
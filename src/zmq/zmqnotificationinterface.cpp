@@ -10,6 +10,18 @@
 
 #include <primitives/block.h>
 #include <util/system.h>
+#include <util/thread.h>
+
+#include <utility>
+
+/** Size of the transactions of a block, as held by a queued event */
+static size_t BlockBytes(const CBlock &block) {
+    size_t bytes{0};
+    for (const CTransactionRef &tx : block.vtx) {
+        bytes += tx->GetTotalSize();
+    }
+    return bytes;
+}
 
 CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr) {}
 
@@ -19,6 +31,7 @@ CZMQNotificationInterface::~CZMQNotificationInterface() {
 
 std::list<const CZMQAbstractNotifier *>
 CZMQNotificationInterface::GetActiveNotifiers() const {
+    LOCK(m_notifiers_mutex);
     std::list<const CZMQAbstractNotifier *> result;
     for (const auto &n : notifiers) {
         result.push_back(n.get());
@@ -26,6 +39,16 @@ CZMQNotificationInterface::GetActiveNotifiers() const {
     return result;
 }
 
+size_t CZMQNotificationInterface::GetQueuedEvents() const {
+    LOCK(m_queue_mutex);
+    return m_queue.size();
+}
+
+uint64_t CZMQNotificationInterface::GetDroppedEvents() const {
+    LOCK(m_queue_mutex);
+    return m_dropped;
+}
+
 CZMQNotificationInterface *CZMQNotificationInterface::Create() {
     std::map<std::string, CZMQNotifierFactory> factories;
     factories["pubhashblock"] =
@@ -57,7 +80,8 @@ CZMQNotificationInterface *CZMQNotificationInterface::Create() {
     if (!notifiers.empty()) {
         std::unique_ptr<CZMQNotificationInterface> notificationInterface(
             new CZMQNotificationInterface());
-        notificationInterface->notifiers = std::move(notifiers);
+        WITH_LOCK(notificationInterface->m_notifiers_mutex,
+                  notificationInterface->notifiers = std::move(notifiers));
 
         if (notificationInterface->Initialize()) {
             return notificationInterface.release();
@@ -83,24 +107,43 @@ bool CZMQNotificationInterface::Initialize() {
         return false;
     }
 
-    for (auto &notifier : notifiers) {
-        if (notifier->Initialize(pcontext)) {
-            LogPrint(BCLog::ZMQ, "zmq: Notifier %s ready (address = %s)\n",
-                     notifier->GetType(), notifier->GetAddress());
-        } else {
-            LogPrint(BCLog::ZMQ, "zmq: Notifier %s failed (address = %s)\n",
-                     notifier->GetType(), notifier->GetAddress());
-            return false;
+    {
+        LOCK(m_notifiers_mutex);
+        for (auto &notifier : notifiers) {
+            if (notifier->Initialize(pcontext)) {
+                LogPrint(BCLog::ZMQ,
+                         "zmq: Notifier %s ready (address = %s)\n",
+                         notifier->GetType(), notifier->GetAddress());
+            } else {
+                LogPrint(BCLog::ZMQ,
+                         "zmq: Notifier %s failed (address = %s)\n",
+                         notifier->GetType(), notifier->GetAddress());
+                return false;
+            }
         }
     }
 
+    m_publisher_thread = std::thread(&util::TraceThread, "zmqpub",
+                                     [this] { ThreadPublish(); });
     return true;
 }
 
 // Called during shutdown sequence
 void CZMQNotificationInterface::Shutdown() {
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
+    if (m_publisher_thread.joinable()) {
+        // The events queued so far are still published, for a limited time
+        {
+            LOCK(m_queue_mutex);
+            m_stop = true;
+            m_stop_deadline =
+                std::chrono::steady_clock::now() + SHUTDOWN_PUBLISH_TIMEOUT;
+        }
+        m_queue_cond.notify_one();
+        m_publisher_thread.join();
+    }
     if (pcontext) {
+        LOCK(m_notifiers_mutex);
         for (auto &notifier : notifiers) {
             LogPrint(BCLog::ZMQ, "zmq: Shutdown notifier %s at %s\n",
                      notifier->GetType(), notifier->GetAddress());
@@ -112,25 +155,78 @@ void CZMQNotificationInterface::Shutdown() {
     }
 }
 
-namespace {
+void CZMQNotificationInterface::Enqueue(Event event, size_t bytes) {
+    {
+        LOCK(m_queue_mutex);
+        // An event is always accepted into an empty queue, however large
+        while (!m_queue.empty() &&
+               (m_queue.size() >= MAX_QUEUED_EVENTS ||
+                m_queued_bytes + bytes > MAX_QUEUED_BYTES)) {
+            m_queued_bytes -= m_queue.front().bytes;
+            m_queue.pop_front();
+            m_dropped++;
+            m_gap++;
+        }
+        m_queue.push_back({std::move(event), bytes});
+        m_queued_bytes += bytes;
+    }
+    m_queue_cond.notify_one();
+}
+
+void CZMQNotificationInterface::ThreadPublish() {
+    while (true) {
+        Event event;
+        uint64_t gap;
+        {
+            WAIT_LOCK(m_queue_mutex, lock);
+            m_queue_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(
+                                        m_queue_mutex) {
+                return m_stop || !m_queue.empty();
+            });
+            if (m_queue.empty()) {
+                return;
+            }
+            if (m_stop &&
+                std::chrono::steady_clock::now() > m_stop_deadline) {
+                LogPrintf("zmq: Dropping %u events not published before "
+                          "shutdown\n",
+                          m_queue.size());
+                m_dropped += m_queue.size();
+                m_queue.clear();
+                m_queued_bytes = 0;
+                return;
+            }
+            event = std::move(m_queue.front().event);
+            m_queued_bytes -= m_queue.front().bytes;
+            m_queue.pop_front();
+            gap = std::exchange(m_gap, 0);
+        }
+        if (gap > 0) {
+            LogPrintf("zmq: Publisher queue full, dropped %u events\n", gap);
+            ForEachNotifier([](CZMQAbstractNotifier *notifier) {
+                notifier->NotifyDroppedEvents();
+                return true;
+            });
+        }
+        event();
+    }
+}
 
-template <typename Function>
-void TryForEachAndRemoveFailed(
-    std::list<std::unique_ptr<CZMQAbstractNotifier>> &notifiers,
-    const Function &func) {
+void CZMQNotificationInterface::ForEachNotifier(
+    const std::function<bool(CZMQAbstractNotifier *)> &func) {
+    LOCK(m_notifiers_mutex);
     for (auto i = notifiers.begin(); i != notifiers.end();) {
         CZMQAbstractNotifier *notifier = i->get();
         if (func(notifier)) {
             ++i;
         } else {
             notifier->Shutdown();
-            i = notifiers.erase(i);
+            m_failed_notifiers.splice(m_failed_notifiers.end(), notifiers,
+                                      i++);
         }
     }
 }
 
-} // anonymous namespace
-
 void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew,
                                                 const CBlockIndex *pindexFork,
                                                 bool fInitialDownload) {
@@ -139,70 +235,93 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew,
         return;
     }
 
-    TryForEachAndRemoveFailed(notifiers,
-                              [pindexNew](CZMQAbstractNotifier *notifier) {
-                                  return notifier->NotifyBlock(pindexNew);
-                              });
+    Enqueue(
+        [this, pindexNew] {
+            ForEachNotifier([pindexNew](CZMQAbstractNotifier *notifier) {
+                return notifier->NotifyBlock(pindexNew);
+            });
+        },
+        0);
 }
 
 void CZMQNotificationInterface::TransactionAddedToMempool(
     const CTransactionRef &ptx, std::shared_ptr<const std::vector<Coin>>,
     uint64_t mempool_sequence) {
-    const CTransaction &tx = *ptx;
-
-    TryForEachAndRemoveFailed(
-        notifiers, [&tx, mempool_sequence](CZMQAbstractNotifier *notifier) {
-            return notifier->NotifyTransaction(tx) &&
-                   notifier->NotifyTransactionAcceptance(tx, mempool_sequence);
-        });
+    Enqueue(
+        [this, ptx, mempool_sequence] {
+            const CTransaction &tx = *ptx;
+            ForEachNotifier(
+                [&tx, mempool_sequence](CZMQAbstractNotifier *notifier) {
+                    return notifier->NotifyTransaction(tx) &&
+                           notifier->NotifyTransactionAcceptance(
+                               tx, mempool_sequence);
+                });
+        },
+        ptx->GetTotalSize());
 }
 
 void CZMQNotificationInterface::TransactionRemovedFromMempool(
     const CTransactionRef &ptx, MemPoolRemovalReason reason,
     uint64_t mempool_sequence) {
     // Called for all non-block inclusion reasons
-    const CTransaction &tx = *ptx;
-
-    TryForEachAndRemoveFailed(
-        notifiers, [&tx, mempool_sequence](CZMQAbstractNotifier *notifier) {
-            return notifier->NotifyTransactionRemoval(tx, mempool_sequence);
-        });
+    Enqueue(
+        [this, ptx, mempool_sequence] {
+            const CTransaction &tx = *ptx;
+            ForEachNotifier(
+                [&tx, mempool_sequence](CZMQAbstractNotifier *notifier) {
+                    return notifier->NotifyTransactionRemoval(
+                        tx, mempool_sequence);
+                });
+        },
+        ptx->GetTotalSize());
 }
 
 void CZMQNotificationInterface::BlockConnected(
     const std::shared_ptr<const CBlock> &pblock,
     const CBlockIndex *pindexConnected) {
-    for (const CTransactionRef &ptx : pblock->vtx) {
-        const CTransaction &tx = *ptx;
-        TryForEachAndRemoveFailed(notifiers,
-                                  [&tx](CZMQAbstractNotifier *notifier) {
-                                      return notifier->NotifyTransaction(tx);
-                                  });
-    }
-
-    // Next we notify BlockConnect listeners for *all* blocks
-    TryForEachAndRemoveFailed(
-        notifiers, [pindexConnected](CZMQAbstractNotifier *notifier) {
-            return notifier->NotifyBlockConnect(pindexConnected);
-        });
+    Enqueue(
+        [this, pblock, pindexConnected] {
+            for (const CTransactionRef &ptx : pblock->vtx) {
+                const CTransaction &tx = *ptx;
+                ForEachNotifier([&tx](CZMQAbstractNotifier *notifier) {
+                    return notifier->NotifyTransaction(tx);
+                });
+            }
+
+            // Next we notify BlockConnect listeners for *all* blocks
+            ForEachNotifier(
+                [pindexConnected](CZMQAbstractNotifier *notifier) {
+                    return notifier->NotifyBlockConnect(pindexConnected);
+                });
+
+            // The block is likely published next as the new tip
+            ForEachNotifier([&pblock](CZMQAbstractNotifier *notifier) {
+                notifier->SetConnectedBlock(pblock);
+                return true;
+            });
+        },
+        BlockBytes(*pblock));
 }
 
 void CZMQNotificationInterface::BlockDisconnected(
     const std::shared_ptr<const CBlock> &pblock,
     const CBlockIndex *pindexDisconnected) {
-    for (const CTransactionRef &ptx : pblock->vtx) {
-        const CTransaction &tx = *ptx;
-        TryForEachAndRemoveFailed(notifiers,
-                                  [&tx](CZMQAbstractNotifier *notifier) {
-                                      return notifier->NotifyTransaction(tx);
-                                  });
-    }
-
-    // Next we notify BlockDisconnect listeners for *all* blocks
-    TryForEachAndRemoveFailed(
-        notifiers, [pindexDisconnected](CZMQAbstractNotifier *notifier) {
-            return notifier->NotifyBlockDisconnect(pindexDisconnected);
-        });
+    Enqueue(
+        [this, pblock, pindexDisconnected] {
+            for (const CTransactionRef &ptx : pblock->vtx) {
+                const CTransaction &tx = *ptx;
+                ForEachNotifier([&tx](CZMQAbstractNotifier *notifier) {
+                    return notifier->NotifyTransaction(tx);
+                });
+            }
+
+            // Next we notify BlockDisconnect listeners for *all* blocks
+            ForEachNotifier(
+                [pindexDisconnected](CZMQAbstractNotifier *notifier) {
+                    return notifier->NotifyBlockDisconnect(pindexDisconnected);
+                });
+        },
+        BlockBytes(*pblock));
 }
 
 CZMQNotificationInterface *g_zmq_notification_interface = nullptr;
@@ -5,19 +5,47 @@
 #ifndef BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
+#include <sync.h>
 #include <validationinterface.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <list>
 #include <memory>
+#include <thread>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
 class CZMQNotificationInterface final : public CValidationInterface {
 public:
+    /**
+     * Maximum number of validation events waiting for the publisher thread.
+     * Beyond it, the oldest events are dropped and the message sequence
+     * numbers skip a value.
+     */
+    static constexpr size_t MAX_QUEUED_EVENTS{100000};
+    /**
+     * Maximum size of the transactions and blocks held by the validation
+     * events waiting for the publisher thread. Beyond it, the oldest events
+     * are dropped as well.
+     */
+    static constexpr size_t MAX_QUEUED_BYTES{256 * 1024 * 1024};
+    /** How long the queued events are still published at shutdown */
+    static constexpr std::chrono::seconds SHUTDOWN_PUBLISH_TIMEOUT{5};
+
     virtual ~CZMQNotificationInterface();
 
-    std::list<const CZMQAbstractNotifier *> GetActiveNotifiers() const;
+    std::list<const CZMQAbstractNotifier *> GetActiveNotifiers() const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_notifiers_mutex);
+
+    /** Number of events waiting for the publisher thread */
+    size_t GetQueuedEvents() const EXCLUSIVE_LOCKS_REQUIRED(!m_queue_mutex);
+    /** Number of events dropped because the queue was full or at shutdown */
+    uint64_t GetDroppedEvents() const EXCLUSIVE_LOCKS_REQUIRED(!m_queue_mutex);
 
     static CZMQNotificationInterface *Create();
 
@@ -43,8 +71,59 @@ protected:
 private:
     CZMQNotificationInterface();
 
+    /** The notifications of a validation event */
+    using Event = std::function<void()>;
+
+    struct QueuedEvent {
+        Event event;
+        /** Size of the transactions or block the event holds */
+        size_t bytes;
+    };
+
+    /**
+     * Queue an event holding bytes of data for the publisher thread, dropping
+     * the oldest ones while the queue is full
+     */
+    void Enqueue(Event event, size_t bytes)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_queue_mutex);
+    void ThreadPublish() EXCLUSIVE_LOCKS_REQUIRED(!m_queue_mutex);
+
+    /**
+     * Call func for each notifier, the notifiers for which it fails are shut
+     * down and no longer notified.
+     */
+    void
+    ForEachNotifier(const std::function<bool(CZMQAbstractNotifier *)> &func)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_notifiers_mutex);
+
     void *pcontext;
-    std::list<std::unique_ptr<CZMQAbstractNotifier>> notifiers;
+
+    /**
+     * Once the publisher thread is started, only it uses the notifiers and
+     * their sockets. The mutex protects the lists for GetActiveNotifiers.
+     */
+    mutable Mutex m_notifiers_mutex;
+    std::list<std::unique_ptr<CZMQAbstractNotifier>>
+        notifiers GUARDED_BY(m_notifiers_mutex);
+    /**
+     * Notifiers that failed, kept alive as GetActiveNotifiers may have
+     * returned them
+     */
+    std::list<std::unique_ptr<CZMQAbstractNotifier>>
+        m_failed_notifiers GUARDED_BY(m_notifiers_mutex);
+
+    mutable Mutex m_queue_mutex;
+    std::condition_variable m_queue_cond;
+    std::deque<QueuedEvent> m_queue GUARDED_BY(m_queue_mutex);
+    /** Sum of the bytes of the queued events */
+    size_t m_queued_bytes GUARDED_BY(m_queue_mutex){0};
+    uint64_t m_dropped GUARDED_BY(m_queue_mutex){0};
+    /** Events dropped since the publisher thread last took one */
+    uint64_t m_gap GUARDED_BY(m_queue_mutex){0};
+    bool m_stop GUARDED_BY(m_queue_mutex){false};
+    std::chrono::steady_clock::time_point
+        m_stop_deadline GUARDED_BY(m_queue_mutex);
+    std::thread m_publisher_thread;
 };
 
 extern CZMQNotificationInterface *g_zmq_notification_interface;
@@ -8,8 +8,6 @@
 #include <chainparams.h>
 #include <config.h>
 #include <node/blockstorage.h>
-#include <primitives/blockhash.h>
-#include <primitives/txid.h>
 #include <rpc/server.h>
 #include <streams.h>
 #include <util/system.h>
@@ -17,11 +15,13 @@
 
 #include <zmq.h>
 
-#include <cstdarg>
 #include <cstddef>
+#include <cstring>
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 using node::ReadBlockFromDisk;
 
@@ -34,43 +34,52 @@ static const char *MSG_RAWBLOCK = "rawblock";
 static const char *MSG_RAWTX = "rawtx";
 static const char *MSG_SEQUENCE = "sequence";
 
-// Internal function to send multipart message
-static int zmq_send_multipart(void *sock, const void *data, size_t size, ...) {
-    va_list args;
-    va_start(args, size);
-
-    while (1) {
-        zmq_msg_t msg;
-
-        int rc = zmq_msg_init_size(&msg, size);
-        if (rc != 0) {
-            zmqError("Unable to initialize ZMQ msg");
-            va_end(args);
-            return -1;
-        }
-
-        void *buf = zmq_msg_data(&msg);
-        memcpy(buf, data, size);
-
-        data = va_arg(args, const void *);
+static bool zmq_msg_init_copy(zmq_msg_t &msg, const void *data, size_t size) {
+    if (zmq_msg_init_size(&msg, size) != 0) {
+        zmqError("Unable to initialize ZMQ msg");
+        return false;
+    }
+    memcpy(zmq_msg_data(&msg), data, size);
+    return true;
+}
 
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
-        if (rc == -1) {
-            zmqError("Unable to send ZMQ msg");
-            zmq_msg_close(&msg);
-            va_end(args);
-            return -1;
-        }
+// Release the shared data of a message once the socket is done with it
+static void zmq_msg_free_shared(void * /* data */, void *hint) {
+    delete static_cast<ZMQMessageData *>(hint);
+}
 
-        zmq_msg_close(&msg);
+// Internal function to send a message part, releasing it in all cases
+static bool zmq_send_part(void *sock, zmq_msg_t &msg, int flags) {
+    const int rc = zmq_msg_send(&msg, sock, flags);
+    if (rc == -1) {
+        zmqError("Unable to send ZMQ msg");
+    }
+    zmq_msg_close(&msg);
+    return rc != -1;
+}
 
-        if (!data) {
-            break;
-        }
+// Internal function to send multipart message, taking ownership of the data
+static int zmq_send_multipart(void *sock, const char *command, zmq_msg_t &data,
+                              uint32_t sequence) {
+    zmq_msg_t msg;
+    if (!zmq_msg_init_copy(msg, command, strlen(command))) {
+        zmq_msg_close(&data);
+        return -1;
+    }
+    if (!zmq_send_part(sock, msg, ZMQ_SNDMORE)) {
+        zmq_msg_close(&data);
+        return -1;
+    }
+    if (!zmq_send_part(sock, data, ZMQ_SNDMORE)) {
+        return -1;
+    }
 
-        size = va_arg(args, size_t);
+    uint8_t msgseq[sizeof(uint32_t)];
+    WriteLE32(msgseq, sequence);
+    if (!zmq_msg_init_copy(msg, msgseq, sizeof(msgseq)) ||
+        !zmq_send_part(sock, msg, 0)) {
+        return -1;
     }
-    va_end(args);
     return 0;
 }
 
@@ -170,21 +179,47 @@ bool CZMQAbstractPublishNotifier::SendZmqMessage(const char *command,
                                                  size_t size) {
     assert(psocket);
 
-    /* send three parts, command & data & a LE 4byte sequence number */
-    uint8_t msgseq[sizeof(uint32_t)];
-    WriteLE32(msgseq, nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size,
-                                msgseq, (size_t)sizeof(uint32_t), nullptr);
-    if (rc == -1) {
+    zmq_msg_t msg;
+    if (!zmq_msg_init_copy(msg, data, size) ||
+        zmq_send_multipart(psocket, command, msg, nSequence) == -1) {
         return false;
     }
 
     /* increment memory only sequence number after sending */
     nSequence++;
+    published_messages++;
 
     return true;
 }
 
+bool CZMQAbstractPublishNotifier::SendZmqMessage(const char *command,
+                                                 const ZMQMessageData &data) {
+    assert(psocket);
+
+    zmq_msg_t msg;
+    auto *hint = new ZMQMessageData(data);
+    if (zmq_msg_init_data(&msg, const_cast<uint8_t *>(data->data()),
+                          data->size(), zmq_msg_free_shared, hint) != 0) {
+        zmqError("Unable to initialize ZMQ msg");
+        delete hint;
+        return false;
+    }
+    if (zmq_send_multipart(psocket, command, msg, nSequence) == -1) {
+        return false;
+    }
+
+    /* increment memory only sequence number after sending */
+    nSequence++;
+    published_messages++;
+
+    return true;
+}
+
+void CZMQAbstractPublishNotifier::NotifyDroppedEvents() {
+    // Skip a sequence number so that the subscribers detect the lost messages
+    nSequence++;
+}
+
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex) {
     BlockHash hash = pindex->GetBlockHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish hashblock %s to %s\n", hash.GetHex(),
@@ -209,21 +244,44 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(
 }
 
 bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex) {
-    LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s to %s\n",
-             pindex->GetBlockHash().GetHex(), this->address);
-
-    const Config &config = GetConfig();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    CBlock block;
-    if (!ReadBlockFromDisk(block, pindex,
-                           config.GetChainParams().GetConsensus())) {
-        zmqError("Can't read block from disk");
-        return false;
+    const BlockHash hash = pindex->GetBlockHash();
+    LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s to %s\n", hash.GetHex(),
+             this->address);
+
+    if (!m_cached_block || m_cached_block_hash != hash) {
+        std::shared_ptr<const CBlock> block;
+        if (m_connected_block && m_connected_block->GetHash() == hash) {
+            block = m_connected_block;
+        } else {
+            const Config &config = GetConfig();
+            auto read_block = std::make_shared<CBlock>();
+            if (!ReadBlockFromDisk(*read_block, pindex,
+                                   config.GetChainParams().GetConsensus())) {
+                zmqError("Can't read block from disk");
+                return false;
+            }
+            block = std::move(read_block);
+        }
+
+        auto data = std::make_shared<std::vector<uint8_t>>();
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags(),
+                      *data, 0, *block);
+        m_cached_block = std::move(data);
+        m_cached_block_hash = hash;
     }
 
-    ss << block;
+    return SendZmqMessage(MSG_RAWBLOCK, m_cached_block);
+}
+
+void CZMQPublishRawBlockNotifier::SetConnectedBlock(
+    const std::shared_ptr<const CBlock> &block) {
+    m_connected_block = block;
+}
 
-    return SendZmqMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+void CZMQPublishRawBlockNotifier::Shutdown() {
+    CZMQAbstractPublishNotifier::Shutdown();
+    m_connected_block.reset();
+    m_cached_block.reset();
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(
@@ -231,9 +289,19 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(
     TxId txid = transaction.GetId();
     LogPrint(BCLog::ZMQ, "zmq: Publish rawtx %s to %s\n", txid.GetHex(),
              this->address);
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ss << transaction;
-    return SendZmqMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    if (!m_cached_tx || m_cached_txid != txid) {
+        auto data = std::make_shared<std::vector<uint8_t>>();
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags(),
+                      *data, 0, transaction);
+        m_cached_tx = std::move(data);
+        m_cached_txid = txid;
+    }
+    return SendZmqMessage(MSG_RAWTX, m_cached_tx);
+}
+
+void CZMQPublishRawTransactionNotifier::Shutdown() {
+    CZMQAbstractPublishNotifier::Shutdown();
+    m_cached_tx.reset();
 }
 
 // TODO: Dedup this code to take label char, log string
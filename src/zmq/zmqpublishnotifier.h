@@ -5,10 +5,20 @@
 #ifndef BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 #define BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 
+#include <primitives/blockhash.h>
+#include <primitives/txid.h>
 #include <zmq/zmqabstractnotifier.h>
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class CBlock;
 class CBlockIndex;
 
+/** Serialized message data, shared by the messages of all the notifiers */
+using ZMQMessageData = std::shared_ptr<const std::vector<uint8_t>>;
+
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier {
 private:
     //! upcounting per message sequence number
@@ -22,9 +32,15 @@ public:
           * message sequence number
     */
     bool SendZmqMessage(const char *command, const void *data, size_t size);
+    /**
+     * Send a message without copying its data, which is kept alive until the
+     * socket is done with it.
+     */
+    bool SendZmqMessage(const char *command, const ZMQMessageData &data);
 
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
+    void NotifyDroppedEvents() override;
 };
 
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier {
@@ -38,13 +54,34 @@ public:
 };
 
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier {
+private:
+    /**
+     * The last connected block, so that publishing it as the new tip does not
+     * read it back from disk
+     */
+    std::shared_ptr<const CBlock> m_connected_block;
+    /** Serialization of the last published block */
+    BlockHash m_cached_block_hash;
+    ZMQMessageData m_cached_block;
+
 public:
     bool NotifyBlock(const CBlockIndex *pindex) override;
+    void SetConnectedBlock(const std::shared_ptr<const CBlock> &block) override;
+    void Shutdown() override;
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier {
+private:
+    /**
+     * Serialization of the last published transaction, which is published
+     * again when it is included in a block
+     */
+    TxId m_cached_txid;
+    ZMQMessageData m_cached_tx;
+
 public:
     bool NotifyTransaction(const CTransaction &transaction) override;
+    void Shutdown() override;
 };
 
 class CZMQPublishSequenceNotifier : public CZMQAbstractPublishNotifier {
@@ -32,6 +32,17 @@ static RPCHelpMan getzmqnotifications() {
                       "Address of the publisher"},
                      {RPCResult::Type::NUM, "hwm",
                       "Outbound message high water mark"},
+                     {RPCResult::Type::NUM, "published",
+                      "Number of messages handed to the socket. Messages "
+                      "beyond the high water mark of a subscriber are "
+                      "dropped by the socket for that subscriber"},
+                     {RPCResult::Type::NUM, "queued",
+                      "Number of validation events waiting to be "
+                      "published, shared by all the notifications"},
+                     {RPCResult::Type::NUM, "dropped",
+                      "Number of validation events dropped because too "
+                      "many were waiting or the node was shutting down, "
+                      "shared by all the notifications"},
                  }},
             }},
         RPCExamples{HelpExampleCli("getzmqnotifications", "") +
@@ -40,12 +51,19 @@ static RPCHelpMan getzmqnotifications() {
             const JSONRPCRequest &request) -> UniValue {
             UniValue result(UniValue::VARR);
             if (g_zmq_notification_interface != nullptr) {
+                const uint64_t queued{
+                    g_zmq_notification_interface->GetQueuedEvents()};
+                const uint64_t dropped{
+                    g_zmq_notification_interface->GetDroppedEvents()};
                 for (const auto *n :
                      g_zmq_notification_interface->GetActiveNotifiers()) {
                     UniValue obj(UniValue::VOBJ);
                     obj.pushKV("type", n->GetType());
                     obj.pushKV("address", n->GetAddress());
                     obj.pushKV("hwm", n->GetOutboundMessageHighWaterMark());
+                    obj.pushKV("published", n->GetPublishedMessages());
+                    obj.pushKV("queued", queued);
+                    obj.pushKV("dropped", dropped);
                     result.push_back(obj);
                 }
             }
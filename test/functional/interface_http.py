@@ -4,10 +4,19 @@
 """Test the RPC HTTP basics."""
 
 import http.client
+import json
+import threading
+import time
 import urllib.parse
 
 from test_framework.test_framework import BitcoinTestFramework
-from test_framework.util import assert_equal, str_to_b64str
+from test_framework.util import (
+    assert_equal,
+    assert_greater_than,
+    assert_greater_than_or_equal,
+    str_to_b64str,
+)
+from test_framework.wallet import MiniWallet
 
 
 class HTTPBasicsTest(BitcoinTestFramework):
@@ -172,6 +181,110 @@ class HTTPBasicsTest(BitcoinTestFramework):
         assert_equal(out1.status, http.client.METHOD_NOT_ALLOWED)
         assert_equal(b"JSONRPC server handles only POST requests", out1.read())
 
+        # Check that connections are served by several event threads
+        self.restart_node(2, ["-rpceventthreads=4"])
+        url = urllib.parse.urlparse(self.nodes[2].url)
+        authpair = f"{url.username}:{url.password}"
+        headers = {"Authorization": f"Basic {str_to_b64str(authpair)}"}
+        conns = [http.client.HTTPConnection(url.hostname, url.port) for _ in range(8)]
+        for _ in range(2):
+            for conn in conns:
+                conn.request("POST", "/", '{"method": "getbestblockhash"}', headers)
+            for conn in conns:
+                out1 = conn.getresponse().read()
+                assert b'"error":null' in out1
+        for conn in conns:
+            conn.close()
+        # The requests were received by more than one event thread
+        event_loops = self.nodes[2].getrpcinfo()["event_loops"]
+        assert_equal(len(event_loops), 4)
+        assert_greater_than_or_equal(sum(event_loops), 16)
+        assert_greater_than(len([n for n in event_loops if n > 0]), 1)
+
+        # Check that large replies are streamed with chunked transfer encoding
+        self.restart_node(2, ["-rest"])
+        node = self.nodes[2]
+        # The node authenticates with a new cookie after the restart
+        url = urllib.parse.urlparse(node.url)
+        authpair = f"{url.username}:{url.password}"
+        headers = {"Authorization": f"Basic {str_to_b64str(authpair)}"}
+        wallet = MiniWallet(node)
+        self.generate(wallet, 300, sync_fun=self.no_op)
+        self.generate(node, 100, sync_fun=self.no_op)
+        # Enough transactions for the verbose mempool to exceed a chunk
+        for _ in range(300):
+            wallet.send_self_transfer(from_node=node)
+        mempool = set(node.getrawmempool())
+        assert_equal(len(mempool), 300)
+
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.connect()
+        conn.request(
+            "POST", "/", '{"method": "getrawmempool", "params": [true]}', headers
+        )
+        out1 = conn.getresponse()
+        assert_equal(out1.status, http.client.OK)
+        assert_equal(out1.headers["Transfer-Encoding"], "chunked")
+        reply = json.loads(out1.read())
+        assert_equal(reply["error"], None)
+        assert_equal(set(reply["result"]), mempool)
+        # The connection is kept alive after a chunked reply
+        conn.request("POST", "/", '{"method": "getbestblockhash"}', headers)
+        out1 = conn.getresponse().read()
+        assert b'"error":null' in out1
+        assert conn.sock is not None
+
+        conn.request("GET", "/rest/mempool/contents.json")
+        out1 = conn.getresponse()
+        assert_equal(out1.status, http.client.OK)
+        assert_equal(out1.headers["Transfer-Encoding"], "chunked")
+        assert_equal(set(json.loads(out1.read())), mempool)
+        conn.close()
+
+        # Check that the requests waiting for REST events don't starve the RPC
+        # requests: with the default 4 RPC threads, at most 2 of them wait.
+        node.syncwithvalidationinterfacequeue()
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.request("GET", "/rest/events/0.json")
+        next_event = json.loads(conn.getresponse().read())["next"]
+        conn.close()
+
+        replies = []
+
+        def wait_for_events():
+            conn = http.client.HTTPConnection(url.hostname, url.port, timeout=120)
+            conn.request("GET", f"/rest/events/{next_event}/60.json")
+            out = conn.getresponse()
+            assert_equal(out.status, http.client.OK)
+            replies.append(json.loads(out.read()))
+            conn.close()
+
+        waiters = [threading.Thread(target=wait_for_events) for _ in range(4)]
+        for waiter in waiters:
+            waiter.start()
+        # The requests beyond the 2 waiting ones are answered at once
+        self.wait_until(lambda: len(replies) == 2)
+        for reply in replies:
+            assert_equal(reply["events"], [])
+            assert_equal(reply["next"], next_event)
+        # The RPC server still answers while the 2 requests are waiting
+        start = time.time()
+        for _ in range(10):
+            node.getblockcount()
+        assert_greater_than(10, time.time() - start)
+        assert_equal(len(replies), 2)
+        # A new block wakes the waiting requests up
+        blockhash = self.generate(node, 1, sync_fun=self.no_op)[0]
+        for waiter in waiters:
+            waiter.join()
+        assert_equal(len(replies), 4)
+        for reply in replies[2:]:
+            assert_equal(reply["start"], next_event)
+            connected = [
+                e for e in reply["events"] if e["type"] == "blockconnected"
+            ]
+            assert_equal(connected[0]["hash"], blockhash)
+
 
 if __name__ == "__main__":
     HTTPBasicsTest().main()
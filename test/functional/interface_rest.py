@@ -11,7 +11,11 @@ from enum import Enum
 from io import BytesIO
 from struct import pack, unpack
 
-from test_framework.messages import BLOCK_HEADER_SIZE
+from test_framework.messages import (
+    BLOCK_HEADER_SIZE,
+    deser_compact_size,
+    deser_string,
+)
 from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import (
     assert_equal,
@@ -401,6 +405,9 @@ class RESTTest(BitcoinTestFramework):
         assert_equal(json_obj["size"], 3)
         # The size of the memory pool should be greater than 3x ~100 bytes
         assert_greater_than(json_obj["bytes"], 300)
+        assert_equal(
+            json_obj["fee_histogram"], self.nodes[0].getmempoolinfo()["fee_histogram"]
+        )
 
         # Check that there are our submitted transactions in the TX memory pool
         json_obj = self.test_rest_request("/mempool/contents")
@@ -409,6 +416,26 @@ class RESTTest(BitcoinTestFramework):
             assert_equal(json_obj[tx]["spentby"], txs[i + 1 : i + 2])
             assert_equal(json_obj[tx]["depends"], txs[i - 1 : i])
 
+        # The binary and hex forms hold the same transactions
+        bin_contents = self.test_rest_request(
+            "/mempool/contents", req_type=ReqType.BIN, ret_type=RetType.BYTES
+        )
+        hex_contents = self.test_rest_request(
+            "/mempool/contents", req_type=ReqType.HEX, ret_type=RetType.BYTES
+        )
+        assert_equal(bytes.fromhex(hex_contents.decode("ascii")), bin_contents)
+        f = BytesIO(bin_contents)
+        # Format version and mempool sequence
+        assert_equal(f.read(1), b"\x01")
+        f.read(8)
+        assert_equal(deser_compact_size(f), len(txs))
+        bin_txids = set()
+        for _ in txs:
+            record = deser_string(f)
+            bin_txids.add(record[:32][::-1].hex())
+        assert_equal(bin_txids, set(txs))
+        assert_equal(f.read(), b"")
+
         # Now mine the transactions
         newblockhash = self.generate(self.nodes[1], 1)
 
@@ -424,6 +451,38 @@ class RESTTest(BitcoinTestFramework):
         for tx in txs:
             assert tx in json_obj["tx"]
 
+        self.log.info("Test the /events URI")
+        self.nodes[0].syncwithvalidationinterfacequeue()
+        events = self.test_rest_request("/events/0")
+        assert_equal(events["start"], 1)
+        assert_equal(events["missed"], 0)
+        assert_equal(
+            [e["sequence"] for e in events["events"]],
+            list(range(1, events["next"])),
+        )
+        added = [e["txid"] for e in events["events"] if e["type"] == "txadded"]
+        assert set(txs) <= set(added)
+        connected = [
+            e for e in events["events"] if e["type"] == "blockconnected"
+        ]
+        assert_equal(connected[-1]["hash"], newblockhash[0])
+        assert set(txs) <= set(connected[-1]["tx"])
+
+        # Resuming from the next sequence number only returns the new events
+        resumed = self.test_rest_request(f"/events/{events['next']}")
+        assert_equal(resumed["events"], [])
+        assert_equal(resumed["next"], events["next"])
+        assert_equal(resumed["stream"], events["stream"])
+        newblockhash = self.generate(self.nodes[1], 1)
+        resumed = self.test_rest_request(f"/events/{events['next']}/10")
+        assert_equal(resumed["start"], events["next"])
+        assert_equal(resumed["events"][0]["sequence"], events["next"])
+        assert_equal(resumed["events"][0]["type"], "blockconnected")
+        assert_equal(resumed["events"][0]["hash"], newblockhash[0])
+
+        self.test_rest_request("/events/x", status=400, ret_type=RetType.OBJ)
+        self.test_rest_request("/events/0/x", status=400, ret_type=RetType.OBJ)
+
         self.log.info("Test the /chaininfo URI")
 
         bb_hash = self.nodes[0].getbestblockhash()
@@ -3,14 +3,21 @@
 # file COPYING or http://www.opensource.org/licenses/mit-license.php.
 """Tests some generic aspects of the RPC interface."""
 
+import http.client
 import multiprocessing
 import os
 import subprocess
 import time
+import urllib.parse
+from base64 import b64encode
 
 from test_framework.authproxy import JSONRPCException
 from test_framework.test_framework import BitcoinTestFramework
-from test_framework.util import assert_equal, assert_greater_than_or_equal
+from test_framework.util import (
+    assert_equal,
+    assert_greater_than,
+    assert_greater_than_or_equal,
+)
 
 
 def expect_http_status(expected_http_status, expected_rpc_code, fcn, *args):
@@ -52,6 +59,66 @@ class RPCInterfaceTest(BitcoinTestFramework):
             os.path.join(self.nodes[0].datadir, self.chain, "debug.log"),
         )
 
+        work_queue = info["work_queue"]
+        assert_equal(work_queue["depth"], 0)
+        assert_equal(work_queue["priority_depth"], 0)
+        assert_equal(work_queue["clients"], 0)
+        assert_greater_than_or_equal(work_queue["served"], 1)
+        assert_greater_than_or_equal(
+            work_queue["max_wait"], work_queue["average_wait"]
+        )
+
+    def test_getrpcstats(self):
+        self.log.info("Testing getrpcstats...")
+
+        node = self.nodes[0]
+        node.getblockhash(0)
+        expect_http_status(500, -8, node.getblockhash, 42)
+        stats = node.getrpcstats()
+        buckets = stats["latency_buckets"]
+        assert_equal(buckets, sorted(buckets))
+        method = stats["methods"]["getblockhash"]
+        assert_equal(method["calls"], 2)
+        assert_equal(method["errors"], 1)
+        assert_equal(len(method["latency"]), len(buckets) + 1)
+        assert_equal(sum(method["latency"]), 2)
+        assert_greater_than(method["bytes_in"], 0)
+        assert_greater_than(method["bytes_out"], 0)
+        assert_greater_than_or_equal(method["cs_main_wait"], 0)
+        assert_greater_than_or_equal(method["mempool_wait"], 0)
+
+        self.log.info("Testing the metrics endpoint...")
+
+        def auth_headers():
+            # The node authenticates with a new cookie after each restart
+            url = urllib.parse.urlparse(node.url)
+            authpair = f"{url.username}:{url.password}"
+            return {
+                "Authorization": f"Basic {b64encode(authpair.encode()).decode()}"
+            }
+
+        def get_metrics(headers):
+            url = urllib.parse.urlparse(node.url)
+            conn = http.client.HTTPConnection(url.hostname, url.port)
+            conn.request("GET", "/metrics", headers=headers)
+            return conn.getresponse()
+
+        # The endpoint is disabled by default
+        assert_equal(get_metrics(auth_headers()).status, 404)
+
+        self.restart_node(0, ["-rpcmetrics"])
+        node.getblockhash(0)
+        assert_equal(get_metrics({}).status, 401)
+        response = get_metrics(auth_headers())
+        assert_equal(response.status, 200)
+        metrics = response.read().decode()
+        assert 'bitcoin_rpc_calls_total{method="getblockhash"} 1\n' in metrics
+        assert (
+            'bitcoin_rpc_duration_seconds_bucket{method="getblockhash",le="+Inf"} 1\n'
+            in metrics
+        )
+        self.restart_node(0)
+
     def test_batch_request(self):
         self.log.info("Testing basic JSON-RPC batch request...")
 
@@ -116,6 +183,7 @@ class RPCInterfaceTest(BitcoinTestFramework):
 
     def run_test(self):
         self.test_getrpcinfo()
+        self.test_getrpcstats()
         self.test_batch_request()
         self.test_http_status_codes()
         self.test_work_queue_exceeded()
@@ -232,8 +232,13 @@ class ZMQTest(BitcoinTestFramework):
             assert_equal(payment_txid, txid.hex())
 
         self.log.info("Test the getzmqnotifications RPC")
+        self.sync_all()
+        notifications = self.nodes[0].getzmqnotifications()
         assert_equal(
-            self.nodes[0].getzmqnotifications(),
+            [
+                {k: n[k] for k in ("type", "address", "hwm")}
+                for n in notifications
+            ],
             [
                 {"type": "pubhashblock", "address": address, "hwm": 1000},
                 {"type": "pubhashtx", "address": address, "hwm": 1000},
@@ -241,6 +246,9 @@ class ZMQTest(BitcoinTestFramework):
                 {"type": "pubrawtx", "address": address, "hwm": 1000},
             ],
         )
+        for n in notifications:
+            assert n["published"] > 0
+            assert_equal(n["dropped"], 0)
 
         assert_equal(self.nodes[1].getzmqnotifications(), [])
 
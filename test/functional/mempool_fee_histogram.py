@@ -0,0 +1,97 @@
+# Copyright (c) 2024 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the mempool fee rate histogram of getmempoolinfo."""
+
+from decimal import Decimal
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.wallet import MiniWallet
+
+
+class MempoolFeeHistogramTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+
+    def run_test(self):
+        node = self.nodes[0]
+        wallet = MiniWallet(node)
+        self.generate(wallet, 4)
+        self.generate(node, 100)
+
+        assert_equal(node.getmempoolinfo()["fee_histogram"], [])
+
+        self.log.info("Transactions are grouped by fee rate range")
+        low = wallet.send_self_transfer(from_node=node, fee_rate=Decimal("11.00"))
+        mid = wallet.send_self_transfer(from_node=node, fee_rate=Decimal("55.00"))
+        high = [
+            wallet.send_self_transfer(from_node=node, fee_rate=Decimal("3500.00"))
+            for _ in range(2)
+        ]
+
+        def size(tx):
+            return node.getmempoolentry(tx["txid"])["size"]
+
+        def check_histogram(expected):
+            histogram = node.getmempoolinfo()["fee_histogram"]
+            for bucket in histogram:
+                assert bucket["sigchecks"] >= 0
+                del bucket["sigchecks"]
+            assert_equal(histogram, expected)
+
+        check_histogram(
+            [
+                {
+                    "min_feerate": Decimal("3000.00"),
+                    "max_feerate": Decimal("4000.00"),
+                    "count": 2,
+                    "size": size(high[0]) + size(high[1]),
+                },
+                {
+                    "min_feerate": Decimal("50.00"),
+                    "max_feerate": Decimal("60.00"),
+                    "count": 1,
+                    "size": size(mid),
+                },
+                {
+                    "min_feerate": Decimal("10.00"),
+                    "max_feerate": Decimal("12.00"),
+                    "count": 1,
+                    "size": size(low),
+                },
+            ]
+        )
+
+        self.log.info("Prioritised transactions move to their modified fee rate")
+        # 1,000,000 XEC is way above the top range for any transaction size
+        node.prioritisetransaction(txid=low["txid"], fee_delta=100_000_000)
+        check_histogram(
+            [
+                {
+                    "min_feerate": Decimal("100000.00"),
+                    "count": 1,
+                    "size": size(low),
+                },
+                {
+                    "min_feerate": Decimal("3000.00"),
+                    "max_feerate": Decimal("4000.00"),
+                    "count": 2,
+                    "size": size(high[0]) + size(high[1]),
+                },
+                {
+                    "min_feerate": Decimal("50.00"),
+                    "max_feerate": Decimal("60.00"),
+                    "count": 1,
+                    "size": size(mid),
+                },
+            ]
+        )
+
+        self.log.info("Mined transactions are removed from the histogram")
+        self.generate(node, 1)
+        assert_equal(node.getmempoolinfo()["fee_histogram"], [])
+
+
+if __name__ == "__main__":
+    MempoolFeeHistogramTest().main()
@@ -32,6 +32,9 @@ Test is as follows:
     mempool.
   - Verify that savemempool throws when the RPC is called if
     node1 can't write to disk.
+  - Verify that the entry heights are restored from a version 2 file,
+    and that -persistmempoolv1 writes a version 1 file, which doesn't
+    store them.
 
 """
 import os
@@ -45,6 +48,7 @@ from test_framework.util import (
     assert_greater_than_or_equal,
     assert_raises_rpc_error,
 )
+from test_framework.wallet import MiniWallet
 
 
 class MempoolPersistTest(BitcoinTestFramework):
@@ -203,6 +207,7 @@ class MempoolPersistTest(BitcoinTestFramework):
         os.rmdir(mempooldotnew1)
 
         self.test_persist_unbroadcast()
+        self.test_persist_v1_dat()
 
     def test_persist_unbroadcast(self):
         node0 = self.nodes[0]
@@ -227,6 +232,42 @@ class MempoolPersistTest(BitcoinTestFramework):
         node0.mockscheduler(16 * 60)
         self.wait_until(lambda: len(conn.get_invs()) == 1)
 
+    def test_persist_v1_dat(self):
+        node0 = self.nodes[0]
+        mempooldat0 = os.path.join(node0.datadir, self.chain, "mempool.dat")
+
+        def read_version():
+            with open(mempooldat0, "rb") as f:
+                return int.from_bytes(f.read(8), "little")
+
+        mini_wallet = MiniWallet(node0)
+        self.generate(mini_wallet, 101, sync_fun=self.no_op)
+        txid = mini_wallet.send_self_transfer(from_node=node0)["txid"]
+        entry_height = node0.getmempoolentry(txid)["height"]
+        # Mine a block without the transaction, so that its entry height is
+        # no longer the current height
+        self.generateblock(
+            node0,
+            f"raw({mini_wallet.get_scriptPubKey().hex()})",
+            [],
+            sync_fun=self.no_op,
+        )
+
+        self.log.debug("Verify that the entry heights are restored")
+        self.stop_node(0)
+        assert_equal(read_version(), 2)
+        self.start_node(0, extra_args=["-disablewallet", "-persistmempoolv1"])
+        assert_equal(node0.getmempoolentry(txid)["height"], entry_height)
+
+        self.log.debug(
+            "Verify that -persistmempoolv1 writes a version 1 file, loaded at"
+            " the current height"
+        )
+        self.stop_node(0)
+        assert_equal(read_version(), 1)
+        self.start_node(0, extra_args=["-disablewallet"])
+        assert_equal(node0.getmempoolentry(txid)["height"], entry_height + 1)
+
 
 if __name__ == "__main__":
     MempoolPersistTest().main()
@@ -0,0 +1,160 @@
+# Copyright (c) 2024 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the relay of orphan transactions together with their unconfirmed
+ancestors, through the getpkgtxns and pkgtxns messages."""
+
+import time
+
+from test_framework.messages import (
+    msg_getpkgtxns,
+    msg_pkgtxns,
+    msg_sendpackages,
+    msg_tx,
+)
+from test_framework.p2p import P2PInterface, p2p_lock
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.wallet import MiniWallet
+
+# How long a transaction stays only requestable by the peers it was announced
+# to (UNCONDITIONAL_RELAY_DELAY)
+UNCONDITIONAL_RELAY_DELAY = 2 * 60
+# How many getpkgtxns requests of a peer are served at once
+# (MAX_PACKAGE_REQUEST_TOKEN_BUCKET)
+MAX_PACKAGE_REQUEST_TOKEN_BUCKET = 100
+
+
+class PackageRelayTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.extra_args = [["-packagerelay"]]
+
+    def add_package_peer(self):
+        peer = self.nodes[0].add_p2p_connection(P2PInterface())
+        peer.send_and_ping(msg_sendpackages())
+        # The node signals its support after the version handshake
+        peer.wait_until(lambda: "sendpackages" in peer.last_message)
+        return peer
+
+    def create_parent_child(self):
+        parent = self.wallet.create_self_transfer(from_node=self.nodes[0])
+        child = self.wallet.create_self_transfer(
+            from_node=self.nodes[0], utxo_to_spend=parent["new_utxo"]
+        )
+        return parent, child
+
+    def test_request_package(self):
+        self.log.info("Orphans are requested with their ancestors")
+        node = self.nodes[0]
+        peer = self.add_package_peer()
+        parent, child = self.create_parent_child()
+
+        peer.send_and_ping(msg_tx(child["tx"]))
+        assert child["txid"] not in node.getrawmempool()
+        peer.wait_until(
+            lambda: "getpkgtxns" in peer.last_message
+            and peer.last_message["getpkgtxns"].txid == int(child["txid"], 16)
+        )
+
+        peer.send_and_ping(msg_pkgtxns([parent["tx"], child["tx"]]))
+        mempool = node.getrawmempool()
+        assert parent["txid"] in mempool
+        assert child["txid"] in mempool
+        node.disconnect_p2ps()
+
+    def test_unsolicited_package(self):
+        self.log.info("Unsolicited packages are ignored")
+        node = self.nodes[0]
+        peer = self.add_package_peer()
+        parent, child = self.create_parent_child()
+
+        peer.send_and_ping(msg_pkgtxns([parent["tx"], child["tx"]]))
+        assert parent["txid"] not in node.getrawmempool()
+        assert child["txid"] not in node.getrawmempool()
+        node.disconnect_p2ps()
+
+    def test_malformed_package(self):
+        self.log.info("Malformed packages are rejected before their scripts")
+        node = self.nodes[0]
+        peer = self.add_package_peer()
+        parent, child = self.create_parent_child()
+        other = self.wallet.create_self_transfer(from_node=node)
+
+        peer.send_and_ping(msg_tx(child["tx"]))
+        peer.wait_until(lambda: "getpkgtxns" in peer.last_message)
+        with node.assert_debug_log(
+            [f"package {child['txid']} is not a child with ancestors"]
+        ):
+            peer.send_and_ping(msg_pkgtxns([other["tx"], child["tx"]]))
+        assert other["txid"] not in node.getrawmempool()
+        assert child["txid"] not in node.getrawmempool()
+
+        # A package spending the same coin twice is rejected as well
+        _, child = self.create_parent_child()
+        peer.send_and_ping(msg_tx(child["tx"]))
+        peer.wait_until(
+            lambda: peer.last_message["getpkgtxns"].txid == int(child["txid"], 16)
+        )
+        with node.assert_debug_log([f"invalid package {child['txid']}"]):
+            peer.send_and_ping(msg_pkgtxns([child["tx"], child["tx"]]))
+        assert child["txid"] not in node.getrawmempool()
+        node.disconnect_p2ps()
+
+    def test_serve_package(self):
+        self.log.info("Packages are served to the peers that request them")
+        node = self.nodes[0]
+        mocktime = int(time.time())
+        node.setmocktime(mocktime)
+        parent, child = self.create_parent_child()
+        self.wallet.sendrawtransaction(from_node=node, tx_hex=parent["hex"])
+        self.wallet.sendrawtransaction(from_node=node, tx_hex=child["hex"])
+        # Let the transactions be requestable without having been announced
+        node.setmocktime(mocktime + UNCONDITIONAL_RELAY_DELAY + 1)
+
+        peer = self.add_package_peer()
+        peer.send_and_ping(msg_getpkgtxns(int(child["txid"], 16)))
+        with p2p_lock:
+            txs = peer.last_message["pkgtxns"].txs
+            for tx in txs:
+                tx.rehash()
+            assert_equal([tx.hash for tx in txs], [parent["txid"], child["txid"]])
+
+        self.log.info("A transaction without unconfirmed ancestors is not found")
+        peer.send_and_ping(msg_getpkgtxns(int(parent["txid"], 16)))
+        with p2p_lock:
+            notfound = peer.last_message["notfound"].vec
+            assert_equal([inv.hash for inv in notfound], [int(parent["txid"], 16)])
+        node.disconnect_p2ps()
+
+        self.log.info("The requests over the rate limit are not served")
+        peer = self.add_package_peer()
+        for _ in range(MAX_PACKAGE_REQUEST_TOKEN_BUCKET):
+            peer.send_message(msg_getpkgtxns(int(child["txid"], 16)))
+        peer.sync_with_ping()
+        assert "notfound" not in peer.last_message
+        peer.send_and_ping(msg_getpkgtxns(int(child["txid"], 16)))
+        with p2p_lock:
+            notfound = peer.last_message["notfound"].vec
+            assert_equal([inv.hash for inv in notfound], [int(child["txid"], 16)])
+            del peer.last_message["pkgtxns"]
+
+        # A request is served again once the bucket refills
+        node.setmocktime(mocktime + UNCONDITIONAL_RELAY_DELAY + 2)
+        peer.send_and_ping(msg_getpkgtxns(int(child["txid"], 16)))
+        assert "pkgtxns" in peer.last_message
+        node.disconnect_p2ps()
+
+    def run_test(self):
+        self.wallet = MiniWallet(self.nodes[0])
+        self.generate(self.wallet, 3)
+        self.generate(self.nodes[0], 100)
+
+        self.test_request_package()
+        self.test_unsolicited_package()
+        self.test_malformed_package()
+        self.test_serve_package()
+
+
+if __name__ == "__main__":
+    PackageRelayTest().main()
@@ -0,0 +1,180 @@
+# Copyright (c) 2024 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the binary encoding of the RPC results, requested with an
+`Accept: application/octet-stream` header."""
+
+import http.client
+import json
+import urllib.parse
+from base64 import b64encode
+from io import BytesIO
+from struct import unpack
+
+from test_framework.messages import (
+    BLOCK_HEADER_SIZE,
+    CTxOut,
+    deser_compact_size,
+    deser_string,
+    deser_uint256,
+    deser_uint256_vector,
+)
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.wallet import MiniWallet
+
+# Version of the binary encoding of the RPC results (RPC_BINARY_VERSION)
+RPC_BINARY_VERSION = 1
+
+
+class RPCBinaryTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.extra_args = [["-txindex"]]
+
+    def call(self, method, *params):
+        """Call a method asking for its binary result, return the HTTP status,
+        the content type and the body of the reply"""
+        url = urllib.parse.urlparse(self.nodes[0].url)
+        authpair = f"{url.username}:{url.password}"
+        headers = {
+            "Authorization": f"Basic {b64encode(authpair.encode()).decode()}",
+            "Accept": "application/octet-stream",
+            "Content-Type": "application/json",
+        }
+        body = json.dumps({"method": method, "params": list(params), "id": 1})
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.request("POST", "/", body, headers)
+        response = conn.getresponse()
+        content_type = response.getheader("Content-Type")
+        data = response.read()
+        conn.close()
+        return response.status, content_type, data
+
+    def call_binary(self, method, *params):
+        status, content_type, data = self.call(method, *params)
+        assert_equal(status, 200)
+        assert_equal(content_type, "application/octet-stream")
+        f = BytesIO(data)
+        assert_equal(f.read(1)[0], RPC_BINARY_VERSION)
+        return f
+
+    def test_getblock(self):
+        self.log.info("Test the binary encoding of getblock")
+        node = self.nodes[0]
+        blockhash = node.getblockhash(100)
+        header = node.getblockheader(blockhash)
+        for verbosity in [0, 1, 2]:
+            f = self.call_binary("getblock", blockhash, verbosity)
+            assert_equal(deser_uint256(f), int(blockhash, 16))
+            assert_equal(unpack("<i", f.read(4))[0], 100)
+            assert_equal(unpack("<i", f.read(4))[0], header["confirmations"])
+            assert_equal(deser_string(f).hex(), node.getblock(blockhash, 0))
+            assert_equal(f.read(), b"")
+
+    def test_getblockheader(self):
+        self.log.info("Test the binary encoding of getblockheader")
+        node = self.nodes[0]
+        blockhash = node.getbestblockhash()
+        f = self.call_binary("getblockheader", blockhash)
+        assert_equal(deser_uint256(f), int(blockhash, 16))
+        assert_equal(unpack("<i", f.read(4))[0], node.getblockcount())
+        assert_equal(unpack("<i", f.read(4))[0], 1)
+        assert_equal(
+            f.read(BLOCK_HEADER_SIZE).hex(), node.getblockheader(blockhash, False)
+        )
+        assert_equal(f.read(), b"")
+
+    def test_getrawtransaction(self):
+        self.log.info("Test the binary encoding of getrawtransaction")
+        node = self.nodes[0]
+        tx = self.wallet.send_self_transfer(from_node=node)
+
+        # An unconfirmed transaction has no block hash
+        f = self.call_binary("getrawtransaction", tx["txid"])
+        assert_equal(deser_uint256(f), 0)
+        assert_equal(deser_string(f).hex(), tx["hex"])
+        assert_equal(f.read(), b"")
+
+        blockhash = self.generate(node, 1)[0]
+        f = self.call_binary("getrawtransaction", tx["txid"], True)
+        assert_equal(deser_uint256(f), int(blockhash, 16))
+        assert_equal(deser_string(f).hex(), tx["hex"])
+        assert_equal(f.read(), b"")
+
+    def test_gettxout(self):
+        self.log.info("Test the binary encoding of gettxout")
+        node = self.nodes[0]
+        tx = self.wallet.send_self_transfer(from_node=node)
+        self.generate(node, 2)
+        txout = node.gettxout(tx["txid"], 0)
+
+        f = self.call_binary("gettxout", tx["txid"], 0)
+        assert_equal(f.read(1), b"\x01")
+        assert_equal(deser_uint256(f), int(node.getbestblockhash(), 16))
+        assert_equal(unpack("<i", f.read(4))[0], 2)
+        output = CTxOut()
+        output.deserialize(f)
+        assert_equal(output.scriptPubKey.hex(), txout["scriptPubKey"]["hex"])
+        assert_equal(output.nValue, tx["tx"].vout[0].nValue)
+        assert_equal(f.read(1), b"\x00")
+        assert_equal(f.read(), b"")
+
+        self.log.info("A missing output is only a flag")
+        f = self.call_binary("gettxout", tx["txid"], 1)
+        assert_equal(f.read(), b"\x00")
+
+    def test_getrawmempool(self):
+        self.log.info("Test the binary encoding of getrawmempool")
+        node = self.nodes[0]
+        txids = [
+            self.wallet.send_self_transfer(from_node=node)["txid"] for _ in range(3)
+        ]
+        mempool = node.getrawmempool(False, True)
+
+        f = self.call_binary("getrawmempool")
+        assert_equal(unpack("<Q", f.read(8))[0], mempool["mempool_sequence"])
+        assert_equal(
+            sorted(deser_uint256_vector(f)), sorted(int(txid, 16) for txid in txids)
+        )
+        assert_equal(f.read(), b"")
+
+        self.log.info("The verbose result has the REST mempool contents format")
+        f = self.call_binary("getrawmempool", True)
+        assert_equal(unpack("<Q", f.read(8))[0], mempool["mempool_sequence"])
+        assert_equal(deser_compact_size(f), len(txids))
+        records = [deser_string(f) for _ in txids]
+        assert_equal(
+            sorted(record[:32][::-1].hex() for record in records), sorted(txids)
+        )
+        assert_equal(f.read(), b"")
+        self.generate(node, 1)
+
+    def test_json_replies(self):
+        self.log.info("The other methods and the errors are replied in JSON")
+        node = self.nodes[0]
+        status, content_type, data = self.call("getblockcount")
+        assert_equal(status, 200)
+        assert_equal(content_type, "application/json")
+        assert_equal(json.loads(data)["result"], node.getblockcount())
+
+        status, content_type, data = self.call("getblock", "00" * 32)
+        assert_equal(status, 500)
+        assert_equal(content_type, "application/json")
+        assert_equal(json.loads(data)["error"]["message"], "Block not found")
+
+    def run_test(self):
+        self.wallet = MiniWallet(self.nodes[0])
+        self.generate(self.wallet, 3)
+        self.generate(self.nodes[0], 100)
+
+        self.test_getblock()
+        self.test_getblockheader()
+        self.test_getrawtransaction()
+        self.test_gettxout()
+        self.test_getrawmempool()
+        self.test_json_replies()
+
+
+if __name__ == "__main__":
+    RPCBinaryTest().main()
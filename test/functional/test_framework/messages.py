@@ -2067,6 +2067,57 @@ class msg_cfcheckpt:
         )
 
 
+class msg_sendpackages:
+    __slots__ = ()
+    msgtype = b"sendpackages"
+
+    def __init__(self):
+        pass
+
+    def deserialize(self, f):
+        pass
+
+    def serialize(self):
+        return b""
+
+    def __repr__(self):
+        return "msg_sendpackages()"
+
+
+class msg_getpkgtxns:
+    __slots__ = ("txid",)
+    msgtype = b"getpkgtxns"
+
+    def __init__(self, txid=0):
+        self.txid = txid
+
+    def deserialize(self, f):
+        self.txid = deser_uint256(f)
+
+    def serialize(self):
+        return ser_uint256(self.txid)
+
+    def __repr__(self):
+        return f"msg_getpkgtxns(txid={self.txid:064x})"
+
+
+class msg_pkgtxns:
+    __slots__ = ("txs",)
+    msgtype = b"pkgtxns"
+
+    def __init__(self, txs=None):
+        self.txs = txs if txs is not None else []
+
+    def deserialize(self, f):
+        self.txs = deser_vector(f, CTransaction)
+
+    def serialize(self):
+        return ser_vector(self.txs)
+
+    def __repr__(self):
+        return f"msg_pkgtxns(txs={self.txs!r})"
+
+
 class msg_avaproof:
     __slots__ = ("proof",)
     msgtype = b"avaproof"
@@ -58,16 +58,19 @@ from test_framework.messages import (
     msg_getblocktxn,
     msg_getdata,
     msg_getheaders,
+    msg_getpkgtxns,
     msg_headers,
     msg_inv,
     msg_mempool,
     msg_merkleblock,
     msg_notfound,
     msg_ping,
+    msg_pkgtxns,
     msg_pong,
     msg_sendaddrv2,
     msg_sendcmpct,
     msg_sendheaders,
+    msg_sendpackages,
     msg_tcpavaresponse,
     msg_tx,
     msg_verack,
@@ -117,16 +120,19 @@ MESSAGEMAP = {
     b"getblocktxn": msg_getblocktxn,
     b"getdata": msg_getdata,
     b"getheaders": msg_getheaders,
+    b"getpkgtxns": msg_getpkgtxns,
     b"headers": msg_headers,
     b"inv": msg_inv,
     b"mempool": msg_mempool,
     b"merkleblock": msg_merkleblock,
     b"notfound": msg_notfound,
     b"ping": msg_ping,
+    b"pkgtxns": msg_pkgtxns,
     b"pong": msg_pong,
     b"sendaddrv2": msg_sendaddrv2,
     b"sendcmpct": msg_sendcmpct,
     b"sendheaders": msg_sendheaders,
+    b"sendpackages": msg_sendpackages,
     b"tx": msg_tx,
     b"verack": msg_verack,
     b"version": msg_version,
@@ -502,6 +508,9 @@ class P2PInterface(P2PConnection):
     def on_getheaders(self, message):
         pass
 
+    def on_getpkgtxns(self, message):
+        pass
+
     def on_headers(self, message):
         pass
 
@@ -514,6 +523,9 @@ class P2PInterface(P2PConnection):
     def on_notfound(self, message):
         pass
 
+    def on_pkgtxns(self, message):
+        pass
+
     def on_pong(self, message):
         pass
 
@@ -526,6 +538,9 @@ class P2PInterface(P2PConnection):
     def on_sendheaders(self, message):
         pass
 
+    def on_sendpackages(self, message):
+        pass
+
     def on_tx(self, message):
         pass
 